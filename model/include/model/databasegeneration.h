@@ -0,0 +1,45 @@
+#ifndef CC_MODEL_DATABASEGENERATION_H
+#define CC_MODEL_DATABASEGENERATION_H
+
+#include <cstdint>
+#include <memory>
+
+#include <odb/core.hxx>
+#include <odb/database.hxx>
+
+namespace cc
+{
+namespace model
+{
+
+/**
+ * Counter which the parser increments at the end of every parsing. Readers
+ * which keep data of the database in memory (e.g. the file cache of the
+ * webserver) compare it to detect that the project has been reparsed. The
+ * table has a single row.
+ */
+#pragma db object
+struct DatabaseGeneration
+{
+  #pragma db id
+  int id;
+
+  #pragma db not_null
+  std::uint64_t generation;
+};
+
+/**
+ * Returns the generation of the database, or 0 if it has never been set, e.g.
+ * in the database of a project parsed by an earlier version.
+ */
+std::uint64_t loadDatabaseGeneration(std::shared_ptr<odb::database> db_);
+
+/**
+ * Increments the generation of the database.
+ */
+void incrementDatabaseGeneration(std::shared_ptr<odb::database> db_);
+
+} // model
+} // cc
+
+#endif // CC_MODEL_DATABASEGENERATION_H
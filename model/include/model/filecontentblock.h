@@ -0,0 +1,99 @@
+#ifndef CC_MODEL_FILECONTENTBLOCK_H
+#define CC_MODEL_FILECONTENTBLOCK_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <odb/core.hxx>
+
+namespace cc
+{
+namespace model
+{
+
+/**
+ * Describes a FileContent whose text is stored compressed in FileContentBlock
+ * rows. The content attribute of such a FileContent is empty. The contents
+ * are compressed after parsing, see model/filecontentstore.h.
+ */
+#pragma db object
+struct FileContentIndex
+{
+  /**
+   * Hash of the FileContent.
+   */
+  #pragma db id not_null
+  std::string hash;
+
+  /**
+   * Size of the uncompressed content in bytes.
+   */
+  #pragma db not_null
+  std::uint64_t size;
+
+  /**
+   * ID of the FileContentDictionary used by the blocks, 0 if none.
+   */
+  #pragma db not_null
+  std::uint64_t dictionary;
+
+  /**
+   * Offsets of the beginnings of the lines after the first one, encoded as
+   * varint deltas.
+   */
+  #pragma db not_null
+  std::vector<char> lineOffsets;
+};
+
+typedef std::shared_ptr<FileContentIndex> FileContentIndexPtr;
+
+/**
+ * A compressed, fixed size part of a file content. Block n holds the bytes
+ * [n * FILE_CONTENT_BLOCK_SIZE, (n + 1) * FILE_CONTENT_BLOCK_SIZE) of the
+ * content.
+ */
+#pragma db object
+struct FileContentBlock
+{
+  #pragma db id auto
+  std::uint64_t id;
+
+  #pragma db not_null
+  std::string hash;
+
+  #pragma db not_null
+  std::uint32_t number;
+
+  #pragma db not_null
+  std::vector<char> data;
+
+#pragma db index("FileContentBlock_hash_number_idx") \
+  unique members(hash, number)
+};
+
+/**
+ * A zstd dictionary trained on the file contents of the project.
+ */
+#pragma db object
+struct FileContentDictionary
+{
+  #pragma db id auto
+  std::uint64_t id;
+
+  #pragma db not_null
+  std::vector<char> data;
+};
+
+#pragma db view object(FileContentIndex)
+struct FileContentIndexSize
+{
+  std::string hash;
+  std::uint64_t size;
+};
+
+} // model
+} // cc
+
+#endif // CC_MODEL_FILECONTENTBLOCK_H
@@ -0,0 +1,70 @@
+#ifndef CC_MODEL_FILECONTENTSTORE_H
+#define CC_MODEL_FILECONTENTSTORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include <odb/database.hxx>
+
+#include <model/filecontent.h>
+
+namespace cc
+{
+namespace model
+{
+
+/**
+ * Size of the uncompressed parts of a file content which are compressed
+ * independently into FileContentBlock rows.
+ */
+constexpr std::size_t FILE_CONTENT_BLOCK_SIZE = 16 * 1024;
+
+/**
+ * Returns the text of a file content, which may be stored either as plain
+ * text or compressed. This function must be called in a transaction.
+ */
+std::string loadFileContent(odb::database& db_, const FileContent& content_);
+
+/**
+ * Returns the lines [firstLine_, lastLine_] (numbered from 1) of a file
+ * content, including the line break at the end of the last line. For a
+ * compressed content only the blocks covering these lines are fetched and
+ * decompressed. This function must be called in a transaction.
+ */
+std::string loadFileLines(
+  odb::database& db_,
+  const FileContent& content_,
+  std::size_t firstLine_,
+  std::size_t lastLine_);
+
+/**
+ * Erases a file content together with its compressed blocks. This function
+ * must be called in a transaction.
+ */
+void eraseFileContent(odb::database& db_, const std::string& hash_);
+
+struct FileContentCompressionReport
+{
+  std::size_t files = 0;
+  std::uint64_t rawSize = 0; /*!< Size of the plain texts. */
+  std::uint64_t compressedSize = 0; /*!< Blocks and line offset tables. */
+  std::uint64_t dictionarySize = 0; /*!< Size of a newly trained dictionary. */
+};
+
+/**
+ * Compresses the file contents which are stored as plain text with zstd and
+ * clears their plain text. On the first call in a project a dictionary is
+ * trained on the contents, later contents are compressed with the same
+ * dictionary. This converts the contents of older workspaces too.
+ * @param threadNum_ Number of threads compressing the contents.
+ */
+FileContentCompressionReport compressFileContents(
+  std::shared_ptr<odb::database> db_,
+  int threadNum_);
+
+} // model
+} // cc
+
+#endif // CC_MODEL_FILECONTENTSTORE_H
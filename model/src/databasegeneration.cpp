@@ -0,0 +1,62 @@
+#include <odb/exception.hxx>
+
+#include <util/odbtransaction.h>
+
+#include <model/databasegeneration.h>
+#include <model/databasegeneration-odb.hxx>
+
+namespace
+{
+
+/**
+ * ID of the only row of the DatabaseGeneration table.
+ */
+constexpr int GENERATION_ID = 1;
+
+} // namespace
+
+namespace cc
+{
+namespace model
+{
+
+std::uint64_t loadDatabaseGeneration(std::shared_ptr<odb::database> db_)
+{
+  try
+  {
+    return util::OdbTransaction {db_} ([&]{
+      std::shared_ptr<DatabaseGeneration> generation
+        = db_->find<DatabaseGeneration>(GENERATION_ID);
+      return generation ? generation->generation : std::uint64_t(0);
+    });
+  }
+  catch (const odb::exception&)
+  {
+    // The table doesn't exist yet.
+    return 0;
+  }
+}
+
+void incrementDatabaseGeneration(std::shared_ptr<odb::database> db_)
+{
+  util::OdbTransaction {db_} ([&]{
+    std::shared_ptr<DatabaseGeneration> generation
+      = db_->find<DatabaseGeneration>(GENERATION_ID);
+
+    if (generation)
+    {
+      ++generation->generation;
+      db_->update(*generation);
+    }
+    else
+    {
+      DatabaseGeneration first;
+      first.id = GENERATION_ID;
+      first.generation = 1;
+      db_->persist(first);
+    }
+  });
+}
+
+} // model
+} // cc
@@ -0,0 +1,516 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <zstd.h>
+#include <zdict.h>
+
+#include <util/logutil.h>
+#include <util/odbtransaction.h>
+
+#include <model/filecontent.h>
+#include <model/filecontent-odb.hxx>
+#include <model/filecontentblock.h>
+#include <model/filecontentblock-odb.hxx>
+#include <model/filecontentstore.h>
+
+namespace
+{
+
+/**
+ * Compression level of the blocks. Contents are compressed once and read
+ * many times, and the decompression speed doesn't depend on the level.
+ */
+constexpr int COMPRESSION_LEVEL = 9;
+
+/**
+ * Number of contents loaded, compressed and written in one transaction.
+ */
+constexpr std::size_t BATCH_SIZE = 256;
+
+/**
+ * Maximum size of the dictionary and of the samples it is trained on.
+ */
+constexpr std::size_t DICTIONARY_SIZE = 112640;
+constexpr std::size_t SAMPLE_BUDGET = 16 * 1024 * 1024;
+
+/**
+ * Number of files the training samples are taken from and the minimal number
+ * of samples a dictionary is worth training on.
+ */
+constexpr std::size_t SAMPLE_FILES = 4096;
+constexpr std::size_t MIN_SAMPLES = 64;
+
+using namespace cc::model;
+
+struct CCtxDeleter
+{
+  void operator()(ZSTD_CCtx* ctx_) const { ZSTD_freeCCtx(ctx_); }
+};
+
+struct DCtxDeleter
+{
+  void operator()(ZSTD_DCtx* ctx_) const { ZSTD_freeDCtx(ctx_); }
+};
+
+struct CDictDeleter
+{
+  void operator()(ZSTD_CDict* dict_) const { ZSTD_freeCDict(dict_); }
+};
+
+struct DDictDeleter
+{
+  void operator()(ZSTD_DDict* dict_) const { ZSTD_freeDDict(dict_); }
+};
+
+void putVarint(std::vector<char>& out_, std::uint64_t value_)
+{
+  while (value_ >= 0x80)
+  {
+    out_.push_back(static_cast<char>((value_ & 0x7f) | 0x80));
+    value_ >>= 7;
+  }
+  out_.push_back(static_cast<char>(value_));
+}
+
+/**
+ * Returns the offsets where the lines of the content begin. A line break at
+ * the end of the content doesn't start a new line.
+ */
+std::vector<std::uint64_t> lineStarts(const std::string& text_)
+{
+  std::vector<std::uint64_t> starts{0};
+
+  for (std::size_t pos = text_.find('\n');
+       pos != std::string::npos && pos + 1 < text_.size();
+       pos = text_.find('\n', pos + 1))
+    starts.push_back(pos + 1);
+
+  return starts;
+}
+
+std::vector<std::uint64_t> lineStarts(const FileContentIndex& index_)
+{
+  std::vector<std::uint64_t> starts{0};
+  std::uint64_t value = 0;
+  unsigned shift = 0;
+
+  for (char c : index_.lineOffsets)
+  {
+    value |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+    shift += 7;
+
+    if (!(c & 0x80))
+    {
+      starts.push_back(starts.back() + value);
+      value = 0;
+      shift = 0;
+    }
+  }
+
+  return starts;
+}
+
+/**
+ * Returns the decompression dictionary of the given ID. Dictionaries are
+ * immutable, so they are cached for the lifetime of the process.
+ */
+std::shared_ptr<ZSTD_DDict> loadDictionary(
+  odb::database& db_,
+  std::uint64_t id_)
+{
+  static std::mutex mutex;
+  static std::map<std::pair<odb::database*, std::uint64_t>,
+    std::shared_ptr<ZSTD_DDict>> dictionaries;
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = dictionaries.find({&db_, id_});
+  if (it != dictionaries.end())
+    return it->second;
+
+  std::shared_ptr<FileContentDictionary> dictionary
+    = db_.find<FileContentDictionary>(id_);
+
+  if (!dictionary)
+    throw std::runtime_error(
+      "Missing file content dictionary: " + std::to_string(id_));
+
+  std::shared_ptr<ZSTD_DDict> ddict(
+    ZSTD_createDDict(dictionary->data.data(), dictionary->data.size()),
+    DDictDeleter());
+
+  dictionaries.emplace(std::make_pair(&db_, id_), ddict);
+  return ddict;
+}
+
+/**
+ * Returns the bytes [begin_, end_) of a compressed content.
+ */
+std::string readRange(
+  odb::database& db_,
+  const FileContentIndex& index_,
+  std::uint64_t begin_,
+  std::uint64_t end_)
+{
+  typedef odb::query<FileContentBlock> BlockQuery;
+
+  end_ = std::min(end_, index_.size);
+  if (begin_ >= end_)
+    return std::string();
+
+  static thread_local std::unique_ptr<ZSTD_DCtx, DCtxDeleter> dctx(
+    ZSTD_createDCtx());
+
+  std::shared_ptr<ZSTD_DDict> ddict;
+  if (index_.dictionary)
+    ddict = loadDictionary(db_, index_.dictionary);
+
+  std::uint32_t firstBlock = begin_ / FILE_CONTENT_BLOCK_SIZE;
+  std::uint32_t lastBlock = (end_ - 1) / FILE_CONTENT_BLOCK_SIZE;
+
+  std::uint64_t rangeBegin
+    = static_cast<std::uint64_t>(firstBlock) * FILE_CONTENT_BLOCK_SIZE;
+  std::string text(
+    std::min<std::uint64_t>(
+      index_.size - rangeBegin,
+      (lastBlock - firstBlock + 1) * FILE_CONTENT_BLOCK_SIZE),
+    '\0');
+
+  for (const FileContentBlock& block : db_.query<FileContentBlock>(
+    (BlockQuery::hash == index_.hash &&
+     BlockQuery::number >= firstBlock &&
+     BlockQuery::number <= lastBlock) + "ORDER BY" + BlockQuery::number))
+  {
+    std::size_t offset
+      = (block.number - firstBlock) * FILE_CONTENT_BLOCK_SIZE;
+    std::size_t capacity
+      = std::min(FILE_CONTENT_BLOCK_SIZE, text.size() - offset);
+
+    std::size_t size = ddict
+      ? ZSTD_decompress_usingDDict(dctx.get(), &text[offset], capacity,
+          block.data.data(), block.data.size(), ddict.get())
+      : ZSTD_decompressDCtx(dctx.get(), &text[offset], capacity,
+          block.data.data(), block.data.size());
+
+    if (ZSTD_isError(size))
+      throw std::runtime_error("Failed to decompress block "
+        + std::to_string(block.number) + " of file content " + index_.hash
+        + ": " + ZSTD_getErrorName(size));
+  }
+
+  return text.substr(begin_ - rangeBegin, end_ - begin_);
+}
+
+/**
+ * Compressed form of a file content.
+ */
+struct CompressedContent
+{
+  FileContentIndex index;
+  std::vector<std::vector<char>> blocks;
+};
+
+CompressedContent compress(
+  const FileContent& content_,
+  std::uint64_t dictionaryId_,
+  ZSTD_CCtx* cctx_,
+  const ZSTD_CDict* cdict_)
+{
+  const std::string& text = content_.content;
+
+  CompressedContent result;
+  result.index.hash = content_.hash;
+  result.index.size = text.size();
+  result.index.dictionary = dictionaryId_;
+
+  std::vector<std::uint64_t> starts = lineStarts(text);
+  for (std::size_t i = 1; i < starts.size(); ++i)
+    putVarint(result.index.lineOffsets, starts[i] - starts[i - 1]);
+
+  for (std::size_t offset = 0; offset < text.size();
+       offset += FILE_CONTENT_BLOCK_SIZE)
+  {
+    std::size_t size = std::min(FILE_CONTENT_BLOCK_SIZE, text.size() - offset);
+    std::vector<char> block(ZSTD_compressBound(size));
+
+    std::size_t compressed = cdict_
+      ? ZSTD_compress_usingCDict(cctx_, block.data(), block.size(),
+          text.data() + offset, size, cdict_)
+      : ZSTD_compressCCtx(cctx_, block.data(), block.size(),
+          text.data() + offset, size, COMPRESSION_LEVEL);
+
+    if (ZSTD_isError(compressed))
+      throw std::runtime_error("Failed to compress file content "
+        + content_.hash + ": " + ZSTD_getErrorName(compressed));
+
+    block.resize(compressed);
+    result.blocks.push_back(std::move(block));
+  }
+
+  return result;
+}
+
+/**
+ * Trains a dictionary on blocks of the given contents. Returns an empty
+ * dictionary if there are too few samples or the training fails.
+ */
+std::vector<char> trainDictionary(
+  std::shared_ptr<odb::database> db_,
+  const std::vector<std::string>& hashes_)
+{
+  std::string samples;
+  std::vector<std::size_t> sampleSizes;
+  std::size_t stride = std::max<std::size_t>(hashes_.size() / SAMPLE_FILES, 1);
+
+  cc::util::OdbTransaction {db_} ([&]{
+    for (std::size_t i = 0;
+         i < hashes_.size() && samples.size() < SAMPLE_BUDGET;
+         i += stride)
+    {
+      std::shared_ptr<FileContent> content
+        = db_->find<FileContent>(hashes_[i]);
+
+      if (!content)
+        continue;
+
+      for (std::size_t offset = 0;
+           offset < content->content.size() && samples.size() < SAMPLE_BUDGET;
+           offset += FILE_CONTENT_BLOCK_SIZE)
+      {
+        std::size_t size = std::min(
+          FILE_CONTENT_BLOCK_SIZE, content->content.size() - offset);
+        samples.append(content->content, offset, size);
+        sampleSizes.push_back(size);
+      }
+    }
+  });
+
+  if (sampleSizes.size() < MIN_SAMPLES)
+    return {};
+
+  std::vector<char> dictionary(DICTIONARY_SIZE);
+  std::size_t size = ZDICT_trainFromBuffer(
+    dictionary.data(), dictionary.size(),
+    samples.data(), sampleSizes.data(), sampleSizes.size());
+
+  if (ZDICT_isError(size))
+  {
+    LOG(warning) << "Failed to train a file content dictionary: "
+      << ZDICT_getErrorName(size);
+    return {};
+  }
+
+  dictionary.resize(size);
+  return dictionary;
+}
+
+} // namespace
+
+namespace cc
+{
+namespace model
+{
+
+std::string loadFileContent(odb::database& db_, const FileContent& content_)
+{
+  if (!content_.content.empty())
+    return content_.content;
+
+  FileContentIndexPtr index = db_.find<FileContentIndex>(content_.hash);
+  return index ? readRange(db_, *index, 0, index->size) : std::string();
+}
+
+std::string loadFileLines(
+  odb::database& db_,
+  const FileContent& content_,
+  std::size_t firstLine_,
+  std::size_t lastLine_)
+{
+  firstLine_ = std::max<std::size_t>(firstLine_, 1);
+  if (lastLine_ < firstLine_)
+    return std::string();
+
+  if (!content_.content.empty())
+  {
+    std::vector<std::uint64_t> starts = lineStarts(content_.content);
+
+    if (firstLine_ > starts.size())
+      return std::string();
+
+    std::uint64_t end = lastLine_ < starts.size()
+      ? starts[lastLine_]
+      : content_.content.size();
+
+    return content_.content.substr(
+      starts[firstLine_ - 1], end - starts[firstLine_ - 1]);
+  }
+
+  FileContentIndexPtr index = db_.find<FileContentIndex>(content_.hash);
+  if (!index)
+    return std::string();
+
+  std::vector<std::uint64_t> starts = lineStarts(*index);
+
+  if (firstLine_ > starts.size())
+    return std::string();
+
+  std::uint64_t end = lastLine_ < starts.size()
+    ? starts[lastLine_]
+    : index->size;
+
+  return readRange(db_, *index, starts[firstLine_ - 1], end);
+}
+
+void eraseFileContent(odb::database& db_, const std::string& hash_)
+{
+  db_.erase_query<FileContentBlock>(
+    odb::query<FileContentBlock>::hash == hash_);
+  db_.erase_query<FileContentIndex>(
+    odb::query<FileContentIndex>::hash == hash_);
+  db_.erase<FileContent>(hash_);
+}
+
+FileContentCompressionReport compressFileContents(
+  std::shared_ptr<odb::database> db_,
+  int threadNum_)
+{
+  FileContentCompressionReport report;
+
+  //--- Collect the plain contents ---//
+
+  std::vector<std::string> hashes;
+  std::uint64_t dictionaryId = 0;
+  std::vector<char> dictionary;
+
+  util::OdbTransaction {db_} ([&]{
+    std::unordered_set<std::string> compressed;
+    for (const FileContentIndexSize& index
+      : db_->query<FileContentIndexSize>())
+      compressed.insert(index.hash);
+
+    for (const FileContentIds& content : db_->query<FileContentIds>())
+      if (!compressed.count(content.hash))
+        hashes.push_back(content.hash);
+
+    // Normally there is a single dictionary, the one trained first.
+    for (const FileContentDictionary& dict
+      : db_->query<FileContentDictionary>())
+      if (!dictionaryId || dict.id < dictionaryId)
+      {
+        dictionaryId = dict.id;
+        dictionary = dict.data;
+      }
+  });
+
+  if (hashes.empty())
+    return report;
+
+  //--- Train a dictionary for the project ---//
+
+  if (!dictionaryId)
+  {
+    dictionary = trainDictionary(db_, hashes);
+
+    if (!dictionary.empty())
+      util::OdbTransaction {db_} ([&]{
+        FileContentDictionary dict;
+        dict.data = dictionary;
+        dictionaryId = db_->persist(dict);
+      });
+
+    report.dictionarySize = dictionary.size();
+  }
+
+  std::unique_ptr<ZSTD_CDict, CDictDeleter> cdict(dictionary.empty()
+    ? nullptr
+    : ZSTD_createCDict(
+        dictionary.data(), dictionary.size(), COMPRESSION_LEVEL));
+
+  //--- Compress the contents batch by batch ---//
+
+  std::size_t threadNum = std::max(threadNum_, 1);
+
+  for (std::size_t batch = 0; batch < hashes.size(); batch += BATCH_SIZE)
+  {
+    std::vector<FileContent> contents;
+
+    util::OdbTransaction {db_} ([&]{
+      for (std::size_t i = batch;
+           i < std::min(batch + BATCH_SIZE, hashes.size());
+           ++i)
+        if (std::shared_ptr<FileContent> content
+          = db_->find<FileContent>(hashes[i]))
+          contents.push_back(std::move(*content));
+    });
+
+    std::vector<CompressedContent> results(contents.size());
+    std::atomic<std::size_t> next(0);
+    std::vector<std::thread> threads;
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    for (std::size_t i = 0; i < std::min(threadNum, contents.size()); ++i)
+      threads.emplace_back([&]{
+        std::unique_ptr<ZSTD_CCtx, CCtxDeleter> cctx(ZSTD_createCCtx());
+
+        try
+        {
+          for (std::size_t j = next++; j < contents.size(); j = next++)
+            results[j] = compress(
+              contents[j], dictionaryId, cctx.get(), cdict.get());
+        }
+        catch (...)
+        {
+          std::lock_guard<std::mutex> lock(errorMutex);
+          if (!error)
+            error = std::current_exception();
+          next = contents.size();
+        }
+      });
+
+    for (std::thread& thread : threads)
+      thread.join();
+
+    if (error)
+      std::rethrow_exception(error);
+
+    util::OdbTransaction {db_} ([&]{
+      for (std::size_t i = 0; i < contents.size(); ++i)
+      {
+        db_->persist(results[i].index);
+
+        FileContentBlock block;
+        block.hash = contents[i].hash;
+        block.number = 0;
+
+        for (std::vector<char>& data : results[i].blocks)
+        {
+          report.compressedSize += data.size();
+          block.data = std::move(data);
+          db_->persist(block);
+          ++block.number;
+        }
+
+        report.rawSize += contents[i].content.size();
+        report.compressedSize += results[i].index.lineOffsets.size();
+        ++report.files;
+
+        contents[i].content.clear();
+        db_->update(contents[i]);
+      }
+    });
+  }
+
+  return report;
+}
+
+} // model
+} // cc
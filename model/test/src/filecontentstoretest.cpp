@@ -0,0 +1,351 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <util/dbutil.h>
+#include <util/hash.h>
+#include <util/odbtransaction.h>
+
+#include <model/filecontent.h>
+#include <model/filecontent-odb.hxx>
+#include <model/filecontentblock.h>
+#include <model/filecontentblock-odb.hxx>
+#include <model/filecontentstore.h>
+
+using namespace cc::model;
+
+namespace fs = boost::filesystem;
+
+// The tests run on a temporary SQLite database.
+#ifdef DATABASE_SQLITE
+
+namespace
+{
+
+/**
+ * Returns a source-like text of at least the given size. The identifiers are
+ * pseudo-random, so the blocks of different texts are similar but not equal.
+ */
+std::string sourceText(std::uint32_t seed_, std::size_t size_)
+{
+  std::string text;
+  std::uint32_t state = seed_ * 2654435761u + 1;
+
+  for (std::size_t line = 0; text.size() < size_; ++line)
+  {
+    state = state * 1664525u + 1013904223u;
+    text += "int function" + std::to_string(state % 10007)
+      + "(int value) { return value * " + std::to_string(line % 97)
+      + "; }" + std::string(state % 7, ' ') + '\n';
+  }
+
+  return text;
+}
+
+/**
+ * Returns the lines [first_, last_] (numbered from 1) of the text.
+ */
+std::string textLines(
+  const std::string& text_,
+  std::size_t first_,
+  std::size_t last_)
+{
+  std::size_t begin = 0;
+  for (std::size_t line = 1; line < first_ && begin < text_.size(); ++line)
+  {
+    begin = text_.find('\n', begin);
+    begin = begin == std::string::npos ? text_.size() : begin + 1;
+  }
+
+  std::size_t end = begin;
+  for (std::size_t line = first_; line <= last_ && end < text_.size(); ++line)
+  {
+    end = text_.find('\n', end);
+    end = end == std::string::npos ? text_.size() : end + 1;
+  }
+
+  return text_.substr(begin, end - begin);
+}
+
+/**
+ * Returns the number (from 1) of the line which contains the given offset.
+ */
+std::size_t lineOf(const std::string& text_, std::size_t offset_)
+{
+  return std::count(text_.begin(), text_.begin() + offset_, '\n') + 1;
+}
+
+} // namespace
+
+class FileContentStoreTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/filecontentstoretestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = dir;
+
+    _db = cc::util::connectDatabase(
+      "sqlite:database=" + _root + "/content.sqlite");
+    ASSERT_NE(nullptr, _db);
+
+    cc::util::createTables(_db, MODEL_SQL_DIR);
+  }
+
+  void TearDown() override
+  {
+    _db.reset();
+
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  /**
+   * Stores the text as a plain file content and returns its hash.
+   */
+  std::string persist(const std::string& text_)
+  {
+    FileContent content;
+    content.hash = cc::util::sha1Hash(text_);
+    content.content = text_;
+
+    cc::util::OdbTransaction {_db} ([&]{
+      _db->persist(content);
+    });
+
+    return content.hash;
+  }
+
+  std::string load(const std::string& hash_)
+  {
+    std::string text;
+
+    cc::util::OdbTransaction {_db} ([&]{
+      std::shared_ptr<FileContent> content = _db->find<FileContent>(hash_);
+      EXPECT_NE(nullptr, content);
+      if (content)
+        text = loadFileContent(*_db, *content);
+    });
+
+    return text;
+  }
+
+  std::string loadLines(
+    const std::string& hash_,
+    std::size_t first_,
+    std::size_t last_)
+  {
+    std::string text;
+
+    cc::util::OdbTransaction {_db} ([&]{
+      std::shared_ptr<FileContent> content = _db->find<FileContent>(hash_);
+      EXPECT_NE(nullptr, content);
+      if (content)
+        text = loadFileLines(*_db, *content, first_, last_);
+    });
+
+    return text;
+  }
+
+  /**
+   * Returns the compression index of the content or nullptr if the content
+   * is stored as plain text. The plain text has to be cleared on
+   * compression.
+   */
+  FileContentIndexPtr index(const std::string& hash_)
+  {
+    FileContentIndexPtr result;
+
+    cc::util::OdbTransaction {_db} ([&]{
+      result = _db->find<FileContentIndex>(hash_);
+
+      std::shared_ptr<FileContent> content = _db->find<FileContent>(hash_);
+      if (result && content)
+        EXPECT_TRUE(content->content.empty());
+    });
+
+    return result;
+  }
+
+  std::string _root;
+  std::shared_ptr<odb::database> _db;
+};
+
+TEST_F(FileContentStoreTest, SmallContents)
+{
+  const std::vector<std::string> texts{
+    "int main()\n{\n  return 0;\n}\n",
+    "no line break at the end\nof the file",
+    "\n\n\n",
+    sourceText(1, 1000)};
+
+  std::vector<std::string> hashes;
+  for (const std::string& text : texts)
+    hashes.push_back(persist(text));
+
+  // The plain contents are read the same way as the compressed ones.
+  EXPECT_EQ(texts[0], load(hashes[0]));
+  EXPECT_EQ("{\n  return 0;\n", loadLines(hashes[0], 2, 3));
+
+  FileContentCompressionReport report = compressFileContents(_db, 2);
+
+  // Too few blocks to train a dictionary on.
+  EXPECT_EQ(texts.size(), report.files);
+  EXPECT_EQ(0u, report.dictionarySize);
+  EXPECT_GT(report.compressedSize, 0u);
+
+  for (std::size_t i = 0; i < texts.size(); ++i)
+  {
+    FileContentIndexPtr contentIndex = index(hashes[i]);
+    ASSERT_NE(nullptr, contentIndex);
+    EXPECT_EQ(0u, contentIndex->dictionary);
+    EXPECT_EQ(texts[i].size(), contentIndex->size);
+
+    EXPECT_EQ(texts[i], load(hashes[i]));
+  }
+
+  EXPECT_EQ("{\n  return 0;\n", loadLines(hashes[0], 2, 3));
+  EXPECT_EQ("}\n", loadLines(hashes[0], 4, 10));
+  EXPECT_EQ("", loadLines(hashes[0], 5, 10));
+  EXPECT_EQ("", loadLines(hashes[0], 3, 2));
+
+  EXPECT_EQ("of the file", loadLines(hashes[1], 2, 2));
+  EXPECT_EQ(texts[1], loadLines(hashes[1], 0, 2));
+
+  EXPECT_EQ("\n", loadLines(hashes[2], 3, 3));
+  EXPECT_EQ(textLines(texts[3], 5, 12), loadLines(hashes[3], 5, 12));
+}
+
+TEST_F(FileContentStoreTest, EmptyContent)
+{
+  std::string hash = persist("");
+
+  EXPECT_EQ(1u, compressFileContents(_db, 1).files);
+
+  FileContentIndexPtr contentIndex = index(hash);
+  ASSERT_NE(nullptr, contentIndex);
+  EXPECT_EQ(0u, contentIndex->size);
+
+  EXPECT_EQ("", load(hash));
+  EXPECT_EQ("", loadLines(hash, 1, 1));
+  EXPECT_EQ("", loadLines(hash, 1, 100));
+}
+
+TEST_F(FileContentStoreTest, LinesAcrossBlocks)
+{
+  // The content spans several blocks and the last block is not full.
+  const std::string text = sourceText(2, 5 * FILE_CONTENT_BLOCK_SIZE + 100);
+  std::string hash = persist(text);
+
+  compressFileContents(_db, 1);
+
+  ASSERT_NE(nullptr, index(hash));
+  EXPECT_EQ(text, load(hash));
+
+  for (std::size_t block = 1; block <= 5; ++block)
+  {
+    // The lines around the block boundary.
+    std::size_t line = lineOf(text, block * FILE_CONTENT_BLOCK_SIZE);
+    EXPECT_EQ(textLines(text, line - 1, line + 1),
+      loadLines(hash, line - 1, line + 1)) << block;
+    EXPECT_EQ(textLines(text, line, line), loadLines(hash, line, line))
+      << block;
+  }
+
+  // Lines covering several whole blocks.
+  std::size_t first = lineOf(text, FILE_CONTENT_BLOCK_SIZE / 2);
+  std::size_t last = lineOf(text, 4 * FILE_CONTENT_BLOCK_SIZE + 10);
+  EXPECT_EQ(textLines(text, first, last), loadLines(hash, first, last));
+
+  std::size_t lines = lineOf(text, text.size() - 1);
+  EXPECT_EQ(textLines(text, lines, lines), loadLines(hash, lines, lines + 5));
+  EXPECT_EQ("", loadLines(hash, lines + 1, lines + 5));
+}
+
+TEST_F(FileContentStoreTest, Dictionary)
+{
+  // Every content has two blocks, which is enough to train a dictionary on.
+  std::vector<std::string> texts;
+  std::vector<std::string> hashes;
+
+  for (std::uint32_t i = 0; i < 40; ++i)
+  {
+    texts.push_back(sourceText(i + 10, FILE_CONTENT_BLOCK_SIZE + 1000));
+    hashes.push_back(persist(texts.back()));
+  }
+
+  FileContentCompressionReport report = compressFileContents(_db, 4);
+
+  EXPECT_EQ(texts.size(), report.files);
+  ASSERT_GT(report.dictionarySize, 0u);
+
+  FileContentIndexPtr firstIndex = index(hashes[0]);
+  ASSERT_NE(nullptr, firstIndex);
+  std::uint64_t dictionary = firstIndex->dictionary;
+  EXPECT_NE(0u, dictionary);
+
+  for (std::size_t i = 0; i < texts.size(); ++i)
+  {
+    FileContentIndexPtr contentIndex = index(hashes[i]);
+    ASSERT_NE(nullptr, contentIndex);
+    EXPECT_EQ(dictionary, contentIndex->dictionary);
+
+    EXPECT_EQ(texts[i], load(hashes[i]));
+
+    std::size_t line = lineOf(texts[i], FILE_CONTENT_BLOCK_SIZE);
+    EXPECT_EQ(textLines(texts[i], line - 2, line + 2),
+      loadLines(hashes[i], line - 2, line + 2));
+  }
+
+  // The contents of a later run are compressed with the same dictionary,
+  // even if they are too few to train one.
+  const std::string text = sourceText(100, 3 * FILE_CONTENT_BLOCK_SIZE);
+  std::string hash = persist(text);
+
+  report = compressFileContents(_db, 1);
+
+  EXPECT_EQ(1u, report.files);
+  EXPECT_EQ(0u, report.dictionarySize);
+
+  FileContentIndexPtr contentIndex = index(hash);
+  ASSERT_NE(nullptr, contentIndex);
+  EXPECT_EQ(dictionary, contentIndex->dictionary);
+
+  EXPECT_EQ(text, load(hash));
+
+  std::size_t line = lineOf(text, 2 * FILE_CONTENT_BLOCK_SIZE);
+  EXPECT_EQ(textLines(text, line, line + 1), loadLines(hash, line, line + 1));
+}
+
+TEST_F(FileContentStoreTest, Erase)
+{
+  const std::string text = sourceText(3, 2 * FILE_CONTENT_BLOCK_SIZE);
+  std::string hash = persist(text);
+
+  compressFileContents(_db, 1);
+  ASSERT_NE(nullptr, index(hash));
+
+  cc::util::OdbTransaction {_db} ([&]{
+    eraseFileContent(*_db, hash);
+
+    EXPECT_EQ(nullptr, _db->find<FileContent>(hash));
+    EXPECT_TRUE(_db->query<FileContentBlock>(
+      odb::query<FileContentBlock>::hash == hash).empty());
+  });
+
+  EXPECT_EQ(nullptr, index(hash));
+}
+
+#endif
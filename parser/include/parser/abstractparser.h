@@ -18,7 +18,8 @@ public:
    * Constructor, initialize the parsers
    * @param ctx_ - Parser context options
    */
-  AbstractParser(ParserContext& ctx_) : _ctx(ctx_){} 
+  AbstractParser(ParserContext& ctx_)
+    : _ctx(ctx_), _threadNum(ctx_.options["jobs"].as<int>()){}
   
   /**
    * Destructor
@@ -44,9 +45,70 @@ public:
    * @return Returns true if the parse succeeded, false otherwise.
    */
   virtual bool parse() = 0;
-  
+
+  /**
+   * Names of the plugins (e.g.: cppparser) whose parse() has to finish before
+   * the parse() of this plugin starts. Plugins which are not loaded are
+   * ignored. Plugins without dependencies on each other parse in parallel.
+   */
+  virtual std::vector<std::string> dependencies() const
+  {
+    return {};
+  }
+
+  /**
+   * Returns false if parse() does its work on a single thread. These plugins
+   * take only one thread from the --jobs budget.
+   */
+  virtual bool multiThreaded() const
+  {
+    return true;
+  }
+
+  /**
+   * Returns true if parse() must not run at the same time as other plugins,
+   * e.g. because it forks processes, which would copy the state of the other
+   * plugins' threads in the middle of their work.
+   */
+  virtual bool exclusive() const
+  {
+    return false;
+  }
+
+  /**
+   * Returns true if the plugin updates its data incrementally, i.e. its
+   * cleanupDatabase() removes the data of the changed files and its parse()
+   * processes only the changed ones. Only these plugins are run when the
+   * parser watches the inputs for changes.
+   */
+  virtual bool incremental() const
+  {
+    return false;
+  }
+
+  /**
+   * Sets the number of threads the plugin can use. The parser driver shares
+   * the --jobs budget among the plugins running at the same time.
+   */
+  void setThreadNum(int threadNum_)
+  {
+    _threadNum = threadNum_;
+  }
+
 protected:
+  /**
+   * Number of threads the plugin can use. This is the --jobs option unless
+   * the parser driver granted a smaller share of it.
+   */
+  int threadNum() const
+  {
+    return _threadNum;
+  }
+
   ParserContext& _ctx;
+
+private:
+  int _threadNum;
 };
 
 } // parser
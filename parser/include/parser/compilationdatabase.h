@@ -0,0 +1,118 @@
+#ifndef CC_PARSER_COMPILATIONDATABASE_H
+#define CC_PARSER_COMPILATIONDATABASE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Compile commands of a JSON compilation database
+ * (http://clang.llvm.org/docs/JSONCompilationDatabase.html).
+ *
+ * The file is memory-mapped and read in one pass, one command object at a
+ * time. The strings of the commands are interned, so the flags repeated by
+ * thousands of commands are stored once, and a command is only a list of
+ * string IDs. The commands are built on demand by command().
+ *
+ * The command lines are split the same way as by Clang's
+ * JSONCompilationDatabase with the GNU command line syntax, including the
+ * removal of compiler wrappers like ccache.
+ */
+class CompilationDatabase
+{
+public:
+  struct Command
+  {
+    std::string directory;
+    std::string filename;
+    std::vector<std::string> commandLine;
+    std::string output;
+  };
+
+  /**
+   * Reads the compilation database.
+   * @param errorMsg_ The reason if the file can't be read or is malformed.
+   * @return nullptr on error.
+   */
+  static std::unique_ptr<CompilationDatabase> load(
+    const std::string& path_,
+    std::string& errorMsg_);
+
+  CompilationDatabase(const CompilationDatabase&) = delete;
+  CompilationDatabase& operator=(const CompilationDatabase&) = delete;
+
+  /**
+   * Returns the number of compile commands.
+   */
+  std::size_t size() const
+  {
+    return _entries.size();
+  }
+
+  /**
+   * Builds the command of the given index.
+   */
+  Command command(std::size_t index_) const;
+
+  const std::string& directory(std::size_t index_) const
+  {
+    return *_strings[_entries[index_].directory];
+  }
+
+  const std::string& filename(std::size_t index_) const
+  {
+    return *_strings[_entries[index_].filename];
+  }
+
+  /**
+   * Returns the FNV hash of the command line joined by spaces. This is the
+   * hash of model::BuildAction::command too.
+   */
+  std::uint64_t commandHash(std::size_t index_) const
+  {
+    return _entries[index_].commandHash;
+  }
+
+  /**
+   * Returns the number of distinct strings of the commands.
+   */
+  std::size_t stringCount() const
+  {
+    return _strings.size();
+  }
+
+private:
+  struct Entry
+  {
+    std::uint32_t directory;
+    std::uint32_t filename;
+    std::uint32_t output;
+    std::uint32_t argumentCount;
+    std::size_t firstArgument; /*!< Index in _arguments. */
+    std::uint64_t commandHash;
+  };
+
+  class Reader;
+
+  CompilationDatabase() = default;
+
+  std::uint32_t intern(std::string& str_);
+
+  std::unordered_map<std::string, std::uint32_t> _stringIds;
+  std::vector<const std::string*> _strings; /*!< Keys of _stringIds. */
+  std::vector<std::uint32_t> _arguments;
+  std::vector<Entry> _entries;
+};
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_COMPILATIONDATABASE_H
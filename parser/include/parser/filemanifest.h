@@ -0,0 +1,96 @@
+#ifndef CC_PARSER_FILEMANIFEST_H
+#define CC_PARSER_FILEMANIFEST_H
+
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * List of the files and directories under the input paths of the parser. The
+ * parser driver walks the inputs once, in parallel, and the plugins iterate
+ * over this list instead of walking the file system again.
+ */
+class FileManifest
+{
+public:
+  struct Entry
+  {
+    std::string path; /*!< Canonical path. */
+    bool directory = false;
+    std::uint64_t size = 0;
+    std::time_t mtime = 0;
+  };
+
+  struct FileType
+  {
+    std::string mimeType; /*!< Empty if the file couldn't be classified. */
+    bool plainText = false;
+  };
+
+  /**
+   * Walks the given input paths on threadNum_ threads. Symbolic links are
+   * followed, but every directory is visited only once. The entries are
+   * stored with canonical paths, so they are found by the paths of the
+   * SourceManager.
+   * @param inputs_ Directories or regular files. Inputs which don't exist are
+   * skipped with a warning.
+   */
+  void scan(const std::vector<std::string>& inputs_, int threadNum_);
+
+  /**
+   * Updates the entries of the given paths only, instead of scanning the
+   * inputs again. A path which exists is added or refreshed, and a new
+   * directory is walked. The entries of a path which doesn't exist anymore
+   * are removed, including the entries under it. The cached file types of
+   * the paths are dropped.
+   * @param paths_ Changed files and directories under the inputs of the last
+   * scan. They don't have to be canonical.
+   */
+  void update(const std::set<std::string>& paths_);
+
+  /**
+   * Returns the entries ordered by path.
+   */
+  const std::vector<Entry>& entries() const;
+
+  /**
+   * Returns the entry of the given path or nullptr if the path was not found
+   * by the scan. The path has to be canonical.
+   */
+  const Entry* find(const std::string& path_) const;
+
+  /**
+   * Returns the type of a file. Files are classified by libmagic only when a
+   * plugin asks for their type, and the result is cached until the next
+   * scan. This function can be called concurrently.
+   */
+  FileType fileType(const std::string& path_) const;
+
+  /**
+   * Determines the MIME type of a file with libmagic. Each thread uses its
+   * own libmagic cookie, so this function can be called concurrently.
+   * @param mimeType_ The MIME type without the encoding (e.g. text/x-c).
+   * @return True if the file is plain text, i.e. it has a text MIME type.
+   */
+  static bool classify(const std::string& path_, std::string& mimeType_);
+
+private:
+  std::vector<Entry> _entries;
+
+  mutable std::mutex _typesMutex;
+  mutable std::unordered_map<std::string, FileType> _types;
+};
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_FILEMANIFEST_H
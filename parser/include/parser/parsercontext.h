@@ -1,13 +1,25 @@
 #ifndef CC_PARSER_PARSERCONTEXT_H
 #define CC_PARSER_PARSERCONTEXT_H
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ctime>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
 #include <unordered_map>
 
 #include <boost/program_options.hpp>
 
 #include <odb/database.hxx>
 
+#include <model/file.h>
+
+#include <parser/compilationdatabase.h>
+#include <parser/filemanifest.h>
+
 namespace po = boost::program_options; 
 
 namespace cc
@@ -43,6 +55,74 @@ struct ParserContext
   std::string& compassRoot;
   po::variables_map& options;
   std::unordered_map<std::string, IncrementalStatus> fileStatus;
+
+  /**
+   * Files and directories under the input paths. It is filled by the parser
+   * driver right before parsing.
+   */
+  FileManifest manifest;
+
+  /**
+   * The parser process handles the shard shardIndex of shardCount shards of
+   * the compile commands (see --shard). Every shard is parsed into its own
+   * database, and the shards are merged by --merge-shards.
+   */
+  std::size_t shardIndex = 0;
+  std::size_t shardCount = 1;
+
+  /**
+   * Returns true if the input identified by key_, e.g. the path of a source
+   * file, belongs to the shard of this process. The shard of a key is the
+   * same in every process.
+   */
+  bool inShard(const std::string& key_) const;
+
+  /**
+   * Parses the value of --shard in "i/N" format where 0 <= i < N.
+   * @return False if the value is malformed.
+   */
+  static bool parseShard(
+    const std::string& shard_,
+    std::size_t& index_,
+    std::size_t& count_);
+
+  /**
+   * Compares the content of the files stored in the database with the files
+   * on the disk, and adds the modified and deleted ones to fileStatus. The
+   * constructor checks every file.
+   */
+  void detectChanges();
+
+  /**
+   * Checks only the given files, e.g. the ones reported by the file watcher
+   * of the watch mode. The unknown paths are skipped.
+   */
+  void detectChanges(const std::set<std::string>& paths_);
+
+  /**
+   * Returns the compilation database of the given JSON file. It is read once
+   * per run and shared by the plugins and by the phases of the parsing. It is
+   * read again if the file has changed since, e.g. in watch mode.
+   * @param errorMsg_ The reason if the file can't be read.
+   * @return nullptr on error.
+   */
+  std::shared_ptr<const CompilationDatabase> compilationDatabase(
+    const std::string& path_,
+    std::string& errorMsg_);
+
+private:
+  struct LoadedCompilationDatabase
+  {
+    std::time_t mtime;
+    std::uint64_t size;
+    std::shared_ptr<const CompilationDatabase> db;
+  };
+
+  void checkFiles(const std::function<bool(const model::File&)>& filter_);
+
+  std::unordered_map<std::string, LoadedCompilationDatabase>
+    _compilationDatabases;
+  std::mutex _compilationDatabasesMutex;
 };
 
 } // parser
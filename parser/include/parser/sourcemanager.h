@@ -1,19 +1,22 @@
 #ifndef CC_PARSER_SOURCEMANAGER_H
 #define CC_PARSER_SOURCEMANAGER_H
 
+#include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <map>
 #include <unordered_set>
-
-#include <magic.h>
+#include <vector>
 
 #include <model/file.h>
 #include <model/file-odb.hxx>
 #include <model/filecontent.h>
 
 #include <util/odbtransaction.h>
+#include <util/sharedhashmap.h>
+
+#include <parser/filemanifest.h>
 
 namespace cc
 {
@@ -37,6 +40,7 @@ public:
    */
   std::map<std::string, model::FilePtr>::size_type numberOfFiles()
   {
+    std::lock_guard<std::mutex> guard(_createFileMutex);
     return _files.size();
   }
 
@@ -61,6 +65,8 @@ public:
    * based on the given beta_ filter. The objects are read from a cache.
    * Uncached files are ignored.
    * @param beta_ A filter functor iterated over the cached model::File objects.
+   * It is called under the lock of the source manager, so it must not call
+   * the source manager.
    */
   template<typename Filter = AllFilesFilter>
   std::vector<model::FilePtr> getFiles(const Filter& beta_ = Filter());
@@ -74,10 +80,32 @@ public:
   void updateFile(const model::File& file_);
 
   /**
-   * This function returns true if the given file is a plain text file.
+   * This function modifies a cached file by the given functor and updates it
+   * in the database if it is persisted already. The parser plugins may run in
+   * parallel and the cached model::File objects are shared between them, so
+   * these objects must be modified only by this function.
+   * @param file_ A model::File object returned by getFile().
+   * @param modify_ A functor which modifies the attributes of the file except
+   * its content and returns true if anything has changed. It is called under
+   * the lock of the source manager, so it must not call the source manager.
+   */
+  void updateFile(
+    const model::FilePtr& file_,
+    const std::function<bool(model::File&)>& modify_);
+
+  /**
+   * This function returns true if the given file is a plain text file. The
+   * type is cached by the file manifest (if set), so a file is not examined
+   * again by the plugins.
    */
   bool isPlainText(const std::string& path_) const;
 
+  /**
+   * This function sets the manifest of the scanned input files. The manifest
+   * must outlive the SourceManager.
+   */
+  void setFileManifest(const FileManifest* manifest_);
+
   // TODO: Maybe this function shouldn't exist.
   void persistFiles();
 
@@ -88,7 +116,51 @@ public:
    */
   void removeFile(const model::File& file_);
 
+  /**
+   * This function moves the set of the persisted files and file contents into
+   * shared memory, so that the processes forked afterwards don't persist the
+   * same files. A file persisted by another process is loaded from the
+   * database when it is not in the cache. This function must be called before
+   * forking, and files must not be removed until unshare() is called.
+   * @param capacity_ Maximal number of the files and file contents.
+   */
+  void share(std::size_t capacity_);
+
+  /**
+   * This function stops sharing the set of the persisted files. The set is
+   * reloaded from the database, so the forked processes must have been
+   * finished.
+   */
+  void unshare();
+
+  /**
+   * This function sets the database connection of a forked process. The
+   * connection of the parent process can't be used by the child.
+   */
+  void setDatabase(std::shared_ptr<odb::database> db_);
+
 private:
+  /**
+   * These functions mark a file or a file content as persisted in the
+   * private or the shared set. A mark in the shared set is only claimed by
+   * this process until it is published, see util::SharedHashMap. When the
+   * shared set is full, the private set is used. _createFileMutex must be
+   * locked.
+   * @return True if it was not marked before.
+   */
+  bool markFilePersisted(model::FileId id_);
+  bool markContentPersisted(const std::string& hash_);
+
+  /**
+   * This function removes the marks of the files and file contents which
+   * couldn't be persisted. _createFileMutex must be locked.
+   */
+  void unmarkPersisted(
+    const std::vector<model::FileId>& files_,
+    const std::vector<std::string>& contents_);
+
+  bool isFilePersisted(model::FileId id_) const;
+
   /**
    * This function creates a model::FileContent object and fills its attributes
    * based on the given path.
@@ -122,12 +194,13 @@ private:
   model::FilePtr getCreateParent(const std::string& path_);
 
   std::shared_ptr<odb::database> _db;
-  util::OdbTransaction _transaction;
   std::map<std::string, model::FilePtr> _files;
   std::unordered_set<model::FileId> _persistedFiles;
   std::unordered_set<std::string> _persistedContents;
+  std::shared_ptr<util::SharedHashMap> _sharedFiles;
+  std::shared_ptr<util::SharedHashMap> _sharedContents;
   std::mutex _createFileMutex;
-  ::magic_t _magicCookie;
+  const FileManifest* _manifest;
 };
 
 template<typename Filter>
@@ -135,6 +208,7 @@ std::vector<model::FilePtr> SourceManager::getFiles(const Filter& beta_)
 {
   std::vector<model::FilePtr> files;
 
+  std::lock_guard<std::mutex> guard(_createFileMutex);
   for (const auto& p: _files)
     if (beta_(p.second))
       files.push_back(p.second);
@@ -0,0 +1,555 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+#include <util/hash.h>
+#include <util/logutil.h>
+
+#include <parser/compilationdatabase.h>
+
+namespace
+{
+
+/**
+ * Splits a command line by the GNU syntax, like the command line parser of
+ * Clang's JSONCompilationDatabase: the arguments are separated by spaces,
+ * the quotes are removed and a backslash escapes the next character, except
+ * in single quotes.
+ */
+class CommandLineSplitter
+{
+public:
+  CommandLineSplitter(const std::string& input_)
+    : _pos(input_.data()), _end(input_.data() + input_.size())
+  {
+  }
+
+  std::vector<std::string> split()
+  {
+    std::vector<std::string> args;
+
+    while (skipSpaces())
+    {
+      args.emplace_back();
+      if (!parseArgument(args.back()))
+        break;
+    }
+
+    return args;
+  }
+
+private:
+  bool skipSpaces()
+  {
+    while (_pos != _end && *_pos == ' ')
+      ++_pos;
+    return _pos != _end;
+  }
+
+  /**
+   * @return False if the input ended.
+   */
+  bool parseArgument(std::string& arg_)
+  {
+    while (_pos != _end && *_pos != ' ')
+    {
+      if (*_pos == '"' || *_pos == '\'')
+      {
+        char quote = *_pos++;
+
+        while (_pos != _end && *_pos != quote)
+        {
+          if (quote == '"' && *_pos == '\\' && ++_pos == _end)
+            return false;
+          arg_.push_back(*_pos++);
+        }
+
+        if (_pos == _end)
+          return false;
+        ++_pos;
+      }
+      else
+      {
+        if (*_pos == '\\' && ++_pos == _end)
+          return false;
+        arg_.push_back(*_pos++);
+      }
+    }
+
+    return _pos != _end;
+  }
+
+  const char* _pos;
+  const char* _end;
+};
+
+/**
+ * Removes the compiler wrapper, e.g. ccache in "ccache g++ -c main.cpp",
+ * like Clang's JSONCompilationDatabase. If the wrapper is followed by a flag
+ * or an input file then it is called as a compiler, and it is kept.
+ * @return True if a wrapper has been removed.
+ */
+bool unwrapCommand(std::vector<std::string>& args_)
+{
+  if (args_.size() < 2)
+    return false;
+
+  std::string wrapper = args_[0].substr(args_[0].rfind('/') + 1);
+
+  if (wrapper != "distcc" && wrapper != "gomacc" &&
+      wrapper != "ccache" && wrapper != "sccache")
+    return false;
+
+  const std::string& next = args_[1];
+  std::string nextName = next.substr(next.rfind('/') + 1);
+  std::size_t dot = nextName.rfind('.');
+
+  bool hasCompiler = !next.empty() && next[0] != '-' &&
+    (dot == std::string::npos || nextName == "." || nextName == "..");
+
+  if (hasCompiler)
+    args_.erase(args_.begin());
+
+  return hasCompiler;
+}
+
+} // namespace
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Reads the JSON document from the mapped file. Only the structure of a
+ * compilation database is accepted: an array of objects. The values of the
+ * unknown keys are skipped.
+ */
+class CompilationDatabase::Reader
+{
+public:
+  Reader(CompilationDatabase& db_, const char* begin_, const char* end_)
+    : _db(db_), _begin(begin_), _pos(begin_), _end(end_)
+  {
+  }
+
+  /**
+   * @throw std::runtime_error if the document is malformed.
+   */
+  void read()
+  {
+    expect('[');
+
+    if (!consume(']'))
+    {
+      do
+        readCommand();
+      while (consume(','));
+
+      expect(']');
+    }
+
+    if (skipSpaces())
+      fail("unexpected data after the array");
+  }
+
+private:
+  void readCommand()
+  {
+    std::string directory, file, output, command;
+    std::vector<std::string> arguments;
+    bool hasDirectory = false, hasFile = false;
+    bool hasCommand = false, hasArguments = false;
+
+    std::string key;
+
+    expect('{');
+
+    if (!consume('}'))
+    {
+      do
+      {
+        key.clear();
+        readString(key);
+        expect(':');
+
+        if (key == "directory")
+        {
+          readString(directory);
+          hasDirectory = true;
+        }
+        else if (key == "file")
+        {
+          readString(file);
+          hasFile = true;
+        }
+        else if (key == "output")
+          readString(output);
+        else if (key == "command")
+        {
+          readString(command);
+          hasCommand = true;
+        }
+        else if (key == "arguments")
+        {
+          expect('[');
+          if (!consume(']'))
+          {
+            do
+            {
+              arguments.emplace_back();
+              readString(arguments.back());
+            }
+            while (consume(','));
+
+            expect(']');
+          }
+
+          hasArguments = true;
+        }
+        else
+          skipValue();
+      }
+      while (consume(','));
+
+      expect('}');
+    }
+
+    if (!hasDirectory)
+      fail("missing key \"directory\"");
+    if (!hasFile)
+      fail("missing key \"file\"");
+    if (!hasCommand && !hasArguments)
+      fail("missing key \"command\" or \"arguments\"");
+
+    // Like Clang, the arguments are preferred to the command.
+    if (!hasArguments)
+      arguments = CommandLineSplitter(command).split();
+
+    while (unwrapCommand(arguments))
+      ;
+
+    Entry entry;
+    entry.directory = _db.intern(directory);
+    entry.filename = _db.intern(file);
+    entry.output = _db.intern(output);
+    entry.argumentCount = static_cast<std::uint32_t>(arguments.size());
+    entry.firstArgument = _db._arguments.size();
+
+    _commandText.clear();
+    for (std::string& arg : arguments)
+    {
+      if (!_commandText.empty())
+        _commandText += ' ';
+      _commandText += arg;
+
+      _db._arguments.push_back(_db.intern(arg));
+    }
+
+    entry.commandHash = util::fnvHash(_commandText);
+
+    _db._entries.push_back(entry);
+  }
+
+  /**
+   * Reads a string value with its escape sequences resolved.
+   */
+  void readString(std::string& str_)
+  {
+    expect('"');
+
+    while (true)
+    {
+      const char* start = _pos;
+      while (_pos != _end && *_pos != '"' && *_pos != '\\')
+        ++_pos;
+      str_.append(start, _pos);
+
+      if (_pos == _end)
+        fail("unterminated string");
+
+      if (*_pos++ == '"')
+        return;
+
+      if (_pos == _end)
+        fail("unterminated string");
+
+      switch (char c = *_pos++)
+      {
+        case '"': case '\\': case '/': str_ += c; break;
+        case 'b': str_ += '\b'; break;
+        case 'f': str_ += '\f'; break;
+        case 'n': str_ += '\n'; break;
+        case 'r': str_ += '\r'; break;
+        case 't': str_ += '\t'; break;
+        case 'u': appendCodePoint(str_); break;
+        default: fail("invalid escape sequence");
+      }
+    }
+  }
+
+  /**
+   * Appends the code point of a \uXXXX escape sequence in UTF-8. The
+   * surrogate pairs are combined.
+   */
+  void appendCodePoint(std::string& str_)
+  {
+    std::uint32_t cp = readHex4();
+
+    if (cp >= 0xD800 && cp < 0xDC00 &&
+        _end - _pos >= 6 && _pos[0] == '\\' && _pos[1] == 'u')
+    {
+      _pos += 2;
+      std::uint32_t low = readHex4();
+      if (low < 0xDC00 || low >= 0xE000)
+        fail("invalid surrogate pair");
+      cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+    }
+
+    if (cp < 0x80)
+      str_ += static_cast<char>(cp);
+    else if (cp < 0x800)
+    {
+      str_ += static_cast<char>(0xC0 | (cp >> 6));
+      str_ += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000)
+    {
+      str_ += static_cast<char>(0xE0 | (cp >> 12));
+      str_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      str_ += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+      str_ += static_cast<char>(0xF0 | (cp >> 18));
+      str_ += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+      str_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+      str_ += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+  }
+
+  std::uint32_t readHex4()
+  {
+    if (_end - _pos < 4)
+      fail("invalid unicode escape");
+
+    std::uint32_t value = 0;
+    for (int i = 0; i < 4; ++i)
+    {
+      char c = *_pos++;
+      value <<= 4;
+
+      if (c >= '0' && c <= '9')
+        value |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        value |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        value |= c - 'A' + 10;
+      else
+        fail("invalid unicode escape");
+    }
+
+    return value;
+  }
+
+  /**
+   * Skips a value of any type.
+   */
+  void skipValue()
+  {
+    if (!skipSpaces())
+      fail("unexpected end of file");
+
+    if (*_pos == '"')
+    {
+      _skipped.clear();
+      readString(_skipped);
+    }
+    else if (*_pos == '[' || *_pos == '{')
+    {
+      char close = *_pos == '[' ? ']' : '}';
+      ++_pos;
+
+      if (!consume(close))
+      {
+        do
+        {
+          if (close == '}')
+          {
+            _skipped.clear();
+            readString(_skipped);
+            expect(':');
+          }
+          skipValue();
+        }
+        while (consume(','));
+
+        expect(close);
+      }
+    }
+    else
+    {
+      // Numbers, true, false and null.
+      const char* start = _pos;
+      while (_pos != _end && *_pos != ',' && *_pos != ']' && *_pos != '}' &&
+             !std::isspace(static_cast<unsigned char>(*_pos)))
+        ++_pos;
+
+      if (_pos == start)
+        fail("value expected");
+    }
+  }
+
+  /**
+   * @return False at the end of the document.
+   */
+  bool skipSpaces()
+  {
+    while (_pos != _end && std::isspace(static_cast<unsigned char>(*_pos)))
+      ++_pos;
+    return _pos != _end;
+  }
+
+  bool consume(char c_)
+  {
+    if (skipSpaces() && *_pos == c_)
+    {
+      ++_pos;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c_)
+  {
+    if (!consume(c_))
+      fail(std::string("'") + c_ + "' expected");
+  }
+
+  [[noreturn]] void fail(const std::string& message_)
+  {
+    throw std::runtime_error(
+      message_ + " at offset " + std::to_string(_pos - _begin));
+  }
+
+  CompilationDatabase& _db;
+  const char* _begin;
+  const char* _pos;
+  const char* _end;
+
+  std::string _commandText;
+  std::string _skipped;
+};
+
+std::unique_ptr<CompilationDatabase> CompilationDatabase::load(
+  const std::string& path_,
+  std::string& errorMsg_)
+{
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now();
+
+  int fd = ::open(path_.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    errorMsg_ = "Cannot open compilation database " + path_ + ": "
+      + std::strerror(errno);
+    return nullptr;
+  }
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0)
+  {
+    errorMsg_ = "Cannot read compilation database " + path_ + ": "
+      + std::strerror(errno);
+    ::close(fd);
+    return nullptr;
+  }
+
+  std::size_t size = st.st_size;
+  void* mapping = nullptr;
+
+  if (size)
+  {
+    mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+      errorMsg_ = "Cannot map compilation database " + path_ + ": "
+        + std::strerror(errno);
+      ::close(fd);
+      return nullptr;
+    }
+
+    // The file is read once from the beginning to the end.
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+  }
+
+  ::close(fd);
+
+  std::unique_ptr<CompilationDatabase> db(new CompilationDatabase());
+  const char* begin = static_cast<const char*>(mapping);
+
+  try
+  {
+    Reader(*db, begin, begin + size).read();
+  }
+  catch (const std::runtime_error& ex)
+  {
+    errorMsg_ = "Error while parsing compilation database " + path_ + ": "
+      + ex.what();
+    db.reset();
+  }
+
+  if (mapping)
+    ::munmap(mapping, size);
+
+  if (db)
+    LOG(info)
+      << "Read " << db->size() << " compile commands with "
+      << db->stringCount() << " distinct strings from " << path_ << " in "
+      << std::chrono::duration_cast<std::chrono::milliseconds>(
+           std::chrono::steady_clock::now() - start).count() << " ms.";
+
+  return db;
+}
+
+CompilationDatabase::Command CompilationDatabase::command(
+  std::size_t index_) const
+{
+  const Entry& entry = _entries[index_];
+
+  Command command;
+  command.directory = *_strings[entry.directory];
+  command.filename = *_strings[entry.filename];
+  command.output = *_strings[entry.output];
+
+  command.commandLine.reserve(entry.argumentCount);
+  for (std::size_t i = 0; i < entry.argumentCount; ++i)
+    command.commandLine.push_back(
+      *_strings[_arguments[entry.firstArgument + i]]);
+
+  return command;
+}
+
+std::uint32_t CompilationDatabase::intern(std::string& str_)
+{
+  auto it = _stringIds.find(str_);
+
+  if (it == _stringIds.end())
+  {
+    it = _stringIds.emplace(std::move(str_), _strings.size()).first;
+    _strings.push_back(&it->first);
+  }
+
+  return it->second;
+}
+
+} // parser
+} // cc
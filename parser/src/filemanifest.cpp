@@ -0,0 +1,514 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+
+#include <magic.h>
+
+#include <util/logutil.h>
+
+#include <parser/filemanifest.h>
+
+namespace
+{
+
+/**
+ * Record layout of the getdents64 system call.
+ */
+struct LinuxDirent64
+{
+  ino64_t d_ino;
+  off64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[1];
+};
+
+/**
+ * A libmagic cookie which is opened on first use in a thread and closed when
+ * the thread exits. libmagic cookies must not be shared between threads.
+ */
+class MagicCookie
+{
+public:
+  MagicCookie()
+    : _cookie(::magic_open(MAGIC_MIME_TYPE | MAGIC_SYMLINK))
+  {
+    if (!_cookie)
+      LOG(warning) << "Failed to create a libmagic cookie!";
+    else if (::magic_load(_cookie, nullptr) != 0)
+    {
+      LOG(warning) << "libmagic error: " << ::magic_error(_cookie);
+      ::magic_close(_cookie);
+      _cookie = nullptr;
+    }
+  }
+
+  ~MagicCookie()
+  {
+    if (_cookie)
+      ::magic_close(_cookie);
+  }
+
+  ::magic_t get() const
+  {
+    return _cookie;
+  }
+
+private:
+  ::magic_t _cookie;
+};
+
+/**
+ * Shared state of the threads walking the directories.
+ */
+struct WalkState
+{
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::deque<std::string> directories;
+  std::set<std::pair<dev_t, ino_t>> visited;
+  std::size_t busyThreads = 0;
+  std::size_t numFiles = 0;
+  std::size_t numDirs = 0;
+  std::chrono::steady_clock::time_point lastReportTime
+    = std::chrono::steady_clock::now();
+};
+
+std::string joinPath(const std::string& dir_, const char* name_)
+{
+  std::string path = dir_;
+  if (path.empty() || path.back() != '/')
+    path += '/';
+  return path += name_;
+}
+
+/**
+ * Returns the canonical form of a path or an empty string on error.
+ */
+std::string canonicalPath(const std::string& path_)
+{
+  char* resolved = ::realpath(path_.c_str(), nullptr);
+  if (!resolved)
+    return std::string();
+
+  std::string path(resolved);
+  std::free(resolved);
+  return path;
+}
+
+/**
+ * Returns the canonical form of a path which may not exist anymore. Only its
+ * directory is resolved, and if the directory is gone too, the path is
+ * returned as it is.
+ */
+std::string removedPath(const std::string& path_)
+{
+  std::string::size_type slash = path_.find_last_of('/');
+  if (slash == std::string::npos || slash == 0)
+    return path_;
+
+  std::string dir = canonicalPath(path_.substr(0, slash));
+  return dir.empty() ? path_ : joinPath(dir, path_.c_str() + slash + 1);
+}
+
+/**
+ * Fills the entry of a file or a directory from its stat.
+ * @return False if the path is neither a regular file nor a directory.
+ */
+bool makeEntry(
+  const std::string& path_,
+  const struct stat& stat_,
+  cc::parser::FileManifest::Entry& entry_)
+{
+  if (!S_ISDIR(stat_.st_mode) && !S_ISREG(stat_.st_mode))
+    return false;
+
+  entry_.path = path_;
+  entry_.directory = S_ISDIR(stat_.st_mode);
+  entry_.mtime = stat_.st_mtime;
+
+  if (!entry_.directory)
+    entry_.size = stat_.st_size;
+
+  return true;
+}
+
+/**
+ * Queues a directory unless it has already been visited through an other
+ * path (e.g. a symbolic link). The caller must hold the lock of the state.
+ */
+void pushDirectory(
+  WalkState& state_,
+  const std::string& path_,
+  const struct stat& stat_)
+{
+  if (state_.visited.emplace(stat_.st_dev, stat_.st_ino).second)
+  {
+    state_.directories.push_back(path_);
+    state_.cond.notify_one();
+  }
+}
+
+/**
+ * Lists a directory with getdents64 and stats the entries relative to the
+ * directory descriptor, so the kernel doesn't resolve the full paths again.
+ */
+void walkDirectory(
+  WalkState& state_,
+  const std::string& dir_,
+  std::vector<cc::parser::FileManifest::Entry>& entries_)
+{
+  int fd = ::openat(
+    AT_FDCWD, dir_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    LOG(warning) << "Failed to open directory " << dir_ << ": "
+      << std::strerror(errno);
+    return;
+  }
+
+  std::vector<std::pair<std::string, struct stat>> subdirs;
+  std::size_t numFiles = 0;
+  char buffer[32768];
+
+  for (;;)
+  {
+    long size = ::syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+    if (size <= 0)
+      break;
+
+    for (long pos = 0; pos < size;)
+    {
+      const LinuxDirent64* dirent
+        = reinterpret_cast<const LinuxDirent64*>(buffer + pos);
+      pos += dirent->d_reclen;
+
+      const char* name = dirent->d_name;
+      if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0)
+        continue;
+
+      // Symbolic links are followed, like boost::filesystem::is_directory()
+      // and is_regular_file() do.
+      struct stat st;
+      if (::fstatat(fd, name, &st, 0) != 0)
+        continue;
+
+      cc::parser::FileManifest::Entry entry;
+      std::string path = joinPath(dir_, name);
+
+      // The directory path is canonical, so only the symbolic links have to
+      // be resolved.
+      struct stat lst;
+      if (dirent->d_type == DT_LNK ||
+          (dirent->d_type == DT_UNKNOWN &&
+           ::fstatat(fd, name, &lst, AT_SYMLINK_NOFOLLOW) == 0 &&
+           S_ISLNK(lst.st_mode)))
+      {
+        path = canonicalPath(path);
+        if (path.empty())
+          continue;
+      }
+
+      if (!makeEntry(path, st, entry))
+        continue;
+
+      if (entry.directory)
+        subdirs.emplace_back(path, st);
+      else
+        ++numFiles;
+
+      entries_.push_back(std::move(entry));
+    }
+  }
+
+  ::close(fd);
+
+  std::lock_guard<std::mutex> lock(state_.mutex);
+
+  for (const auto& subdir : subdirs)
+    pushDirectory(state_, subdir.first, subdir.second);
+
+  state_.numFiles += numFiles;
+  ++state_.numDirs;
+
+  auto currTime = std::chrono::steady_clock::now();
+  if (currTime - state_.lastReportTime >= std::chrono::seconds(15))
+  {
+    LOG(info)
+      << "Scanning inputs: visited " << state_.numFiles << " files in "
+      << state_.numDirs << " directories so far.";
+    state_.lastReportTime = currTime;
+  }
+}
+
+void walkWorker(
+  WalkState& state_,
+  std::vector<cc::parser::FileManifest::Entry>& entries_)
+{
+  std::unique_lock<std::mutex> lock(state_.mutex);
+
+  for (;;)
+  {
+    state_.cond.wait(lock, [&state_]{
+      return !state_.directories.empty() || state_.busyThreads == 0;
+    });
+
+    // The walk is over when no directory is queued and no other thread could
+    // queue a new one.
+    if (state_.directories.empty())
+      break;
+
+    std::string dir = std::move(state_.directories.front());
+    state_.directories.pop_front();
+    ++state_.busyThreads;
+
+    lock.unlock();
+    walkDirectory(state_, dir, entries_);
+    lock.lock();
+
+    if (--state_.busyThreads == 0 && state_.directories.empty())
+      state_.cond.notify_all();
+  }
+}
+
+} // namespace
+
+namespace cc
+{
+namespace parser
+{
+
+void FileManifest::scan(
+  const std::vector<std::string>& inputs_,
+  int threadNum_)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  WalkState state;
+  _entries.clear();
+
+  {
+    std::lock_guard<std::mutex> lock(_typesMutex);
+    _types.clear();
+  }
+
+  for (const std::string& input : inputs_)
+  {
+    struct stat st;
+    Entry entry;
+    std::string path = canonicalPath(input);
+
+    if (path.empty() ||
+        ::stat(path.c_str(), &st) != 0 ||
+        !makeEntry(path, st, entry))
+    {
+      LOG(warning) << "Not found: " << input;
+      continue;
+    }
+
+    if (entry.directory)
+      pushDirectory(state, path, st);
+    else
+      ++state.numFiles;
+
+    _entries.push_back(std::move(entry));
+  }
+
+  std::size_t threadNum = std::max(threadNum_, 1);
+  std::vector<std::vector<Entry>> results(threadNum);
+  std::vector<std::thread> threads;
+
+  for (std::size_t i = 0; i < threadNum; ++i)
+    threads.emplace_back(
+      [&state, &results, i]{ walkWorker(state, results[i]); });
+
+  for (std::thread& thread : threads)
+    thread.join();
+
+  for (std::vector<Entry>& result : results)
+    std::move(result.begin(), result.end(), std::back_inserter(_entries));
+
+  std::sort(_entries.begin(), _entries.end(),
+    [](const Entry& lhs_, const Entry& rhs_){ return lhs_.path < rhs_.path; });
+
+  // A symbolic link and its target are the same entry.
+  _entries.erase(std::unique(_entries.begin(), _entries.end(),
+    [](const Entry& lhs_, const Entry& rhs_){ return lhs_.path == rhs_.path; }),
+    _entries.end());
+
+  LOG(info)
+    << "Scanned " << state.numFiles << " files in " << state.numDirs
+    << " directories in " << std::chrono::duration_cast<
+      std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+      .count() << " ms.";
+}
+
+void FileManifest::update(const std::set<std::string>& paths_)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  WalkState state;
+  std::vector<Entry> added;
+  std::set<std::string> removed;
+
+  for (const std::string& changed : paths_)
+  {
+    struct stat st;
+    Entry entry;
+    std::string path = canonicalPath(changed);
+
+    if (path.empty() ||
+        ::stat(path.c_str(), &st) != 0 ||
+        !makeEntry(path, st, entry))
+    {
+      removed.insert(removedPath(changed));
+      continue;
+    }
+
+    // The files of a new directory may have been created before it was
+    // watched, so they are not reported one by one.
+    if (entry.directory && !find(path))
+      pushDirectory(state, path, st);
+
+    added.push_back(std::move(entry));
+  }
+
+  walkWorker(state, added);
+
+  std::sort(added.begin(), added.end(),
+    [](const Entry& lhs_, const Entry& rhs_){ return lhs_.path < rhs_.path; });
+  added.erase(std::unique(added.begin(), added.end(),
+    [](const Entry& lhs_, const Entry& rhs_){ return lhs_.path == rhs_.path; }),
+    added.end());
+
+  // A path is removed if it or one of its parent directories is removed.
+  auto isRemoved = [&removed](const std::string& path_)
+  {
+    if (removed.empty())
+      return false;
+
+    for (std::string::size_type pos = path_.size();
+      pos != std::string::npos && pos > 0;
+      pos = path_.rfind('/', pos - 1))
+    {
+      if (removed.count(path_.substr(0, pos)))
+        return true;
+    }
+
+    return false;
+  };
+
+  {
+    std::lock_guard<std::mutex> lock(_typesMutex);
+
+    for (const Entry& entry : added)
+      _types.erase(entry.path);
+
+    if (!removed.empty())
+    {
+      for (auto type = _types.begin(); type != _types.end();)
+        if (isRemoved(type->first))
+          type = _types.erase(type);
+        else
+          ++type;
+    }
+  }
+
+  // Both lists are sorted, so they are merged in one pass. The new entries
+  // replace the old ones of the same path.
+  std::vector<Entry> entries;
+  entries.reserve(_entries.size() + added.size());
+
+  auto it = added.begin();
+  for (Entry& entry : _entries)
+  {
+    while (it != added.end() && it->path < entry.path)
+      entries.push_back(std::move(*it++));
+
+    if (it != added.end() && it->path == entry.path)
+      entries.push_back(std::move(*it++));
+    else if (!isRemoved(entry.path))
+      entries.push_back(std::move(entry));
+  }
+  std::move(it, added.end(), std::back_inserter(entries));
+
+  _entries.swap(entries);
+
+  LOG(info)
+    << "Updated " << added.size() << " and removed " << removed.size()
+    << " paths of the input manifest in " << std::chrono::duration_cast<
+      std::chrono::milliseconds>(std::chrono::steady_clock::now() - start)
+      .count() << " ms.";
+}
+
+const std::vector<FileManifest::Entry>& FileManifest::entries() const
+{
+  return _entries;
+}
+
+const FileManifest::Entry* FileManifest::find(const std::string& path_) const
+{
+  auto it = std::lower_bound(_entries.begin(), _entries.end(), path_,
+    [](const Entry& entry_, const std::string& path_)
+    {
+      return entry_.path < path_;
+    });
+
+  return it != _entries.end() && it->path == path_ ? &*it : nullptr;
+}
+
+FileManifest::FileType FileManifest::fileType(const std::string& path_) const
+{
+  {
+    std::lock_guard<std::mutex> lock(_typesMutex);
+    auto it = _types.find(path_);
+    if (it != _types.end())
+      return it->second;
+  }
+
+  // libmagic reads the file, so the lock is not held meanwhile. Two threads
+  // may classify the same file, which is harmless.
+  FileType type;
+  type.plainText = classify(path_, type.mimeType);
+
+  std::lock_guard<std::mutex> lock(_typesMutex);
+  _types.emplace(path_, type);
+  return type;
+}
+
+bool FileManifest::classify(const std::string& path_, std::string& mimeType_)
+{
+  static thread_local MagicCookie cookie;
+
+  const char* magic = cookie.get()
+    ? ::magic_file(cookie.get(), path_.c_str())
+    : nullptr;
+
+  if (!magic)
+  {
+    LOG(warning) << "Couldn't use magic on file: " << path_;
+    mimeType_.clear();
+    return false;
+  }
+
+  mimeType_ = magic;
+  return mimeType_.compare(0, 5, "text/") == 0;
+}
+
+} // parser
+} // cc
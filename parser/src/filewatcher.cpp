@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <boost/filesystem.hpp>
+
+#include <util/logutil.h>
+
+#include "filewatcher.h"
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+
+const std::uint32_t WATCH_MASK
+  = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+  | IN_DELETE_SELF | IN_ONLYDIR;
+
+bool isHidden(const fs::path& path_)
+{
+  std::string name = path_.filename().string();
+  return name.size() > 1 && name[0] == '.' && name != "..";
+}
+
+} // namespace
+
+namespace cc
+{
+namespace parser
+{
+
+FileWatcher::FileWatcher(const std::vector<std::string>& paths_)
+  : _fullScan(false)
+{
+  _fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+  if (_fd < 0)
+    throw std::runtime_error(
+      std::string("inotify is not available: ") + std::strerror(errno));
+
+  for (const std::string& path : paths_)
+  {
+    boost::system::error_code ec;
+
+    if (fs::is_directory(path, ec))
+      addWatches(fs::canonical(path, ec).string());
+    else if (fs::exists(path, ec))
+    {
+      std::string dir = fs::canonical(path, ec).parent_path().string();
+      int wd = ::inotify_add_watch(_fd, dir.c_str(), WATCH_MASK);
+      if (wd >= 0)
+        _watches[wd] = dir;
+    }
+    else
+      LOG(warning) << "Not found, it is not watched: " << path;
+  }
+}
+
+FileWatcher::~FileWatcher()
+{
+  ::close(_fd);
+}
+
+void FileWatcher::addWatches(const std::string& dir_)
+{
+  int wd = ::inotify_add_watch(_fd, dir_.c_str(), WATCH_MASK);
+
+  if (wd < 0)
+  {
+    // The limit is fs.inotify.max_user_watches.
+    LOG(warning)
+      << "Couldn't watch " << dir_ << ": " << std::strerror(errno);
+    return;
+  }
+
+  _watches[wd] = dir_;
+
+  boost::system::error_code ec;
+  for (fs::directory_iterator it(dir_, ec), end; !ec && it != end;
+       it.increment(ec))
+    if (fs::is_directory(it->symlink_status()) && !isHidden(it->path()))
+      addWatches(it->path().string());
+}
+
+bool FileWatcher::wait(
+  std::set<std::string>& changed_,
+  int quietMs_,
+  const volatile std::sig_atomic_t& stop_)
+{
+  _fullScan = false;
+
+  // The poll timeout is short, so that stop_ is checked regularly even if the
+  // signal doesn't interrupt poll().
+  const int pollMs = 500;
+  bool changed = false;
+  auto lastEvent = std::chrono::steady_clock::now();
+
+  while (!stop_)
+  {
+    pollfd pfd{_fd, POLLIN, 0};
+    int ready = ::poll(&pfd, 1, changed ? std::min(quietMs_, pollMs) : pollMs);
+
+    if (ready < 0 && errno != EINTR)
+      throw std::runtime_error(
+        std::string("poll() failed: ") + std::strerror(errno));
+
+    if (ready > 0 && readEvents(changed_))
+    {
+      changed = true;
+      lastEvent = std::chrono::steady_clock::now();
+    }
+    else if (changed && std::chrono::steady_clock::now() - lastEvent
+      >= std::chrono::milliseconds(quietMs_))
+      return true;
+  }
+
+  return false;
+}
+
+bool FileWatcher::readEvents(std::set<std::string>& changed_)
+{
+  alignas(inotify_event) char buffer[64 * 1024];
+  bool changed = false;
+
+  while (true)
+  {
+    ssize_t length = ::read(_fd, buffer, sizeof(buffer));
+
+    if (length <= 0)
+      break;
+
+    for (const char* ptr = buffer; ptr < buffer + length; )
+    {
+      const inotify_event* event
+        = reinterpret_cast<const inotify_event*>(ptr);
+      ptr += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_Q_OVERFLOW)
+      {
+        LOG(warning) << "The inotify event queue overflowed.";
+        _fullScan = changed = true;
+        continue;
+      }
+
+      auto watch = _watches.find(event->wd);
+      if (watch == _watches.end())
+        continue;
+
+      if (event->mask & IN_IGNORED)
+      {
+        _watches.erase(watch);
+        continue;
+      }
+
+      if (!event->len)
+        continue;
+
+      std::string path = watch->second + '/' + event->name;
+
+      if (event->mask & IN_ISDIR)
+      {
+        if ((event->mask & (IN_CREATE | IN_MOVED_TO)) &&
+            !isHidden(fs::path(path)))
+          addWatches(path);
+
+        // The files of a moved directory are not reported one by one.
+        if (event->mask & (IN_MOVED_FROM | IN_MOVED_TO))
+          _fullScan = true;
+      }
+
+      changed_.insert(path);
+
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+} // parser
+} // cc
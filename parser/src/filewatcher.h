@@ -0,0 +1,82 @@
+#ifndef CC_PARSER_FILEWATCHER_H
+#define CC_PARSER_FILEWATCHER_H
+
+#include <csignal>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Watches the input paths of the parser with inotify. The directories are
+ * watched recursively, and the directories created later are watched too.
+ * For an input file, e.g. a compilation database, its directory is watched.
+ * Hidden directories, e.g. .git, are not watched.
+ */
+class FileWatcher
+{
+public:
+  /**
+   * @throw std::runtime_error if inotify is not available.
+   */
+  explicit FileWatcher(const std::vector<std::string>& paths_);
+  FileWatcher(const FileWatcher&) = delete;
+  FileWatcher& operator=(const FileWatcher&) = delete;
+  ~FileWatcher();
+
+  /**
+   * Waits until a file is changed, created, moved or deleted, then collects
+   * the further changes until none arrives for quietMs_ milliseconds. This
+   * way a burst of changes, e.g. a checkout, is handled at once.
+   * @param changed_ The paths of the changed files and of the created or
+   * deleted directories are added here.
+   * @param stop_ Waiting is aborted when it becomes nonzero, e.g. by a
+   * signal handler.
+   * @return False if waiting has been aborted.
+   */
+  bool wait(
+    std::set<std::string>& changed_,
+    int quietMs_,
+    const volatile std::sig_atomic_t& stop_);
+
+  /**
+   * Returns true if the changes of the previous wait() are not known file by
+   * file, because the event queue of the kernel overflowed or a directory
+   * was moved. Then every file has to be checked.
+   */
+  bool fullScanNeeded() const
+  {
+    return _fullScan;
+  }
+
+  std::size_t watchCount() const
+  {
+    return _watches.size();
+  }
+
+private:
+  /**
+   * Watches the directory and its subdirectories.
+   */
+  void addWatches(const std::string& dir_);
+
+  /**
+   * Reads the available events.
+   * @return True if any path has changed.
+   */
+  bool readEvents(std::set<std::string>& changed_);
+
+  int _fd;
+  std::unordered_map<int, std::string> _watches;
+  bool _fullScan;
+};
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_FILEWATCHER_H
@@ -1,8 +1,12 @@
+#include <chrono>
+#include <csignal>
 #include <memory>
 #include <string>
 #include <vector>
+#include <iomanip>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 
 #include <boost/log/expressions.hpp>
 #include <boost/log/expressions/attr.hpp>
@@ -18,10 +22,17 @@
 #include <util/logutil.h>
 #include <util/odbtransaction.h>
 
+#include <model/databasegeneration.h>
+#include <model/filecontentstore.h>
+
 #include <parser/parsercontext.h>
 #include <parser/pluginhandler.h>
 #include <parser/sourcemanager.h>
 
+#include "filewatcher.h"
+#include "pluginscheduler.h"
+#include "shardmerge.h"
+
 namespace po = boost::program_options;
 namespace fs = boost::filesystem;
 namespace trivial = boost::log::trivial;
@@ -82,11 +93,67 @@ po::options_description commandLineArguments()
      "further actions modifying the state of the database.")
     ("incremental-threshold", po::value<int>()->default_value(10),
       "This is a threshold percentage. If the total ratio of changed files "
-      "is greater than this value, full parse is forced instead of incremental parsing.");
+      "is greater than this value, full parse is forced instead of incremental parsing.")
+    ("migrate-file-contents",
+      "Compresses the file contents of an existing project which were stored "
+      "as plain text by an earlier version, then exits without parsing.")
+    ("shard", po::value<std::string>(),
+      "Parses only a slice of the compile commands, given in \"i/N\" format "
+      "where 0 <= i < N. The compile commands are assigned to the shards by "
+      "the hash of their source files, so N parser processes started with "
+      "the same N parse disjoint slices. Each shard should be parsed into its "
+      "own database (an SQLite file or a PostgreSQL schema, see the \"schema\" "
+      "key of the connection string), then merged by --merge-shards. The "
+      "file contents of the shards are compressed after the merge.")
+    ("merge-shards", po::value<std::vector<std::string>>()->multitoken(),
+      "Merges the databases of the shards parsed with --shard into the "
+      "database of the project, then exits without parsing. The connection "
+      "strings of the shards are listed, e.g. --merge-shards "
+      "'sqlite:database=~/cc/shard0.sqlite' "
+      "'sqlite:database=~/cc/shard1.sqlite'. PostgreSQL shards must be "
+      "schemas of the database of the project.")
+    ("watch",
+      "After parsing, the parser keeps running and watches the input paths "
+      "for changes. The changed files and the translation units affected by "
+      "them are parsed incrementally, while the caches of the parser stay in "
+      "memory. Only the plugins supporting incremental parsing (e.g. "
+      "cppparser) are run on the changes. The parser exits on SIGINT or "
+      "SIGTERM.")
+    ("watch-delay", po::value<int>()->default_value(2000),
+      "In watch mode the changes are collected until no further change "
+      "arrives for this many milliseconds, so a burst of changes (e.g. a "
+      "checkout) is parsed at once.");
 
   return desc;
 }
 
+/**
+ * This function compresses the file contents which are stored as plain text
+ * and logs the achieved compression ratio.
+ */
+void compressFileContents(std::shared_ptr<odb::database> db_, int threadNum_)
+{
+  LOG(info) << "Compressing file contents.";
+
+  cc::model::FileContentCompressionReport report
+    = cc::model::compressFileContents(db_, threadNum_);
+
+  if (!report.rawSize)
+    return;
+
+  const double mib = 1024.0 * 1024.0;
+
+  LOG(info)
+    << "Compressed " << report.files << " file contents: "
+    << std::fixed << std::setprecision(1)
+    << report.rawSize / mib << " MiB -> " << report.compressedSize / mib
+    << " MiB (" << 100.0 * report.compressedSize / report.rawSize << "%)"
+    << (report.dictionarySize
+      ? ", trained a " + std::to_string(report.dictionarySize / 1024)
+        + " KiB dictionary."
+      : ".");
+}
+
 /**
  * This function checks the existence of the workspace and project directory
  * based on the given command line arguments.
@@ -210,6 +277,203 @@ void incrementalCleanup(cc::parser::ParserContext& ctx_)
   }
 }
 
+/**
+ * Prints the wall and CPU time of the parser plugins.
+ * @param stats_ Statistics of the plugins collected by the scheduler.
+ * @param wallTime_ Wall time of the whole parsing step in seconds.
+ */
+void printStatistics(
+  const std::vector<cc::parser::PluginScheduler::Statistics>& stats_,
+  double wallTime_)
+{
+  LOG(info) << "[Statistics] Parsing took " << std::fixed
+    << std::setprecision(2) << wallTime_ << " s:";
+  LOG(info) << "[Statistics] " << std::left << std::setw(20) << "plugin"
+    << std::right << std::setw(8) << "threads" << std::setw(12) << "wall (s)"
+    << std::setw(12) << "cpu (s)" << "  status";
+
+  for (const cc::parser::PluginScheduler::Statistics& stat : stats_)
+  {
+    std::ostringstream line;
+    line << std::left << std::setw(20) << stat.plugin
+      << std::right << std::setw(8) << stat.threadNum
+      << std::fixed << std::setprecision(2)
+      << std::setw(12) << stat.wallTime
+      << std::setw(12) << stat.cpuTime
+      << "  " << (stat.success ? "ok" : "failed");
+
+    LOG(info) << "[Statistics] " << line.str();
+  }
+}
+
+/**
+ * Writes the project_info.json file of the project directory.
+ * @param vm_ Command line arguments.
+ * @param projDir_ Project directory.
+ */
+void writeProjectInfo(const po::variables_map& vm_, const std::string& projDir_)
+{
+  boost::property_tree::ptree pt;
+
+  if (vm_.count("label"))
+  {
+    boost::property_tree::ptree labels;
+
+    for (const std::string& label :
+      vm_["label"].as<std::vector<std::string>>())
+    {
+      std::size_t pos = label.find('=');
+
+      if (pos == std::string::npos)
+        LOG(warning)
+          << "Label doesn't contain '=' for separating label and the path: "
+          << label;
+      else
+        labels.put(label.substr(0, pos), label.substr(pos + 1));
+    }
+
+    pt.add_child("labels", labels);
+  }
+
+  pt.put("database", vm_["database"].as<std::string>());
+
+  if (vm_.count("description"))
+    pt.put("description", vm_["description"].as<std::string>());
+
+  boost::property_tree::write_json(projDir_ + "/project_info.json", pt);
+}
+
+namespace
+{
+
+volatile std::sig_atomic_t stopWatching = 0;
+
+void requestStopWatching(int)
+{
+  stopWatching = 1;
+}
+
+} // namespace
+
+/**
+ * Adds the parse() of the given plugins to the scheduler.
+ */
+void addPlugins(
+  cc::parser::PluginScheduler& scheduler_,
+  cc::parser::PluginHandler& pHandler_,
+  const std::vector<std::string>& pluginNames_)
+{
+  for (const std::string& pluginName : pluginNames_)
+  {
+    std::shared_ptr<cc::parser::AbstractParser> parser
+      = pHandler_.getParser(pluginName);
+
+    scheduler_.addPlugin(
+      pluginName,
+      parser->dependencies(),
+      parser->multiThreaded(),
+      [parser](int threadNum_)
+      {
+        parser->setThreadNum(threadNum_);
+        return parser->parse();
+      },
+      parser->exclusive());
+  }
+}
+
+/**
+ * Keeps the parser running after the initial parse, and parses the changes of
+ * the input paths incrementally. The source manager, the parser context and
+ * the plugins are kept, so their caches are not loaded again. Only the
+ * plugins which support incremental parsing are run on the changes.
+ * @param pluginNames_ The loaded plugins in dependency order.
+ * @return The exit code of the parser.
+ */
+int watch(
+  po::variables_map& vm_,
+  cc::parser::ParserContext& ctx_,
+  cc::parser::PluginHandler& pHandler_,
+  const std::vector<std::string>& pluginNames_)
+{
+  const std::vector<std::string>& inputs
+    = vm_["input"].as<std::vector<std::string>>();
+
+  // The updates are incremental even if the initial parse was forced.
+  vm_.erase("force");
+
+  std::vector<std::string> pluginNames;
+  for (const std::string& pluginName : pluginNames_)
+    if (pHandler_.getParser(pluginName)->incremental())
+      pluginNames.push_back(pluginName);
+    else
+      LOG(info) << "[" << pluginName << "] doesn't support incremental "
+        "parsing, it is skipped while watching.";
+
+  cc::parser::PluginScheduler scheduler(vm_["jobs"].as<int>());
+  addPlugins(scheduler, pHandler_, pluginNames);
+
+  cc::parser::FileWatcher watcher(inputs);
+
+  std::signal(SIGINT, requestStopWatching);
+  std::signal(SIGTERM, requestStopWatching);
+
+  LOG(info) << "Watching " << watcher.watchCount() << " directories for "
+    "changes.";
+
+  std::set<std::string> changed;
+
+  while (watcher.wait(changed, vm_["watch-delay"].as<int>(), stopWatching))
+  {
+    std::chrono::steady_clock::time_point start
+      = std::chrono::steady_clock::now();
+
+    ctx_.fileStatus.clear();
+
+    if (watcher.fullScanNeeded())
+      ctx_.detectChanges();
+    else
+      ctx_.detectChanges(changed);
+
+    LOG(info) << "[Watch] " << changed.size() << " paths changed, "
+      << ctx_.fileStatus.size() << " parsed files are affected.";
+
+    for (const std::string& pluginName : pluginNames)
+      pHandler_.getParser(pluginName)->markModifiedFiles();
+
+    for (const std::string& pluginName : pluginNames)
+      if (!pHandler_.getParser(pluginName)->cleanupDatabase())
+      {
+        LOG(error) << "[" << pluginName << "] cleanup failed!";
+        return 2;
+      }
+
+    incrementalCleanup(ctx_);
+
+    // New files may have been added under the inputs. The inputs are scanned
+    // again only if the changes are not known path by path.
+    if (watcher.fullScanNeeded())
+      ctx_.manifest.scan(inputs, vm_["jobs"].as<int>());
+    else
+      ctx_.manifest.update(changed);
+    changed.clear();
+
+    if (!scheduler.run())
+      LOG(warning) << "Some of the parser plugins failed!";
+
+    ctx_.srcMgr.persistFiles();
+    compressFileContents(ctx_.db, vm_["jobs"].as<int>());
+    cc::model::incrementDatabaseGeneration(ctx_.db);
+
+    LOG(info) << "[Watch] The database has been updated in " << std::fixed
+      << std::setprecision(2) << std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count() << " s.";
+  }
+
+  LOG(info) << "Watching has been stopped.";
+
+  return 0;
+}
+
 int main(int argc, char* argv[])
 {
   std::string compassRoot = cc::util::binaryPathToInstallDir(argv[0]);
@@ -283,6 +547,25 @@ int main(int argc, char* argv[])
     LOG(error) << "Error in command line arguments: " << e.what();
     return 1;
   }
+
+  if (vm.count("watch") && !vm.count("input"))
+  {
+    LOG(error) << "The watch mode needs input paths to watch.";
+    return 1;
+  }
+
+  if (vm.count("shard"))
+  {
+    std::size_t shardIndex, shardCount;
+
+    if (!cc::parser::ParserContext::parseShard(
+      vm["shard"].as<std::string>(), shardIndex, shardCount))
+    {
+      LOG(error) << "The value of --shard must be in \"i/N\" format, where "
+        "0 <= i < N.";
+      return 1;
+    }
+  }
   
   //--- Check database and project directory existence ---//
   
@@ -337,6 +620,42 @@ int main(int argc, char* argv[])
 
   if (vm.count("force") || isNewDb)
     cc::util::createTables(db, SQL_DIR);
+  else
+    // The databases of the projects parsed by an earlier version lack the
+    // tables of the newer models.
+    for (const auto& table : {
+      std::make_pair("FileContentIndex", "filecontentblock-odb.sql"),
+      std::make_pair("DatabaseGeneration", "databasegeneration-odb.sql")})
+      if (!cc::util::tableExists(db, table.first))
+        cc::util::createTablesFromFile(db, SQL_DIR + '/' + table.second);
+
+  if (vm.count("migrate-file-contents"))
+  {
+    compressFileContents(db, vm["jobs"].as<int>());
+    return 0;
+  }
+
+  //--- Merge shards ---//
+
+  if (vm.count("merge-shards"))
+  {
+    for (const std::string& shard :
+      vm["merge-shards"].as<std::vector<std::string>>())
+      if (!cc::parser::mergeShard(db, vm["database"].as<std::string>(), shard))
+        return 1;
+
+    // The shards store their contents as plain text, so they are compressed
+    // once, with one dictionary.
+    compressFileContents(db, vm["jobs"].as<int>());
+
+    cc::model::incrementDatabaseGeneration(db);
+
+    if (vm.count("force") || isNewDb)
+      cc::util::createIndexes(db, SQL_DIR);
+
+    writeProjectInfo(vm, projDir);
+    return 0;
+  }
 
   //--- Start parsers ---//
 
@@ -355,7 +674,19 @@ int main(int argc, char* argv[])
   cc::parser::ParserContext ctx(db, srcMgr, compassRoot, vm);
   pHandler.createPlugins(ctx);
 
+  cc::parser::PluginScheduler scheduler(vm["jobs"].as<int>());
+
   std::vector<std::string> pluginNames = pHandler.getLoadedPluginNames();
+  addPlugins(scheduler, pHandler, pluginNames);
+
+  // The incremental steps are run sequentially, in the dependency order.
+  pluginNames = scheduler.topologicalOrder();
+  if (pluginNames.size() != pHandler.getLoadedPluginNames().size())
+  {
+    LOG(error) << "Dependencies of the parser plugins contain a cycle!";
+    return 1;
+  }
+
   for (const std::string& pluginName : pluginNames)
   {
     LOG(info) << "[" << pluginName << "] started to mark modified files!";
@@ -397,52 +728,53 @@ int main(int argc, char* argv[])
     incrementalCleanup(ctx);
   }
 
-  // TODO: Handle errors returned by parse().
-  for (const std::string& pluginName : pluginNames)
-  {
-    LOG(info) << "[" << pluginName << "] parse started!";
-    pHandler.getParser(pluginName)->parse();
-  }
+  //--- Scan the input paths ---//
 
-  //--- Add indexes to the database ---//
+  // The plugins iterate over the manifest instead of walking the inputs on
+  // their own.
+  if (vm.count("input"))
+    ctx.manifest.scan(
+      vm["input"].as<std::vector<std::string>>(), vm["jobs"].as<int>());
+  srcMgr.setFileManifest(&ctx.manifest);
 
-  if (vm.count("force") || isNewDb)
-    cc::util::createIndexes(db, SQL_DIR);
+  // Independent plugins parse in parallel, sharing the --jobs threads. The
+  // failure of a plugin is reported, but the others still run.
+  std::chrono::steady_clock::time_point parseStart
+    = std::chrono::steady_clock::now();
 
-  //--- Create project config file ---//
+  if (!scheduler.run())
+    LOG(warning) << "Some of the parser plugins failed!";
 
-  boost::property_tree::ptree pt;
+  double parseTime = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - parseStart).count();
 
-  if (vm.count("label"))
-  {
-    boost::property_tree::ptree labels;
+  //--- Compress the new file contents ---//
 
-    for (const std::string& label : vm["label"].as<std::vector<std::string>>())
-    {
-      std::size_t pos = label.find('=');
+  srcMgr.persistFiles();
 
-      if (pos == std::string::npos)
-        LOG(warning)
-          << "Label doesn't contain '=' for separating label and the path: "
-          << label;
-      else
-        labels.put(label.substr(0, pos), label.substr(pos + 1));
-    }
+  // Every shard would train its own dictionary, and the blocks of the same
+  // content would differ between the shards, so the contents of the shards
+  // are compressed after --merge-shards.
+  if (!vm.count("shard"))
+    compressFileContents(db, vm["jobs"].as<int>());
 
-    pt.add_child("labels", labels);
-  }
+  // The webserver drops its cached data of the project when the generation
+  // changes.
+  cc::model::incrementDatabaseGeneration(db);
 
-  std::string database
-    = cc::util::connStrComponent(vm["database"].as<std::string>(), "database");
+  //--- Add indexes to the database ---//
 
-  pt.put("database", vm["database"].as<std::string>());
+  if (vm.count("force") || isNewDb)
+    cc::util::createIndexes(db, SQL_DIR);
+
+  //--- Create project config file ---//
 
-  if (vm.count("description"))
-    pt.put("description", vm["description"].as<std::string>());
+  writeProjectInfo(vm, projDir);
 
-  boost::property_tree::write_json(projDir + "/project_info.json", pt);
+  printStatistics(scheduler.statistics(), parseTime);
 
-  // TODO: Print statistics.
+  if (vm.count("watch"))
+    return watch(vm, ctx, pHandler, pluginNames);
 
   return 0;
 }
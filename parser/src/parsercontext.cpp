@@ -1,4 +1,5 @@
 #include <fstream>
+#include <stdexcept>
 
 #include <boost/filesystem.hpp>
 
@@ -28,15 +29,36 @@ ParserContext::ParserContext(
     compassRoot(compassRoot_),
     options(options_)
 {
-  std::unordered_map<std::string, std::string> fileHashes;
+  if (options.count("shard"))
+    parseShard(options["shard"].as<std::string>(), shardIndex, shardCount);
 
+  detectChanges();
+}
+
+void ParserContext::detectChanges()
+{
+  checkFiles([](const model::File&) { return true; });
+}
+
+void ParserContext::detectChanges(const std::set<std::string>& paths_)
+{
+  checkFiles([&paths_](const model::File& file_)
+  {
+    return paths_.count(file_.path) != 0;
+  });
+}
+
+void ParserContext::checkFiles(
+  const std::function<bool(const model::File&)>& filter_)
+{
   (util::OdbTransaction(this->db))([&]
    {
      // Fetch directory and binary type files from SourceManager
-     auto func = [](model::FilePtr item)
+     auto func = [&filter_](model::FilePtr item)
      {
        return item->type != model::File::DIRECTORY_TYPE &&
-              item->type != model::File::BINARY_TYPE;
+              item->type != model::File::BINARY_TYPE &&
+              filter_(*item);
      };
      std::vector<model::FilePtr> files = this->srcMgr.getFiles(func);
 
@@ -50,8 +72,6 @@ ParserContext::ParserContext(
            if (!content)
              continue;
 
-           fileHashes[file->path] = content->hash;
-
            std::ifstream fileStream(file->path);
            std::string fileContent(
              std::istreambuf_iterator<char>{fileStream},
@@ -77,6 +97,66 @@ ParserContext::ParserContext(
      // TODO: detect ADDED files
    });
 }
+
+std::shared_ptr<const CompilationDatabase> ParserContext::compilationDatabase(
+  const std::string& path_,
+  std::string& errorMsg_)
+{
+  boost::system::error_code ec;
+  std::time_t mtime = boost::filesystem::last_write_time(path_, ec);
+  std::uint64_t size = ec ? 0 : boost::filesystem::file_size(path_, ec);
+
+  std::lock_guard<std::mutex> guard(_compilationDatabasesMutex);
+
+  auto it = _compilationDatabases.find(path_);
+  if (!ec && it != _compilationDatabases.end() &&
+      it->second.mtime == mtime && it->second.size == size)
+    return it->second.db;
+
+  std::shared_ptr<const CompilationDatabase> compDb
+    = CompilationDatabase::load(path_, errorMsg_);
+
+  if (compDb)
+    _compilationDatabases[path_] = {mtime, size, compDb};
+  else
+    _compilationDatabases.erase(path_);
+
+  return compDb;
 }
+
+bool ParserContext::inShard(const std::string& key_) const
+{
+  return shardCount <= 1 || util::fnvHash(key_) % shardCount == shardIndex;
 }
 
+bool ParserContext::parseShard(
+  const std::string& shard_,
+  std::size_t& index_,
+  std::size_t& count_)
+{
+  std::size_t slash = shard_.find('/');
+  if (slash == std::string::npos)
+    return false;
+
+  try
+  {
+    std::size_t indexEnd, countEnd;
+    unsigned long index = std::stoul(shard_.substr(0, slash), &indexEnd);
+    unsigned long count = std::stoul(shard_.substr(slash + 1), &countEnd);
+
+    if (indexEnd != slash || countEnd != shard_.size() - slash - 1 ||
+        count == 0 || index >= count)
+      return false;
+
+    index_ = index;
+    count_ = count;
+    return true;
+  }
+  catch (const std::logic_error&)
+  {
+    return false;
+  }
+}
+
+}
+}
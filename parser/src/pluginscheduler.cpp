@@ -0,0 +1,320 @@
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <exception>
+#include <unordered_map>
+
+#include <util/logutil.h>
+
+#include "pluginscheduler.h"
+
+namespace
+{
+
+/**
+ * Returns the user and system CPU time used by the whole process in seconds.
+ */
+double processCpuTime()
+{
+  rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0.0;
+
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+    + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+} // namespace
+
+namespace cc
+{
+namespace parser
+{
+
+PluginScheduler::PluginScheduler(int threadNum_)
+  : _threadNum(std::max(threadNum_, 1)),
+    _freeThreads(_threadNum),
+    _lastCpuTime(0.0)
+{
+}
+
+void PluginScheduler::addPlugin(
+  const std::string& name_,
+  const std::vector<std::string>& dependencies_,
+  bool multiThreaded_,
+  ParseFunction parse_,
+  bool exclusive_)
+{
+  Plugin plugin;
+  plugin.name = name_;
+  plugin.dependencyNames = dependencies_;
+  plugin.multiThreaded = multiThreaded_;
+  plugin.exclusive = exclusive_;
+  plugin.parse = std::move(parse_);
+  plugin.stats.plugin = name_;
+
+  _plugins.push_back(std::move(plugin));
+}
+
+std::vector<std::vector<std::size_t>> PluginScheduler::dependencyGraph() const
+{
+  std::unordered_map<std::string, std::size_t> indices;
+  for (std::size_t i = 0; i < _plugins.size(); ++i)
+    indices[_plugins[i].name] = i;
+
+  std::vector<std::vector<std::size_t>> graph(_plugins.size());
+
+  for (std::size_t i = 0; i < _plugins.size(); ++i)
+    for (const std::string& dependency : _plugins[i].dependencyNames)
+    {
+      auto it = indices.find(dependency);
+      if (it != indices.end() && it->second != i)
+        graph[i].push_back(it->second);
+    }
+
+  return graph;
+}
+
+std::vector<std::size_t> PluginScheduler::resolveOrder(
+  const std::vector<std::vector<std::size_t>>& graph_) const
+{
+  std::vector<std::size_t> order;
+  std::vector<bool> ordered(_plugins.size(), false);
+
+  // The plugins are few, so the graph is simply scanned repeatedly. Each pass
+  // takes the first plugin (in registration order) whose dependencies are
+  // already ordered.
+  bool progress = true;
+  while (progress)
+  {
+    progress = false;
+
+    for (std::size_t i = 0; i < _plugins.size(); ++i)
+    {
+      if (ordered[i])
+        continue;
+
+      if (std::all_of(graph_[i].begin(), graph_[i].end(),
+        [&ordered](std::size_t dep_) { return ordered[dep_]; }))
+      {
+        order.push_back(i);
+        ordered[i] = true;
+        progress = true;
+        break;
+      }
+    }
+  }
+
+  return order;
+}
+
+std::vector<std::string> PluginScheduler::topologicalOrder() const
+{
+  std::vector<std::string> names;
+
+  for (std::size_t index : resolveOrder(dependencyGraph()))
+    names.push_back(_plugins[index].name);
+
+  return names;
+}
+
+bool PluginScheduler::run()
+{
+  std::vector<std::vector<std::size_t>> graph = dependencyGraph();
+  std::vector<std::size_t> order = resolveOrder(graph);
+
+  if (order.size() != _plugins.size())
+  {
+    for (std::size_t i = 0; i < _plugins.size(); ++i)
+      if (std::find(order.begin(), order.end(), i) == order.end())
+        LOG(error) << "[" << _plugins[i].name << "] is part of or depends on "
+          "a dependency cycle of parser plugins!";
+    return false;
+  }
+
+  // The plugins can be run again, e.g. by the watch mode.
+  for (Plugin& plugin : _plugins)
+  {
+    plugin.state = State::WAITING;
+    plugin.stats = Statistics();
+    plugin.stats.plugin = plugin.name;
+  }
+
+  _statistics.clear();
+  _lastCpuTime = processCpuTime();
+
+  bool success = true;
+  std::size_t finishedNum = 0;
+
+  while (finishedNum < _plugins.size())
+  {
+    startReadyPlugins(order, graph);
+
+    std::vector<std::pair<std::size_t, bool>> finished;
+
+    {
+      std::unique_lock<std::mutex> lock(_finishedMutex);
+      _finishedCond.wait(lock, [this]{ return !_finished.empty(); });
+      finished.swap(_finished);
+    }
+
+    accountCpuTime();
+
+    for (const auto& result : finished)
+    {
+      Plugin& plugin = _plugins[result.first];
+      plugin.thread.join();
+
+      plugin.state = State::FINISHED;
+      plugin.stats.success = result.second;
+      plugin.stats.wallTime = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - plugin.start).count();
+
+      _freeThreads += plugin.stats.threadNum;
+      _statistics.push_back(plugin.stats);
+      ++finishedNum;
+
+      if (result.second)
+        LOG(info) << "[" << plugin.name << "] parse finished!";
+      else
+      {
+        LOG(error) << "[" << plugin.name << "] parse failed!";
+        success = false;
+      }
+    }
+  }
+
+  return success;
+}
+
+void PluginScheduler::startReadyPlugins(
+  const std::vector<std::size_t>& order_,
+  const std::vector<std::vector<std::size_t>>& graph_)
+{
+  std::vector<std::size_t> singles;
+  std::vector<std::size_t> multis;
+  const std::size_t* exclusive = nullptr;
+  bool running = false;
+
+  for (const std::size_t& index : order_)
+  {
+    const Plugin& plugin = _plugins[index];
+
+    if (plugin.state == State::RUNNING)
+    {
+      // Nothing else starts while an exclusive plugin is running.
+      if (plugin.exclusive)
+        return;
+      running = true;
+    }
+
+    if (plugin.state != State::WAITING ||
+        !std::all_of(graph_[index].begin(), graph_[index].end(),
+          [this](std::size_t dep_)
+          {
+            return _plugins[dep_].state == State::FINISHED;
+          }))
+      continue;
+
+    if (plugin.exclusive && !exclusive)
+      exclusive = &index;
+
+    (plugin.multiThreaded ? multis : singles).push_back(index);
+  }
+
+  if (singles.empty() && multis.empty())
+    return;
+
+  // A ready exclusive plugin waits for the running ones, and the other ready
+  // plugins wait for it, so that it is not starved.
+  if (exclusive)
+  {
+    if (!running)
+    {
+      accountCpuTime();
+      startPlugin(
+        *exclusive, _plugins[*exclusive].multiThreaded ? _freeThreads : 1);
+    }
+    return;
+  }
+
+  accountCpuTime();
+
+  // Single-threaded plugins are usually waiting for I/O or for an external
+  // process, so they shouldn't starve the multi-threaded ones.
+  int reserved = multis.empty()
+    ? 0
+    : std::max(static_cast<int>(multis.size()), _freeThreads / 2);
+
+  for (std::size_t index : singles)
+  {
+    if (_freeThreads - reserved <= 0)
+      break;
+    startPlugin(index, 1);
+  }
+
+  for (std::size_t i = 0; i < multis.size() && _freeThreads > 0; ++i)
+    startPlugin(
+      multis[i],
+      std::max(_freeThreads / static_cast<int>(multis.size() - i), 1));
+}
+
+void PluginScheduler::startPlugin(std::size_t index_, int threadNum_)
+{
+  Plugin& plugin = _plugins[index_];
+
+  plugin.state = State::RUNNING;
+  plugin.stats.threadNum = threadNum_;
+  plugin.start = std::chrono::steady_clock::now();
+  _freeThreads -= threadNum_;
+
+  LOG(info) << "[" << plugin.name << "] parse started with " << threadNum_
+    << " thread(s)!";
+
+  plugin.thread = std::thread([this, index_, threadNum_]()
+  {
+    const Plugin& plugin = _plugins[index_];
+    bool success = false;
+
+    try
+    {
+      success = plugin.parse(threadNum_);
+    }
+    catch (const std::exception& ex_)
+    {
+      LOG(error) << "[" << plugin.name << "] parse threw an exception: "
+        << ex_.what();
+    }
+    catch (...)
+    {
+      LOG(error) << "[" << plugin.name << "] parse threw an unknown exception!";
+    }
+
+    std::lock_guard<std::mutex> lock(_finishedMutex);
+    _finished.emplace_back(index_, success);
+    _finishedCond.notify_one();
+  });
+}
+
+void PluginScheduler::accountCpuTime()
+{
+  double cpuTime = processCpuTime();
+  int usedThreads = _threadNum - _freeThreads;
+
+  if (usedThreads > 0)
+    for (Plugin& plugin : _plugins)
+      if (plugin.state == State::RUNNING)
+        plugin.stats.cpuTime
+          += (cpuTime - _lastCpuTime) * plugin.stats.threadNum / usedThreads;
+
+  _lastCpuTime = cpuTime;
+}
+
+const std::vector<PluginScheduler::Statistics>&
+PluginScheduler::statistics() const
+{
+  return _statistics;
+}
+
+} // parser
+} // cc
@@ -0,0 +1,158 @@
+#ifndef CC_PARSER_PLUGINSCHEDULER_H
+#define CC_PARSER_PLUGINSCHEDULER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Runs the parse() step of the parser plugins along their dependency graph.
+ * A plugin starts as soon as its dependencies have finished, so independent
+ * plugins parse in parallel. The plugins share one thread budget (--jobs):
+ * a running plugin holds the threads it was granted until it finishes.
+ * Exclusive plugins run alone with all threads.
+ */
+class PluginScheduler
+{
+public:
+  /**
+   * Parse function of a plugin. It gets the number of threads granted to the
+   * plugin and returns whether the parsing succeeded.
+   */
+  typedef std::function<bool(int)> ParseFunction;
+
+  struct Statistics
+  {
+    std::string plugin;
+    int threadNum = 0;
+    double wallTime = 0.0; /*!< In seconds. */
+    double cpuTime = 0.0; /*!< In seconds, see run(). */
+    bool success = false;
+  };
+
+  /**
+   * @param threadNum_ The number of threads shared by the plugins.
+   */
+  PluginScheduler(int threadNum_);
+
+  PluginScheduler(const PluginScheduler&) = delete;
+  PluginScheduler& operator=(const PluginScheduler&) = delete;
+
+  /**
+   * Registers a plugin. Dependencies on plugins which are not registered
+   * (e.g. skipped ones) are ignored.
+   * @param multiThreaded_ If false then the plugin is granted a single thread.
+   * Single-threaded plugins may take at most half of the free threads while a
+   * multi-threaded plugin is waiting to start.
+   * @param exclusive_ If true then the plugin starts only when no other plugin
+   * is running, and no other plugin starts while it is ready or running.
+   */
+  void addPlugin(
+    const std::string& name_,
+    const std::vector<std::string>& dependencies_,
+    bool multiThreaded_,
+    ParseFunction parse_,
+    bool exclusive_ = false);
+
+  /**
+   * Returns the plugin names in an order which respects the dependencies.
+   * Among independent plugins the registration order is kept. Plugins which
+   * are part of (or depend on) a dependency cycle are missing from the result.
+   */
+  std::vector<std::string> topologicalOrder() const;
+
+  /**
+   * Runs the parse function of every plugin and waits for all of them. A
+   * failed plugin doesn't prevent its dependents from running.
+   *
+   * The CPU time of the process is measured whenever a plugin starts or
+   * finishes. The time between two measurements is divided among the running
+   * plugins in proportion to their threads, so the CPU time of a plugin is
+   * exact only if it was running alone.
+   *
+   * run() can be called again, e.g. by the watch mode.
+   *
+   * @return False if the dependencies contain a cycle (in which case nothing
+   * is run) or if any of the plugins failed.
+   */
+  bool run();
+
+  /**
+   * Statistics of the plugins of the last run() in the order they finished.
+   */
+  const std::vector<Statistics>& statistics() const;
+
+private:
+  enum class State
+  {
+    WAITING,
+    RUNNING,
+    FINISHED
+  };
+
+  struct Plugin
+  {
+    std::string name;
+    std::vector<std::string> dependencyNames;
+    bool multiThreaded;
+    bool exclusive;
+    ParseFunction parse;
+    State state = State::WAITING;
+    std::thread thread;
+    std::chrono::steady_clock::time_point start;
+    Statistics stats;
+  };
+
+  /**
+   * Returns the indices of the registered dependencies of each plugin.
+   */
+  std::vector<std::vector<std::size_t>> dependencyGraph() const;
+
+  /**
+   * Returns the plugin indices in topological order, see topologicalOrder().
+   */
+  std::vector<std::size_t> resolveOrder(
+    const std::vector<std::vector<std::size_t>>& graph_) const;
+
+  /**
+   * Starts the plugins whose dependencies have finished, as long as there
+   * are free threads. A ready exclusive plugin is started alone, once the
+   * running plugins have finished.
+   */
+  void startReadyPlugins(
+    const std::vector<std::size_t>& order_,
+    const std::vector<std::vector<std::size_t>>& graph_);
+
+  void startPlugin(std::size_t index_, int threadNum_);
+
+  /**
+   * Distributes the CPU time used since the previous call among the running
+   * plugins.
+   */
+  void accountCpuTime();
+
+  std::vector<Plugin> _plugins;
+  std::vector<Statistics> _statistics;
+  int _threadNum;
+  int _freeThreads;
+  double _lastCpuTime;
+
+  std::mutex _finishedMutex;
+  std::condition_variable _finishedCond;
+  std::vector<std::pair<std::size_t, bool>> _finished;
+};
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_PLUGINSCHEDULER_H
@@ -0,0 +1,698 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+
+#ifdef DATABASE_SQLITE
+#  include <odb/sqlite/connection.hxx>
+#endif
+
+#ifdef DATABASE_PGSQL
+#  include <libpq-fe.h>
+#  include <odb/pgsql/connection.hxx>
+#endif
+
+#include <odb/connection.hxx>
+#include <odb/transaction.hxx>
+
+#include <util/dbutil.h>
+#include <util/logutil.h>
+
+#include "shardmerge.h"
+
+namespace
+{
+
+typedef std::vector<std::vector<std::string>> Rows;
+
+/**
+ * These tables are not merged: the schema version of ODB and the generation
+ * of the database, which is incremented after the merge.
+ */
+const std::set<std::string> skippedTables{
+  "schema_version", "DatabaseGeneration"};
+
+/**
+ * The tables of the compressed file contents. A shard stores its contents as
+ * plain text, and they are compressed after the merge: the blocks refer to a
+ * dictionary of their own shard, and the blocks of the same content differ
+ * between the shards.
+ */
+const std::set<std::string> compressedContentTables{
+  "FileContentIndex", "FileContentBlock", "FileContentDictionary"};
+
+struct Column
+{
+  std::string name;
+  bool notNull;
+};
+
+struct Table
+{
+  std::string name;
+  std::vector<Column> columns;
+  std::vector<std::string> primaryKey;
+
+  /**
+   * True if the primary key is one column generated by the database.
+   */
+  bool autoId = false;
+
+  /**
+   * Foreign key columns and the tables referenced by them.
+   */
+  std::map<std::string, std::string> references;
+};
+
+std::string quote(const std::string& name_)
+{
+  return '"' + name_ + '"';
+}
+
+std::string literal(const std::string& value_)
+{
+  std::string result = "'";
+
+  for (char c : value_)
+  {
+    if (c == '\'')
+      result += '\'';
+    result += c;
+  }
+
+  return result + '\'';
+}
+
+/**
+ * Returns a condition which is true if the column has the same value in the
+ * two rows, including NULL values.
+ */
+std::string equals(
+  const Column& column_,
+  const std::string& left_,
+  const std::string& right_)
+{
+  std::string left = left_ + '.' + quote(column_.name);
+  std::string right = right_ + '.' + quote(column_.name);
+
+  if (column_.notNull)
+    return left + " = " + right;
+
+#ifdef DATABASE_PGSQL
+  return left + " IS NOT DISTINCT FROM " + right;
+#else
+  return left + " IS " + right;
+#endif
+}
+
+class ShardMerger
+{
+public:
+  /**
+   * @param schema_ Schema of the project tables.
+   * @param shardSchema_ Schema of the shard tables.
+   */
+  ShardMerger(
+    odb::connection& connection_,
+    const std::string& schema_,
+    const std::string& shardSchema_)
+    : _connection(connection_), _schema(schema_), _shardSchema(shardSchema_)
+  {
+  }
+
+  /**
+   * Merges the tables of the shard. It must be called in a transaction.
+   */
+  void merge();
+
+private:
+  /**
+   * Runs a query and returns its result as text.
+   */
+  Rows query(const std::string& sql_);
+
+  std::vector<std::string> tableNames(const std::string& schema_);
+
+  /**
+   * Reads the columns and the keys of a shard table from the catalog.
+   */
+  Table table(const std::string& name_);
+
+  /**
+   * Orders the tables so that every table follows the tables which it
+   * references.
+   */
+  std::vector<const Table*> mergeOrder() const;
+
+  /**
+   * Returns the temporary table which maps the shard IDs of the table to the
+   * project IDs, or an empty string if the IDs are not changed. The IDs of a
+   * derived class are the IDs of its base class.
+   */
+  std::string idMap(const std::string& table_) const;
+
+  /**
+   * Merges a table.
+   * @return The number of the inserted rows.
+   */
+  std::uint64_t mergeTable(const Table& table_);
+
+  std::string target(const std::string& table_) const
+  {
+    return quote(_schema) + '.' + quote(table_);
+  }
+
+  std::string source(const std::string& table_) const
+  {
+    return quote(_shardSchema) + '.' + quote(table_);
+  }
+
+  odb::connection& _connection;
+  std::string _schema;
+  std::string _shardSchema;
+  std::map<std::string, Table> _tables;
+  std::map<std::string, std::string> _idMaps;
+};
+
+void ShardMerger::merge()
+{
+  std::set<std::string> targetTables;
+  for (const std::string& name : tableNames(_schema))
+    targetTables.insert(name);
+
+  for (const std::string& name : tableNames(_shardSchema))
+  {
+    if (skippedTables.count(name))
+      continue;
+
+    if (compressedContentTables.count(name))
+    {
+      if (!query("SELECT 1 FROM " + source(name) + " LIMIT 1").empty())
+        throw std::runtime_error(
+          "the shard has compressed file contents, it has to be parsed again "
+          "with --shard");
+      continue;
+    }
+
+    if (!targetTables.count(name))
+    {
+      LOG(warning)
+        << "Table " << name << " of the shard is missing from the project "
+        << "database, it is skipped.";
+      continue;
+    }
+
+    _tables.emplace(name, table(name));
+  }
+
+  for (const Table* table : mergeOrder())
+  {
+    std::uint64_t rows = mergeTable(*table);
+    LOG(debug) << "Merged " << rows << " rows into " << table->name << '.';
+  }
+
+  for (const auto& idMap : _idMaps)
+    _connection.execute("DROP TABLE " + quote(idMap.second));
+}
+
+Rows ShardMerger::query(const std::string& sql_)
+{
+  Rows rows;
+
+#ifdef DATABASE_SQLITE
+  sqlite3* handle
+    = static_cast<odb::sqlite::connection&>(_connection).handle();
+
+  sqlite3_stmt* statement;
+  if (sqlite3_prepare_v2(
+        handle, sql_.c_str(), -1, &statement, nullptr) != SQLITE_OK)
+    throw std::runtime_error(sqlite3_errmsg(handle));
+
+  int status;
+  while ((status = sqlite3_step(statement)) == SQLITE_ROW)
+  {
+    std::vector<std::string> row;
+
+    for (int i = 0; i < sqlite3_column_count(statement); ++i)
+    {
+      const unsigned char* text = sqlite3_column_text(statement, i);
+      row.emplace_back(text ? reinterpret_cast<const char*>(text) : "");
+    }
+
+    rows.push_back(std::move(row));
+  }
+
+  std::string error = sqlite3_errmsg(handle);
+  sqlite3_finalize(statement);
+
+  if (status != SQLITE_DONE)
+    throw std::runtime_error(error);
+#endif
+
+#ifdef DATABASE_PGSQL
+  PGconn* handle = static_cast<odb::pgsql::connection&>(_connection).handle();
+
+  PGresult* result = PQexec(handle, sql_.c_str());
+
+  if (PQresultStatus(result) != PGRES_TUPLES_OK)
+  {
+    std::string error = PQresultErrorMessage(result);
+    PQclear(result);
+    throw std::runtime_error(error);
+  }
+
+  for (int i = 0; i < PQntuples(result); ++i)
+  {
+    std::vector<std::string> row;
+
+    for (int j = 0; j < PQnfields(result); ++j)
+      row.emplace_back(PQgetvalue(result, i, j));
+
+    rows.push_back(std::move(row));
+  }
+
+  PQclear(result);
+#endif
+
+  return rows;
+}
+
+std::vector<std::string> ShardMerger::tableNames(const std::string& schema_)
+{
+  std::vector<std::string> names;
+
+#ifdef DATABASE_SQLITE
+  for (const auto& row : query(
+    "SELECT name FROM " + quote(schema_) + ".sqlite_master "
+    "WHERE type = 'table'"))
+    if (!boost::starts_with(row[0], "sqlite_"))
+      names.push_back(row[0]);
+#endif
+
+#ifdef DATABASE_PGSQL
+  for (const auto& row : query(
+    "SELECT table_name FROM information_schema.tables "
+    "WHERE table_schema = " + literal(schema_) +
+    " AND table_type = 'BASE TABLE'"))
+    names.push_back(row[0]);
+#endif
+
+  return names;
+}
+
+Table ShardMerger::table(const std::string& name_)
+{
+  Table table;
+  table.name = name_;
+
+#ifdef DATABASE_SQLITE
+  std::string pragma = "PRAGMA " + quote(_shardSchema) + '.';
+  std::map<int, std::string> primaryKey;
+
+  // Columns: cid, name, type, notnull, dflt_value, pk.
+  for (const auto& row : query(
+    pragma + "table_info(" + literal(name_) + ')'))
+  {
+    table.columns.push_back({row[1], row[3] == "1"});
+
+    if (row[5] != "0")
+      primaryKey[std::stoi(row[5])] = row[1];
+  }
+
+  for (const auto& column : primaryKey)
+    table.primaryKey.push_back(column.second);
+
+  // ODB declares the generated IDs as AUTOINCREMENT.
+  Rows sql = query(
+    "SELECT sql FROM " + quote(_shardSchema) + ".sqlite_master "
+    "WHERE type = 'table' AND name = " + literal(name_));
+
+  table.autoId = table.primaryKey.size() == 1 && !sql.empty() &&
+    boost::algorithm::to_upper_copy(sql[0][0]).find("AUTOINCREMENT")
+      != std::string::npos;
+
+  // Columns: id, seq, table, from, to, on_update, on_delete, match. Only the
+  // foreign keys of one column are translated.
+  std::map<std::string, std::vector<std::pair<std::string, std::string>>>
+    foreignKeys;
+
+  for (const auto& row : query(
+    pragma + "foreign_key_list(" + literal(name_) + ')'))
+    foreignKeys[row[0]].emplace_back(row[3], row[2]);
+
+  for (const auto& foreignKey : foreignKeys)
+    if (foreignKey.second.size() == 1)
+      table.references.insert(foreignKey.second.front());
+#endif
+
+#ifdef DATABASE_PGSQL
+  std::string relation = literal(source(name_)) + "::regclass";
+  std::set<std::string> generated;
+
+  for (const auto& row : query(
+    "SELECT column_name, is_nullable, column_default "
+    "FROM information_schema.columns "
+    "WHERE table_schema = " + literal(_shardSchema) +
+    " AND table_name = " + literal(name_) +
+    " ORDER BY ordinal_position"))
+  {
+    table.columns.push_back({row[0], row[1] == "NO"});
+
+    if (boost::starts_with(row[2], "nextval("))
+      generated.insert(row[0]);
+  }
+
+  for (const auto& row : query(
+    "SELECT a.attname FROM pg_index i "
+    "JOIN pg_attribute a "
+    "ON a.attrelid = i.indrelid AND a.attnum = ANY(i.indkey) "
+    "WHERE i.indrelid = " + relation + " AND i.indisprimary"))
+    table.primaryKey.push_back(row[0]);
+
+  table.autoId = table.primaryKey.size() == 1 &&
+    generated.count(table.primaryKey.front());
+
+  for (const auto& row : query(
+    "SELECT a.attname, r.relname FROM pg_constraint c "
+    "JOIN pg_attribute a "
+    "ON a.attrelid = c.conrelid AND a.attnum = c.conkey[1] "
+    "JOIN pg_class r ON r.oid = c.confrelid "
+    "WHERE c.conrelid = " + relation + " AND c.contype = 'f' "
+    "AND array_length(c.conkey, 1) = 1"))
+    table.references.emplace(row[0], row[1]);
+#endif
+
+  return table;
+}
+
+std::vector<const Table*> ShardMerger::mergeOrder() const
+{
+  std::vector<const Table*> order;
+  std::map<std::string, int> state; // 1: visiting, 2: visited.
+
+  std::function<void(const Table&)> visit = [&](const Table& table_)
+  {
+    state[table_.name] = 1;
+
+    for (const auto& reference : table_.references)
+    {
+      auto it = _tables.find(reference.second);
+
+      if (it == _tables.end() || reference.second == table_.name)
+        continue;
+
+      int referenceState = state[reference.second];
+
+      if (referenceState == 0)
+        visit(it->second);
+      else if (referenceState == 1)
+        LOG(warning)
+          << "The foreign keys of " << table_.name << " and "
+          << reference.second << " form a cycle, the IDs referenced by "
+          << table_.name << '.' << reference.first
+          << " may not be translated.";
+    }
+
+    state[table_.name] = 2;
+    order.push_back(&table_);
+  };
+
+  for (const auto& table : _tables)
+    if (!state[table.first])
+      visit(table.second);
+
+  return order;
+}
+
+std::string ShardMerger::idMap(const std::string& table_) const
+{
+  auto map = _idMaps.find(table_);
+  if (map != _idMaps.end())
+    return map->second;
+
+  auto table = _tables.find(table_);
+  if (table == _tables.end() || table->second.primaryKey.size() != 1)
+    return std::string();
+
+  auto base = table->second.references.find(table->second.primaryKey[0]);
+  if (base == table->second.references.end() || base->second == table_)
+    return std::string();
+
+  return idMap(base->second);
+}
+
+std::uint64_t ShardMerger::mergeTable(const Table& table_)
+{
+  //--- Translate the foreign keys ---//
+
+  std::string columns;
+  std::string select;
+  std::string joins;
+
+  for (const Column& column : table_.columns)
+  {
+    std::string value = "s." + quote(column.name);
+
+    auto reference = table_.references.find(column.name);
+    if (reference != table_.references.end() &&
+        reference->second != table_.name)
+    {
+      std::string map = idMap(reference->second);
+
+      if (!map.empty())
+      {
+        std::string alias = "m" + std::to_string(joins.size());
+        joins += " LEFT JOIN " + quote(map) + ' ' + alias
+          + " ON " + alias + ".old_id = " + value;
+        value = "COALESCE(" + alias + ".new_id, " + value + ')';
+      }
+    }
+
+    if (!columns.empty())
+    {
+      columns += ", ";
+      select += ", ";
+    }
+
+    columns += quote(column.name);
+    select += value + " AS " + quote(column.name);
+  }
+
+  std::string from = " FROM " + source(table_.name) + " s" + joins;
+
+  //--- Rows identified by a natural key ---//
+
+  if (!table_.primaryKey.empty() && !table_.autoId)
+  {
+#ifdef DATABASE_SQLITE
+    return _connection.execute(
+      "INSERT OR IGNORE INTO " + target(table_.name) + " (" + columns + ") "
+      "SELECT " + select + from);
+#else
+    return _connection.execute(
+      "INSERT INTO " + target(table_.name) + " (" + columns + ") "
+      "SELECT " + select + from + " ON CONFLICT DO NOTHING");
+#endif
+  }
+
+  _connection.execute("CREATE TEMP TABLE cc_stage AS SELECT " + select + from);
+
+  std::uint64_t rows;
+
+  if (table_.autoId)
+  {
+    //--- Rows with generated IDs ---//
+
+    const std::string& id = table_.primaryKey.front();
+    std::string map = quote("cc_map_" + table_.name);
+
+    // The new rows get the IDs after the largest one of the project.
+    long long maxId = std::stoll(query(
+      "SELECT COALESCE(MAX(" + quote(id) + "), 0) FROM "
+      + target(table_.name))[0][0]);
+    long long minId = std::stoll(query(
+      "SELECT COALESCE(MIN(" + quote(id) + "), 1) FROM cc_stage")[0][0]);
+    std::string newId
+      = "st." + quote(id) + " + " + std::to_string(maxId - minId + 1);
+
+    // A row equal to a project row in every other column is mapped to it.
+    // The references to the same table are not compared, since they are not
+    // translated yet.
+    std::string key;
+    for (const Column& column : table_.columns)
+    {
+      auto reference = table_.references.find(column.name);
+      if (column.name == id || (reference != table_.references.end() &&
+          reference->second == table_.name))
+        continue;
+
+      key += (key.empty() ? "" : " AND ") + equals(column, "m", "st");
+    }
+
+    _connection.execute(
+      "CREATE TEMP TABLE " + map +
+      " (old_id BIGINT PRIMARY KEY, new_id BIGINT NOT NULL)");
+
+    _connection.execute(
+      "INSERT INTO " + map + " (old_id, new_id) "
+      "SELECT st." + quote(id) + ", COALESCE(MIN(m." + quote(id) + "), "
+      + newId + ") FROM cc_stage st "
+      "LEFT JOIN " + target(table_.name) + " m ON "
+      + (key.empty() ? "1 = 0" : key) +
+      " GROUP BY st." + quote(id));
+
+    _idMaps[table_.name] = "cc_map_" + table_.name;
+
+    std::string values;
+    std::string selfJoins;
+
+    for (const Column& column : table_.columns)
+    {
+      std::string value = "st." + quote(column.name);
+      auto reference = table_.references.find(column.name);
+
+      if (column.name == id)
+        value = "mp.new_id";
+      else if (reference != table_.references.end() &&
+               reference->second == table_.name)
+      {
+        std::string alias = "s" + std::to_string(selfJoins.size());
+        selfJoins += " LEFT JOIN " + map + ' ' + alias
+          + " ON " + alias + ".old_id = " + value;
+        value = "COALESCE(" + alias + ".new_id, " + value + ')';
+      }
+
+      values += (values.empty() ? "" : ", ") + value;
+    }
+
+    rows = _connection.execute(
+      "INSERT INTO " + target(table_.name) + " (" + columns + ") "
+      "SELECT " + values + " FROM cc_stage st "
+      "JOIN " + map + " mp ON mp.old_id = st." + quote(id) + selfJoins +
+      " WHERE mp.new_id = " + newId);
+
+#ifdef DATABASE_PGSQL
+    // The explicit IDs don't advance the sequence of the column.
+    if (rows)
+      query(
+        "SELECT setval(pg_get_serial_sequence("
+        + literal(target(table_.name)) + ", " + literal(id) + "), "
+        "(SELECT MAX(" + quote(id) + ") FROM " + target(table_.name) + "))");
+#endif
+  }
+  else
+  {
+    //--- Rows without a primary key ---//
+
+    // EXCEPT compares the rows as sets, so NULL values are equal and the
+    // database can sort or hash the rows instead of scanning the project
+    // table for each staged row.
+    rows = _connection.execute(
+      "INSERT INTO " + target(table_.name) + " (" + columns + ") "
+      "SELECT " + columns + " FROM cc_stage "
+      "EXCEPT SELECT " + columns + " FROM " + target(table_.name));
+  }
+
+  _connection.execute("DROP TABLE cc_stage");
+
+  return rows;
+}
+
+} // namespace
+
+namespace cc
+{
+namespace parser
+{
+
+bool mergeShard(
+  std::shared_ptr<odb::database> db_,
+  const std::string& connStr_,
+  const std::string& shardConnStr_)
+{
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now();
+
+  odb::connection_ptr connection = db_->connection();
+  std::string schema;
+  std::string shardSchema;
+
+#ifdef DATABASE_SQLITE
+  std::string path = util::connStrComponent(shardConnStr_, "database");
+  if (path.substr(0, 2) == "~/")
+    if (char* home = std::getenv("HOME"))
+      path = home + path.substr(1);
+
+  if (!boost::filesystem::is_regular_file(path))
+  {
+    LOG(error) << "Shard database " << path << " doesn't exist.";
+    return false;
+  }
+
+  schema = "main";
+  shardSchema = "shard";
+#endif
+
+#ifdef DATABASE_PGSQL
+  schema = util::connStrComponent(connStr_, "schema");
+  if (schema.empty())
+    schema = "public";
+
+  shardSchema = util::connStrComponent(shardConnStr_, "schema");
+
+  if (shardSchema.empty() || shardSchema == schema ||
+      util::connStrComponent(shardConnStr_, "database") !=
+      util::connStrComponent(connStr_, "database"))
+  {
+    LOG(error)
+      << "A PostgreSQL shard must be another schema of the project "
+      << "database: " << shardConnStr_;
+    return false;
+  }
+#endif
+
+  LOG(info) << "Merging shard " << shardConnStr_;
+
+  bool attached = false;
+  bool success = true;
+
+  try
+  {
+#ifdef DATABASE_SQLITE
+    // A database can't be attached in a transaction.
+    connection->execute("ATTACH DATABASE " + literal(path) + " AS shard");
+    attached = true;
+#endif
+
+    odb::transaction transaction(connection->begin());
+    ShardMerger(*connection, schema, shardSchema).merge();
+    transaction.commit();
+  }
+  catch (const std::exception& ex)
+  {
+    LOG(error) << "Merging shard " << shardConnStr_ << " failed: " << ex.what();
+    success = false;
+  }
+
+  if (attached)
+    connection->execute("DETACH DATABASE shard");
+
+  if (success)
+    LOG(info)
+      << "Merged shard " << shardConnStr_ << " in "
+      << std::chrono::duration_cast<std::chrono::seconds>(
+           std::chrono::steady_clock::now() - start).count() << " s.";
+
+  return success;
+}
+
+} // parser
+} // cc
@@ -0,0 +1,49 @@
+#ifndef CC_PARSER_SHARDMERGE_H
+#define CC_PARSER_SHARDMERGE_H
+
+#include <memory>
+#include <string>
+
+#include <odb/database.hxx>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Merges the database of a shard (see --shard) into the database of the
+ * project. The tables are discovered from the catalog of the shard, so the
+ * tables of every plugin are merged. The tables are merged in the order of
+ * their foreign keys, in one transaction:
+ *
+ * - Rows identified by content hashes, e.g. File, CppAstNode and CppEdge,
+ *   are inserted unless a row with the same ID already exists.
+ * - Rows with database generated IDs, e.g. CppEntity and BuildAction, are
+ *   deduplicated by the values of their other columns. The new ones get IDs
+ *   after the largest one of the project. The foreign keys referencing them,
+ *   including the IDs of the derived classes, are translated to the new IDs.
+ * - Rows without a primary key, e.g. the elements of containers, are
+ *   inserted unless the same row already exists.
+ *
+ * The file contents of a shard must be plain text, they are compressed after
+ * the merge. A shard with compressed contents is not merged.
+ *
+ * SQLite shards are attached to the project database. PostgreSQL shards must
+ * be schemas of the project database (see the "schema" key of the
+ * connection string).
+ *
+ * @param db_ Database of the project.
+ * @param connStr_ Connection string of the project database.
+ * @param shardConnStr_ Connection string of the shard database.
+ * @return True if the shard has been merged.
+ */
+bool mergeShard(
+  std::shared_ptr<odb::database> db_,
+  const std::string& connStr_,
+  const std::string& shardConnStr_);
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_SHARDMERGE_H
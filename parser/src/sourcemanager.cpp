@@ -6,6 +6,8 @@
 #include <util/hash.h>
 #include <util/logutil.h>
 
+#include <model/filecontentstore.h>
+
 #include <parser/sourcemanager.h>
 
 namespace cc
@@ -14,36 +16,16 @@ namespace parser
 {
 
 SourceManager::SourceManager(std::shared_ptr<odb::database> db_)
-  : _db(db_), _transaction(db_), _magicCookie(nullptr)
+  : _db(db_), _manifest(nullptr)
 {
   //--- Reload files from database ---//
 
   reloadCache();
-
-  //--- Initialize magic for plain text testing ---//
-
-  if ((_magicCookie = ::magic_open(MAGIC_SYMLINK)))
-  {
-    if (::magic_load(_magicCookie, 0) != 0)
-    {
-      LOG(warning)
-        << "libmagic error: "
-        << ::magic_error(_magicCookie);
-
-      ::magic_close(_magicCookie);
-      _magicCookie = nullptr;
-    }
-  }
-  else
-    LOG(warning) << "Failed to create a libmagic cookie!";
 }
 
 SourceManager::~SourceManager()
 {
   persistFiles();
-
-  if (_magicCookie)
-    ::magic_close(_magicCookie);
 }
 
 void SourceManager::reloadCache()
@@ -52,16 +34,16 @@ void SourceManager::reloadCache()
   _persistedFiles.clear();
   _persistedContents.clear();
 
-  _transaction([&, this]() {
+  util::OdbTransaction {_db} ([&, this]() {
 
     for (const model::File& file : _db->query<model::File>())
     {
       _files[file.path] = std::make_shared<model::File>(file);
-      _persistedFiles.insert(file.id);
+      markFilePersisted(file.id);
     }
 
     for (const auto& fileContentId : _db->query<model::FileContentIds>())
-      _persistedContents.insert(fileContentId.hash);
+      markContentPersisted(fileContentId.hash);
   });
 }
 
@@ -116,8 +98,24 @@ model::FilePtr SourceManager::getCreateFileEntry(
     return file;
   }
 
+  std::shared_ptr<util::SharedHashMap> sharedFiles = _sharedFiles;
   _createFileMutex.unlock();
 
+  //--- Load the file if it was persisted by another process ---//
+
+  if (sharedFiles && sharedFiles->contains(util::fnvHash(path_)))
+  {
+    model::FilePtr file;
+    util::OdbTransaction {_db} ([&, this]() {
+      file = _db->find<model::File>(util::fnvHash(path_));
+    });
+
+    // The other process may not have committed the file yet. Then the new
+    // entry is not persisted again by persistFiles().
+    if (file)
+      return file;
+  }
+
   //--- Create new file entry ---//
 
   boost::system::error_code ec;
@@ -201,41 +199,46 @@ model::FilePtr SourceManager::getCreateParent(const std::string& path_)
 
 bool SourceManager::isPlainText(const std::string& path_) const
 {
-  static std::mutex _magicFileMutex;
-  std::lock_guard<std::mutex> guard(_magicFileMutex);
-
-  const char* magic = ::magic_file(_magicCookie, path_.c_str());
+  if (_manifest)
+    return _manifest->fileType(path_).plainText;
 
-  if (!magic)
-  {
-    LOG(warning) << "Couldn't use magic on file: " << path_;
-    return false;
-  }
-
-  if (std::strstr(magic, "text"))
-    return true;
+  std::string mimeType;
+  return FileManifest::classify(path_, mimeType);
+}
 
-  return false;
+void SourceManager::setFileManifest(const FileManifest* manifest_)
+{
+  _manifest = manifest_;
 }
 
 void SourceManager::updateFile(const model::File& file_)
 {
-  _createFileMutex.lock();
-  bool find = _persistedFiles.find(file_.id) != _persistedFiles.end();
-  _createFileMutex.unlock();
+  std::lock_guard<std::mutex> guard(_createFileMutex);
 
-  if (find)
-    _transaction([&]() {
+  if (isFilePersisted(file_.id))
+    util::OdbTransaction {_db} ([&]() {
       _db->update(file_);
     });
 }
 
+void SourceManager::updateFile(
+  const model::FilePtr& file_,
+  const std::function<bool(model::File&)>& modify_)
+{
+  std::lock_guard<std::mutex> guard(_createFileMutex);
+
+  if (modify_(*file_) && isFilePersisted(file_->id))
+    util::OdbTransaction {_db} ([&]() {
+      _db->update(*file_);
+    });
+}
+
 void SourceManager::removeFile(const model::File& file_)
 {
   bool removeContent = false;
 
   // Delete File and FileContent (only when no other File references it)
-  _transaction([&]() {
+  util::OdbTransaction {_db} ([&]() {
     if(file_.content)
     {
       auto relFiles = _db->query<model::File>(
@@ -243,7 +246,7 @@ void SourceManager::removeFile(const model::File& file_)
       if (relFiles.size() == 1)
       {
         removeContent = true;
-        _db->erase<model::FileContent>(file_.content.object_id());
+        model::eraseFileContent(*_db, file_.content.object_id());
       }
     }
     _db->erase<model::File>(file_.id);
@@ -263,42 +266,166 @@ void SourceManager::persistFiles()
 {
   std::lock_guard<std::mutex> guard(_createFileMutex);
 
-  _transaction([&]() {
-    for (const auto& p : _files)
-    {
-      if (_persistedFiles.find(p.second->id) == _persistedFiles.end())
-        _persistedFiles.insert(p.second->id);
-      else
-        continue;
+  // The marks of the files and contents persisted here are published after
+  // the commit, or removed if the transaction fails.
+  std::vector<model::FileId> files;
+  std::vector<std::string> contents;
 
-      try
+  try
+  {
+    util::OdbTransaction {_db} ([&]() {
+      for (const auto& p : _files)
       {
-        // Directories don't have content.
-        if (p.second->content &&
-            _persistedContents.find(p.second->content.object_id()) ==
-            _persistedContents.end())
+        if (!markFilePersisted(p.second->id))
+          continue;
+
+        files.push_back(p.second->id);
+
+        try
         {
-          p.second->content.load();
-          _db->persist(*p.second->content);
-          _persistedContents.insert(p.second->content.object_id());
+          // Directories don't have content.
+          if (p.second->content &&
+              markContentPersisted(p.second->content.object_id()))
+          {
+            contents.push_back(p.second->content.object_id());
+            p.second->content.load();
+            _db->persist(*p.second->content);
+          }
+
+          _db->persist(*p.second);
+
+          // TODO: The memory consumption should be checked to see if not
+          // unloading the lazy shared pointer keeps the file content in
+          // memory. If so then this line should be uncommented. The reason for
+          // not unloading is that some parsers may want to read the file
+          // contents and if this can be done through the File object then the
+          // file is not needed to be read from disk.
+          p.second->content.unload();
         }
+        catch (const odb::object_already_persistent&)
+        {
+        }
+      }
+    });
+  }
+  catch (...)
+  {
+    unmarkPersisted(files, contents);
+    throw;
+  }
 
-        _db->persist(*p.second);
+  if (_sharedFiles)
+    for (model::FileId id : files)
+      _sharedFiles->publish(id);
 
-        // TODO: The memory consumption should be checked to see if not
-        // unloading the lazy shared pointer keeps the file content in memory.
-        // If so then this line should be uncommented. The reason for not
-        // unloading is that some parsers may want to read the file contents and
-        // if this can be done through the File object then the file is not
-        // needed to be read from disk.
-        p.second->content.unload();
-      }
-      catch (const odb::object_already_persistent&)
-      {
-      }
-    }
+  if (_sharedContents)
+    for (const std::string& hash : contents)
+      _sharedContents->publish(util::fnvHash(hash));
+}
+
+void SourceManager::share(std::size_t capacity_)
+{
+  std::lock_guard<std::mutex> guard(_createFileMutex);
+
+  if (_sharedFiles)
+    return;
+
+  _sharedFiles = std::make_shared<util::SharedHashMap>(
+    std::max(capacity_, 2 * _persistedFiles.size()));
+  _sharedContents = std::make_shared<util::SharedHashMap>(
+    std::max(capacity_, 2 * _persistedContents.size()));
+
+  for (model::FileId id : _persistedFiles)
+  {
+    _sharedFiles->insert(id, 0);
+    _sharedFiles->publish(id);
+  }
+  for (const std::string& hash : _persistedContents)
+  {
+    _sharedContents->insert(util::fnvHash(hash), 0);
+    _sharedContents->publish(util::fnvHash(hash));
+  }
+
+  _persistedFiles.clear();
+  _persistedContents.clear();
+}
+
+void SourceManager::unshare()
+{
+  std::lock_guard<std::mutex> guard(_createFileMutex);
+
+  if (!_sharedFiles)
+    return;
+
+  _sharedFiles.reset();
+  _sharedContents.reset();
+
+  util::OdbTransaction {_db} ([&, this]() {
+    for (const model::FileIdView& file : _db->query<model::FileIdView>())
+      _persistedFiles.insert(file.id);
+
+    for (const auto& fileContentId : _db->query<model::FileContentIds>())
+      _persistedContents.insert(fileContentId.hash);
   });
 }
 
+void SourceManager::setDatabase(std::shared_ptr<odb::database> db_)
+{
+  std::lock_guard<std::mutex> guard(_createFileMutex);
+  _db = db_;
+}
+
+bool SourceManager::markFilePersisted(model::FileId id_)
+{
+  if (_sharedFiles)
+    switch (_sharedFiles->insert(id_, 0))
+    {
+      case util::SharedHashMap::Insertion::INSERTED: return true;
+      case util::SharedHashMap::Insertion::FOUND: return false;
+      case util::SharedHashMap::Insertion::FULL: break;
+    }
+
+  return _persistedFiles.insert(id_).second;
+}
+
+bool SourceManager::markContentPersisted(const std::string& hash_)
+{
+  // The shared set stores the hashes of the SHA-1 hashes.
+  if (_sharedContents)
+    switch (_sharedContents->insert(util::fnvHash(hash_), 0))
+    {
+      case util::SharedHashMap::Insertion::INSERTED: return true;
+      case util::SharedHashMap::Insertion::FOUND: return false;
+      case util::SharedHashMap::Insertion::FULL: break;
+    }
+
+  return _persistedContents.insert(hash_).second;
+}
+
+void SourceManager::unmarkPersisted(
+  const std::vector<model::FileId>& files_,
+  const std::vector<std::string>& contents_)
+{
+  for (model::FileId id : files_)
+  {
+    if (_sharedFiles)
+      _sharedFiles->release(id);
+    _persistedFiles.erase(id);
+  }
+
+  for (const std::string& hash : contents_)
+  {
+    if (_sharedContents)
+      _sharedContents->release(util::fnvHash(hash));
+    _persistedContents.erase(hash);
+  }
+}
+
+bool SourceManager::isFilePersisted(model::FileId id_) const
+{
+  return (_sharedFiles && _sharedFiles->contains(id_))
+    || _persistedFiles.find(id_) != _persistedFiles.end();
+}
+
 } // parser
 } // cc
@@ -0,0 +1,258 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <util/hash.h>
+
+#include <parser/compilationdatabase.h>
+
+using namespace cc::parser;
+
+namespace fs = boost::filesystem;
+
+using Args = std::vector<std::string>;
+
+class CompilationDatabaseTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/compilationdatabasetestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = dir;
+  }
+
+  void TearDown() override
+  {
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  /**
+   * Writes the JSON document to compile_commands.json and loads it.
+   */
+  std::unique_ptr<CompilationDatabase> load(const std::string& json_)
+  {
+    std::string path = _root + "/compile_commands.json";
+    {
+      std::ofstream ofs(path, std::ios::binary);
+      ofs << json_;
+    }
+
+    _errorMsg.clear();
+    return CompilationDatabase::load(path, _errorMsg);
+  }
+
+  std::string _root;
+  std::string _errorMsg;
+};
+
+TEST_F(CompilationDatabaseTest, Command)
+{
+  std::unique_ptr<CompilationDatabase> db = load(R"([
+    {
+      "directory": "/project",
+      "command": "g++ -c main.cpp -o main.o",
+      "file": "main.cpp",
+      "output": "main.o"
+    }
+  ])");
+
+  ASSERT_NE(nullptr, db) << _errorMsg;
+  ASSERT_EQ(1u, db->size());
+  EXPECT_EQ("/project", db->directory(0));
+  EXPECT_EQ("main.cpp", db->filename(0));
+
+  CompilationDatabase::Command command = db->command(0);
+  EXPECT_EQ("/project", command.directory);
+  EXPECT_EQ("main.cpp", command.filename);
+  EXPECT_EQ("main.o", command.output);
+  EXPECT_EQ(
+    Args({"g++", "-c", "main.cpp", "-o", "main.o"}), command.commandLine);
+}
+
+TEST_F(CompilationDatabaseTest, EmptyArray)
+{
+  std::unique_ptr<CompilationDatabase> db = load(" [ ] \n");
+
+  ASSERT_NE(nullptr, db) << _errorMsg;
+  EXPECT_EQ(0u, db->size());
+  EXPECT_EQ(0u, db->stringCount());
+}
+
+TEST_F(CompilationDatabaseTest, CommandHash)
+{
+  std::unique_ptr<CompilationDatabase> db = load(R"([
+    {
+      "directory": "/project",
+      "command": "g++  -DNAME=\"a b\"   -c main.cpp",
+      "file": "main.cpp"
+    },
+    {
+      "directory": "/project",
+      "arguments": ["g++", "-c", "util.cpp"],
+      "file": "util.cpp"
+    }
+  ])");
+
+  ASSERT_NE(nullptr, db) << _errorMsg;
+  ASSERT_EQ(2u, db->size());
+
+  // The hash is the same as the hash of the command of the build action,
+  // which is the command line joined by spaces.
+  for (std::size_t i = 0; i < db->size(); ++i)
+    EXPECT_EQ(
+      cc::util::fnvHash(
+        boost::algorithm::join(db->command(i).commandLine, " ")),
+      db->commandHash(i));
+
+  EXPECT_NE(db->commandHash(0), db->commandHash(1));
+}
+
+TEST_F(CompilationDatabaseTest, Escapes)
+{
+  // The JSON escapes are resolved first, then the command is split by the
+  // GNU command line syntax.
+  std::unique_ptr<CompilationDatabase> db = load(R"([
+    {
+      "directory": "\/project\\dir",
+      "command": "g++ -DNAME=\"a b\" 'x \"y\"' c\\ d \"e\\\"f\" -c é.cpp",
+      "file": "\u00e9\ud83d\ude00.cpp"
+    }
+  ])");
+
+  ASSERT_NE(nullptr, db) << _errorMsg;
+  ASSERT_EQ(1u, db->size());
+
+  CompilationDatabase::Command command = db->command(0);
+  EXPECT_EQ("/project\\dir", command.directory);
+  EXPECT_EQ("\xc3\xa9\xf0\x9f\x98\x80.cpp", command.filename);
+  EXPECT_EQ(
+    Args({"g++", "-DNAME=a b", "x \"y\"", "c d", "e\"f", "-c",
+      "\xc3\xa9.cpp"}),
+    command.commandLine);
+}
+
+TEST_F(CompilationDatabaseTest, Arguments)
+{
+  // The arguments are not split again, and they are preferred to the
+  // command. The unknown keys are skipped.
+  std::unique_ptr<CompilationDatabase> db = load(R"([
+    {
+      "directory": "/project",
+      "arguments": ["g++", "-DNAME=a b", "-c", "main.cpp"],
+      "command": "clang++ -c main.cpp",
+      "unknown": {"key": [1, 2.5, true, null, "value"]},
+      "file": "main.cpp"
+    }
+  ])");
+
+  ASSERT_NE(nullptr, db) << _errorMsg;
+  ASSERT_EQ(1u, db->size());
+  EXPECT_EQ(
+    Args({"g++", "-DNAME=a b", "-c", "main.cpp"}),
+    db->command(0).commandLine);
+}
+
+TEST_F(CompilationDatabaseTest, CompilerWrapper)
+{
+  std::unique_ptr<CompilationDatabase> db = load(R"([
+    {
+      "directory": "/project",
+      "command": "ccache g++ -c a.cpp",
+      "file": "a.cpp"
+    },
+    {
+      "directory": "/project",
+      "arguments": ["/usr/bin/ccache", "distcc", "/usr/bin/g++", "-c", "b.cpp"],
+      "file": "b.cpp"
+    },
+    {
+      "directory": "/project",
+      "command": "ccache -c c.cpp",
+      "file": "c.cpp"
+    },
+    {
+      "directory": "/project",
+      "command": "ccache c.cpp",
+      "file": "c.cpp"
+    }
+  ])");
+
+  ASSERT_NE(nullptr, db) << _errorMsg;
+  ASSERT_EQ(4u, db->size());
+
+  EXPECT_EQ(Args({"g++", "-c", "a.cpp"}), db->command(0).commandLine);
+  EXPECT_EQ(Args({"/usr/bin/g++", "-c", "b.cpp"}), db->command(1).commandLine);
+
+  // The wrapper is called as a compiler if a flag or an input file follows.
+  EXPECT_EQ(Args({"ccache", "-c", "c.cpp"}), db->command(2).commandLine);
+  EXPECT_EQ(Args({"ccache", "c.cpp"}), db->command(3).commandLine);
+}
+
+TEST_F(CompilationDatabaseTest, StringsAreInterned)
+{
+  std::unique_ptr<CompilationDatabase> db = load(R"([
+    {
+      "directory": "/project",
+      "arguments": ["g++", "-O2", "-c", "a.cpp"],
+      "file": "a.cpp"
+    },
+    {
+      "directory": "/project",
+      "arguments": ["g++", "-O2", "-c", "b.cpp"],
+      "file": "b.cpp"
+    }
+  ])");
+
+  ASSERT_NE(nullptr, db) << _errorMsg;
+  ASSERT_EQ(2u, db->size());
+
+  // "/project", "a.cpp", "b.cpp", "g++", "-O2", "-c" and the empty output.
+  EXPECT_EQ(7u, db->stringCount());
+
+  EXPECT_EQ(Args({"g++", "-O2", "-c", "a.cpp"}), db->command(0).commandLine);
+  EXPECT_EQ(Args({"g++", "-O2", "-c", "b.cpp"}), db->command(1).commandLine);
+}
+
+TEST_F(CompilationDatabaseTest, MissingFile)
+{
+  std::string errorMsg;
+  EXPECT_EQ(nullptr,
+    CompilationDatabase::load(_root + "/missing.json", errorMsg));
+  EXPECT_NE(std::string::npos, errorMsg.find("missing.json"));
+}
+
+TEST_F(CompilationDatabaseTest, Malformed)
+{
+  const std::vector<std::string> documents{
+    "",
+    "{}",
+    "[",
+    R"([{"directory": "/project", "file": "a.cpp"}])",
+    R"([{"directory": "/project", "command": "g++ -c a.cpp"}])",
+    R"([{"file": "a.cpp", "command": "g++ -c a.cpp"}])",
+    R"([{"directory": "/project", "file": "a.cpp", "command": "g++)",
+    R"([{"directory": "/pro\ject", "file": "a.cpp", "command": "g++"}])",
+    R"([{"directory": "/project", "file": "\u12", "command": "g++"}])",
+    R"([{"directory": "/project" "file": "a.cpp", "command": "g++"}])",
+    R"([{"directory": "/project", "file": "a.cpp", "command": "g++"},])",
+    R"([] [])"};
+
+  for (const std::string& document : documents)
+  {
+    EXPECT_EQ(nullptr, load(document)) << document;
+    EXPECT_FALSE(_errorMsg.empty()) << document;
+  }
+}
@@ -0,0 +1,219 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <parser/filemanifest.h>
+
+using namespace cc::parser;
+
+namespace fs = boost::filesystem;
+
+class FileManifestTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/filemanifesttestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = fs::canonical(dir).native();
+
+    // root/
+    //   project/
+    //     binary.dat
+    //     main.cpp
+    //     src/
+    //       util.h
+    //     srclink -> src
+    //     mainlink.cpp -> main.cpp
+    //   outside/
+    //     outside.txt
+    //   project/outsidelink -> outside
+    fs::create_directories(_root + "/project/src");
+    fs::create_directories(_root + "/outside");
+
+    write(_root + "/project/main.cpp", "int main()\n{\n  return 0;\n}\n");
+    write(_root + "/project/src/util.h", "#define UTIL 1\n");
+    write(_root + "/outside/outside.txt", "Some plain text.\n");
+    write(_root + "/project/binary.dat",
+      std::string("\x7f\x45\x4c\x46\x02\x01\x01\x00\x00\x00\xff\xfe", 12));
+
+    fs::create_symlink(_root + "/project/src", _root + "/project/srclink");
+    fs::create_symlink(
+      _root + "/project/main.cpp", _root + "/project/mainlink.cpp");
+    fs::create_symlink(_root + "/outside", _root + "/project/outsidelink");
+  }
+
+  void TearDown() override
+  {
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  static void write(const std::string& path_, const std::string& content_)
+  {
+    std::ofstream ofs(path_, std::ios::binary);
+    ofs << content_;
+  }
+
+  std::vector<std::string> paths(const FileManifest& manifest_) const
+  {
+    std::vector<std::string> result;
+    for (const FileManifest::Entry& entry : manifest_.entries())
+      result.push_back(entry.path.substr(_root.size()));
+    return result;
+  }
+
+  std::string _root;
+};
+
+TEST_F(FileManifestTest, CanonicalPaths)
+{
+  FileManifest manifest;
+
+  // The input is not canonical and the symbolic links lead to entries which
+  // are found through the real paths too.
+  manifest.scan({_root + "/project/../project/."}, 2);
+
+  EXPECT_EQ(
+    std::vector<std::string>({
+      "/outside",
+      "/outside/outside.txt",
+      "/project",
+      "/project/binary.dat",
+      "/project/main.cpp",
+      "/project/src",
+      "/project/src/util.h"}),
+    paths(manifest));
+}
+
+TEST_F(FileManifestTest, Find)
+{
+  FileManifest manifest;
+  manifest.scan({_root + "/project", _root + "/missing"}, 1);
+
+  const FileManifest::Entry* main = manifest.find(_root + "/project/main.cpp");
+  ASSERT_NE(nullptr, main);
+  EXPECT_FALSE(main->directory);
+  EXPECT_EQ(27u, main->size);
+
+  const FileManifest::Entry* src = manifest.find(_root + "/project/src");
+  ASSERT_NE(nullptr, src);
+  EXPECT_TRUE(src->directory);
+
+  EXPECT_EQ(nullptr, manifest.find(_root + "/project/mainlink.cpp"));
+  EXPECT_EQ(nullptr, manifest.find(_root + "/missing"));
+}
+
+TEST_F(FileManifestTest, SingleFileInput)
+{
+  FileManifest manifest;
+  manifest.scan({_root + "/project/mainlink.cpp"}, 1);
+
+  EXPECT_EQ(std::vector<std::string>({"/project/main.cpp"}), paths(manifest));
+}
+
+TEST_F(FileManifestTest, PlainText)
+{
+  FileManifest manifest;
+  manifest.scan({_root + "/project"}, 1);
+
+  FileManifest::FileType source
+    = manifest.fileType(_root + "/project/main.cpp");
+  EXPECT_TRUE(source.plainText);
+  EXPECT_EQ(0u, source.mimeType.find("text/"));
+
+  FileManifest::FileType binary
+    = manifest.fileType(_root + "/project/binary.dat");
+  EXPECT_FALSE(binary.plainText);
+  EXPECT_NE(0u, binary.mimeType.find("text/"));
+
+  std::string mimeType;
+  EXPECT_TRUE(FileManifest::classify(_root + "/outside/outside.txt", mimeType));
+  EXPECT_EQ("text/plain", mimeType);
+}
+
+TEST_F(FileManifestTest, FileTypeIsCached)
+{
+  FileManifest manifest;
+  manifest.scan({_root + "/project"}, 1);
+
+  const std::string path = _root + "/project/src/util.h";
+  EXPECT_TRUE(manifest.fileType(path).plainText);
+
+  // The cached type is returned even if the file is not plain text anymore.
+  write(path, std::string("\x00\x01\x02\x03\xff\xfe\xfd", 7));
+  EXPECT_TRUE(manifest.fileType(path).plainText);
+
+  // The next scan drops the cache.
+  manifest.scan({_root + "/project"}, 1);
+  EXPECT_FALSE(manifest.fileType(path).plainText);
+}
+
+TEST_F(FileManifestTest, Update)
+{
+  FileManifest manifest;
+  manifest.scan({_root + "/project"}, 1);
+
+  // A file is changed, a file is deleted, and a new directory is created
+  // with a file which is not reported.
+  write(_root + "/project/main.cpp", "int main() {}\n");
+  fs::remove(_root + "/project/binary.dat");
+  fs::create_directories(_root + "/project/new");
+  write(_root + "/project/new/new.cpp", "int x;\n");
+
+  manifest.update({
+    _root + "/project/main.cpp",
+    _root + "/project/binary.dat",
+    _root + "/project/new"});
+
+  EXPECT_EQ(
+    std::vector<std::string>({
+      "/outside",
+      "/outside/outside.txt",
+      "/project",
+      "/project/main.cpp",
+      "/project/new",
+      "/project/new/new.cpp",
+      "/project/src",
+      "/project/src/util.h"}),
+    paths(manifest));
+
+  const FileManifest::Entry* main = manifest.find(_root + "/project/main.cpp");
+  ASSERT_NE(nullptr, main);
+  EXPECT_EQ(14u, main->size);
+}
+
+TEST_F(FileManifestTest, UpdateRemovesDirectory)
+{
+  FileManifest manifest;
+  manifest.scan({_root + "/project"}, 1);
+
+  const std::string path = _root + "/project/src/util.h";
+  EXPECT_TRUE(manifest.fileType(path).plainText);
+
+  // The entries under a deleted directory are removed with it.
+  fs::remove_all(_root + "/project/src");
+  manifest.update({_root + "/project/src"});
+
+  EXPECT_EQ(nullptr, manifest.find(_root + "/project/src"));
+  EXPECT_EQ(nullptr, manifest.find(path));
+  EXPECT_NE(nullptr, manifest.find(_root + "/project/main.cpp"));
+
+  // The cached type of a changed file is dropped.
+  fs::create_directories(_root + "/project/src");
+  write(path, std::string("\x00\x01\x02\x03\xff\xfe\xfd", 7));
+  manifest.update({_root + "/project/src"});
+
+  ASSERT_NE(nullptr, manifest.find(path));
+  EXPECT_FALSE(manifest.fileType(path).plainText);
+}
@@ -0,0 +1,268 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "pluginscheduler.h"
+
+using namespace cc::parser;
+
+namespace
+{
+
+/**
+ * Records the events of the plugins in the order they happened.
+ */
+class EventLog
+{
+public:
+  void add(const std::string& event_)
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    _events.push_back(event_);
+  }
+
+  std::vector<std::string> events()
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    return _events;
+  }
+
+  std::ptrdiff_t position(const std::string& event_)
+  {
+    std::lock_guard<std::mutex> guard(_mutex);
+    for (std::size_t i = 0; i < _events.size(); ++i)
+      if (_events[i] == event_)
+        return i;
+    return -1;
+  }
+
+private:
+  std::mutex _mutex;
+  std::vector<std::string> _events;
+};
+
+PluginScheduler::ParseFunction logged(
+  EventLog& log_,
+  const std::string& name_,
+  bool success_ = true)
+{
+  return [&log_, name_, success_](int)
+  {
+    log_.add(name_ + " start");
+    log_.add(name_ + " end");
+    return success_;
+  };
+}
+
+const PluginScheduler::Statistics* findStatistics(
+  const PluginScheduler& scheduler_,
+  const std::string& plugin_)
+{
+  for (const PluginScheduler::Statistics& stats : scheduler_.statistics())
+    if (stats.plugin == plugin_)
+      return &stats;
+  return nullptr;
+}
+
+} // namespace
+
+TEST(PluginSchedulerTest, TopologicalOrder)
+{
+  PluginScheduler scheduler(4);
+  auto noop = [](int) { return true; };
+
+  scheduler.addPlugin("metrics", {"cpp", "skipped"}, false, noop);
+  scheduler.addPlugin("search", {}, false, noop);
+  scheduler.addPlugin("cpp", {}, true, noop);
+  scheduler.addPlugin("git", {"git"}, false, noop);
+
+  // The registration order is kept among the independent plugins, the
+  // unregistered dependencies and the self-dependencies are ignored.
+  EXPECT_EQ(
+    std::vector<std::string>({"search", "cpp", "metrics", "git"}),
+    scheduler.topologicalOrder());
+}
+
+TEST(PluginSchedulerTest, CycleIsNotRun)
+{
+  PluginScheduler scheduler(2);
+  EventLog log;
+
+  scheduler.addPlugin("a", {"b"}, false, logged(log, "a"));
+  scheduler.addPlugin("b", {"a"}, false, logged(log, "b"));
+  scheduler.addPlugin("c", {}, false, logged(log, "c"));
+  scheduler.addPlugin("d", {"a"}, false, logged(log, "d"));
+
+  EXPECT_EQ(std::vector<std::string>({"c"}), scheduler.topologicalOrder());
+  EXPECT_FALSE(scheduler.run());
+  EXPECT_TRUE(log.events().empty());
+  EXPECT_TRUE(scheduler.statistics().empty());
+}
+
+TEST(PluginSchedulerTest, DependenciesFinishFirst)
+{
+  PluginScheduler scheduler(4);
+  EventLog log;
+
+  scheduler.addPlugin("metrics", {"cpp", "python"}, false,
+    logged(log, "metrics"));
+  scheduler.addPlugin("cpp", {}, true, logged(log, "cpp"));
+  scheduler.addPlugin("python", {}, false, logged(log, "python"));
+  scheduler.addPlugin("report", {"metrics"}, false, logged(log, "report"));
+
+  ASSERT_TRUE(scheduler.run());
+  ASSERT_EQ(8u, log.events().size());
+
+  EXPECT_LT(log.position("cpp end"), log.position("metrics start"));
+  EXPECT_LT(log.position("python end"), log.position("metrics start"));
+  EXPECT_LT(log.position("metrics end"), log.position("report start"));
+
+  ASSERT_EQ(4u, scheduler.statistics().size());
+  EXPECT_EQ("report", scheduler.statistics().back().plugin);
+}
+
+TEST(PluginSchedulerTest, IndependentPluginsRunInParallel)
+{
+  PluginScheduler scheduler(2);
+  std::atomic<int> running(0);
+
+  // Both plugins succeed only if they run at the same time.
+  auto meet = [&running](int)
+  {
+    ++running;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (running < 2 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    return running == 2;
+  };
+
+  scheduler.addPlugin("a", {}, false, meet);
+  scheduler.addPlugin("b", {}, false, meet);
+
+  EXPECT_TRUE(scheduler.run());
+}
+
+TEST(PluginSchedulerTest, ThreadBudget)
+{
+  PluginScheduler scheduler(8);
+  std::atomic<int> cppThreads(0);
+  std::atomic<int> searchThreads(0);
+
+  scheduler.addPlugin("search", {}, false, [&searchThreads](int threadNum_)
+  {
+    searchThreads = threadNum_;
+    return true;
+  });
+  scheduler.addPlugin("cpp", {"search"}, true, [&cppThreads](int threadNum_)
+  {
+    cppThreads = threadNum_;
+    return true;
+  });
+
+  ASSERT_TRUE(scheduler.run());
+
+  // A single-threaded plugin gets one thread, a multi-threaded plugin running
+  // alone gets all of them.
+  EXPECT_EQ(1, searchThreads);
+  EXPECT_EQ(8, cppThreads);
+  EXPECT_EQ(1, findStatistics(scheduler, "search")->threadNum);
+  EXPECT_EQ(8, findStatistics(scheduler, "cpp")->threadNum);
+}
+
+TEST(PluginSchedulerTest, FailureIsReported)
+{
+  PluginScheduler scheduler(2);
+  EventLog log;
+
+  scheduler.addPlugin("failing", {}, false, logged(log, "failing", false));
+  scheduler.addPlugin("throwing", {}, false, [](int) -> bool
+  {
+    throw std::runtime_error("Parse error");
+  });
+  scheduler.addPlugin("dependent", {"failing", "throwing"}, false,
+    logged(log, "dependent"));
+
+  EXPECT_FALSE(scheduler.run());
+
+  // A failed plugin doesn't prevent its dependents from running.
+  EXPECT_LT(log.position("failing end"), log.position("dependent start"));
+
+  ASSERT_EQ(3u, scheduler.statistics().size());
+  EXPECT_FALSE(findStatistics(scheduler, "failing")->success);
+  EXPECT_FALSE(findStatistics(scheduler, "throwing")->success);
+  EXPECT_TRUE(findStatistics(scheduler, "dependent")->success);
+}
+
+TEST(PluginSchedulerTest, RunAgain)
+{
+  PluginScheduler scheduler(2);
+  std::atomic<int> calls(0);
+  bool fail = true;
+
+  scheduler.addPlugin("plugin", {}, true, [&calls, &fail](int)
+  {
+    ++calls;
+    return !fail;
+  });
+
+  EXPECT_FALSE(scheduler.run());
+
+  fail = false;
+  EXPECT_TRUE(scheduler.run());
+  EXPECT_EQ(2, calls);
+
+  ASSERT_EQ(1u, scheduler.statistics().size());
+  EXPECT_TRUE(scheduler.statistics().front().success);
+}
+
+TEST(PluginSchedulerTest, ExclusivePluginRunsAlone)
+{
+  PluginScheduler scheduler(4);
+  std::atomic<int> running(0);
+  std::atomic<bool> overlapped(false);
+  std::atomic<int> exclusiveThreads(0);
+
+  auto other = [&running](int)
+  {
+    ++running;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    --running;
+    return true;
+  };
+
+  scheduler.addPlugin("a", {}, false, other);
+  scheduler.addPlugin("cpp", {}, true,
+    [&](int threadNum_)
+    {
+      exclusiveThreads = threadNum_;
+      if (++running != 1)
+        overlapped = true;
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      if (running != 1)
+        overlapped = true;
+      --running;
+      return true;
+    },
+    true);
+  scheduler.addPlugin("b", {}, false, other);
+  scheduler.addPlugin("c", {}, true, other);
+
+  ASSERT_TRUE(scheduler.run());
+
+  // The exclusive plugin waits for the running plugins, gets all threads and
+  // the others don't start while it is running.
+  EXPECT_FALSE(overlapped);
+  EXPECT_EQ(4, exclusiveThreads);
+  EXPECT_EQ(4u, scheduler.statistics().size());
+}
@@ -0,0 +1,276 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <odb/transaction.hxx>
+
+#ifdef DATABASE_SQLITE
+#  include <odb/sqlite/connection.hxx>
+#endif
+
+#include <util/dbutil.h>
+
+#include "shardmerge.h"
+
+using namespace cc::parser;
+
+namespace fs = boost::filesystem;
+
+// The PostgreSQL shards are schemas of a running server, so only the SQLite
+// shards are tested.
+#ifdef DATABASE_SQLITE
+
+namespace
+{
+
+/**
+ * The tables resemble the ones generated by ODB: File is identified by a
+ * content hash, Entity has generated IDs, Derived is a derived class of
+ * Entity and Entity_tags is a container without primary key. The FileContent
+ * tables are the ones of model/filecontent.h and model/filecontentblock.h.
+ */
+const std::vector<std::string> schema{
+  "CREATE TABLE \"File\" ("
+  "  \"id\" INTEGER NOT NULL PRIMARY KEY,"
+  "  \"path\" TEXT NOT NULL)",
+  "CREATE TABLE \"Entity\" ("
+  "  \"id\" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,"
+  "  \"name\" TEXT NOT NULL,"
+  "  \"file\" INTEGER,"
+  "  CONSTRAINT \"file_fk\" FOREIGN KEY (\"file\")"
+  "    REFERENCES \"File\" (\"id\") DEFERRABLE INITIALLY DEFERRED)",
+  "CREATE TABLE \"Derived\" ("
+  "  \"id\" INTEGER NOT NULL PRIMARY KEY,"
+  "  \"extra\" TEXT NOT NULL,"
+  "  CONSTRAINT \"id_fk\" FOREIGN KEY (\"id\")"
+  "    REFERENCES \"Entity\" (\"id\") DEFERRABLE INITIALLY DEFERRED)",
+  "CREATE TABLE \"Entity_tags\" ("
+  "  \"object_id\" INTEGER NOT NULL,"
+  "  \"index\" INTEGER NOT NULL,"
+  "  \"value\" TEXT,"
+  "  CONSTRAINT \"object_id_fk\" FOREIGN KEY (\"object_id\")"
+  "    REFERENCES \"Entity\" (\"id\") ON DELETE CASCADE)",
+  "CREATE TABLE \"FileContent\" ("
+  "  \"hash\" TEXT NOT NULL PRIMARY KEY,"
+  "  \"content\" TEXT NOT NULL)",
+  "CREATE TABLE \"FileContentIndex\" ("
+  "  \"hash\" TEXT NOT NULL PRIMARY KEY,"
+  "  \"size\" INTEGER NOT NULL,"
+  "  \"dictionary\" INTEGER NOT NULL,"
+  "  \"lineOffsets\" BLOB NOT NULL)",
+  "CREATE TABLE \"FileContentBlock\" ("
+  "  \"id\" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,"
+  "  \"hash\" TEXT NOT NULL,"
+  "  \"number\" INTEGER NOT NULL,"
+  "  \"data\" BLOB NOT NULL)",
+  "CREATE UNIQUE INDEX \"FileContentBlock_hash_number_idx\""
+  "  ON \"FileContentBlock\" (\"hash\", \"number\")",
+  "CREATE TABLE \"FileContentDictionary\" ("
+  "  \"id\" INTEGER NOT NULL PRIMARY KEY AUTOINCREMENT,"
+  "  \"data\" BLOB NOT NULL)"};
+
+} // namespace
+
+class ShardMergeTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/shardmergetestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = dir;
+  }
+
+  void TearDown() override
+  {
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  std::string connStr(const std::string& name_) const
+  {
+    return "sqlite:database=" + _root + '/' + name_ + ".sqlite";
+  }
+
+  /**
+   * Creates a database with the test schema and runs the statements in it.
+   */
+  std::shared_ptr<odb::database> create(
+    const std::string& name_,
+    const std::vector<std::string>& statements_)
+  {
+    std::shared_ptr<odb::database> db
+      = cc::util::connectDatabase(connStr(name_));
+
+    odb::transaction transaction(db->begin());
+    for (const std::string& statement : schema)
+      db->execute(statement);
+    for (const std::string& statement : statements_)
+      db->execute(statement);
+    transaction.commit();
+
+    return db;
+  }
+
+  /**
+   * Returns the rows of the query, the columns separated by '|'.
+   */
+  static std::vector<std::string> query(
+    std::shared_ptr<odb::database> db_,
+    const std::string& sql_)
+  {
+    std::vector<std::string> rows;
+
+    // The connection is released before the next merge, which takes the
+    // single connection of the database.
+    odb::connection_ptr connection = db_->connection();
+    sqlite3* handle
+      = static_cast<odb::sqlite::connection&>(*connection).handle();
+
+    sqlite3_exec(handle, sql_.c_str(),
+      [](void* rows_, int num_, char** values_, char**)
+      {
+        std::string row;
+        for (int i = 0; i < num_; ++i)
+        {
+          if (i)
+            row += '|';
+          row += values_[i] ? values_[i] : "NULL";
+        }
+        static_cast<std::vector<std::string>*>(rows_)->push_back(row);
+        return 0;
+      },
+      &rows, nullptr);
+
+    return rows;
+  }
+
+  std::string _root;
+};
+
+TEST_F(ShardMergeTest, TwoShards)
+{
+  std::shared_ptr<odb::database> db = create("project", {
+    "INSERT INTO \"File\" VALUES (100, 'a.cpp')",
+    "INSERT INTO \"Entity\" VALUES (1, 'a', 100), (2, 'b', 100)",
+    "INSERT INTO \"Derived\" VALUES (2, 'bx')",
+    "INSERT INTO \"Entity_tags\" VALUES (2, 0, 't')"});
+
+  // The IDs of the shards overlap with the project. "b" is in the project
+  // already, "c" is new.
+  create("shard1", {
+    "INSERT INTO \"File\" VALUES (100, 'a.cpp'), (200, 'b.cpp')",
+    "INSERT INTO \"Entity\" VALUES (1, 'b', 100), (2, 'c', 200)",
+    "INSERT INTO \"Derived\" VALUES (2, 'cx')",
+    "INSERT INTO \"Entity_tags\" VALUES "
+    "(1, 0, 't'), (2, 0, 'u'), (2, 1, NULL)"});
+
+  // "c" has been merged from the first shard, "d" is new.
+  create("shard2", {
+    "INSERT INTO \"File\" VALUES (200, 'b.cpp')",
+    "INSERT INTO \"Entity\" VALUES (1, 'c', 200), (5, 'd', NULL)",
+    "INSERT INTO \"Derived\" VALUES (5, 'dx')",
+    "INSERT INTO \"Entity_tags\" VALUES (1, 1, NULL), (5, 0, 'v')"});
+
+  ASSERT_TRUE(mergeShard(db, connStr("project"), connStr("shard1")));
+  ASSERT_TRUE(mergeShard(db, connStr("project"), connStr("shard2")));
+
+  EXPECT_EQ(
+    std::vector<std::string>({"100|a.cpp", "200|b.cpp"}),
+    query(db, "SELECT \"id\", \"path\" FROM \"File\" ORDER BY \"id\""));
+
+  // The rows equal to a project row are mapped to it, the others get new
+  // IDs.
+  EXPECT_EQ(
+    std::vector<std::string>({"a|100", "b|100", "c|200", "d|NULL"}),
+    query(db,
+      "SELECT \"name\", \"file\" FROM \"Entity\" ORDER BY \"name\""));
+
+  EXPECT_EQ(
+    std::vector<std::string>({"2"}),
+    query(db, "SELECT \"id\" FROM \"Entity\" WHERE \"name\" = 'b'"));
+
+  // The IDs of the derived class and the container follow the new IDs of
+  // Entity. Equal container rows, including NULL values, are not duplicated.
+  EXPECT_EQ(
+    std::vector<std::string>({"b|bx", "c|cx", "d|dx"}),
+    query(db,
+      "SELECT e.\"name\", d.\"extra\" FROM \"Derived\" d "
+      "JOIN \"Entity\" e ON e.\"id\" = d.\"id\" ORDER BY e.\"name\""));
+
+  EXPECT_EQ(
+    std::vector<std::string>({"b|0|t", "c|0|u", "c|1|NULL", "d|0|v"}),
+    query(db,
+      "SELECT e.\"name\", t.\"index\", t.\"value\" FROM \"Entity_tags\" t "
+      "JOIN \"Entity\" e ON e.\"id\" = t.\"object_id\" "
+      "ORDER BY e.\"name\", t.\"index\""));
+}
+
+TEST_F(ShardMergeTest, FileContents)
+{
+  std::shared_ptr<odb::database> db = create("project", {});
+
+  // The shards store their contents as plain text. The content "b" is in
+  // both of them.
+  create("shard1", {
+    "INSERT INTO \"FileContent\" VALUES ('ha', 'a'), ('hb', 'b')"});
+  create("shard2", {
+    "INSERT INTO \"FileContent\" VALUES ('hb', 'b'), ('hc', 'c')"});
+
+  ASSERT_TRUE(mergeShard(db, connStr("project"), connStr("shard1")));
+  ASSERT_TRUE(mergeShard(db, connStr("project"), connStr("shard2")));
+
+  EXPECT_EQ(
+    std::vector<std::string>({"ha|a", "hb|b", "hc|c"}),
+    query(db,
+      "SELECT \"hash\", \"content\" FROM \"FileContent\" "
+      "ORDER BY \"hash\""));
+
+  for (const char* table :
+    {"FileContentIndex", "FileContentBlock", "FileContentDictionary"})
+    EXPECT_EQ(
+      std::vector<std::string>({"0"}),
+      query(db, std::string("SELECT COUNT(*) FROM \"") + table + '"'))
+      << table;
+}
+
+TEST_F(ShardMergeTest, CompressedShard)
+{
+  std::shared_ptr<odb::database> db = create("project", {
+    "INSERT INTO \"FileContent\" VALUES ('ha', 'a')"});
+
+  // The blocks of a compressed shard refer to the dictionary of the shard,
+  // so the shard is rejected, and nothing is merged from it.
+  create("shard", {
+    "INSERT INTO \"File\" VALUES (100, 'a.cpp')",
+    "INSERT INTO \"FileContent\" VALUES ('hb', '')",
+    "INSERT INTO \"FileContentDictionary\" VALUES (1, x'00')",
+    "INSERT INTO \"FileContentIndex\" VALUES ('hb', 1, 1, x'')",
+    "INSERT INTO \"FileContentBlock\" VALUES (1, 'hb', 0, x'00')"});
+
+  EXPECT_FALSE(mergeShard(db, connStr("project"), connStr("shard")));
+
+  EXPECT_EQ(
+    std::vector<std::string>({"ha"}),
+    query(db, "SELECT \"hash\" FROM \"FileContent\""));
+  EXPECT_EQ(
+    std::vector<std::string>({"0"}),
+    query(db, "SELECT COUNT(*) FROM \"File\""));
+}
+
+TEST_F(ShardMergeTest, MissingShard)
+{
+  std::shared_ptr<odb::database> db = create("project", {});
+
+  EXPECT_FALSE(mergeShard(db, connStr("project"), connStr("missing")));
+}
+
+#endif
@@ -56,6 +56,22 @@ struct CppEdge
 
 typedef std::shared_ptr<CppEdge> CppEdgePtr;
 
+#pragma db view object(CppEdge)
+struct CppEdgeIdView
+{
+  #pragma db column(CppEdge::id)
+  CppEdgeId id;
+
+  #pragma db column(CppEdge::from)
+  FileId from;
+
+  #pragma db column(CppEdge::to)
+  FileId to;
+
+  #pragma db column(CppEdge::type)
+  CppEdge::Type type;
+};
+
 inline std::string typeToString(CppEdge::Type type_)
 {
   switch (type_)
@@ -109,6 +125,13 @@ struct CppEdgeAttribute
 
 typedef std::shared_ptr<CppEdgeAttribute> CppEdgeAttributePtr;
 
+#pragma db view object(CppEdgeAttribute)
+struct CppEdgeAttributeIdView
+{
+  #pragma db column(CppEdgeAttribute::id)
+  CppEdgeAttributeId id;
+};
+
 inline std::string CppEdgeAttribute::toString() const
 {
   return std::string("CppEdge")
@@ -0,0 +1,45 @@
+#ifndef CC_MODEL_CPPFILEGRAPH_H
+#define CC_MODEL_CPPFILEGRAPH_H
+
+#include <cstdint>
+#include <string>
+
+#include <model/cppedge.h>
+
+namespace cc
+{
+namespace model
+{
+
+/**
+ * Kinds of the edges of the file level dependency graph which is built by the
+ * C++ parser from CppHeaderInclusion and CppEdge rows and saved into the
+ * project directory as a util::CsrGraph.
+ */
+enum CppFileGraphEdge : std::uint8_t
+{
+  FG_INCLUDE = 0, /*!< Includer file -> included file. */
+  FG_PROVIDE = 1 + CppEdge::PROVIDE,
+  FG_IMPLEMENT = 1 + CppEdge::IMPLEMENT,
+  FG_USE = 1 + CppEdge::USE,
+  FG_DEPEND = 1 + CppEdge::DEPEND
+};
+
+inline std::uint8_t fileGraphEdgeKind(CppEdge::Type type_)
+{
+  return static_cast<std::uint8_t>(1 + type_);
+}
+
+/**
+ * Returns the path of the file graph in the given project directory
+ * (i.e. workspace/project).
+ */
+inline std::string cppFileGraphPath(const std::string& projectDir_)
+{
+  return projectDir_ + "/cppfilegraph.bin";
+}
+
+} // model
+} // cc
+
+#endif // CC_MODEL_CPPFILEGRAPH_H
@@ -42,6 +42,16 @@ struct CppHeaderInclusion
 
 typedef std::shared_ptr<CppHeaderInclusion> CppHeaderInclusionPtr;
 
+#pragma db view object(CppHeaderInclusion)
+struct CppHeaderInclusionIdView
+{
+  #pragma db column(CppHeaderInclusion::includer)
+  FileId includer;
+
+  #pragma db column(CppHeaderInclusion::included)
+  FileId included;
+};
+
 } // model
 } // cc
 
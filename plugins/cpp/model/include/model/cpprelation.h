@@ -2,12 +2,17 @@
 #define CC_MODEL_CPPRELATION_H
 
 #include <memory>
+#include <string>
+
+#include <util/hash.h>
 
 namespace cc
 {
 namespace model
 {
 
+typedef std::uint64_t CppRelationId;
+
 #pragma db object
 struct CppRelation
 {
@@ -19,8 +24,8 @@ struct CppRelation
     DeclContext
   };
 
-  #pragma db id auto
-  int id;
+  #pragma db id
+  CppRelationId id;
 
   std::uint64_t lhs;
   std::uint64_t rhs;
@@ -44,6 +49,18 @@ struct CppRelation
 
 typedef std::shared_ptr<CppRelation> CppRelationPtr;
 
+/**
+ * The ID of a relation is the hash of its content, so a relation seen by
+ * several translation units is stored once.
+ */
+inline std::uint64_t createIdentifier(const CppRelation& rel_)
+{
+  return util::fnvHash(
+    std::to_string(rel_.lhs) + ':' +
+    std::to_string(rel_.rhs) + ':' +
+    std::to_string(static_cast<int>(rel_.kind)));
+}
+
 #pragma db view object(CppRelation)
 struct CppRelationCount
 {
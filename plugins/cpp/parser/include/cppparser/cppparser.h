@@ -1,15 +1,20 @@
 #ifndef CC_PARSER_CXXPARSER_H
 #define CC_PARSER_CXXPARSER_H
 
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <unordered_set>
 #include <vector>
 
-#include <clang/Tooling/JSONCompilationDatabase.h>
+#include <clang/Tooling/CompilationDatabase.h>
 #include <clang/Tooling/Tooling.h>
 
 #include <model/buildaction.h>
+#include <model/file.h>
 
 #include <parser/abstractparser.h>
 #include <parser/parsercontext.h>
@@ -18,6 +23,8 @@ namespace cc
 {
 namespace parser
 {
+
+struct PreambleGroup;
   
 class CppParser : public AbstractParser
 {
@@ -26,18 +33,27 @@ public:
   virtual ~CppParser();  
   virtual void markModifiedFiles() override;
   /**
-   * Maintains and cleans up the database in preparation of incremental parsing.
+   * Cleans up the database in preparation of incremental parsing.
    *
-   * A graph is constructed from the files to be cleaned up along the inclusion
-   * relations. Then the nodes of the graph are sorted topologically.
-   * In each iteration the leaf nodes of the graph are cleaned up (paralelly),
-   * which guarantees that no file is cleaned up before its dependants.
+   * The rows of the modified and deleted files are deleted in one
+   * transaction, which is retried on deadlock. The file IDs are processed in
+   * chunks of 1000, each by one set-based DELETE per table, see
+   * cleanupFiles(). The AST nodes of the files are deleted by cascade with
+   * the files later.
    *
    * @return Returns true if the cleanup succeeded, false otherwise.
    */
   virtual bool cleanupDatabase() override;
   virtual bool parse() override;
 
+  /**
+   * The parser is exclusive with --isolated-workers, so that the worker
+   * processes are not forked while the threads of other plugins hold locks.
+   */
+  virtual bool exclusive() const override;
+
+  virtual bool incremental() const override;
+
 private:
   /**
    * A single build command's cc::util::JobQueueThreadPool job.
@@ -61,24 +77,6 @@ private:
     ParseJob(const ParseJob&) = default;
   };
 
-  struct CleanupJob
-  {
-    /**
-     * The path of the file to be cleaned up.
-     */
-    std::string path;
-
-    /**
-     * The # of the cleanup job.
-     */
-    std::size_t index;
-
-    CleanupJob(const std::string& path, std::size_t index)
-      : path(path), index(index)
-    {}
-  };
-
-
   /**
    * This function gets the input-output pairs from the compile command.
    *
@@ -95,23 +93,115 @@ private:
   model::BuildActionPtr addBuildAction(
     const clang::tooling::CompileCommand& command_);
 
+  /**
+   * Stores the sources and targets of a compile command.
+   * @param duplicate_ True if the translation unit was not parsed because an
+   * equivalent one had been parsed. The parse status of the source file is
+   * not changed then.
+   */
   void addCompileCommand(
     const clang::tooling::CompileCommand& command_,
     model::BuildActionPtr buildAction_,
-    bool error_ = false);
+    bool error_ = false,
+    bool duplicate_ = false);
 
   bool isParsed(const clang::tooling::CompileCommand& command_);
   bool isSourceFile(const std::string& file_) const;
   bool isNonSourceFlag(const std::string& arg_) const;
+
+  /**
+   * Computes the hash of the preprocessed token stream of a translation
+   * unit without parsing it.
+   * @return False if the translation unit couldn't be preprocessed.
+   */
+  bool preprocessedHash(
+    const clang::tooling::CompileCommand& command_,
+    std::uint64_t& hash_);
   bool parseByJson(const std::string& jsonFile_, std::size_t threadNum_);
-  int parseWorker(const clang::tooling::CompileCommand& command_);
+
+  /**
+   * Parses the jobs in forked worker processes instead of threads. The caches
+   * of the persisted objects are moved into shared memory first. A worker is
+   * replaced after a number of jobs or when its memory usage exceeds a limit.
+   * A job whose worker crashes is retried once in a new worker, then it is
+   * recorded as a failed one.
+   * @param parseJob_ Parses a job in a worker process and returns its status.
+   * @param finishJob_ Called in this process with a job, its status and its
+   * duration in milliseconds.
+   */
+  void parseInWorkers(
+    const std::vector<ParseJob>& jobs_,
+    std::size_t workerNum_,
+    const std::function<int(const ParseJob&)>& parseJob_,
+    const std::function<void(const ParseJob&, int, std::uint64_t)>& finishJob_);
+
+  /**
+   * Parses a translation unit.
+   * @param preamble_ If given then the translation unit loads the precompiled
+   * header of this preamble group. If it fails, then the translation unit is
+   * parsed again without it.
+   * @return Non-zero if parsing has been failed.
+   */
+  int parseWorker(
+    const clang::tooling::CompileCommand& command_,
+    const PreambleGroup* preamble_ = nullptr);
+
+  /**
+   * Builds the precompiled header of a preamble group.
+   * @return True if the precompiled header has been built.
+   */
+  bool buildPreamble(PreambleGroup& group_);
   
   void initBuildActions();
-  void markByInclusion(model::FilePtr file_);
-  std::vector<std::vector<std::string>> createCleanupOrder();
-  bool cleanupWorker(const std::string& path_);
+
+  /**
+   * Collects the file level relations (header inclusions and CppEdges) from
+   * the database and saves them as a memory mappable util::CsrGraph into the
+   * project directory. The incremental parser and the C++ service use this
+   * graph instead of querying the database node by node.
+   */
+  void saveFileGraph();
+
+  /**
+   * The model::CppRelation rows stored by earlier versions have generated IDs
+   * and many duplicates. If the table still has the schema of the generated
+   * IDs, this function converts it, replaces the IDs of the rows by the
+   * content hash IDs and drops the duplicates. Otherwise it does nothing.
+   */
+  void migrateRelations();
+
+  /**
+   * Logs the allocations of the model object arenas of the translation units
+   * and the peak resident memory of the parser and of its worker processes.
+   */
+  void logMemoryStatistics();
+
+  /**
+   * Deletes the C++ entities, inheritances, friendships, build actions and
+   * file relations of the files by a few set-based statements. It must be
+   * called in a transaction.
+   */
+  void cleanupFiles(const std::vector<model::FileId>& files_);
+
+  /**
+   * Removes the AST nodes, edges and edge attributes of the files from the
+   * warm caches kept by the watch mode, before they are deleted. It must be
+   * called in a transaction.
+   * @param fileIds_ Comma separated list of the file IDs.
+   */
+  void evictFromCaches(const std::string& fileIds_);
+
+  /**
+   * True if the entity and relation caches are filled from an earlier parse,
+   * and are kept in sync with the database (see --watch).
+   */
+  bool _cachesLoaded = false;
 
   std::unordered_set<std::uint64_t> _parsedCommandHashes;
+  std::unordered_set<std::uint64_t> _parsedSemanticHashes;
+  std::unordered_set<std::uint64_t> _preprocessedHashes;
+  std::mutex _preprocessedHashesMutex;
+  std::string _fileGraphPath;
 
 };
   
@@ -5,6 +5,7 @@
 #include <mutex>
 #include <type_traits>
 #include <stack>
+#include <unordered_set>
 
 #include <clang/Basic/SourceLocation.h>
 #include <clang/Basic/SourceManager.h>
@@ -33,6 +34,7 @@
 
 #include <parser/parsercontext.h>
 #include <parser/sourcemanager.h>
+#include <util/arena.h>
 #include <util/hash.h>
 #include <util/odbtransaction.h>
 #include <util/logutil.h>
@@ -40,6 +42,7 @@
 #include <cppparser/filelocutil.h>
 
 #include "entitycache.h"
+#include "idcache.h"
 #include "symbolhelper.h"
 
 namespace cc
@@ -71,6 +74,7 @@ public:
     ParserContext& ctx_,
     clang::ASTContext& astContext_,
     EntityCache& entityCache_,
+    IdCache& relationCache_,
     std::unordered_map<const void*, model::CppAstNodeId>& clangToAstNodeId_)
     : _isImplicit(false),
       _ctx(ctx_),
@@ -80,6 +84,7 @@ public:
       _mngCtx(astContext_.createMangleContext()),
       _cppSourceType("CPP"),
       _entityCache(entityCache_),
+      _relationCache(relationCache_),
       _clangToAstNodeId(clangToAstNodeId_)
   {
   }
@@ -108,20 +113,7 @@ public:
         _astNodes.push_back(typeLocAstNode);
     }
 
-    (util::OdbTransaction(_ctx.db))([this]{
-      util::persistAll(_astNodes, _ctx.db);
-      util::persistAll(_enumConstants, _ctx.db);
-      util::persistAll(_enums, _ctx.db);
-      util::persistAll(_types, _ctx.db);
-      util::persistAll(_typedefs, _ctx.db);
-      util::persistAll(_variables, _ctx.db);
-      util::persistAll(_namespaces, _ctx.db);
-      util::persistAll(_members, _ctx.db);
-      util::persistAll(_inheritances, _ctx.db);
-      util::persistAll(_friends, _ctx.db);
-      util::persistAll(_functions, _ctx.db);
-      util::persistAll(_relations, _ctx.db);
-    });
+    persist();
   }
 
   bool shouldVisitImplicitCode() const { return true; }
@@ -143,7 +135,7 @@ public:
 
   bool TraverseFunctionDecl(clang::FunctionDecl* fd_)
   {
-    _functionStack.push(std::make_shared<model::CppFunction>());
+    _functionStack.push(_arena.makeShared<model::CppFunction>());
 
     bool b = Base::TraverseFunctionDecl(fd_);
 
@@ -156,7 +148,7 @@ public:
 
   bool TraverseCXXDeductionGuideDecl(clang::CXXDeductionGuideDecl* fd_)
   {
-    _functionStack.push(std::make_shared<model::CppFunction>());
+    _functionStack.push(_arena.makeShared<model::CppFunction>());
 
     bool b = Base::TraverseCXXDeductionGuideDecl(fd_);
 
@@ -169,7 +161,7 @@ public:
 
   bool TraverseCXXMethodDecl(clang::CXXMethodDecl* fd_)
   {
-    _functionStack.push(std::make_shared<model::CppFunction>());
+    _functionStack.push(_arena.makeShared<model::CppFunction>());
 
     bool b = Base::TraverseCXXMethodDecl(fd_);
 
@@ -182,7 +174,7 @@ public:
 
   bool TraverseCXXConstructorDecl(clang::CXXConstructorDecl* fd_)
   {
-    _functionStack.push(std::make_shared<model::CppFunction>());
+    _functionStack.push(_arena.makeShared<model::CppFunction>());
 
     bool b = Base::TraverseCXXConstructorDecl(fd_);
 
@@ -195,7 +187,7 @@ public:
 
   bool TraverseCXXDestructorDecl(clang::CXXDestructorDecl* fd_)
   {
-    _functionStack.push(std::make_shared<model::CppFunction>());
+    _functionStack.push(_arena.makeShared<model::CppFunction>());
 
     bool b = Base::TraverseCXXDestructorDecl(fd_);
 
@@ -208,7 +200,7 @@ public:
 
   bool TraverseCXXConversionDecl(clang::CXXConversionDecl* fd_)
   {
-    _functionStack.push(std::make_shared<model::CppFunction>());
+    _functionStack.push(_arena.makeShared<model::CppFunction>());
 
     bool b = Base::TraverseCXXConversionDecl(fd_);
 
@@ -221,7 +213,7 @@ public:
 
   bool TraverseRecordDecl(clang::RecordDecl* rd_)
   {
-    _typeStack.push(std::make_shared<model::CppRecord>());
+    _typeStack.push(_arena.makeShared<model::CppRecord>());
 
     bool b = Base::TraverseRecordDecl(rd_);
 
@@ -234,7 +226,7 @@ public:
 
   bool TraverseCXXRecordDecl(clang::CXXRecordDecl* rd_)
   {
-    _typeStack.push(std::make_shared<model::CppRecord>());
+    _typeStack.push(_arena.makeShared<model::CppRecord>());
 
     bool b = Base::TraverseCXXRecordDecl(rd_);
 
@@ -248,7 +240,7 @@ public:
   bool TraverseClassTemplateSpecializationDecl(
     clang::ClassTemplateSpecializationDecl* rd_)
   {
-    _typeStack.push(std::make_shared<model::CppRecord>());
+    _typeStack.push(_arena.makeShared<model::CppRecord>());
 
     bool b = Base::TraverseClassTemplateSpecializationDecl(rd_);
 
@@ -262,7 +254,7 @@ public:
   bool TraverseClassTemplatePartialSpecializationDecl(
     clang::ClassTemplatePartialSpecializationDecl* rd_)
   {
-    _typeStack.push(std::make_shared<model::CppRecord>());
+    _typeStack.push(_arena.makeShared<model::CppRecord>());
 
     bool b = Base::TraverseClassTemplatePartialSpecializationDecl(rd_);
 
@@ -275,7 +267,7 @@ public:
 
   bool TraverseEnumDecl(clang::EnumDecl* ed_)
   {
-    _enumStack.push(std::make_shared<model::CppEnum>());
+    _enumStack.push(_arena.makeShared<model::CppEnum>());
 
     bool b = Base::TraverseEnumDecl(ed_);
 
@@ -341,13 +333,13 @@ public:
 
     const clang::TypedefNameDecl* td = type->getDecl();
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->location = getFileLoc(tl_.getBeginLoc(), tl_.getEndLoc());
     astNode->astType = model::CppAstNode::AstType::TypeLocation;
     astNode->astValue = td->getNameAsString();
     astNode->symbolType = model::CppAstNode::SymbolType::Typedef;
-    astNode->entityHash = util::fnvHash(getUSR(td));
+    astNode->entityHash = getUSRHash(td);
 
     _locToTypeLoc[tl_.getBeginLoc().getRawEncoding()] = astNode;
 
@@ -361,13 +353,13 @@ public:
 
     const clang::EnumDecl* ed = type->getDecl();
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->location = getFileLoc(tl_.getBeginLoc(), tl_.getEndLoc());
     astNode->astType = model::CppAstNode::AstType::TypeLocation;
     astNode->astValue = ed->getNameAsString();
     astNode->symbolType = model::CppAstNode::SymbolType::Enum;
-    astNode->entityHash = util::fnvHash(getUSR(ed));
+    astNode->entityHash = getUSRHash(ed);
 
     _locToTypeLoc[tl_.getBeginLoc().getRawEncoding()] = astNode;
 
@@ -381,13 +373,13 @@ public:
 
     const clang::RecordDecl* rd = type->getDecl();
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->location = getFileLoc(tl_.getBeginLoc(), tl_.getEndLoc());
     astNode->astType = model::CppAstNode::AstType::TypeLocation;
     astNode->astValue = rd->getNameAsString();
     astNode->symbolType = model::CppAstNode::SymbolType::Type;
-    astNode->entityHash = util::fnvHash(getUSR(rd));
+    astNode->entityHash = getUSRHash(rd);
 
     _locToTypeLoc[tl_.getBeginLoc().getRawEncoding()] = astNode;
 
@@ -405,11 +397,11 @@ public:
 
     //--- CppAstNode ---//
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = getDeclPartAsString(_clangSrcMgr, rd_);
     astNode->location = getFileLoc(rd_->getBeginLoc(), rd_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(rd_));
+    astNode->entityHash = getUSRHash(rd_);
     astNode->symbolType = model::CppAstNode::SymbolType::Type;
     astNode->astType
       = rd_->isThisDeclarationADefinition()
@@ -456,11 +448,11 @@ public:
         if (baseDecl)
         {
           model::CppInheritancePtr inheritance
-            = std::make_shared<model::CppInheritance>();
+            = _arena.makeShared<model::CppInheritance>();
           _inheritances.push_back(inheritance);
 
           inheritance->derived = cppRecord->entityHash;
-          inheritance->base = util::fnvHash(getUSR(baseDecl));
+          inheritance->base = getUSRHash(baseDecl);
           inheritance->isVirtual = it->isVirtual();
           inheritance->visibility = getVisibility(it->getAccessSpecifier());
 
@@ -490,11 +482,11 @@ public:
           //--- Friend classes ---//
 
           model::CppFriendshipPtr friendship
-            = std::make_shared<model::CppFriendship>();
+            = _arena.makeShared<model::CppFriendship>();
           _friends.push_back(friendship);
 
           friendship->target = cppRecord->entityHash;
-          friendship->theFriend = util::fnvHash(getUSR(cxxRecordDecl));
+          friendship->theFriend = getUSRHash(cxxRecordDecl);
 
           clang::SourceRange range = (*it)->getSourceRange();
           _locToAstValue[tsi->getTypeLoc().getBeginLoc().getRawEncoding()]
@@ -506,11 +498,11 @@ public:
           //--- Friend functions ---//
 
           model::CppFriendshipPtr friendship
-            = std::make_shared<model::CppFriendship>();
+            = _arena.makeShared<model::CppFriendship>();
           _friends.push_back(friendship);
 
           friendship->target = cppRecord->entityHash;
-          friendship->theFriend = util::fnvHash(getUSR(friendDecl));
+          friendship->theFriend = getUSRHash(friendDecl);
         }
       }
     }
@@ -522,11 +514,11 @@ public:
   {
     //--- CppAstNode ---//
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = getDeclPartAsString(_clangSrcMgr, ed_);
     astNode->location = getFileLoc(ed_->getBeginLoc(), ed_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(ed_));
+    astNode->entityHash = getUSRHash(ed_);
     astNode->symbolType = model::CppAstNode::SymbolType::Enum;
     astNode->astType
       = ed_->isThisDeclarationADefinition()
@@ -560,11 +552,11 @@ public:
   {
     //--- CppAstNode ---//
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = ec_->getNameAsString();
     astNode->location = getFileLoc(ec_->getBeginLoc(), ec_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(ec_));
+    astNode->entityHash = getUSRHash(ec_);
     astNode->symbolType = model::CppAstNode::SymbolType::EnumConstant;
     astNode->astType = model::CppAstNode::AstType::Definition;
 
@@ -578,7 +570,7 @@ public:
     //--- CppEnumConstant ---//
 
     model::CppEnumConstantPtr enumConstant
-      = std::make_shared<model::CppEnumConstant>();
+      = _arena.makeShared<model::CppEnumConstant>();
     _enumConstants.push_back(enumConstant);
 
     enumConstant->astNodeId = astNode->id;
@@ -596,7 +588,7 @@ public:
   {
     //--- CppAstNode ---//
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = getSourceText(
       _clangSrcMgr,
@@ -604,7 +596,7 @@ public:
       td_->getSourceRange().getEnd(),
       true);
     astNode->location = getFileLoc(td_->getBeginLoc(), td_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(td_));
+    astNode->entityHash = getUSRHash(td_);
     astNode->symbolType = model::CppAstNode::SymbolType::Typedef;
     astNode->astType = model::CppAstNode::AstType::Definition;
 
@@ -617,7 +609,7 @@ public:
 
     //--- CppTypedef ---//
 
-    model::CppTypedefPtr cppTypedef = std::make_shared<model::CppTypedef>();
+    model::CppTypedefPtr cppTypedef = _arena.makeShared<model::CppTypedef>();
     _typedefs.push_back(cppTypedef);
 
     clang::QualType qualType = td_->getUnderlyingType();
@@ -626,7 +618,7 @@ public:
     cppTypedef->entityHash = astNode->entityHash;
     cppTypedef->name = td_->getNameAsString();
     cppTypedef->qualifiedName = td_->getQualifiedNameAsString();
-    cppTypedef->typeHash = util::fnvHash(getUSR(qualType, _astContext));
+    cppTypedef->typeHash = getUSRHash(qualType, _astContext);
     cppTypedef->qualifiedType = qualType.getAsString();
 
     //--- AST type for aliased type ---//
@@ -648,11 +640,11 @@ public:
   {
     //--- CppAstNode ---//
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = getSignature(fn_);
     astNode->location = getFileLoc(fn_->getBeginLoc(), fn_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(fn_));
+    astNode->entityHash = getUSRHash(fn_);
     astNode->symbolType = model::CppAstNode::SymbolType::Function;
     astNode->astType
       = fn_->isThisDeclarationADefinition()
@@ -676,7 +668,7 @@ public:
     cppFunction->entityHash = astNode->entityHash;
     cppFunction->name = fn_->getNameAsString();
     cppFunction->qualifiedName = fn_->getQualifiedNameAsString();
-    cppFunction->typeHash = util::fnvHash(getUSR(qualType, _astContext));
+    cppFunction->typeHash = getUSRHash(qualType, _astContext);
     cppFunction->qualifiedType = qualType.getAsString();
 
     clang::CXXMethodDecl* md = llvm::dyn_cast<clang::CXXMethodDecl>(fn_);
@@ -714,7 +706,7 @@ public:
     if (md && !_typeStack.empty())
     {
       model::CppMemberTypePtr member
-        = std::make_shared<model::CppMemberType>();
+        = _arena.makeShared<model::CppMemberType>();
       _members.push_back(member);
 
       member->memberAstNode = astNode;
@@ -737,13 +729,13 @@ public:
       if (!member || init->getSourceOrder() == -1)
         continue;
 
-      model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+      model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
       astNode->astValue = getSignature(cd_);
       astNode->location = getFileLoc(
         init->getSourceRange().getBegin(),
         init->getSourceRange().getEnd());
-      astNode->entityHash = util::fnvHash(getUSR(member));
+      astNode->entityHash = getUSRHash(member);
       astNode->symbolType
         = isFunctionPointer(member)
         ? model::CppAstNode::SymbolType::FunctionPtr
@@ -763,7 +755,7 @@ public:
   {
     //--- CppAstNode ---//
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = getSourceText(
       _clangSrcMgr,
@@ -771,7 +763,7 @@ public:
       fd_->getSourceRange().getEnd(),
       true);
     astNode->location = getFileLoc(fd_->getBeginLoc(), fd_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(fd_));
+    astNode->entityHash = getUSRHash(fd_);
     astNode->symbolType
       = isFunctionPointer(fd_)
       ? model::CppAstNode::SymbolType::FunctionPtr
@@ -787,20 +779,20 @@ public:
 
     //--- CppMemberType ---//
 
-    model::CppMemberTypePtr member = std::make_shared<model::CppMemberType>();
+    model::CppMemberTypePtr member = _arena.makeShared<model::CppMemberType>();
     _members.push_back(member);
 
     clang::QualType qualType = fd_->getType();
 
     member->typeHash = _typeStack.top()->entityHash;
     member->memberAstNode = astNode;
-    member->memberTypeHash = util::fnvHash(getUSR(qualType, _astContext));
+    member->memberTypeHash = getUSRHash(qualType, _astContext);
     member->kind = model::CppMemberType::Kind::Field;
     member->visibility = getMemberVisibility(fd_);
 
     //--- CppVariable ---//
 
-    model::CppVariablePtr variable = std::make_shared<model::CppVariable>();
+    model::CppVariablePtr variable = _arena.makeShared<model::CppVariable>();
     _variables.push_back(variable);
 
     variable->astNodeId = astNode->id;
@@ -826,7 +818,7 @@ public:
   {
     //--- CppAstNode ---//
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = getSourceText(
       _clangSrcMgr,
@@ -834,7 +826,7 @@ public:
       vd_->getEndLoc(),
       true);
     astNode->location = getFileLoc(vd_->getLocation(), vd_->getLocation());
-    astNode->entityHash = util::fnvHash(getUSR(vd_));
+    astNode->entityHash = getUSRHash(vd_);
     astNode->symbolType
       = isFunctionPointer(vd_)
       ? model::CppAstNode::SymbolType::FunctionPtr
@@ -866,7 +858,7 @@ public:
 
     //--- CppVariable ---//
 
-    model::CppVariablePtr variable = std::make_shared<model::CppVariable>();
+    model::CppVariablePtr variable = _arena.makeShared<model::CppVariable>();
     _variables.push_back(variable);
 
     clang::QualType qualType = vd_->getType();
@@ -875,7 +867,7 @@ public:
     variable->entityHash = astNode->entityHash;
     variable->name = vd_->getNameAsString();
     variable->qualifiedName = vd_->getQualifiedNameAsString();
-    variable->typeHash = util::fnvHash(getUSR(qualType, _astContext));
+    variable->typeHash = getUSRHash(qualType, _astContext);
     variable->qualifiedType = qualType.getAsString();
 
     if (_functionStack.empty())
@@ -887,7 +879,8 @@ public:
     {
       variable->tags.insert(model::Tag::Static);
 
-      model::CppMemberTypePtr member = std::make_shared<model::CppMemberType>();
+      model::CppMemberTypePtr member
+        = _arena.makeShared<model::CppMemberType>();
       _members.push_back(member);
 
       member->typeHash = _typeStack.top()->entityHash;
@@ -924,7 +917,7 @@ public:
   {
     //--- CppAstNode ---//
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = getSourceText(
       _clangSrcMgr,
@@ -946,7 +939,7 @@ public:
 
     //--- CppNamespace ---//
 
-    model::CppNamespacePtr ns = std::make_shared<model::CppNamespace>();
+    model::CppNamespacePtr ns = _arena.makeShared<model::CppNamespace>();
     _namespaces.push_back(ns);
 
     ns->astNodeId = astNode->id;
@@ -959,13 +952,13 @@ public:
 
   bool VisitCXXConstructExpr(clang::CXXConstructExpr* ce_)
   {
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     const clang::CXXConstructorDecl* ctor = ce_->getConstructor();
 
     astNode->astValue = getSignature(ctor);
     astNode->location = getFileLoc(ce_->getBeginLoc(), ce_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(ctor));
+    astNode->entityHash = getUSRHash(ctor);
     astNode->symbolType = model::CppAstNode::SymbolType::Function;
     astNode->astType = model::CppAstNode::AstType::Usage;
     astNode->visibleInSourceCode = false;
@@ -989,11 +982,11 @@ public:
     if (!functionDecl)
       return true;
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = getSignature(functionDecl);
     astNode->location = getFileLoc(ne_->getBeginLoc(), ne_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(functionDecl));
+    astNode->entityHash = getUSRHash(functionDecl);
     astNode->symbolType = model::CppAstNode::SymbolType::Function;
     astNode->astType = model::CppAstNode::AstType::Usage;
 
@@ -1023,11 +1016,11 @@ public:
     if (!functionDecl)
       return true;
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = getSignature(functionDecl);
     astNode->location = getFileLoc(de_->getBeginLoc(), de_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(functionDecl));
+    astNode->entityHash = getUSRHash(functionDecl);
     astNode->symbolType = model::CppAstNode::SymbolType::Function;
     astNode->astType = model::CppAstNode::AstType::Usage;
     astNode->id = model::createIdentifier(*astNode);
@@ -1051,7 +1044,7 @@ public:
     const clang::FunctionDecl* funcCallee
       = llvm::dyn_cast<clang::FunctionDecl>(callee);
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     std::string usr = getUSR(namedCallee);
 
@@ -1086,7 +1079,7 @@ public:
 
     if (const clang::VarDecl* vd = llvm::dyn_cast<clang::VarDecl>(decl))
     {
-      astNode = std::make_shared<model::CppAstNode>();
+      astNode = _arena.makeShared<model::CppAstNode>();
 
       model::FileLoc location =
         getFileLoc(vd->getLocation(), vd->getLocation());
@@ -1104,7 +1097,7 @@ public:
         astNode->astValue = vd->getNameAsString();
 
       astNode->location = getFileLoc(dr_->getBeginLoc(), dr_->getEndLoc());
-      astNode->entityHash = util::fnvHash(getUSR(vd));
+      astNode->entityHash = getUSRHash(vd);
       astNode->symbolType
         = isFunctionPointer(vd)
         ? model::CppAstNode::SymbolType::FunctionPtr
@@ -1119,7 +1112,7 @@ public:
     else if (const clang::EnumConstantDecl* ec
       = llvm::dyn_cast<clang::EnumConstantDecl>(decl))
     {
-      astNode = std::make_shared<model::CppAstNode>();
+      astNode = _arena.makeShared<model::CppAstNode>();
 
       if (!_contextStatementStack.empty())
       {
@@ -1134,7 +1127,7 @@ public:
         astNode->astValue = ec->getNameAsString();
 
       astNode->location = getFileLoc(dr_->getBeginLoc(), dr_->getEndLoc());
-      astNode->entityHash = util::fnvHash(getUSR(ec));
+      astNode->entityHash = getUSRHash(ec);
       astNode->symbolType = model::CppAstNode::SymbolType::EnumConstant;
       astNode->astType = model::CppAstNode::AstType::Usage;
 
@@ -1155,11 +1148,11 @@ public:
     const clang::CXXMethodDecl* method
       = llvm::dyn_cast<clang::CXXMethodDecl>(vd);
 
-    model::CppAstNodePtr astNode = std::make_shared<model::CppAstNode>();
+    model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
     astNode->astValue = method ? getSignature(method) : vd->getNameAsString();
     astNode->location = getFileLoc(me_->getBeginLoc(), me_->getEndLoc());
-    astNode->entityHash = util::fnvHash(getUSR(vd));
+    astNode->entityHash = getUSRHash(vd);
     astNode->symbolType
       = method
       ? model::CppAstNode::SymbolType::Function
@@ -1191,11 +1184,14 @@ public:
       if (left == _clangToAstNodeId.end() || right == _clangToAstNodeId.end())
         continue;
 
-      model::CppRelationPtr rel = std::make_shared<model::CppRelation>();
+      model::CppRelationPtr rel = _arena.makeShared<model::CppRelation>();
       rel->kind = model::CppRelation::Kind::Override;
       rel->lhs = _entityCache.at(left->second);
       rel->rhs = _entityCache.at(right->second);
-      _relations.push_back(rel);
+      rel->id = model::createIdentifier(*rel);
+
+      if (_relationCache.insert(rel->id))
+        _relations.push_back(rel);
     }
 
     return true;
@@ -1204,6 +1200,45 @@ public:
 private:
   using Base = clang::RecursiveASTVisitor<ClangASTVisitor>;
 
+  /**
+   * Persists the collected objects. The IDs of the AST nodes and the
+   * relations are published in the shared caches after the commit, or
+   * released if they couldn't be persisted, see util::SharedHashMap.
+   */
+  void persist()
+  {
+    try
+    {
+      (util::OdbTransaction(_ctx.db))([this]{
+        util::persistAll(_astNodes, _ctx.db);
+        util::persistAll(_enumConstants, _ctx.db);
+        util::persistAll(_enums, _ctx.db);
+        util::persistAll(_types, _ctx.db);
+        util::persistAll(_typedefs, _ctx.db);
+        util::persistAll(_variables, _ctx.db);
+        util::persistAll(_namespaces, _ctx.db);
+        util::persistAll(_members, _ctx.db);
+        util::persistAll(_inheritances, _ctx.db);
+        util::persistAll(_friends, _ctx.db);
+        util::persistAll(_functions, _ctx.db);
+        util::persistAll(_relations, _ctx.db);
+      });
+    }
+    catch (...)
+    {
+      for (const model::CppAstNodePtr& node : _astNodes)
+        _entityCache.release(node->id);
+      for (const model::CppRelationPtr& relation : _relations)
+        _relationCache.release(relation->id);
+      throw;
+    }
+
+    for (const model::CppAstNodePtr& node : _astNodes)
+      _entityCache.publish(node->id);
+    for (const model::CppRelationPtr& relation : _relations)
+      _relationCache.publish(relation->id);
+  }
+
   /**
    * This function inserts a model::CppAstNodeId to a cache in a thread-safe
    * way. The cache is static so the parsers in each thread can use the same.
@@ -1245,13 +1280,9 @@ private:
 
     if (start_.isInvalid() || end_.isInvalid())
     {
-      fileLoc.file = getFile(start_);
-      const std::string& type = fileLoc.file.load()->type;
-      if (type != model::File::DIRECTORY_TYPE && type != _cppSourceType)
-      {
-        fileLoc.file->type = _cppSourceType;
-        _ctx.srcMgr.updateFile(*fileLoc.file);
-      }
+      model::FilePtr file = getFile(start_);
+      markCppSource(file);
+      fileLoc.file = file;
       return fileLoc;
     }
 
@@ -1266,18 +1297,33 @@ private:
     if (!_isImplicit)
       _fileLocUtil.setRange(realStart, realEnd, fileLoc.range);
 
-    fileLoc.file = getFile(realStart);
-
-    const std::string& type = fileLoc.file.load()->type;
-    if (type != model::File::DIRECTORY_TYPE && type != _cppSourceType)
-    {
-      fileLoc.file->type = _cppSourceType;
-      _ctx.srcMgr.updateFile(*fileLoc.file);
-    }
+    model::FilePtr file = getFile(realStart);
+    markCppSource(file);
+    fileLoc.file = file;
 
     return fileLoc;
   }
 
+  /**
+   * Sets the type of the file to C++ source unless it is a directory. The
+   * file is shared with the other plugins, so it is modified by the source
+   * manager, once per translation unit.
+   */
+  void markCppSource(const model::FilePtr& file_)
+  {
+    if (!_markedFiles.insert(file_->id).second)
+      return;
+
+    _ctx.srcMgr.updateFile(file_, [this](model::File& entry_)
+    {
+      if (entry_.type == model::File::DIRECTORY_TYPE ||
+          entry_.type == _cppSourceType)
+        return false;
+      entry_.type = _cppSourceType;
+      return true;
+    });
+  }
+
   bool isFunctionPointer(const clang::ValueDecl* vd_) const
   {
     const clang::Type* type = vd_->getType().getTypePtrOrNull();
@@ -1463,6 +1509,11 @@ private:
     return false;
   }
 
+  // The model objects of the translation unit are allocated here, and freed
+  // at once after they are persisted. It is declared first, so it is
+  // destroyed after every container of the objects.
+  util::Arena _arena;
+
   std::vector<model::CppAstNodePtr>      _astNodes;
   std::vector<model::CppEnumConstantPtr> _enumConstants;
   std::vector<model::CppEnumPtr>         _enums;
@@ -1491,8 +1542,10 @@ private:
   clang::MangleContext* _mngCtx;
   const std::string _cppSourceType;
   std::unordered_map<std::string, model::FilePtr> _files;
+  std::unordered_set<model::FileId> _markedFiles;
 
   EntityCache& _entityCache;
+  IdCache& _relationCache;
   std::unordered_map<const void*, model::CppAstNodeId>& _clangToAstNodeId;
 
   // clang::TypeLoc for type names is like clang::DeclRefExpr for objects: it
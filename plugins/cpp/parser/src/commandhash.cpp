@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/filesystem.hpp>
+
+#include <util/hash.h>
+
+#include "commandhash.h"
+
+namespace cc
+{
+namespace parser
+{
+
+bool hasSourceExtension(const std::string& file_)
+{
+  const std::vector<std::string> cppExts{
+    ".c", ".cc", ".cpp", ".cxx", ".o", ".so", ".a"};
+
+  std::string ext = boost::filesystem::extension(file_);
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+  return std::find(cppExts.begin(), cppExts.end(), ext) != cppExts.end();
+}
+
+std::uint64_t semanticCommandHash(
+  const clang::tooling::CompileCommand& command_)
+{
+  // Flags which don't affect the AST, and the ones of them which have a
+  // separate argument.
+  static const std::vector<std::string> ignoredFlags{
+    "-c", "-M", "-MM", "-MD", "-MMD", "-MP", "-MG", "-w", "-pipe",
+    "-pedantic", "-pedantic-errors", "-fcolor-diagnostics",
+    "-fno-color-diagnostics"};
+  static const std::vector<std::string> ignoredFlagsWithArg{
+    "-o", "-MF", "-MT", "-MQ", "-MJ", "-Xlinker", "-Xassembler",
+    "-dependency-file", "--serialize-diagnostics"};
+  static const std::vector<std::string> ignoredJoinedFlags{
+    "-o", "-MF", "-MT", "-MQ", "-MJ"};
+  static const std::vector<std::string> ignoredPrefixes{
+    "-W", "-fdiagnostics-", "-fmessage-length", "-fdebug-prefix-map="};
+
+  // Debug info flags. They are matched explicitly, because other flags start
+  // with -g too (e.g. -gcc-toolchain).
+  static const std::vector<std::string> debugFlags{
+    "-g", "-g0", "-g1", "-g2", "-g3", "-gmlt", "-gline-tables-only",
+    "-gline-directives-only", "-gcolumn-info", "-gno-column-info",
+    "-gsplit-dwarf", "-gz", "-gcodeview", "-gembed-source", "-gmodules",
+    "-gstrict-dwarf", "-gno-strict-dwarf", "-grecord-gcc-switches",
+    "-gno-record-gcc-switches", "-gpubnames", "-gno-pubnames",
+    "-ggnu-pubnames", "-gno-gnu-pubnames", "-gfull", "-gused", "-gbtf",
+    "-gsimple-template-names"};
+  static const std::vector<std::string> debugPrefixes{
+    "-ggdb", "-gdwarf", "-gstabs", "-gxcoff", "-gvms", "-gsplit-dwarf=",
+    "-gz="};
+
+  // Flags having a path argument which is relative to the build directory.
+  static const std::vector<std::string> pathFlags{
+    "-I", "-isystem", "-iquote", "-idirafter", "-include", "-imacros"};
+
+  auto absolute = [&command_](const std::string& path_)
+  {
+    return boost::filesystem::absolute(path_, command_.Directory).string();
+  };
+
+  auto contains = [](const std::vector<std::string>& v_, const std::string& s_)
+  {
+    return std::find(v_.begin(), v_.end(), s_) != v_.end();
+  };
+
+  std::vector<std::string> args;
+
+  // Only the final state of each macro matters, not the order of -D and -U
+  // flags of different macros.
+  std::map<std::string, std::string> macros;
+
+  const std::vector<std::string>& cmd = command_.CommandLine;
+
+  if (!cmd.empty())
+    args.push_back(boost::filesystem::path(cmd[0]).filename().string());
+
+  for (std::size_t i = 1; i < cmd.size(); ++i)
+  {
+    const std::string& arg = cmd[i];
+
+    if (contains(ignoredFlags, arg) || contains(debugFlags, arg))
+      continue;
+
+    if (contains(ignoredFlagsWithArg, arg))
+    {
+      ++i;
+      continue;
+    }
+
+    auto startsWithAny = [&arg](const std::vector<std::string>& prefixes_)
+    {
+      return std::any_of(prefixes_.begin(), prefixes_.end(),
+        [&arg](const std::string& prefix_)
+        {
+          return boost::algorithm::starts_with(arg, prefix_);
+        });
+    };
+
+    if (startsWithAny(ignoredJoinedFlags) || startsWithAny(debugPrefixes))
+      continue;
+
+    // -Wp passes flags to the preprocessor.
+    if (!boost::algorithm::starts_with(arg, "-Wp,") &&
+        startsWithAny(ignoredPrefixes))
+      continue;
+
+    if (arg == "-D" || arg == "-U")
+    {
+      if (++i < cmd.size())
+      {
+        std::string macro = cmd[i];
+        std::string name = macro.substr(0, macro.find('='));
+        macros[name] = arg == "-U" ? "-U" : "-D" + macro;
+      }
+      continue;
+    }
+
+    if (boost::algorithm::starts_with(arg, "-D") ||
+        boost::algorithm::starts_with(arg, "-U"))
+    {
+      std::string name = arg.substr(2, arg.find('=') - 2);
+      macros[name] = boost::algorithm::starts_with(arg, "-U") ? "-U" : arg;
+      continue;
+    }
+
+    if (contains(pathFlags, arg))
+    {
+      args.push_back(arg);
+      if (++i < cmd.size())
+        args.push_back(absolute(cmd[i]));
+      continue;
+    }
+
+    if (boost::algorithm::starts_with(arg, "-I"))
+    {
+      args.push_back("-I" + absolute(arg.substr(2)));
+      continue;
+    }
+
+    if (hasSourceExtension(arg))
+    {
+      args.push_back(absolute(arg));
+      continue;
+    }
+
+    args.push_back(arg);
+  }
+
+  for (const auto& macro : macros)
+    args.push_back(macro.first + ' ' + macro.second);
+
+  return util::fnvHash(boost::algorithm::join(args, "\n"));
+}
+
+} // parser
+} // cc
@@ -0,0 +1,33 @@
+#ifndef CC_PARSER_COMMANDHASH_H
+#define CC_PARSER_COMMANDHASH_H
+
+#include <cstdint>
+#include <string>
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Returns true if the file is a C/C++ source file, or an object or library
+ * file given to the compiler, based on its extension.
+ */
+bool hasSourceExtension(const std::string& file_);
+
+/**
+ * Returns a hash of the compile command which is the same for commands
+ * producing the same AST. It ignores the output files, the dependency file
+ * flags, the warning and diagnostic flags, the debug info flags and the
+ * linker and assembler flags, together with their separate arguments. The
+ * macros are ordered by their names and the paths are made absolute.
+ */
+std::uint64_t semanticCommandHash(
+  const clang::tooling::CompileCommand& command_);
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_COMMANDHASH_H
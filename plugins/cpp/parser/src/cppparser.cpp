@@ -1,41 +1,91 @@
 #include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <deque>
+#include <iomanip>
 #include <numeric>
 #include <fstream>
 #include <iterator>
+#include <limits>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/filesystem.hpp>
-#include <boost/graph/graph_traits.hpp>
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/topological_sort.hpp>
+
+#include <poll.h>
+#include <sys/resource.h>
+
+#ifdef DATABASE_SQLITE
+#  include <odb/sqlite/connection.hxx>
+#endif
 
 #include <clang/Frontend/CompilerInstance.h>
 #include <clang/Frontend/FrontendAction.h>
+#include <clang/Frontend/FrontendActions.h>
+#include <clang/Tooling/ArgumentsAdjusters.h>
 
 #include <model/buildaction.h>
 #include <model/buildaction-odb.hxx>
 #include <model/buildsourcetarget.h>
 #include <model/buildsourcetarget-odb.hxx>
+#include <model/cppastnode.h>
+#include <model/cppastnode-odb.hxx>
+#include <model/cppedge.h>
+#include <model/cppedge-odb.hxx>
+#include <model/cppfilegraph.h>
+#include <model/cppheaderinclusion.h>
+#include <model/cppheaderinclusion-odb.hxx>
 #include <model/file.h>
 #include <model/file-odb.hxx>
 
+#include <util/arena.h>
+#include <util/csrgraph.h>
+#include <util/dbutil.h>
 #include <util/hash.h>
 #include <util/logutil.h>
 #include <util/odbtransaction.h>
+#include <util/sharedhashmap.h>
 #include <util/threadpool.h>
 
+#include <parser/compilationdatabase.h>
+
 #include <cppparser/cppparser.h>
+#include <cppparser/filelocutil.h>
 
 #include "clangastvisitor.h"
 #include "relationcollector.h"
 #include "entitycache.h"
+#include "idcache.h"
 #include "ppincludecallback.h"
 #include "ppmacrocallback.h"
 #include "doccommentcollector.h"
 #include "diagnosticmessagehandler.h"
+#include "preamblegroups.h"
+#include "commandhash.h"
+#include "filegraph.h"
+#include "parseworkerprocess.h"
+
+namespace
+{
+
+/**
+ * Status of a translation unit which has not been parsed because its
+ * preprocessed token stream equals an already parsed one.
+ */
+constexpr int PARSE_DUPLICATE = -1;
+
+/**
+ * Job index of an idle worker process.
+ */
+constexpr std::size_t NO_JOB = std::numeric_limits<std::size_t>::max();
+
+} // namespace
 
 namespace cc
 {
@@ -48,6 +98,18 @@ public:
   static void cleanUp()
   {
     MyFrontendAction::_entityCache.clear();
+    MyFrontendAction::_relationCache.clear();
+    RelationCollector::cleanUp();
+  }
+
+  static EntityCache& entityCache()
+  {
+    return MyFrontendAction::_entityCache;
+  }
+
+  static IdCache& relationCache()
+  {
+    return MyFrontendAction::_relationCache;
   }
 
   static void init(ParserContext& ctx_)
@@ -55,6 +117,9 @@ public:
     util::OdbTransaction {ctx_.db} ([&] {
       for (const model::CppAstNode& node : ctx_.db->query<model::CppAstNode>())
         MyFrontendAction::_entityCache.insert(node);
+
+      for (const model::CppRelation& rel : ctx_.db->query<model::CppRelation>())
+        MyFrontendAction::_relationCache.insert(rel.id);
     });
   }
 
@@ -83,7 +148,7 @@ private:
     {
       {
         ClangASTVisitor clangAstVisitor(
-          _ctx, _context, _entityCache, _clangToAstNodeId);
+          _ctx, _context, _entityCache, relationCache(), _clangToAstNodeId);
         clangAstVisitor.TraverseDecl(context_.getTranslationUnitDecl());
       }
 
@@ -143,6 +208,7 @@ private:
 
   private:
     static EntityCache _entityCache;
+    static IdCache _relationCache;
 
     ParserContext& _ctx;
   };
@@ -151,16 +217,203 @@ private:
 };
 
 EntityCache VisitorActionFactory::MyFrontendAction::_entityCache;
+IdCache VisitorActionFactory::MyFrontendAction::_relationCache;
+
+/**
+ * Builds the precompiled header of a preamble group. The preprocessor
+ * callbacks record the inclusions and macros of the preamble's headers here,
+ * since they are not preprocessed again by the translation units loading the
+ * precompiled header.
+ */
+class PreambleActionFactory : public clang::tooling::FrontendActionFactory
+{
+public:
+  PreambleActionFactory(ParserContext& ctx_, PreambleGroup& group_)
+    : _ctx(ctx_), _group(group_)
+  {
+  }
 
-bool CppParser::isSourceFile(const std::string& file_) const
+  std::unique_ptr<clang::FrontendAction> create() override
+  {
+    return std::make_unique<PreambleAction>(_ctx, _group);
+  }
+
+private:
+  /**
+   * Collects the files compiled into the precompiled header.
+   */
+  class HeaderCallback : public clang::PPCallbacks
+  {
+  public:
+    HeaderCallback(
+      const clang::SourceManager& srcMgr_,
+      PreambleGroup& group_)
+      : _srcMgr(srcMgr_), _group(group_)
+    {
+    }
+
+    void FileChanged(
+      clang::SourceLocation loc_,
+      FileChangeReason reason_,
+      clang::SrcMgr::CharacteristicKind,
+      clang::FileID) override
+    {
+      if (reason_ != EnterFile)
+        return;
+
+      std::string path = FileLocUtil(_srcMgr).getFilePath(loc_);
+      if (!path.empty())
+        _group.headers.insert(path);
+    }
+
+  private:
+    const clang::SourceManager& _srcMgr;
+    PreambleGroup& _group;
+  };
+
+  class PreambleAction : public clang::GeneratePCHAction
+  {
+  public:
+    PreambleAction(ParserContext& ctx_, PreambleGroup& group_)
+      : _ctx(ctx_), _group(group_)
+    {
+    }
+
+    virtual bool BeginSourceFileAction(
+      clang::CompilerInstance& compiler_) override
+    {
+      compiler_.getFrontendOpts().OutputFile = _group.pchPath;
+
+      compiler_.createASTContext();
+      auto& pp = compiler_.getPreprocessor();
+      EntityCache& entityCache = VisitorActionFactory::entityCache();
+
+      pp.addPPCallbacks(std::make_unique<PPIncludeCallback>(
+        _ctx, compiler_.getASTContext(), entityCache, pp, _group.headerPath));
+      pp.addPPCallbacks(std::make_unique<PPMacroCallback>(
+        _ctx, compiler_.getASTContext(), entityCache, pp));
+      pp.addPPCallbacks(std::make_unique<HeaderCallback>(
+        compiler_.getSourceManager(), _group));
+
+      return clang::GeneratePCHAction::BeginSourceFileAction(compiler_);
+    }
+
+  private:
+    ParserContext& _ctx;
+    PreambleGroup& _group;
+  };
+
+  ParserContext& _ctx;
+  PreambleGroup& _group;
+};
+
+/**
+ * Creates a compilation database containing the given command.
+ * @param error_ The error message if the database can't be created.
+ */
+static std::unique_ptr<clang::tooling::FixedCompilationDatabase>
+createCompilationDb(
+  const clang::tooling::CompileCommand& command_,
+  std::string& error_)
 {
-  const std::vector<std::string> cppExts{
-    ".c", ".cc", ".cpp", ".cxx", ".o", ".so", ".a"};
+  std::vector<const char*> commandLine;
+  commandLine.reserve(command_.CommandLine.size());
+  commandLine.push_back("--");
+  std::transform(
+    command_.CommandLine.begin() + 1, // Skip compiler name
+    command_.CommandLine.end(),
+    std::back_inserter(commandLine),
+    [](const std::string& s){ return s.c_str(); });
 
-  std::string ext = boost::filesystem::extension(file_);
-  std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+  int argc = commandLine.size();
 
-  return std::find(cppExts.begin(), cppExts.end(), ext) != cppExts.end();
+  return std::unique_ptr<clang::tooling::FixedCompilationDatabase>(
+    clang::tooling::FixedCompilationDatabase::loadFromCommandLine(
+      argc,
+      commandLine.data(),
+      error_));
+}
+
+/**
+ * Computes a hash of the token stream of a translation unit after
+ * preprocessing. Besides the spelling of the tokens it covers the file and
+ * offset of their spelling location, so translation units with the same hash
+ * produce the same AST.
+ */
+class PreprocessedHashAction : public clang::PreprocessorFrontendAction
+{
+public:
+  PreprocessedHashAction(std::uint64_t& hash_) : _hash(hash_)
+  {
+  }
+
+protected:
+  virtual void ExecuteAction() override
+  {
+    clang::Preprocessor& pp = getCompilerInstance().getPreprocessor();
+    const clang::SourceManager& srcMgr = pp.getSourceManager();
+
+    // FNV-1a, like util::fnvHash(), over the whole stream.
+    std::uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](const char* data_, std::size_t size_)
+    {
+      for (std::size_t i = 0; i < size_; ++i)
+      {
+        hash ^= static_cast<std::uint64_t>(data_[i]);
+        hash *= static_cast<std::uint64_t>(1099511628211ULL);
+      }
+    };
+
+    clang::FileID lastFile;
+    clang::Token token;
+
+    pp.EnterMainSourceFile();
+
+    for (pp.Lex(token); token.isNot(clang::tok::eof); pp.Lex(token))
+    {
+      std::pair<clang::FileID, unsigned> loc
+        = srcMgr.getDecomposedSpellingLoc(token.getLocation());
+
+      if (loc.first != lastFile)
+      {
+        lastFile = loc.first;
+        if (const clang::FileEntry* file = srcMgr.getFileEntryForID(loc.first))
+          mix(file->getName().data(), file->getName().size());
+      }
+
+      mix(reinterpret_cast<const char*>(&loc.second), sizeof(loc.second));
+
+      std::string spelling = pp.getSpelling(token);
+      mix(spelling.data(), spelling.size());
+    }
+
+    _hash = hash;
+  }
+
+private:
+  std::uint64_t& _hash;
+};
+
+class PreprocessedHashActionFactory
+  : public clang::tooling::FrontendActionFactory
+{
+public:
+  PreprocessedHashActionFactory(std::uint64_t& hash_) : _hash(hash_)
+  {
+  }
+
+  std::unique_ptr<clang::FrontendAction> create() override
+  {
+    return std::make_unique<PreprocessedHashAction>(_hash);
+  }
+
+private:
+  std::uint64_t& _hash;
+};
+
+bool CppParser::isSourceFile(const std::string& file_) const
+{
+  return hasSourceExtension(file_);
 }
 
 bool CppParser::isNonSourceFlag(const std::string& arg_) const
@@ -249,7 +502,8 @@ model::BuildActionPtr CppParser::addBuildAction(
 void CppParser::addCompileCommand(
   const clang::tooling::CompileCommand& command_,
   model::BuildActionPtr buildAction_,
-  bool error_)
+  bool error_,
+  bool duplicate_)
 {
   util::OdbTransaction transaction(_ctx.db);
 
@@ -260,21 +514,27 @@ void CppParser::addCompileCommand(
   {
     model::BuildSource buildSource;
     buildSource.file = _ctx.srcMgr.getFile(srcTarget.first);
-    buildSource.file->parseStatus = error_
-      ? model::File::PSPartiallyParsed
-      : model::File::PSFullyParsed;
-    _ctx.srcMgr.updateFile(*buildSource.file);
+    if (!duplicate_)
+      _ctx.srcMgr.updateFile(buildSource.file, [error_](model::File& file_)
+      {
+        file_.parseStatus = error_
+          ? model::File::PSPartiallyParsed
+          : model::File::PSFullyParsed;
+        return true;
+      });
     buildSource.action = buildAction_;
     sources.push_back(std::move(buildSource));
 
     model::BuildTarget buildTarget;
     buildTarget.file = _ctx.srcMgr.getFile(srcTarget.second);
     buildTarget.action = buildAction_;
-    if (buildTarget.file->type != model::File::BINARY_TYPE)
+    _ctx.srcMgr.updateFile(buildTarget.file, [](model::File& file_)
     {
-      buildTarget.file->type = model::File::BINARY_TYPE;
-      _ctx.srcMgr.updateFile(*buildTarget.file);
-    }
+      if (file_.type == model::File::BINARY_TYPE)
+        return false;
+      file_.type = model::File::BINARY_TYPE;
+      return true;
+    });
 
     targets.push_back(std::move(buildTarget));
   }
@@ -289,27 +549,15 @@ void CppParser::addCompileCommand(
   });
 }
 
-int CppParser::parseWorker(const clang::tooling::CompileCommand& command_)
+int CppParser::parseWorker(
+  const clang::tooling::CompileCommand& command_,
+  const PreambleGroup* preamble_)
 {
   //--- Assemble compiler command line ---//
 
-  std::vector<const char*> commandLine;
-  commandLine.reserve(command_.CommandLine.size());
-  commandLine.push_back("--");
-  std::transform(
-    command_.CommandLine.begin() + 1, // Skip compiler name
-    command_.CommandLine.end(),
-    std::back_inserter(commandLine),
-    [](const std::string& s){ return s.c_str(); });
-
-  int argc = commandLine.size();
-
   std::string compilationDbLoadError;
-  std::unique_ptr<clang::tooling::FixedCompilationDatabase> compilationDb(
-    clang::tooling::FixedCompilationDatabase::loadFromCommandLine(
-      argc,
-      commandLine.data(),
-      compilationDbLoadError));
+  std::unique_ptr<clang::tooling::FixedCompilationDatabase> compilationDb
+    = createCompilationDb(command_, compilationDbLoadError);
 
   if (!compilationDb)
   {
@@ -323,14 +571,49 @@ int CppParser::parseWorker(const clang::tooling::CompileCommand& command_)
 
   //--- Start the tool ---//
 
-  VisitorActionFactory factory(_ctx);
-  clang::tooling::ClangTool tool(*compilationDb, command_.Filename);
+  bool preambleError = false;
+
+  auto run = [&, this](const PreambleGroup* preamble_)
+  {
+    VisitorActionFactory factory(_ctx);
+    clang::tooling::ClangTool tool(*compilationDb, command_.Filename);
+
+    if (preamble_)
+      tool.appendArgumentsAdjuster(clang::tooling::getInsertArgumentAdjuster(
+        {"-include-pch", preamble_->pchPath},
+        clang::tooling::ArgumentInsertPosition::BEGIN));
 
-  llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> diagOpts = new clang::DiagnosticOptions();
-  DiagnosticMessageHandler diagMsgHandler(diagOpts.get(), _ctx.srcMgr, _ctx.db);
-  tool.setDiagnosticConsumer(&diagMsgHandler);
+    llvm::IntrusiveRefCntPtr<clang::DiagnosticOptions> diagOpts
+      = new clang::DiagnosticOptions();
+    DiagnosticMessageHandler diagMsgHandler(
+      diagOpts.get(), _ctx.srcMgr, _ctx.db);
+    tool.setDiagnosticConsumer(&diagMsgHandler);
 
-  int error = tool.run(&factory);
+    int error = tool.run(&factory);
+
+    // The translation unit is parsed again without the preamble if the error
+    // may be caused by it, so its diagnostics are not stored twice.
+    preambleError = error && preamble_
+      && diagMsgHandler.hasPreambleError(preamble_->headers);
+
+    if (preambleError)
+      diagMsgHandler.discard();
+
+    return error;
+  };
+
+  int error = run(preamble_);
+
+  // A header which is included again after the preamble, e.g. one without an
+  // include guard, may break the translation unit. Other errors occur without
+  // the preamble too, so the translation unit is not parsed again for them.
+  if (preambleError)
+  {
+    LOG(debug)
+      << "[cppparser] Parsing " << command_.Filename
+      << " with precompiled preamble failed, parsing it without.";
+    error = run(nullptr);
+  }
 
   //--- Save build command ---//
 
@@ -339,136 +622,103 @@ int CppParser::parseWorker(const clang::tooling::CompileCommand& command_)
   return error;
 }
 
-CppParser::CppParser(ParserContext& ctx_) : AbstractParser(ctx_)
+bool CppParser::preprocessedHash(
+  const clang::tooling::CompileCommand& command_,
+  std::uint64_t& hash_)
 {
+  std::string compilationDbLoadError;
+  std::unique_ptr<clang::tooling::FixedCompilationDatabase> compilationDb
+    = createCompilationDb(command_, compilationDbLoadError);
+
+  if (!compilationDb)
+    return false;
+
+  clang::tooling::ClangTool tool(*compilationDb, command_.Filename);
+
+  // The diagnostics are reported by the full parse.
+  clang::IgnoringDiagConsumer diagConsumer;
+  tool.setDiagnosticConsumer(&diagConsumer);
+
+  PreprocessedHashActionFactory factory(hash_);
+
+  return tool.run(&factory) == 0;
 }
 
-std::vector<std::vector<std::string>> CppParser::createCleanupOrder()
+bool CppParser::buildPreamble(PreambleGroup& group_)
 {
-  typedef boost::adjacency_list<boost::vecS, boost::vecS,
-    boost::bidirectionalS> Graph;
-  typedef boost::adjacency_list<>::vertex_descriptor Vertex;
-  typedef std::pair<int, int> Edge;
+  std::string compilationDbLoadError;
+  std::unique_ptr<clang::tooling::FixedCompilationDatabase> compilationDb
+    = createCompilationDb(group_.pchCommand, compilationDbLoadError);
 
-  Graph g;
-  std::vector<Edge> edges;
-  std::map<std::string, Vertex> fileNameToVertex;
-  std::deque<std::pair<std::string, Vertex>> deleteQueue;
+  if (!compilationDb)
+    return false;
 
-  for(const auto& file : _ctx.fileStatus)
-  {
-    fileNameToVertex[file.first] = boost::add_vertex(g);
-  }
+  clang::tooling::ClangTool tool(*compilationDb, group_.headerPath);
 
-  try
-  {
-    util::OdbTransaction{_ctx.db}([&]
-    {
-      for (const auto& item : _ctx.fileStatus)
-      {
-        auto file = _ctx.srcMgr.getFile(item.first);
+  // The diagnostics of the generated header are not stored. If the preamble
+  // can't be built then the translation units are parsed without it.
+  clang::IgnoringDiagConsumer diagConsumer;
+  tool.setDiagnosticConsumer(&diagConsumer);
 
-        auto inclusions = _ctx.db->query<model::CppHeaderInclusion>(
-          odb::query<model::CppHeaderInclusion>::included == file->id);
+  PreambleActionFactory factory(_ctx, group_);
 
-        for (const auto& inclusion : inclusions)
-        {
-          bool inserted;
-          model::FilePtr includer = inclusion.includer.load();
-          boost::graph_traits<Graph>::edge_descriptor e;
-          boost::tie(e, inserted) = boost::add_edge(
-            fileNameToVertex.at(includer->path),
-            fileNameToVertex.at(file->path), g);
-        }
-      }
-    });
-  }
-  catch (odb::database_exception&)
-  {
-    LOG(fatal) << "[cppparser] Topological ordering failed!";
-    return std::vector<std::vector<std::string>>();
-  }
+  return tool.run(&factory) == 0;
+}
 
-  if (fileNameToVertex.empty())
-  {
-    LOG(info) << "[cppparser] No changed files to create topological order!";
-    return std::vector<std::vector<std::string>>();
-  }
+CppParser::CppParser(ParserContext& ctx_) : AbstractParser(ctx_)
+{
+  _fileGraphPath = model::cppFileGraphPath(
+    _ctx.options["workspace"].as<std::string>() + '/' +
+    _ctx.options["name"].as<std::string>());
+}
 
-  std::vector<std::vector<std::string>> order;
-  std::size_t index = 0;
-  while (!fileNameToVertex.empty())
-  {
-    order.resize(order.size() + 1);
+void CppParser::markModifiedFiles()
+{
+  std::vector<model::FilePtr> filePtrs;
 
-    for (const auto& item : fileNameToVertex)
+  for (const auto& item : _ctx.fileStatus)
+    if (item.second == IncrementalStatus::MODIFIED ||
+        item.second == IncrementalStatus::DELETED)
     {
-      if (boost::in_degree(item.second, g) == 0)
-      {
-        order[index].push_back(item.first);
-      }
+      model::FilePtr file = _ctx.srcMgr.getFile(item.first);
+      if (file)
+        filePtrs.push_back(file);
     }
 
-    for (const std::string& path : order[index])
-    {
-      boost::clear_out_edges(fileNameToVertex[path], g);
-      fileNameToVertex.erase(path);
-    }
+  // Detect changed files through C++ header inclusions. The file graph saved
+  // by the previous parse reflects the inclusions which are currently in the
+  // database. If it is missing, then it is built from the database.
+  util::OdbTransaction {_ctx.db} ([&]
+  {
+    std::unique_ptr<util::CsrGraph> fileGraph
+      = util::CsrGraph::load(_fileGraphPath);
 
-    /* Circular dependencies in the parsed code would cause
-     * this loop to be infinite. If no files were put in
-     * the current cleanup level, there is probably a
-     * circular dependency somewhere. The rest of the
-     * to-be-cleaned up files can be put in an additional level.
-     */
-    if (order[index].size() == 0)
-    {
-      for (const auto& item : fileNameToVertex)
-      {
-        order[index].push_back(item.first);
-      }
-      
-      fileNameToVertex.clear();
+    if (!fileGraph)
+      fileGraph = createFileGraph(*_ctx.db);
 
-      LOG(debug) << "[cppparser] Circular dependency detected.";
-    }
+    std::vector<util::CsrGraph::NodeId> roots;
+    for (const model::FilePtr& file : filePtrs)
+      roots.push_back(file->id);
 
-    ++index;
-  }
-  LOG(debug) << "[cppparser] Topology has " << index << " levels.";
+    std::vector<util::CsrGraph::NodeId> includers = fileGraph->closure(
+      roots, util::CsrGraph::mask(model::FG_INCLUDE), true);
 
-  return order;
-}
+    // The files are loaded in chunks, since the number of the bound
+    // parameters of a query is limited.
+    const std::size_t chunkSize = 500;
 
-void CppParser::markModifiedFiles()
-{
-  std::vector<model::FilePtr> filePtrs(_ctx.fileStatus.size());
-
-  std::transform(_ctx.fileStatus.begin(),
-                 _ctx.fileStatus.end(),
-                 filePtrs.begin(),
-                 [this](const auto& item)
-                 {
-                   if (item.second == IncrementalStatus::MODIFIED ||
-                       item.second == IncrementalStatus::DELETED)
-                   {
-                     return _ctx.srcMgr.getFile(item.first);
-                   }
-                   else
-                   {
-                     return std::make_shared<model::File>();
-                   }
-                 });
-
-  // Detect changed files through C++ header inclusions.
-  util::OdbTransaction {_ctx.db} ([&]
-  {
-    for (const model::FilePtr file : filePtrs)
+    for (std::size_t begin = 0; begin < includers.size(); begin += chunkSize)
     {
-      if(file)
-      {
-        markByInclusion(file);
-      }
+      auto end = includers.begin()
+        + std::min(begin + chunkSize, includers.size());
+
+      for (const model::File& includer : _ctx.db->query<model::File>(
+        odb::query<model::File>::id.in_range(includers.begin() + begin, end)))
+        if (!_ctx.fileStatus.count(includer.path))
+        {
+          _ctx.fileStatus.emplace(includer.path, IncrementalStatus::MODIFIED);
+          LOG(debug) << "[cppparser] File modified: " << includer.path;
+        }
     }
   }); // end of transaction
 
@@ -479,26 +729,22 @@ void CppParser::markModifiedFiles()
     {
       std::string errorMsg;
 
-      std::unique_ptr<clang::tooling::JSONCompilationDatabase> compDb
-        = clang::tooling::JSONCompilationDatabase::loadFromFile(
-          input, errorMsg,
-          clang::tooling::JSONCommandLineSyntax::Gnu);
+      // The compilation database is read once, parse() uses it too.
+      std::shared_ptr<const CompilationDatabase> compDb
+        = _ctx.compilationDatabase(input, errorMsg);
 
-      if (!errorMsg.empty())
+      if (!compDb)
       {
         LOG(error) << errorMsg;
         continue;
       }
 
-      // Read the compilation commands from the JSON file
-      std::vector<clang::tooling::CompileCommand> compileCommands =
-        compDb->getAllCompileCommands();
-      std::unordered_set<std::string> commandTexts;
-      for (const auto& command : compileCommands)
-      {
-        commandTexts.insert(
-          boost::algorithm::join(command.CommandLine, " "));
-      }
+      // The build actions store the command lines joined by spaces, whose
+      // hashes are computed by the reader.
+      std::unordered_set<std::uint64_t> commandHashes;
+      commandHashes.reserve(compDb->size());
+      for (std::size_t i = 0; i < compDb->size(); ++i)
+        commandHashes.insert(compDb->commandHash(i));
 
       // Load the compilation commands from the workspace database
       util::OdbTransaction {_ctx.db} ([&] {
@@ -506,7 +752,7 @@ void CppParser::markModifiedFiles()
         {
           // If a compilation command is found in the workspace database,
           // but not in the JSON file, mark the source files for cleanup.
-          if (commandTexts.find(ba.command) == commandTexts.end())
+          if (!commandHashes.count(util::fnvHash(ba.command)))
           {
             for(auto buildSourceLazyPtr : ba.sources)
             {
@@ -525,163 +771,173 @@ void CppParser::markModifiedFiles()
 
 bool CppParser::cleanupDatabase()
 {
-  // Construct the topological order of the files.
-  // Each subvector is layer of leaves.
-
-  std::vector<std::vector<std::string>> topologicallyOrderedFiles =
-    createCleanupOrder();
-
-  // Calculate the complete number of cleanup jobs.
+  std::chrono::steady_clock::time_point start
+    = std::chrono::steady_clock::now();
 
-  int threadNum = _ctx.options["jobs"].as<int>();
-  int numCleanupJobs = std::accumulate(
-    topologicallyOrderedFiles.begin(),
-    topologicallyOrderedFiles.end(),
-    0,
-    [](int sum, const auto& level)
-    {
-      return sum + level.size();
-    }
-  );
-  bool allJobsSucceded = true;
+  std::vector<model::FileId> files;
 
-  // Define the cleanup action for a single file.
+  for (const auto& item : _ctx.fileStatus)
+    if (item.second != IncrementalStatus::ADDED)
+      if (model::FilePtr file = _ctx.srcMgr.getFile(item.first))
+        files.push_back(file->id);
 
-  auto cleanupCommand = [this, &numCleanupJobs, &allJobsSucceded](CleanupJob& job_)
+  if (files.empty())
   {
-
-    LOG(info)
-      << "[cppparser] "
-      << '(' << job_.index << '/' << numCleanupJobs << ')'
-      << " Database cleanup: " << job_.path;
-
-    bool success = this->cleanupWorker(job_.path);
-
-    if (!success)
-    {
-      allJobsSucceded = false;
-      LOG(error)
-        << "[cppparser] "
-        << '(' << job_.index << '/' << numCleanupJobs << ')'
-        << " Database cleanup for " << job_.path << " has been failed.";
-    }
-    else
-      LOG(debug)
-        << "[cppparser] "
-        << '(' << job_.index << '/' << numCleanupJobs << ')'
-        << " Database cleanup for " << job_.path << " has succeeded.";
-  };
-
-  // Process all the layers of the graph.
-  // The elements of a single layer can be cleaned up parallely.
-
-  int levelIndex = 0;
-  std::size_t jobIndex = 0;
-  for (const auto& level : topologicallyOrderedFiles)
-  {
-    std::unique_ptr<util::JobQueueThreadPool<CleanupJob>> pool =
-      util::make_thread_pool<CleanupJob>(threadNum, cleanupCommand);
-
-    LOG(debug) << "[cppparser] Started cleanup level: " << ++levelIndex;
-    for (const std::string& filePath : level)
-    {
-      CleanupJob job(filePath, ++jobIndex);
-      pool->enqueue(job);
-    }
-
-    pool->wait();
-    LOG(debug)
-      << "[cppparser] Finished cleanup level: " << levelIndex
-      << " (" << jobIndex << " jobs)";
+    LOG(info) << "[cppparser] No changed files to clean up!";
+    return true;
   }
 
-  return allJobsSucceded;
-}
-
-bool CppParser::cleanupWorker(const std::string& path_)
-{
   const unsigned short maxTries = 3;
   for (unsigned short tryCount = 1; ; ++tryCount)
   {
     try
     {
-      util::OdbTransaction{_ctx.db}([&]
-      {
-        switch (_ctx.fileStatus[path_])
-        {
-          case IncrementalStatus::MODIFIED:
-          case IncrementalStatus::DELETED:
-          case IncrementalStatus::ACTION_CHANGED:
-          {
-            // Fetch file from SourceManager by path
-            model::FilePtr delFile = _ctx.srcMgr.getFile(path_);
-
-            // Query CppAstNode
-            auto defCppAstNodes = _ctx.db->query<model::CppAstNode>(
-              odb::query<model::CppAstNode>::location.file == delFile->id);
-
-            for (const model::CppAstNode& astNode : defCppAstNodes)
-            {
-              // Delete CppEntity
-              _ctx.db->erase_query<model::CppEntity>(odb::query<model::CppEntity>::astNodeId == astNode.id);
-
-              if (astNode.astType == model::CppAstNode::AstType::Definition)
-              {
-                // Delete CppInheritance
-                _ctx.db->erase_query<model::CppInheritance>(
-                  odb::query<model::CppInheritance>::derived == astNode.entityHash);
-
-                // Delete CppFriendship
-                _ctx.db->erase_query<model::CppFriendship>(
-                  odb::query<model::CppFriendship>::target == astNode.entityHash);
-              }
-            }
-
-            // Delete BuildAction
-            auto delSources = _ctx.db->query<model::BuildSource>(
-              odb::query<model::BuildSource>::file == delFile->id);
-            for (const model::BuildSource& source : delSources)
-            {
-              _ctx.db->erase<model::BuildAction>(source.action->id);
-            }
-
-            // Delete CppEdge (connected to File)
-            _ctx.db->erase_query<model::CppEdge>(odb::query<model::CppEdge>::from == delFile->id);
-
-            break;
-          }
-
-          case IncrementalStatus::ADDED:
-            // Empty deliberately
-            break;
-        }
+      util::OdbTransaction {_ctx.db} ([&] {
+        cleanupFiles(files);
       });
+      break;
     }
-    catch (odb::deadlock& ex)
+    catch (odb::deadlock&)
     {
       if (tryCount < maxTries)
         LOG(warning) << "[cppparser] Transaction deadlock occurred, "
-          << "retrying (" << (tryCount + 1) << '/' << maxTries << "): " << path_;
+          << "retrying (" << (tryCount + 1) << '/' << maxTries << ").";
       else
       {
-        LOG(error) << "[cppparser] Transaction deadlock occurred, aborting: " << path_;
+        LOG(error) << "[cppparser] Transaction deadlock occurred, aborting.";
         return false;
       }
     }
-    catch (odb::database_exception&)
+    catch (odb::database_exception& ex)
     {
-      LOG(fatal) << "[cppparser] Transaction failed!";
+      LOG(fatal) << "[cppparser] Transaction failed: " << ex.what();
       return false;
     }
+  }
 
-    return true;
+  LOG(info)
+    << "[cppparser] Database cleanup of " << files.size() << " files took "
+    << std::chrono::duration_cast<std::chrono::milliseconds>(
+         std::chrono::steady_clock::now() - start).count() << " ms.";
+
+  return true;
+}
+
+void CppParser::cleanupFiles(const std::vector<model::FileId>& files_)
+{
+  // The IDs are written into the statements, so their number is not limited
+  // by the bound parameters of the database. The unsigned IDs are stored as
+  // signed 64 bit integers.
+  const std::size_t chunkSize = 1000;
+
+  const std::string definition = std::to_string(
+    static_cast<int>(model::CppAstNode::AstType::Definition));
+
+  std::uint64_t entities = 0, inheritances = 0, friendships = 0;
+  std::uint64_t actions = 0, edges = 0;
+
+  for (std::size_t begin = 0; begin < files_.size(); begin += chunkSize)
+  {
+    std::string fileIds;
+
+    for (std::size_t i = begin;
+         i < std::min(begin + chunkSize, files_.size());
+         ++i)
+      fileIds += (fileIds.empty() ? "" : ",")
+        + std::to_string(static_cast<std::int64_t>(files_[i]));
+
+    if (_cachesLoaded)
+      evictFromCaches(fileIds);
+
+    const std::string astNodesOfFiles
+      = "FROM \"CppAstNode\" WHERE \"location_file\" IN (" + fileIds + ')';
+
+    // The rows of the derived classes and of the tags are deleted by the
+    // foreign keys of the polymorphic hierarchy.
+    entities += _ctx.db->execute(
+      "DELETE FROM \"CppEntity\" WHERE \"astNodeId\" IN "
+      "(SELECT \"id\" " + astNodesOfFiles + ')');
+
+    inheritances += _ctx.db->execute(
+      "DELETE FROM \"CppInheritance\" WHERE \"derived\" IN "
+      "(SELECT \"entityHash\" " + astNodesOfFiles +
+      " AND \"astType\" = " + definition + ')');
+
+    friendships += _ctx.db->execute(
+      "DELETE FROM \"CppFriendship\" WHERE \"target\" IN "
+      "(SELECT \"entityHash\" " + astNodesOfFiles +
+      " AND \"astType\" = " + definition + ')');
+
+    // The sources and the targets of the actions are deleted by cascade.
+    actions += _ctx.db->execute(
+      "DELETE FROM \"BuildAction\" WHERE \"id\" IN "
+      "(SELECT \"action\" FROM \"BuildSource\" "
+      "WHERE \"file\" IN (" + fileIds + "))");
+
+    edges += _ctx.db->execute(
+      "DELETE FROM \"CppEdge\" WHERE \"from\" IN (" + fileIds + ')');
   }
+
+  LOG(debug)
+    << "[cppparser] Deleted " << entities << " entities, " << inheritances
+    << " inheritances, " << friendships << " friendships, " << actions
+    << " build actions and " << edges << " file relations.";
+}
+
+void CppParser::evictFromCaches(const std::string& fileIds_)
+{
+  // The AST nodes and the edges of the files are deleted by cascade when the
+  // files are deleted.
+  typedef odb::query<model::CppAstNodeIds> AstQuery;
+  typedef odb::query<model::CppEdgeIdView> EdgeQuery;
+  typedef odb::query<model::CppEdgeAttributeIdView> EdgeAttrQuery;
+
+  const std::string edgesOfFiles
+    = "\"from\" IN (" + fileIds_ + ") OR \"to\" IN (" + fileIds_ + ')';
+
+  EntityCache& entityCache = VisitorActionFactory::entityCache();
+  for (const model::CppAstNodeIds& node : _ctx.db->query<model::CppAstNodeIds>(
+    AstQuery("\"location_file\" IN (" + fileIds_ + ')')))
+    entityCache.erase(node.id);
+
+  std::vector<model::CppEdgeId> edges;
+  for (const model::CppEdgeIdView& edge
+    : _ctx.db->query<model::CppEdgeIdView>(EdgeQuery(edgesOfFiles)))
+    edges.push_back(edge.id);
+
+  std::vector<model::CppEdgeAttributeId> attributes;
+  for (const model::CppEdgeAttributeIdView& attr
+    : _ctx.db->query<model::CppEdgeAttributeIdView>(EdgeAttrQuery(
+      "\"edge\" IN (SELECT \"id\" FROM \"CppEdge\" WHERE "
+      + edgesOfFiles + ')')))
+    attributes.push_back(attr.id);
+
+  RelationCollector::erase(edges, attributes);
+}
+
+bool CppParser::exclusive() const
+{
+  return _ctx.options.count("isolated-workers");
+}
+
+bool CppParser::incremental() const
+{
+  return true;
 }
 
 bool CppParser::parse()
 {
+  // In watch mode the caches are kept for the next incremental parse. The
+  // shared caches of the isolated workers can't erase elements, so they are
+  // always rebuilt.
+  bool keepCaches = _ctx.options.count("watch")
+    && !_ctx.options.count("isolated-workers");
+
+  migrateRelations();
   initBuildActions();
-  VisitorActionFactory::init(_ctx);
+
+  if (!_cachesLoaded)
+    VisitorActionFactory::init(_ctx);
 
   bool success = true;
 
@@ -689,38 +945,160 @@ bool CppParser::parse()
     : _ctx.options["input"].as<std::vector<std::string>>())
     if (boost::filesystem::is_regular_file(input))
       success
-        = success && parseByJson(input, _ctx.options["jobs"].as<int>());
+        = success && parseByJson(input, threadNum());
+
+  if (keepCaches)
+    _cachesLoaded = true;
+  else
+    VisitorActionFactory::cleanUp();
 
-  VisitorActionFactory::cleanUp();
   _parsedCommandHashes.clear();
+  _parsedSemanticHashes.clear();
+  _preprocessedHashes.clear();
+
+  saveFileGraph();
+  logMemoryStatistics();
 
   return success;
 }
 
-void CppParser::initBuildActions()
+void CppParser::migrateRelations()
 {
+  std::vector<model::CppRelation> relations;
+
+  bool migrate = util::OdbTransaction {_ctx.db} ([&] {
+    // The tables of the earlier versions, which generated the IDs, are
+    // recognized by their schema, so the relations are read only once.
+    bool generatedIds = false;
+
+#ifdef DATABASE_SQLITE
+    sqlite3* handle = static_cast<odb::sqlite::connection&>(
+      odb::transaction::current().connection()).handle();
+
+    sqlite3_stmt* statement;
+    if (sqlite3_prepare_v2(handle,
+          "SELECT 1 FROM sqlite_master "
+          "WHERE type = 'table' AND name = 'CppRelation' "
+          "AND sql LIKE '%AUTOINCREMENT%'",
+          -1, &statement, nullptr) != SQLITE_OK)
+      throw std::runtime_error(sqlite3_errmsg(handle));
+
+    generatedIds = sqlite3_step(statement) == SQLITE_ROW;
+    sqlite3_finalize(statement);
+#endif
+
+#ifdef DATABASE_PGSQL
+    // The generated IDs were stored in a serial INTEGER column, which can't
+    // hold the hash IDs.
+    generatedIds = _ctx.db->execute(
+      "SELECT 1 FROM information_schema.columns "
+      "WHERE table_schema = current_schema() "
+      "AND table_name = 'CppRelation' AND column_name = 'id' "
+      "AND data_type = 'integer'");
+
+    if (generatedIds)
+      _ctx.db->execute(
+        "ALTER TABLE \"CppRelation\" "
+        "ALTER COLUMN \"id\" DROP DEFAULT, "
+        "ALTER COLUMN \"id\" TYPE BIGINT");
+#endif
+
+    if (!generatedIds)
+      return false;
+
+    for (const model::CppRelation& rel : _ctx.db->query<model::CppRelation>())
+      relations.push_back(rel);
+
+#ifdef DATABASE_SQLITE
+    // The AUTOINCREMENT of a column can't be dropped, so the table is created
+    // again below. Its indexes are dropped with it.
+    _ctx.db->execute("DROP TABLE \"CppRelation\"");
+#else
+    _ctx.db->erase_query<model::CppRelation>();
+#endif
+
+    return true;
+  });
+
+  if (!migrate)
+    return;
+
+#ifdef DATABASE_SQLITE
+  // The table is created by the schema generated by ODB, as the current model
+  // describes it. The statements run on their own connection, so this can't
+  // be done in the transaction above.
+  util::createTablesFromFile(_ctx.db,
+    _ctx.compassRoot + "/share/codecompass/sql/cpprelation-odb.sql");
+#endif
+
+  std::unordered_set<model::CppRelationId> ids;
+
   util::OdbTransaction {_ctx.db} ([&] {
-    for (const model::BuildAction& ba : _ctx.db->query<model::BuildAction>())
-      _parsedCommandHashes.insert(util::fnvHash(ba.command));
+    for (model::CppRelation& rel : relations)
+    {
+      rel.id = model::createIdentifier(rel);
+
+      if (ids.insert(rel.id).second)
+        _ctx.db->persist(rel);
+    }
   });
+
+  LOG(info)
+    << "[cppparser] Migrated the C++ relations to hash IDs, dropped "
+    << relations.size() - ids.size() << " duplicates of "
+    << relations.size() << " relations.";
 }
 
-void CppParser::markByInclusion(model::FilePtr file_)
+void CppParser::logMemoryStatistics()
 {
-  auto inclusions = _ctx.db->query<model::CppHeaderInclusion>(
-    odb::query<model::CppHeaderInclusion>::included == file_->id);
-  
-  for (auto inc : inclusions)
-  {
-    model::FilePtr loaded = inc.includer.load();
-    if (!_ctx.fileStatus.count(loaded->path))
-    {
-      _ctx.fileStatus.emplace(loaded->path, IncrementalStatus::MODIFIED);
-      LOG(debug) << "[cppparser] File modified: " << loaded->path;
+  const double mib = 1024.0 * 1024.0;
 
-      markByInclusion(loaded);
-    }
-  }
+  std::uint64_t peakBytes;
+  util::Arena::Statistics arenas = util::Arena::totals(peakBytes);
+
+  // The arenas of the isolated workers are released in the worker processes,
+  // so only their resident memory is known here.
+  if (arenas.allocations)
+    LOG(info)
+      << "[cppparser] Model arenas: " << arenas.allocations
+      << " allocations, " << std::fixed << std::setprecision(1)
+      << arenas.bytes / mib << " MiB in " << arenas.blocks
+      << " blocks, at most " << peakBytes / mib << " MiB per arena.";
+
+  // The maximum resident set size is given in KiB on Linux.
+  rusage self, children;
+  ::getrusage(RUSAGE_SELF, &self);
+  ::getrusage(RUSAGE_CHILDREN, &children);
+
+  LOG(info)
+    << "[cppparser] Peak resident memory: " << std::fixed
+    << std::setprecision(1) << self.ru_maxrss / 1024.0 << " MiB"
+    << (children.ru_maxrss
+      ? ", " + std::to_string(children.ru_maxrss / 1024)
+        + " MiB in the worker processes."
+      : ".");
+}
+
+void CppParser::saveFileGraph()
+{
+  std::unique_ptr<util::CsrGraph> graph;
+
+  util::OdbTransaction {_ctx.db} ([&] {
+    graph = createFileGraph(*_ctx.db);
+  });
+
+  if (graph->save(_fileGraphPath))
+    LOG(info)
+      << "[cppparser] File graph saved (" << graph->nodeCount() << " files, "
+      << graph->edgeCount() << " edges).";
+}
+
+void CppParser::initBuildActions()
+{
+  util::OdbTransaction {_ctx.db} ([&] {
+    for (const model::BuildAction& ba : _ctx.db->query<model::BuildAction>())
+      _parsedCommandHashes.insert(util::fnvHash(ba.command));
+  });
 }
 
 bool CppParser::parseByJson(
@@ -729,58 +1107,52 @@ bool CppParser::parseByJson(
 {
   std::string errorMsg;
 
-  std::unique_ptr<clang::tooling::JSONCompilationDatabase> compDb
-    = clang::tooling::JSONCompilationDatabase::loadFromFile(
-        jsonFile_, errorMsg,
-        clang::tooling::JSONCommandLineSyntax::Gnu);
+  std::shared_ptr<const CompilationDatabase> compDb
+    = _ctx.compilationDatabase(jsonFile_, errorMsg);
 
-  if (!errorMsg.empty())
+  if (!compDb)
   {
     LOG(error) << errorMsg;
     return false;
   }
 
-  //--- Read the compilation commands compile database ---//
+  std::size_t numCompileCommands = compDb->size();
 
-  std::vector<clang::tooling::CompileCommand> compileCommands =
-    compDb->getAllCompileCommands();
-  std::size_t numCompileCommands = compileCommands.size();
+  // Only the commands which are parsed or recorded are built. The jobs refer
+  // to them, so they are stored in a deque whose elements are not moved.
+  std::deque<clang::tooling::CompileCommand> compileCommands;
 
-  //--- Create a thread pool for the current commands ---//
-  std::unique_ptr<
-    util::JobQueueThreadPool<ParseJob>> pool =
-    util::make_thread_pool<ParseJob>(
-      threadNum_, [this, &numCompileCommands](ParseJob& job_)
-      {
-        const clang::tooling::CompileCommand& command = job_.command;
+  //--- Collect the commands which are not parsed yet ---//
 
-        LOG(info)
-          << '(' << job_.index << '/' << numCompileCommands << ')'
-          << " Parsing " << command.Filename;
+  std::vector<ParseJob> jobs;
+  std::size_t index = 0;
 
-        int error = this->parseWorker(command);
+  // Commands producing the same AST as an already parsed one. These are
+  // only recorded as build actions.
+  std::vector<const clang::tooling::CompileCommand*> duplicates;
 
-        if (error)
-          LOG(warning)
-            << '(' << job_.index << '/' << numCompileCommands << ')'
-            << " Parsing " << command.Filename << " has been failed.";
-      });
+  // Compile commands of the source files belonging to other parser
+  // processes (see --shard).
+  std::size_t otherShards = 0;
 
-  //--- Push all commands into the thread pool's queue ---//
-  std::size_t index = 0;
-
-  for (const auto& command : compileCommands)
+  for (std::size_t i = 0; i < numCompileCommands; ++i)
   {
-    ParseJob job(command, ++index);
+    ++index;
 
-    auto hash = util::fnvHash(
-      boost::algorithm::join(command.CommandLine, " "));
+    if (!_ctx.inShard(boost::filesystem::absolute(
+          compDb->filename(i), compDb->directory(i)).string()))
+    {
+      ++otherShards;
+      continue;
+    }
+
+    auto hash = compDb->commandHash(i);
 
     if (_parsedCommandHashes.find(hash) != _parsedCommandHashes.end())
     {
       LOG(info)
         << '(' << index << '/' << numCompileCommands << ')'
-        << " Already parsed " << command.Filename;
+        << " Already parsed " << compDb->filename(i);
 
       continue;
     }
@@ -789,17 +1161,386 @@ bool CppParser::parseByJson(
 
     _parsedCommandHashes.insert(hash);
 
-    //--- Push the job ---//
+    CompilationDatabase::Command dbCommand = compDb->command(i);
+    compileCommands.emplace_back(
+      dbCommand.directory, dbCommand.filename,
+      std::move(dbCommand.commandLine), dbCommand.output);
+    const clang::tooling::CompileCommand& command = compileCommands.back();
 
-    pool->enqueue(job);
+    if (!_parsedSemanticHashes.insert(semanticCommandHash(command)).second)
+    {
+      LOG(info)
+        << '(' << index << '/' << numCompileCommands << ')'
+        << " Already parsed with equivalent flags " << command.Filename;
+
+      duplicates.push_back(&command);
+      continue;
+    }
+
+    jobs.emplace_back(command, index);
+  }
+
+  if (otherShards)
+    LOG(info)
+      << "[cppparser] " << otherShards << " of " << numCompileCommands
+      << " compile commands belong to other shards than " << _ctx.shardIndex
+      << '/' << _ctx.shardCount << '.';
+
+  //--- Find the sources compiled by several commands ---//
+
+  // These are preprocessed first if the preprocessed token streams are
+  // compared.
+  bool dedupPreprocessed = _ctx.options.count("dedup-preprocessed");
+  std::unordered_set<std::string> repeatedSources;
+
+  if (dedupPreprocessed)
+  {
+    std::unordered_set<std::string> sources;
+
+    for (const ParseJob& job : jobs)
+    {
+      const clang::tooling::CompileCommand& command = job.command;
+      std::string source = boost::filesystem::absolute(
+        command.Filename, command.Directory).string();
+
+      if (!sources.insert(source).second)
+        repeatedSources.insert(source);
+    }
   }
 
-  // Block execution until every job is finished.
-  pool->wait();
+  //--- Build the shared preambles ---//
+
+  PreambleGroups preambles(
+    _ctx.options["workspace"].as<std::string>() + '/' +
+    _ctx.options["name"].as<std::string>() + "/preambles");
+
+  if (!_ctx.options.count("skip-preamble"))
+  {
+    std::vector<const clang::tooling::CompileCommand*> commands;
+    for (const ParseJob& job : jobs)
+      commands.push_back(&job.command.get());
+
+    preambles.plan(commands);
+
+    std::unique_ptr<util::JobQueueThreadPool<PreambleGroup*>> preamblePool =
+      util::make_thread_pool<PreambleGroup*>(
+        threadNum_, [this](PreambleGroup* group_)
+        {
+          auto start = std::chrono::steady_clock::now();
+
+          group_->built = this->buildPreamble(*group_);
+          group_->buildTime
+            = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+
+          if (!group_->built)
+            LOG(warning)
+              << "[cppparser] Building the precompiled preamble of "
+              << group_->directory << " has been failed.";
+        });
+
+    for (const std::unique_ptr<PreambleGroup>& group : preambles.groups())
+      preamblePool->enqueue(group.get());
+
+    preamblePool->wait();
+  }
+
+  //--- Parse the translation units ---//
+
+  bool isolated = _ctx.options.count("isolated-workers");
+
+  // The worker processes compare the preprocessed hashes in shared memory.
+  std::unique_ptr<util::SharedHashMap> sharedPreprocessedHashes;
+  if (isolated && dedupPreprocessed)
+    sharedPreprocessedHashes.reset(new util::SharedHashMap(jobs.size()));
+
+  // Returns the error code of parseWorker() or PARSE_DUPLICATE.
+  auto parseJob = [&, this](const ParseJob& job_)
+  {
+    const clang::tooling::CompileCommand& command = job_.command;
+
+    std::uint64_t ppHash;
+    bool claimed = false;
+
+    if (repeatedSources.count(boost::filesystem::absolute(
+          command.Filename, command.Directory).string()) &&
+        this->preprocessedHash(command, ppHash))
+    {
+      bool isNew;
+
+      // The hash is claimed until the translation unit is parsed, so that a
+      // crashed worker's claim is taken over by the retry.
+      if (sharedPreprocessedHashes)
+        switch (sharedPreprocessedHashes->insert(ppHash, 0))
+        {
+          case util::SharedHashMap::Insertion::INSERTED:
+            isNew = claimed = true;
+            break;
+          case util::SharedHashMap::Insertion::FOUND:
+            isNew = false;
+            break;
+          case util::SharedHashMap::Insertion::FULL:
+            isNew = true;
+            break;
+        }
+      else
+      {
+        std::lock_guard<std::mutex> lock(_preprocessedHashesMutex);
+        isNew = _preprocessedHashes.insert(ppHash).second;
+      }
+
+      if (!isNew)
+        return PARSE_DUPLICATE;
+    }
+
+    LOG(info)
+      << '(' << job_.index << '/' << numCompileCommands << ')'
+      << " Parsing " << command.Filename;
+
+    PreambleGroup* group = preambles.find(command);
+    bool usePreamble
+      = group && PreambleGroups::usesPreamble(*group, command);
+
+    int error = this->parseWorker(command, usePreamble ? group : nullptr);
+
+    if (claimed)
+      sharedPreprocessedHashes->publish(ppHash);
+
+    return error;
+  };
+
+  // Records the result of a job. The worker processes send their results to
+  // this process, so it is called here in both modes.
+  std::mutex duplicatesMutex;
+
+  auto finishJob = [&](
+    const ParseJob& job_,
+    int error_,
+    std::uint64_t durationMs_)
+  {
+    const clang::tooling::CompileCommand& command = job_.command;
+
+    if (error_ == PARSE_DUPLICATE)
+    {
+      LOG(info)
+        << '(' << job_.index << '/' << numCompileCommands << ')'
+        << " Already parsed with the same preprocessed content "
+        << command.Filename;
+
+      std::lock_guard<std::mutex> lock(duplicatesMutex);
+      duplicates.push_back(&command);
+      return;
+    }
+
+    PreambleGroup* group = preambles.find(command);
+
+    if (group && PreambleGroups::usesPreamble(*group, command))
+    {
+      group->preambleMs += durationMs_;
+      ++group->preambleUnits;
+    }
+    else if (group)
+      group->baselineMs = durationMs_;
+
+    if (error_)
+      LOG(warning)
+        << '(' << job_.index << '/' << numCompileCommands << ')'
+        << " Parsing " << command.Filename << " has been failed.";
+  };
+
+  if (isolated)
+    parseInWorkers(jobs, threadNum_, parseJob, finishJob);
+  else
+  {
+    //--- Create a thread pool for the current commands ---//
+    std::unique_ptr<
+      util::JobQueueThreadPool<ParseJob>> pool =
+      util::make_thread_pool<ParseJob>(
+        threadNum_, [&](ParseJob& job_)
+        {
+          auto start = std::chrono::steady_clock::now();
+
+          int error = parseJob(job_);
+
+          finishJob(job_, error,
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - start).count());
+        });
+
+    //--- Push all commands into the thread pool's queue ---//
+
+    for (const ParseJob& job : jobs)
+      pool->enqueue(job);
+
+    // Block execution until every job is finished.
+    pool->wait();
+  }
+
+  preambles.report();
+
+  //--- Record the duplicate commands ---//
+
+  for (const clang::tooling::CompileCommand* command : duplicates)
+    addCompileCommand(*command, addBuildAction(*command), false, true);
+
+  if (!duplicates.empty())
+    LOG(info)
+      << "[cppparser] " << duplicates.size() << " compile commands were "
+      << "recorded without parsing, since their translation units had been "
+      << "parsed by other commands.";
 
   return true;
 }
 
+void CppParser::parseInWorkers(
+  const std::vector<ParseJob>& jobs_,
+  std::size_t workerNum_,
+  const std::function<int(const ParseJob&)>& parseJob_,
+  const std::function<void(const ParseJob&, int, std::uint64_t)>& finishJob_)
+{
+  std::size_t recycleCount = std::max<std::size_t>(
+    _ctx.options["worker-recycle-count"].as<std::size_t>(), 1);
+  std::size_t rssLimit
+    = _ctx.options["worker-rss-limit"].as<std::size_t>() * 1024 * 1024;
+  std::size_t cacheCapacity
+    = _ctx.options["worker-cache-capacity"].as<std::size_t>();
+
+  //--- Share the caches of the persisted objects with the workers ---//
+
+  _ctx.srcMgr.persistFiles();
+  _ctx.srcMgr.share(cacheCapacity);
+  VisitorActionFactory::entityCache().share(cacheCapacity);
+  VisitorActionFactory::relationCache().share(cacheCapacity);
+  RelationCollector::share(_ctx, cacheCapacity);
+
+  // Writing to a crashed worker would kill this process otherwise.
+  ::signal(SIGPIPE, SIG_IGN);
+
+  std::shared_ptr<odb::database> parentDb = _ctx.db;
+
+  std::function<bool()> init = [this, parentDb]
+  {
+    // The connection of the parent is still referenced by parentDb, so its
+    // destructor doesn't close the socket shared with the parent.
+    _ctx.db = util::connectDatabase(
+      _ctx.options["database"].as<std::string>(), false);
+
+    if (!_ctx.db)
+    {
+      LOG(error) << "[cppparser] Worker failed to connect to the database.";
+      return false;
+    }
+
+    _ctx.srcMgr.setDatabase(_ctx.db);
+    return true;
+  };
+
+  std::function<int(std::size_t)> handler = [&](std::size_t index_)
+  {
+    return parseJob_(jobs_[index_]);
+  };
+
+  //--- Send the jobs to the workers ---//
+
+  struct Worker
+  {
+    std::unique_ptr<ParseWorkerProcess> process;
+    std::size_t job = NO_JOB;
+  };
+
+  std::vector<Worker> workers(std::max<std::size_t>(workerNum_, 1));
+  std::vector<unsigned char> crashes(jobs_.size(), 0);
+  std::deque<std::size_t> queue;
+
+  for (std::size_t i = 0; i < jobs_.size(); ++i)
+    queue.push_back(i);
+
+  while (true)
+  {
+    for (Worker& worker : workers)
+      while (worker.job == NO_JOB && !queue.empty())
+      {
+        if (!worker.process)
+          worker.process.reset(new ParseWorkerProcess(
+            init, handler, recycleCount, rssLimit));
+
+        if (worker.process->send(queue.front()))
+        {
+          worker.job = queue.front();
+          queue.pop_front();
+        }
+        else
+          worker.process.reset();
+      }
+
+    std::vector<pollfd> fds;
+    std::vector<Worker*> busy;
+
+    for (Worker& worker : workers)
+      if (worker.job != NO_JOB)
+      {
+        fds.push_back({worker.process->resultFd(), POLLIN, 0});
+        busy.push_back(&worker);
+      }
+
+    if (busy.empty())
+      break;
+
+    if (::poll(fds.data(), fds.size(), -1) < 0)
+      continue;
+
+    for (std::size_t i = 0; i < busy.size(); ++i)
+    {
+      if (!fds[i].revents)
+        continue;
+
+      Worker& worker = *busy[i];
+      const ParseJob& job = jobs_[worker.job];
+
+      ParseWorkerProcess::Result result;
+
+      if (worker.process->receive(result))
+      {
+        finishJob_(job, result.status, result.durationMs);
+
+        worker.job = NO_JOB;
+        if (result.retire)
+          worker.process.reset();
+
+        continue;
+      }
+
+      //--- The worker has crashed ---//
+
+      std::string exitStatus = worker.process->exitStatus();
+      worker.process.reset();
+
+      if (++crashes[worker.job] < 2)
+      {
+        LOG(warning)
+          << "[cppparser] Worker " << exitStatus << " while parsing "
+          << job.command.get().Filename << ", retrying it.";
+
+        queue.push_front(worker.job);
+      }
+      else
+      {
+        LOG(error)
+          << "[cppparser] Worker " << exitStatus << " again while parsing "
+          << job.command.get().Filename << ", it is skipped.";
+
+        addCompileCommand(job.command, addBuildAction(job.command), true);
+      }
+
+      worker.job = NO_JOB;
+    }
+  }
+
+  workers.clear();
+
+  _ctx.srcMgr.unshare();
+}
+
 CppParser::~CppParser()
 {
 }
@@ -814,7 +1555,39 @@ extern "C"
     description.add_options()
       ("skip-doccomment",
        "If this flag is given the parser will skip parsing the documentation "
-       "comments.");
+       "comments.")
+      ("dedup-preprocessed",
+       "If this flag is given then the translation units of source files "
+       "compiled by several commands are preprocessed first, and the ones "
+       "whose preprocessed token stream equals an already parsed one are not "
+       "parsed again.")
+      ("skip-preamble",
+       "If this flag is given the parser will not build precompiled headers "
+       "from the common first includes of the translation units compiled "
+       "with the same flags in the same directory.")
+      ("isolated-workers",
+       "If this flag is given then the translation units are parsed in "
+       "forked worker processes instead of threads, so a crash of the "
+       "compiler front-end loses only one translation unit. A translation "
+       "unit whose worker crashes is retried once, then it is skipped. "
+       "PostgreSQL is recommended in this mode, since SQLite serializes the "
+       "writers of the workers.")
+      ("worker-recycle-count",
+       po::value<std::size_t>()->default_value(100),
+       "A worker process is replaced by a new one after parsing this many "
+       "translation units (see --isolated-workers).")
+      ("worker-rss-limit",
+       po::value<std::size_t>()->default_value(0),
+       "Recycle threshold of the worker processes in MiB: a worker is "
+       "replaced by a new one if its resident memory exceeds this value "
+       "after a translation unit. This is not a hard cap, a single "
+       "translation unit may take more memory. 0 means no threshold (see "
+       "--isolated-workers).")
+      ("worker-cache-capacity",
+       po::value<std::size_t>()->default_value(1 << 25),
+       "Maximal number of the elements of each cache shared by the worker "
+       "processes, e.g. the AST nodes and the files. The memory of the "
+       "caches is only allocated when it is used (see --isolated-workers).");
     return description;
   }
 
@@ -49,6 +49,8 @@ void DiagnosticMessageHandler::HandleDiagnostic(
 
   //--- Message location ---//
 
+  std::string path;
+
   if (info_.getLocation().isValid() && info_.hasSourceManager())
   {
     FileLocUtil fileLocUtil(info_.getSourceManager());
@@ -57,13 +59,46 @@ void DiagnosticMessageHandler::HandleDiagnostic(
     model::Range fileLoc;
     fileLocUtil.setRange(loc, loc, fileLoc);
 
+    path = fileLocUtil.getFilePath(loc);
+
     buildLog.location.range = fileLoc;
-    buildLog.location.file = _srcMgr.getFile(fileLocUtil.getFilePath(loc));
+    buildLog.location.file = _srcMgr.getFile(path);
+  }
+
+  //--- Errors of a precompiled header ---//
+
+  if (diagLevel_ >= clang::DiagnosticsEngine::Error)
+  {
+    unsigned id = info_.getID();
+
+    if (id >= clang::diag::DIAG_START_SERIALIZATION &&
+        id < clang::diag::DIAG_START_LEX)
+      _serializationError = true;
+    else if (!path.empty())
+      _errorFiles.insert(path);
   }
 
   _messages.push_back(buildLog);
 }
 
+void DiagnosticMessageHandler::discard()
+{
+  _messages.clear();
+}
+
+bool DiagnosticMessageHandler::hasPreambleError(
+  const std::unordered_set<std::string>& headers_) const
+{
+  if (_serializationError)
+    return true;
+
+  for (const std::string& path : _errorFiles)
+    if (headers_.count(path))
+      return true;
+
+  return false;
+}
+
 DiagnosticMessageHandler::~DiagnosticMessageHandler()
 {
   util::OdbTransaction{_db}([this](){
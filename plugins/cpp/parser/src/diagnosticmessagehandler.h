@@ -1,6 +1,8 @@
 #ifndef CC_PARSER_DIAGNOSTICMESSAGEHANDLER_H
 #define CC_PARSER_DIAGNOSTICMESSAGEHANDLER_H
 
+#include <string>
+#include <unordered_set>
 #include <vector>
 #include <clang/Basic/Diagnostic.h>
 #include <clang/Frontend/TextDiagnosticPrinter.h>
@@ -25,9 +27,23 @@ public:
     clang::DiagnosticsEngine::Level diagLevel_,
     const clang::Diagnostic& info_) override;
 
+  /**
+   * Drops the collected messages, so that they are not stored.
+   */
+  void discard();
+
+  /**
+   * Returns true if an error may be caused by a precompiled header: it was
+   * reported on loading the precompiled header, or it is in one of the given
+   * headers compiled into it.
+   */
+  bool hasPreambleError(const std::unordered_set<std::string>& headers_) const;
+
 private:
   SourceManager& _srcMgr;
   std::vector<model::BuildLog> _messages;
+  std::unordered_set<std::string> _errorFiles;
+  bool _serializationError = false;
   std::shared_ptr<odb::database> _db;
 };
 
@@ -1,3 +1,5 @@
+#include <algorithm>
+
 #include "entitycache.h"
 
 namespace cc
@@ -7,6 +9,14 @@ namespace parser
 
 bool EntityCache::insert(const model::CppAstNode& node_)
 {
+  if (_sharedCache)
+    switch (_sharedCache->insert(node_.id, node_.entityHash))
+    {
+      case util::SharedHashMap::Insertion::INSERTED: return true;
+      case util::SharedHashMap::Insertion::FOUND: return false;
+      case util::SharedHashMap::Insertion::FULL: break;
+    }
+
   std::lock_guard<std::mutex> guard(_cacheMutex);
   return _entityCache.insert(
     std::make_pair(node_.id, node_.entityHash)).second;
@@ -14,13 +24,56 @@ bool EntityCache::insert(const model::CppAstNode& node_)
 
 std::uint64_t EntityCache::at(const model::CppAstNodeId& id_) const
 {
+  std::uint64_t entityHash;
+  if (_sharedCache && _sharedCache->find(id_, entityHash))
+    return entityHash;
+
   std::lock_guard<std::mutex> guard(_cacheMutex);
   return _entityCache.at(id_);
 }
 
+void EntityCache::publish(const model::CppAstNodeId& id_)
+{
+  if (_sharedCache)
+    _sharedCache->publish(id_);
+}
+
+void EntityCache::release(const model::CppAstNodeId& id_)
+{
+  if (_sharedCache)
+    _sharedCache->release(id_);
+
+  std::lock_guard<std::mutex> guard(_cacheMutex);
+  _entityCache.erase(id_);
+}
+
+void EntityCache::erase(const model::CppAstNodeId& id_)
+{
+  std::lock_guard<std::mutex> guard(_cacheMutex);
+  _entityCache.erase(id_);
+}
+
 void EntityCache::clear()
 {
   _entityCache.clear();
+  _sharedCache.reset();
+}
+
+void EntityCache::share(std::size_t capacity_)
+{
+  if (_sharedCache)
+    return;
+
+  _sharedCache.reset(new util::SharedHashMap(
+    std::max(capacity_, 2 * _entityCache.size())));
+
+  for (const auto& entity : _entityCache)
+  {
+    _sharedCache->insert(entity.first, entity.second);
+    _sharedCache->publish(entity.first);
+  }
+
+  _entityCache.clear();
 }
 
 }
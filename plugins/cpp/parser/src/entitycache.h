@@ -1,11 +1,14 @@
 #ifndef CC_PARSER_ENTITYCACHE_H
 #define CC_PARSER_ENTITYCACHE_H
 
+#include <memory>
 #include <unordered_map>
 #include <mutex>
 
 #include <model/cppastnode.h>
 
+#include <util/sharedhashmap.h>
+
 namespace cc
 {
 namespace parser
@@ -25,6 +28,18 @@ public:
    */
   bool insert(const model::CppAstNode& node_);
 
+  /**
+   * Marks an inserted element as persisted. A shared cache keeps the element
+   * claimed by this process until then, see util::SharedHashMap.
+   */
+  void publish(const model::CppAstNodeId& id_);
+
+  /**
+   * Removes an inserted element which couldn't be persisted, so that the
+   * next insertion of it succeeds.
+   */
+  void release(const model::CppAstNodeId& id_);
+
   /**
    * Returns a reference to the mapped value of the element with key equivalent
    * to id_. If no such element exists, an exception of type
@@ -33,12 +48,30 @@ public:
   std::uint64_t at(const model::CppAstNodeId& id_) const;
 
   /**
-   * Removes all elements from the cache.
+   * Removes the element from a private cache, e.g. when the AST node is
+   * deleted by the incremental parsing. The shared cache has no erase.
+   */
+  void erase(const model::CppAstNodeId& id_);
+
+  /**
+   * Removes all elements from the cache. A shared cache becomes private
+   * again.
    */
   void clear();
 
+  /**
+   * Moves the elements into shared memory, so that the processes forked
+   * afterwards use the same cache. This function must be called before
+   * forking, when no other thread uses the cache. When the shared cache is
+   * full, the further elements go into the private cache of the process.
+   * @param capacity_ Maximal number of the elements. It is raised to twice
+   * the current size if that is more.
+   */
+  void share(std::size_t capacity_);
+
 private:
   std::unordered_map<model::CppAstNodeId, std::uint64_t> _entityCache;
+  std::unique_ptr<util::SharedHashMap> _sharedCache;
   mutable std::mutex _cacheMutex;
 };
 
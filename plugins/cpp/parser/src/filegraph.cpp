@@ -0,0 +1,33 @@
+#include <vector>
+
+#include <model/cppedge.h>
+#include <model/cppedge-odb.hxx>
+#include <model/cppfilegraph.h>
+#include <model/cppheaderinclusion.h>
+#include <model/cppheaderinclusion-odb.hxx>
+
+#include "filegraph.h"
+
+namespace cc
+{
+namespace parser
+{
+
+std::unique_ptr<util::CsrGraph> createFileGraph(odb::database& db_)
+{
+  std::vector<util::CsrGraph::Edge> edges;
+
+  for (const model::CppHeaderInclusionIdView& inc
+    : db_.query<model::CppHeaderInclusionIdView>())
+    edges.push_back({inc.includer, inc.included, model::FG_INCLUDE});
+
+  for (const model::CppEdgeIdView& edge
+    : db_.query<model::CppEdgeIdView>())
+    edges.push_back({
+      edge.from, edge.to, model::fileGraphEdgeKind(edge.type)});
+
+  return std::unique_ptr<util::CsrGraph>(new util::CsrGraph(std::move(edges)));
+}
+
+} // parser
+} // cc
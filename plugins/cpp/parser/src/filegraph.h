@@ -0,0 +1,25 @@
+#ifndef CC_PARSER_FILEGRAPH_H
+#define CC_PARSER_FILEGRAPH_H
+
+#include <memory>
+
+#include <odb/database.hxx>
+
+#include <util/csrgraph.h>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Builds the file graph from the header inclusions and the CppEdges of the
+ * database, reading each table by one query. The kinds of the edges are
+ * model::CppFileGraphEdge values. It must be called in a transaction.
+ */
+std::unique_ptr<util::CsrGraph> createFileGraph(odb::database& db_);
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_FILEGRAPH_H
@@ -0,0 +1,63 @@
+#include <algorithm>
+
+#include "idcache.h"
+
+namespace cc
+{
+namespace parser
+{
+
+bool IdCache::insert(std::uint64_t id_)
+{
+  if (_sharedIds)
+    switch (_sharedIds->insert(id_, 0))
+    {
+      case util::SharedHashMap::Insertion::INSERTED: return true;
+      case util::SharedHashMap::Insertion::FOUND: return false;
+      case util::SharedHashMap::Insertion::FULL: break;
+    }
+
+  std::lock_guard<std::mutex> guard(_cacheMutex);
+  return _ids.insert(id_).second;
+}
+
+void IdCache::publish(std::uint64_t id_)
+{
+  if (_sharedIds)
+    _sharedIds->publish(id_);
+}
+
+void IdCache::release(std::uint64_t id_)
+{
+  if (_sharedIds)
+    _sharedIds->release(id_);
+
+  std::lock_guard<std::mutex> guard(_cacheMutex);
+  _ids.erase(id_);
+}
+
+void IdCache::clear()
+{
+  _ids.clear();
+  _sharedIds.reset();
+}
+
+void IdCache::share(std::size_t capacity_)
+{
+  if (_sharedIds)
+    return;
+
+  _sharedIds.reset(new util::SharedHashMap(
+    std::max(capacity_, 2 * _ids.size())));
+
+  for (std::uint64_t id : _ids)
+  {
+    _sharedIds->insert(id, 0);
+    _sharedIds->publish(id);
+  }
+
+  _ids.clear();
+}
+
+} // parser
+} // cc
@@ -0,0 +1,68 @@
+#ifndef CC_PARSER_IDCACHE_H
+#define CC_PARSER_IDCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+
+#include <util/sharedhashmap.h>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Thread safe set of the IDs of the persisted objects, e.g. the content hash
+ * IDs of model::CppRelation. It tells the parser threads and the isolated
+ * worker processes which objects are already stored.
+ */
+class IdCache
+{
+public:
+  /**
+   * This function inserts an ID to the cache in a thread-safe way.
+   * @return If the insertion was successful (i.e. the cache didn't contain the
+   * id before) then the function returns true.
+   */
+  bool insert(std::uint64_t id_);
+
+  /**
+   * Marks an inserted ID as persisted. A shared cache keeps the ID claimed by
+   * this process until then, see util::SharedHashMap.
+   */
+  void publish(std::uint64_t id_);
+
+  /**
+   * Removes an inserted ID whose object couldn't be persisted, so that the
+   * next insertion of it succeeds.
+   */
+  void release(std::uint64_t id_);
+
+  /**
+   * Removes all elements from the cache. A shared cache becomes private
+   * again.
+   */
+  void clear();
+
+  /**
+   * Moves the elements into shared memory, so that the processes forked
+   * afterwards use the same cache. This function must be called before
+   * forking, when no other thread uses the cache. When the shared cache is
+   * full, the further IDs go into the private cache of the process.
+   * @param capacity_ Maximal number of the elements. It is raised to twice
+   * the current size if that is more.
+   */
+  void share(std::size_t capacity_);
+
+private:
+  std::unordered_set<std::uint64_t> _ids;
+  std::unique_ptr<util::SharedHashMap> _sharedIds;
+  std::mutex _cacheMutex;
+};
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_IDCACHE_H
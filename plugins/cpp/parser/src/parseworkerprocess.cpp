@@ -0,0 +1,213 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "parseworkerprocess.h"
+
+namespace
+{
+
+/**
+ * Parent ends of the pipes of the running workers. A new worker closes them,
+ * otherwise the pipes of a crashed worker wouldn't be closed while the
+ * workers forked after it are running. Workers are created by one thread.
+ */
+std::vector<int>& parentFds()
+{
+  static std::vector<int> fds;
+  return fds;
+}
+
+void unregisterFd(int fd_)
+{
+  std::vector<int>& fds = parentFds();
+  for (std::size_t i = 0; i < fds.size(); ++i)
+    if (fds[i] == fd_)
+    {
+      fds[i] = fds.back();
+      fds.pop_back();
+      return;
+    }
+}
+
+bool readAll(int fd_, void* data_, std::size_t size_)
+{
+  char* data = static_cast<char*>(data_);
+
+  while (size_)
+  {
+    ssize_t n = ::read(fd_, data, size_);
+
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+
+    data += n;
+    size_ -= n;
+  }
+
+  return true;
+}
+
+bool writeAll(int fd_, const void* data_, std::size_t size_)
+{
+  const char* data = static_cast<const char*>(data_);
+
+  while (size_)
+  {
+    ssize_t n = ::write(fd_, data, size_);
+
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return false;
+
+    data += n;
+    size_ -= n;
+  }
+
+  return true;
+}
+
+} // namespace
+
+namespace cc
+{
+namespace parser
+{
+
+ParseWorkerProcess::ParseWorkerProcess(
+  const std::function<bool()>& init_,
+  const std::function<int(std::size_t)>& handler_,
+  std::size_t maxJobs_,
+  std::size_t maxRss_)
+  : _resultFd{0, 0}
+{
+  openPipe(_resultFd[0], _resultFd[1]);
+
+  // Buffered output would be written by both processes.
+  std::cout.flush();
+  std::clog.flush();
+  std::fflush(nullptr);
+
+  if (startProcess() == 0)
+  {
+    // This is the child process.
+    for (int fd : parentFds())
+      ::close(fd);
+
+    ::close(_pipeFd[1]);
+    ::close(_resultFd[0]);
+
+    runWorker(init_, handler_, maxJobs_, maxRss_);
+  }
+
+  ::close(_pipeFd[0]);
+  _pipeFd[0] = 0;
+  ::close(_resultFd[1]);
+  _resultFd[1] = 0;
+
+  parentFds().push_back(_pipeFd[1]);
+  parentFds().push_back(_resultFd[0]);
+}
+
+ParseWorkerProcess::~ParseWorkerProcess()
+{
+  // The worker exits when it reads the end of the job pipe, which is closed
+  // by the destructor of PipedProcess before waiting for the worker.
+  unregisterFd(_pipeFd[1]);
+  unregisterFd(_resultFd[0]);
+  closePipe(_resultFd[0], _resultFd[1]);
+}
+
+bool ParseWorkerProcess::send(std::size_t index_)
+{
+  std::uint64_t index = index_;
+  return writeAll(_pipeFd[1], &index, sizeof(index));
+}
+
+bool ParseWorkerProcess::receive(Result& result_)
+{
+  return readAll(_resultFd[0], &result_, sizeof(result_));
+}
+
+std::string ParseWorkerProcess::exitStatus()
+{
+  try
+  {
+    refreshExitStatus(true);
+  }
+  catch (const Failure&)
+  {
+    return "lost";
+  }
+
+  if (WIFSIGNALED(_childExitStatus))
+    return "killed by signal " + std::to_string(WTERMSIG(_childExitStatus))
+      + " (" + ::strsignal(WTERMSIG(_childExitStatus)) + ")";
+
+  if (WIFEXITED(_childExitStatus))
+    return "exited with status "
+      + std::to_string(WEXITSTATUS(_childExitStatus));
+
+  return "stopped";
+}
+
+void ParseWorkerProcess::runWorker(
+  const std::function<bool()>& init_,
+  const std::function<int(std::size_t)>& handler_,
+  std::size_t maxJobs_,
+  std::size_t maxRss_)
+{
+  // The worker exits by _exit(), so that the destructors of the objects
+  // copied from the parent, e.g. its database connection, are not run.
+  if (!init_())
+    ::_exit(1);
+
+  for (std::size_t jobs = 1; ; ++jobs)
+  {
+    std::uint64_t index;
+    if (!readAll(_pipeFd[0], &index, sizeof(index)))
+      break;
+
+    auto start = std::chrono::steady_clock::now();
+
+    Result result{};
+    result.index = index;
+    result.status = handler_(index);
+    result.durationMs
+      = std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start).count();
+    result.retire
+      = jobs >= maxJobs_ || (maxRss_ && residentMemory() > maxRss_);
+
+    if (!writeAll(_resultFd[1], &result, sizeof(result)) || result.retire)
+      break;
+  }
+
+  std::cout.flush();
+  std::clog.flush();
+  std::fflush(nullptr);
+  ::_exit(0);
+}
+
+std::size_t ParseWorkerProcess::residentMemory()
+{
+  std::ifstream statm("/proc/self/statm");
+
+  std::size_t size = 0, resident = 0;
+  statm >> size >> resident;
+
+  return resident * ::sysconf(_SC_PAGESIZE);
+}
+
+} // parser
+} // cc
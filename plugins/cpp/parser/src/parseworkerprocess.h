@@ -0,0 +1,109 @@
+#ifndef CC_PARSER_PARSEWORKERPROCESS_H
+#define CC_PARSER_PARSEWORKERPROCESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <util/pipedprocess.h>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Forked process parsing translation units for the parser process. The
+ * parent sends the index of a job through a pipe, and the worker answers with
+ * the status of the job through another one. If the worker crashes, then the
+ * parent reads the end of the pipe instead of the answer.
+ *
+ * A worker exits after a number of jobs or when its memory usage exceeds a
+ * threshold, so that the memory fragmented by the parsing is given back to
+ * the system. The memory is checked between the jobs only, so the threshold
+ * is not a cap: a single job may use more. The last answer of the worker
+ * tells the parent that it retires.
+ */
+class ParseWorkerProcess : public util::PipedProcess
+{
+public:
+  /**
+   * Answer of the worker for a job.
+   */
+  struct Result
+  {
+    std::uint64_t index;
+    std::uint64_t durationMs; /*!< Wall time of the job. */
+    std::int32_t status; /*!< Return value of the job handler. */
+    bool retire; /*!< The worker exits after sending this result. */
+  };
+
+  /**
+   * Forks the worker.
+   * @param init_ Called first in the worker. If it returns false, then the
+   * worker exits.
+   * @param handler_ Called in the worker with the index of each job.
+   * @param maxJobs_ The worker exits after this many jobs.
+   * @param maxRss_ The worker exits when its resident memory exceeds this
+   * many bytes after a job. 0 means no threshold.
+   */
+  ParseWorkerProcess(
+    const std::function<bool()>& init_,
+    const std::function<int(std::size_t)>& handler_,
+    std::size_t maxJobs_,
+    std::size_t maxRss_);
+
+  /**
+   * Tells the worker to exit and waits for it.
+   */
+  ~ParseWorkerProcess();
+
+  /**
+   * Sends a job to the worker.
+   * @return False if the worker is not running anymore.
+   */
+  bool send(std::size_t index_);
+
+  /**
+   * Reads the answer for the job sent last. It blocks until the answer
+   * arrives.
+   * @return False if the worker has exited or crashed without answering.
+   */
+  bool receive(Result& result_);
+
+  /**
+   * File descriptor of the answers, which can be polled.
+   */
+  int resultFd() const
+  {
+    return _resultFd[0];
+  }
+
+  /**
+   * Waits for the worker to exit and describes how it has exited.
+   */
+  std::string exitStatus();
+
+private:
+  /**
+   * Job loop of the worker. It never returns.
+   */
+  [[noreturn]] void runWorker(
+    const std::function<bool()>& init_,
+    const std::function<int(std::size_t)>& handler_,
+    std::size_t maxJobs_,
+    std::size_t maxRss_);
+
+  /**
+   * Returns the resident memory of this process in bytes.
+   */
+  static std::size_t residentMemory();
+
+  int _resultFd[2];
+};
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_PARSEWORKERPROCESS_H
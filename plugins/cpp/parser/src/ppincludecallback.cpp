@@ -14,23 +14,41 @@ PPIncludeCallback::PPIncludeCallback(
   ParserContext& ctx_,
   clang::ASTContext& astContext_,
   EntityCache& entityCache_,
-  clang::Preprocessor&) :
+  clang::Preprocessor&,
+  std::string skippedIncluder_) :
     _ctx(ctx_),
     _cppSourceType("CPP"),
     _clangSrcMgr(astContext_.getSourceManager()),
     _fileLocUtil(astContext_.getSourceManager()),
-    _entityCache(entityCache_)
+    _entityCache(entityCache_),
+    _skippedIncluder(std::move(skippedIncluder_))
 {
 }
 
 PPIncludeCallback::~PPIncludeCallback()
 {
   _ctx.srcMgr.persistFiles();
+  persist();
+}
+
+void PPIncludeCallback::persist()
+{
+  try
+  {
+    (util::OdbTransaction(_ctx.db))([this]{
+      util::persistAll(_astNodes, _ctx.db);
+      util::persistAll(_headerIncs, _ctx.db);
+    });
+  }
+  catch (...)
+  {
+    for (const model::CppAstNodePtr& node : _astNodes)
+      _entityCache.release(node->id);
+    throw;
+  }
 
-  (util::OdbTransaction(_ctx.db))([this]{
-    util::persistAll(_astNodes, _ctx.db);
-    util::persistAll(_headerIncs, _ctx.db);
-  });
+  for (const model::CppAstNodePtr& node : _astNodes)
+    _entityCache.publish(node->id);
 }
 
 model::CppAstNodePtr PPIncludeCallback::createFileAstNode(
@@ -73,29 +91,31 @@ void PPIncludeCallback::InclusionDirective(
   clang::SourceLocation expLoc = _clangSrcMgr.getExpansionLoc(hashLoc_);
   clang::PresumedLoc presLoc = _clangSrcMgr.getPresumedLoc(expLoc);
 
+  if (!_skippedIncluder.empty() && presLoc.getFilename() == _skippedIncluder)
+    return;
+
+  // The parse status is not written to the database, only the type.
+  auto markParsed = [this](model::File& file_)
+  {
+    file_.parseStatus = model::File::PSFullyParsed;
+    if (file_.type == model::File::DIRECTORY_TYPE ||
+        file_.type == _cppSourceType)
+      return false;
+    file_.type = _cppSourceType;
+    return true;
+  };
+
   //--- Included file ---//
 
   std::string includedPath = searchPath_.str() + '/' + fileName_.str();
   model::FilePtr included = _ctx.srcMgr.getFile(includedPath);
-  included->parseStatus = model::File::PSFullyParsed;
-  if (included->type != model::File::DIRECTORY_TYPE &&
-      included->type != _cppSourceType)
-  {
-    included->type = _cppSourceType;
-    _ctx.srcMgr.updateFile(*included);
-  }
+  _ctx.srcMgr.updateFile(included, markParsed);
 
   //--- Includer file ---//
 
   std::string includerPath = presLoc.getFilename();
   model::FilePtr includer = _ctx.srcMgr.getFile(includerPath);
-  includer->parseStatus = model::File::PSFullyParsed;
-  if (includer->type != model::File::DIRECTORY_TYPE &&
-      includer->type != _cppSourceType)
-  {
-    includer->type = _cppSourceType;
-    _ctx.srcMgr.updateFile(*includer);
-  }
+  _ctx.srcMgr.updateFile(includer, markParsed);
 
   //--- CppAstNode ---//
 
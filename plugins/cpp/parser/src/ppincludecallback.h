@@ -24,11 +24,17 @@ namespace parser
 class PPIncludeCallback : public clang::PPCallbacks
 {
 public:
+  /**
+   * @param skippedIncluder_ The inclusions in this file are not recorded. It
+   * is the generated header of a precompiled preamble, which is not a part of
+   * the project.
+   */
   PPIncludeCallback(
     ParserContext& ctx_,
     clang::ASTContext& astContext_,
     EntityCache& entityCache_,
-    clang::Preprocessor& pp_);
+    clang::Preprocessor& pp_,
+    std::string skippedIncluder_ = std::string());
 
   ~PPIncludeCallback();
 
@@ -45,6 +51,13 @@ public:
     clang::SrcMgr::CharacteristicKind FileType) override;
 
 private:
+  /**
+   * Persists the collected objects. The IDs of the AST nodes are published in
+   * the entity cache after the commit, or released if they couldn't be
+   * persisted.
+   */
+  void persist();
+
   /**
    * This function creates an AST Node from a file.
    */
@@ -57,6 +70,7 @@ private:
   const clang::SourceManager& _clangSrcMgr;
   FileLocUtil _fileLocUtil;
   EntityCache& _entityCache;
+  const std::string _skippedIncluder;
 
   std::vector<model::CppAstNodePtr>         _astNodes;
   std::vector<model::CppHeaderInclusionPtr> _headerIncs;
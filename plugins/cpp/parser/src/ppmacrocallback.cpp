@@ -27,12 +27,28 @@ PPMacroCallback::PPMacroCallback(
 PPMacroCallback::~PPMacroCallback()
 {
   _ctx.srcMgr.persistFiles();
+  persist();
+}
 
-  (util::OdbTransaction(_ctx.db))([this]{
-    util::persistAll(_astNodes, _ctx.db);
-    util::persistAll(_macros, _ctx.db);
-    util::persistAll(_macrosExpansion, _ctx.db);
-  });
+void PPMacroCallback::persist()
+{
+  try
+  {
+    (util::OdbTransaction(_ctx.db))([this]{
+      util::persistAll(_astNodes, _ctx.db);
+      util::persistAll(_macros, _ctx.db);
+      util::persistAll(_macrosExpansion, _ctx.db);
+    });
+  }
+  catch (...)
+  {
+    for (const model::CppAstNodePtr& node : _astNodes)
+      _entityCache.release(node->id);
+    throw;
+  }
+
+  for (const model::CppAstNodePtr& node : _astNodes)
+    _entityCache.publish(node->id);
 }
 
 void PPMacroCallback::MacroExpands(
@@ -140,7 +156,8 @@ void PPMacroCallback::MacroExpands(
   {
     _astNodes.push_back(astNode);
 
-    model::CppMacroExpansionPtr mExp(new model::CppMacroExpansion);
+    model::CppMacroExpansionPtr mExp
+      = _arena.makeShared<model::CppMacroExpansion>();
     mExp->astNodeId = astNode->id;
     mExp->expansion = expansion;
 
@@ -166,7 +183,7 @@ void PPMacroCallback::MacroDefined(
   {
     _astNodes.push_back(astNode);
 
-    model::CppMacroPtr macro = std::make_shared<model::CppMacro>();
+    model::CppMacroPtr macro = _arena.makeShared<model::CppMacro>();
     macro->astNodeId = astNode->id;
     macro->entityHash = astNode->entityHash;
     macro->name = astNode->astValue;
@@ -198,7 +215,7 @@ model::CppAstNodePtr PPMacroCallback::createMacroAstNode(
   const clang::Token& macroNameTok_,
   const clang::MacroInfo* mi_)
 {
-  model::CppAstNodePtr astNode(new model::CppAstNode);
+  model::CppAstNodePtr astNode = _arena.makeShared<model::CppAstNode>();
 
   astNode->astValue = macroNameTok_.getIdentifierInfo()->getName().str();
   astNode->entityHash = util::fnvHash(getUSR(mi_));
@@ -217,14 +234,17 @@ void PPMacroCallback::addFileLoc(
 
   model::FileLoc fileLoc;
   _fileLocUtil.setRange(start_, end_, fileLoc.range);
-  fileLoc.file = _ctx.srcMgr.getFile(_fileLocUtil.getFilePath(start_));
+  model::FilePtr file = _ctx.srcMgr.getFile(_fileLocUtil.getFilePath(start_));
+  fileLoc.file = file;
 
-  const std::string& type = fileLoc.file.load()->type;
-  if (type != model::File::DIRECTORY_TYPE && type != _cppSourceType)
+  _ctx.srcMgr.updateFile(file, [this](model::File& file_)
   {
-    fileLoc.file->type = _cppSourceType;
-    _ctx.srcMgr.updateFile(*fileLoc.file);
-  }
+    if (file_.type == model::File::DIRECTORY_TYPE ||
+        file_.type == _cppSourceType)
+      return false;
+    file_.type = _cppSourceType;
+    return true;
+  });
 
   astNode_->location = fileLoc;
 }
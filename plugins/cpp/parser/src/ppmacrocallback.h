@@ -14,6 +14,7 @@
 
 #include <parser/parsercontext.h>
 
+#include <util/arena.h>
 #include <util/logutil.h>
 
 #include "entitycache.h"
@@ -50,6 +51,12 @@ public:
     const clang::MacroDirective* undef_) override;
 
 private:
+  /**
+   * Persists the collected objects. The IDs of the AST nodes are published in
+   * the entity cache after the commit, or released if they couldn't be
+   * persisted.
+   */
+  void persist();
 
   /**
    * This function creates an AST Node for a macro.
@@ -89,6 +96,7 @@ private:
   bool _disabled = false;
 
   EntityCache& _entityCache;
+  util::Arena                              _arena;
   std::vector<model::CppAstNodePtr>        _astNodes;
   std::vector<model::CppMacroPtr>          _macros;
   std::vector<model::CppMacroExpansionPtr> _macrosExpansion;
@@ -0,0 +1,358 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/filesystem.hpp>
+
+#include <util/logutil.h>
+
+#include "preamblegroups.h"
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+
+/**
+ * A preamble is built only if this many translation units share it, one of
+ * which is parsed without it as a baseline.
+ */
+constexpr std::size_t PREAMBLE_MIN_UNITS = 3;
+
+/**
+ * A preamble is built only if it contains at least this many includes.
+ */
+constexpr std::size_t PREAMBLE_MIN_INCLUDES = 3;
+
+std::string absolutePath(const std::string& path_, const std::string& dir_)
+{
+  return fs::absolute(path_, dir_).lexically_normal().string();
+}
+
+/**
+ * Returns the index of the source file argument in the command line or 0 if
+ * it is not found.
+ */
+std::size_t sourceArgIndex(const clang::tooling::CompileCommand& command_)
+{
+  std::string source = absolutePath(command_.Filename, command_.Directory);
+
+  for (std::size_t i = 1; i < command_.CommandLine.size(); ++i)
+    if (absolutePath(command_.CommandLine[i], command_.Directory) == source)
+      return i;
+
+  return 0;
+}
+
+/**
+ * Returns the arguments of the command apart from the compiler, the source
+ * file and the output file. Commands with the same flags can share a
+ * precompiled header.
+ */
+std::vector<std::string> flags(const clang::tooling::CompileCommand& command_)
+{
+  std::size_t sourceIndex = sourceArgIndex(command_);
+  std::vector<std::string> result;
+
+  for (std::size_t i = 1; i < command_.CommandLine.size(); ++i)
+  {
+    const std::string& arg = command_.CommandLine[i];
+
+    if (i == sourceIndex)
+      continue;
+
+    if (arg == "-o")
+      ++i;
+    else if (!boost::starts_with(arg, "-o"))
+      result.push_back(arg);
+  }
+
+  return result;
+}
+
+bool isCSource(const std::string& path_)
+{
+  return fs::extension(path_) == ".c";
+}
+
+} // namespace
+
+namespace cc
+{
+namespace parser
+{
+
+PreambleGroups::PreambleGroups(const std::string& directory_)
+  : _directory(directory_)
+{
+}
+
+PreambleGroups::~PreambleGroups()
+{
+  boost::system::error_code ec;
+  fs::remove_all(_directory, ec);
+}
+
+void PreambleGroups::plan(
+  const std::vector<const clang::tooling::CompileCommand*>& commands_)
+{
+  typedef std::pair<
+    const clang::tooling::CompileCommand*,
+    std::vector<std::string>> Unit;
+
+  //--- Group the commands by their directory and flags ---//
+
+  std::map<std::string, std::vector<Unit>> candidates;
+
+  for (const clang::tooling::CompileCommand* commandPtr : commands_)
+  {
+    const clang::tooling::CompileCommand& command = *commandPtr;
+
+    if (!sourceArgIndex(command))
+      continue;
+
+    std::string source = absolutePath(command.Filename, command.Directory);
+    std::string sourceDir = fs::path(source).parent_path().string();
+
+    std::vector<std::string> includes = readIncludePrefix(source);
+    if (includes.size() < PREAMBLE_MIN_INCLUDES)
+      continue;
+
+    std::string key
+      = command.Directory + '\n' + sourceDir + '\n'
+      + (isCSource(source) ? "c" : "c++") + '\n'
+      + boost::algorithm::join(flags(command), "\n");
+
+    candidates[key].emplace_back(&command, std::move(includes));
+  }
+
+  //--- Find the best include prefix of each group ---//
+
+  for (auto& candidate : candidates)
+  {
+    std::vector<Unit*> units;
+    for (Unit& unit : candidate.second)
+      units.push_back(&unit);
+
+    // Follow the most common include at each position. The best prefix is
+    // the one saving the most header parsing: its length times the number of
+    // translation units sharing it.
+    std::vector<Unit*> bestUnits;
+    std::size_t bestLength = 0;
+
+    for (std::size_t depth = 0; units.size() >= PREAMBLE_MIN_UNITS; ++depth)
+    {
+      std::map<std::string, std::size_t> counts;
+      for (const Unit* unit : units)
+        if (unit->second.size() > depth)
+          ++counts[unit->second[depth]];
+
+      if (counts.empty())
+        break;
+
+      const std::string& include = std::max_element(
+        counts.begin(), counts.end(),
+        [](const std::pair<const std::string, std::size_t>& left_,
+           const std::pair<const std::string, std::size_t>& right_)
+        {
+          return left_.second < right_.second;
+        })->first;
+
+      units.erase(
+        std::remove_if(units.begin(), units.end(),
+          [&](const Unit* unit_)
+          {
+            return unit_->second.size() <= depth
+              || unit_->second[depth] != include;
+          }),
+        units.end());
+
+      if (units.size() >= PREAMBLE_MIN_UNITS &&
+          depth + 1 >= PREAMBLE_MIN_INCLUDES &&
+          (depth + 1) * units.size() >= bestLength * bestUnits.size())
+      {
+        bestUnits = units;
+        bestLength = depth + 1;
+      }
+    }
+
+    if (bestUnits.empty())
+      continue;
+
+    const clang::tooling::CompileCommand& first = *bestUnits.front()->first;
+
+    std::unique_ptr<PreambleGroup> group(new PreambleGroup);
+    group->directory = fs::path(
+      absolutePath(first.Filename, first.Directory)).parent_path().string();
+    group->includes.assign(
+      bestUnits.front()->second.begin(),
+      bestUnits.front()->second.begin() + bestLength);
+
+    for (const Unit* unit : bestUnits)
+      group->commands.push_back(unit->first);
+
+    _groups.push_back(std::move(group));
+  }
+
+  //--- Write the generated headers ---//
+
+  if (_groups.empty())
+    return;
+
+  boost::system::error_code ec;
+  fs::create_directories(_directory, ec);
+
+  if (ec)
+  {
+    LOG(warning)
+      << "[cppparser] Failed to create directory " << _directory
+      << " for precompiled preambles: " << ec.message();
+    _groups.clear();
+    return;
+  }
+
+  for (std::size_t i = 0; i < _groups.size(); ++i)
+  {
+    PreambleGroup& group = *_groups[i];
+    const clang::tooling::CompileCommand& first = *group.commands.front();
+
+    std::string name = _directory + "/preamble-" + std::to_string(i);
+    group.headerPath = name + (isCSource(first.Filename) ? ".h" : ".hpp");
+    group.pchPath = name + ".pch";
+
+    std::ofstream header(group.headerPath);
+    for (const std::string& include : group.includes)
+      header << include << '\n';
+
+    // The precompiled header is built by the command of the first
+    // translation unit, compiling the generated header instead of the
+    // source file.
+    std::size_t sourceIndex = sourceArgIndex(first);
+
+    group.pchCommand.Directory = first.Directory;
+    group.pchCommand.Filename = group.headerPath;
+    group.pchCommand.CommandLine = first.CommandLine;
+    group.pchCommand.CommandLine[sourceIndex] = group.headerPath;
+
+    for (const clang::tooling::CompileCommand* command : group.commands)
+      _commandToGroup[command] = &group;
+  }
+}
+
+PreambleGroup* PreambleGroups::find(
+  const clang::tooling::CompileCommand& command_) const
+{
+  auto it = _commandToGroup.find(&command_);
+  return it == _commandToGroup.end() ? nullptr : it->second;
+}
+
+bool PreambleGroups::usesPreamble(
+  const PreambleGroup& group_,
+  const clang::tooling::CompileCommand& command_)
+{
+  return group_.built && group_.commands.front() != &command_;
+}
+
+void PreambleGroups::report() const
+{
+  for (const std::unique_ptr<PreambleGroup>& group : _groups)
+  {
+    if (!group->built)
+      continue;
+
+    std::size_t units = group->preambleUnits;
+    std::uint64_t baseline = group->baselineMs;
+    double average = units ? double(group->preambleMs) / units : 0.0;
+
+    std::ostringstream message;
+    message
+      << std::fixed << std::setprecision(1)
+      << "[cppparser] Preamble of " << group->includes.size()
+      << " includes in " << group->directory
+      << ": built in " << group->buildTime.count() << " ms, "
+      << units << " translation units parsed in " << average
+      << " ms on average, " << baseline << " ms without preamble";
+
+    if (baseline && average > 0)
+      message << " (speedup " << baseline / average << "x)";
+
+    LOG(info) << message.str() << '.';
+  }
+}
+
+std::vector<std::string> PreambleGroups::readIncludePrefix(
+  const std::string& path_)
+{
+  std::vector<std::string> includes;
+  std::ifstream source(path_);
+  std::string sourceDir = fs::path(path_).parent_path().string();
+
+  std::string line;
+  bool inComment = false;
+
+  while (std::getline(source, line))
+  {
+    boost::algorithm::trim(line);
+
+    if (inComment)
+    {
+      std::size_t end = line.find("*/");
+      if (end == std::string::npos)
+        continue;
+
+      inComment = false;
+      line = boost::algorithm::trim_copy(line.substr(end + 2));
+    }
+
+    if (line.empty() || boost::starts_with(line, "//"))
+      continue;
+
+    if (boost::starts_with(line, "/*"))
+    {
+      std::size_t end = line.find("*/", 2);
+      if (end == std::string::npos)
+        inComment = true;
+      else if (!boost::algorithm::trim_copy(line.substr(end + 2)).empty())
+        break;
+
+      continue;
+    }
+
+    if (line[0] != '#')
+      break;
+
+    std::string directive = boost::algorithm::trim_left_copy(line.substr(1));
+    if (!boost::starts_with(directive, "include") ||
+        boost::starts_with(directive, "include_next"))
+      break;
+
+    std::string target = boost::algorithm::trim_copy(directive.substr(7));
+    if (target.size() < 2)
+      break;
+
+    char close = target[0] == '<' ? '>' : target[0] == '"' ? '"' : 0;
+    std::size_t closePos = close ? target.find(close, 1) : std::string::npos;
+    if (closePos == std::string::npos)
+      break;
+
+    std::string file = target.substr(1, closePos - 1);
+
+    // The generated header is not next to the source file, so a quoted
+    // include which is found relative to the source file is made absolute.
+    if (close == '"' && fs::is_regular_file(sourceDir + '/' + file))
+      includes.push_back(
+        "#include \"" + absolutePath(file, sourceDir) + '"');
+    else
+      includes.push_back("#include " + target.substr(0, closePos + 1));
+  }
+
+  return includes;
+}
+
+} // parser
+} // cc
@@ -0,0 +1,136 @@
+#ifndef CC_PARSER_PREAMBLEGROUPS_H
+#define CC_PARSER_PREAMBLEGROUPS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <clang/Tooling/CompilationDatabase.h>
+
+namespace cc
+{
+namespace parser
+{
+
+/**
+ * Translation units compiled with the same flags in the same directory which
+ * start with the same #include directives. These includes are compiled once
+ * into a precompiled header (the preamble) which is loaded by the
+ * translation units of the group instead of parsing the headers again.
+ */
+struct PreambleGroup
+{
+  /**
+   * Directory of the source files.
+   */
+  std::string directory;
+
+  /**
+   * The common #include directives. Quoted includes which are relative to
+   * the directory of the source files are rewritten to absolute paths.
+   */
+  std::vector<std::string> includes;
+
+  /**
+   * The compile commands of the translation units in the group.
+   */
+  std::vector<const clang::tooling::CompileCommand*> commands;
+
+  /**
+   * Generated header containing the includes, and the precompiled header
+   * built from it.
+   */
+  std::string headerPath;
+  std::string pchPath;
+
+  /**
+   * Compile command building the precompiled header.
+   */
+  clang::tooling::CompileCommand pchCommand;
+
+  /**
+   * The files compiled into the precompiled header. An error in one of them
+   * may be caused by the preamble, e.g. when a header without an include
+   * guard is included again by a translation unit.
+   */
+  std::unordered_set<std::string> headers;
+
+  bool built = false;
+  std::chrono::milliseconds buildTime{0};
+
+  /**
+   * The first translation unit of the group is parsed without the preamble,
+   * so that the other ones can be compared to it.
+   */
+  std::atomic<std::uint64_t> baselineMs{0};
+  std::atomic<std::uint64_t> preambleMs{0};
+  std::atomic<std::size_t> preambleUnits{0};
+};
+
+/**
+ * Finds the groups of translation units which can share a preamble.
+ */
+class PreambleGroups
+{
+public:
+  /**
+   * @param directory_ The generated headers and the precompiled headers are
+   * written into this directory. It is removed by the destructor.
+   */
+  PreambleGroups(const std::string& directory_);
+  ~PreambleGroups();
+
+  /**
+   * Groups the compile commands by their directory and flags, and finds the
+   * longest include prefix shared by enough translation units of each group.
+   * The generated header of each group is written to the disk.
+   */
+  void plan(
+    const std::vector<const clang::tooling::CompileCommand*>& commands_);
+
+  const std::vector<std::unique_ptr<PreambleGroup>>& groups() const
+  {
+    return _groups;
+  }
+
+  /**
+   * Returns the group of the compile command or nullptr if it has no group.
+   */
+  PreambleGroup* find(const clang::tooling::CompileCommand& command_) const;
+
+  /**
+   * Returns true if the command should be parsed with the preamble of its
+   * group, i.e. it is not the baseline translation unit of the group.
+   */
+  static bool usesPreamble(
+    const PreambleGroup& group_,
+    const clang::tooling::CompileCommand& command_);
+
+  /**
+   * Logs the build time of each preamble, and the average parse time of the
+   * translation units with and without it.
+   */
+  void report() const;
+
+  /**
+   * Returns the leading #include directives of a source file. The scan stops
+   * at the first line which is not an include, a comment or empty.
+   */
+  static std::vector<std::string> readIncludePrefix(const std::string& path_);
+
+private:
+  std::string _directory;
+  std::vector<std::unique_ptr<PreambleGroup>> _groups;
+  std::unordered_map<
+    const clang::tooling::CompileCommand*, PreambleGroup*> _commandToGroup;
+};
+
+} // parser
+} // cc
+
+#endif // CC_PARSER_PREAMBLEGROUPS_H
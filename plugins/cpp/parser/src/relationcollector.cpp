@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 #include <clang/AST/ASTContext.h>
 
@@ -15,6 +16,8 @@ namespace parser
 std::unordered_set<model::CppEdgeId> RelationCollector::_edgeCache;
 std::unordered_set<model::CppEdgeAttributeId> RelationCollector::_edgeAttrCache;
 std::mutex RelationCollector::_edgeCacheMutex;
+std::unique_ptr<util::SharedHashMap> RelationCollector::_sharedEdgeCache;
+std::unique_ptr<util::SharedHashMap> RelationCollector::_sharedEdgeAttrCache;
 
 RelationCollector::RelationCollector(
   ParserContext& ctx_,
@@ -25,30 +28,138 @@ RelationCollector::RelationCollector(
   // Fill edge cache on first object initialization
   // Note that the caches are static members.
   std::lock_guard<std::mutex> cacheLock(_edgeCacheMutex);
+  if (_edgeCache.empty() && !_sharedEdgeCache)
+    loadCache(_ctx);
+}
+
+void RelationCollector::loadCache(ParserContext& ctx_)
+{
+  util::OdbTransaction{ctx_.db}([&ctx_]
+  {
+    for (const model::CppEdge &edge : ctx_.db->query<model::CppEdge>())
+    {
+      _edgeCache.insert(edge.id);
+    }
+    for (const model::CppEdgeAttribute &edgeAttr : ctx_.db->query<model::CppEdgeAttribute>())
+    {
+      _edgeAttrCache.insert(edgeAttr.id);
+    }
+  }); // end of transaction
+}
+
+void RelationCollector::share(ParserContext& ctx_, std::size_t capacity_)
+{
+  std::lock_guard<std::mutex> cacheLock(_edgeCacheMutex);
+
+  if (_sharedEdgeCache)
+    return;
+
   if (_edgeCache.empty())
+    loadCache(ctx_);
+
+  _sharedEdgeCache.reset(new util::SharedHashMap(
+    std::max(capacity_, 2 * _edgeCache.size())));
+  _sharedEdgeAttrCache.reset(new util::SharedHashMap(
+    std::max(capacity_, 2 * _edgeAttrCache.size())));
+
+  for (model::CppEdgeId id : _edgeCache)
+  {
+    _sharedEdgeCache->insert(id, 0);
+    _sharedEdgeCache->publish(id);
+  }
+  for (model::CppEdgeAttributeId id : _edgeAttrCache)
+  {
+    _sharedEdgeAttrCache->insert(id, 0);
+    _sharedEdgeAttrCache->publish(id);
+  }
+
+  _edgeCache.clear();
+  _edgeAttrCache.clear();
+}
+
+void RelationCollector::erase(
+  const std::vector<model::CppEdgeId>& edges_,
+  const std::vector<model::CppEdgeAttributeId>& attributes_)
+{
+  std::lock_guard<std::mutex> cacheLock(_edgeCacheMutex);
+
+  for (model::CppEdgeId id : edges_)
+    _edgeCache.erase(id);
+  for (model::CppEdgeAttributeId id : attributes_)
+    _edgeAttrCache.erase(id);
+}
+
+bool RelationCollector::insertEdgeId(model::CppEdgeId id_)
+{
+  if (_sharedEdgeCache)
+    switch (_sharedEdgeCache->insert(id_, 0))
+    {
+      case util::SharedHashMap::Insertion::INSERTED: return true;
+      case util::SharedHashMap::Insertion::FOUND: return false;
+      case util::SharedHashMap::Insertion::FULL: break;
+    }
+
+  std::lock_guard<std::mutex> cacheLock(_edgeCacheMutex);
+  return _edgeCache.insert(id_).second;
+}
+
+bool RelationCollector::insertEdgeAttributeId(model::CppEdgeAttributeId id_)
+{
+  if (_sharedEdgeAttrCache)
+    switch (_sharedEdgeAttrCache->insert(id_, 0))
+    {
+      case util::SharedHashMap::Insertion::INSERTED: return true;
+      case util::SharedHashMap::Insertion::FOUND: return false;
+      case util::SharedHashMap::Insertion::FULL: break;
+    }
+
+  std::lock_guard<std::mutex> cacheLock(_edgeCacheMutex);
+  return _edgeAttrCache.insert(id_).second;
+}
+
+void RelationCollector::persist()
+{
+  try
   {
-    util::OdbTransaction{_ctx.db}([this]
+    (util::OdbTransaction(_ctx.db))([this]{
+      util::persistAll(_newEdges, _ctx.db);
+      util::persistAll(_newEdgeAttributes, _ctx.db);
+    });
+  }
+  catch (...)
+  {
+    std::lock_guard<std::mutex> cacheLock(_edgeCacheMutex);
+
+    for (const model::CppEdgePtr& edge : _newEdges)
+    {
+      if (_sharedEdgeCache)
+        _sharedEdgeCache->release(edge->id);
+      _edgeCache.erase(edge->id);
+    }
+
+    for (const model::CppEdgeAttributePtr& attr : _newEdgeAttributes)
     {
-      for (const model::CppEdge &edge : _ctx.db->query<model::CppEdge>())
-      {
-        _edgeCache.insert(edge.id);
-      }
-      for (const model::CppEdgeAttribute &edgeAttr : _ctx.db->query<model::CppEdgeAttribute>())
-      {
-        _edgeAttrCache.insert(edgeAttr.id);
-      }
-    }); // end of transaction
+      if (_sharedEdgeAttrCache)
+        _sharedEdgeAttrCache->release(attr->id);
+      _edgeAttrCache.erase(attr->id);
+    }
+
+    throw;
   }
+
+  if (_sharedEdgeCache)
+    for (const model::CppEdgePtr& edge : _newEdges)
+      _sharedEdgeCache->publish(edge->id);
+
+  if (_sharedEdgeAttrCache)
+    for (const model::CppEdgeAttributePtr& attr : _newEdgeAttributes)
+      _sharedEdgeAttrCache->publish(attr->id);
 }
 
 RelationCollector::~RelationCollector()
 {
   _ctx.srcMgr.persistFiles();
-
-  (util::OdbTransaction(_ctx.db))([this]{
-    util::persistAll(_newEdges, _ctx.db);
-    util::persistAll(_newEdgeAttributes, _ctx.db);
-  });
+  persist();
 }
 
 bool RelationCollector::VisitFunctionDecl(clang::FunctionDecl* fd_)
@@ -81,7 +192,7 @@ bool RelationCollector::VisitFunctionDecl(clang::FunctionDecl* fd_)
   if (declFile->id != defFile->id)
   {
     model::CppEdgeAttributePtr attr
-      = std::make_shared<model::CppEdgeAttribute>();
+      = _arena.makeShared<model::CppEdgeAttribute>();
 
     attr->key   = "provide";
     attr->value = fd_->getNameAsString();
@@ -159,6 +270,8 @@ void RelationCollector::cleanUp()
 {
   _edgeCache.clear();
   _edgeAttrCache.clear();
+  _sharedEdgeCache.reset();
+  _sharedEdgeAttrCache.reset();
 }
 
 void RelationCollector::addEdge(
@@ -172,17 +285,17 @@ void RelationCollector::addEdge(
 
   //--- Add edge ---//
 
-  model::CppEdgePtr edge = std::make_shared<model::CppEdge>();
+  model::CppEdgePtr edge = _arena.makeShared<model::CppEdge>();
 
-  edge->from = std::make_shared<model::File>();
+  edge->from = _arena.makeShared<model::File>();
   edge->from->id = from_;
-  edge->to = std::make_shared<model::File>();
+  edge->to = _arena.makeShared<model::File>();
   edge->to->id = to_;
 
   edge->type = type_;
   edge->id   = createIdentifier(*edge);
 
-  if (_edgeCache.insert(edge->id).second)
+  if (insertEdgeId(edge->id))
   {
     _newEdges.push_back(edge);
 
@@ -193,7 +306,7 @@ void RelationCollector::addEdge(
       attr_->edge = edge;
       attr_->id = model::createIdentifier(*attr_);
 
-      if (_edgeAttrCache.insert(attr_->id).second)
+      if (insertEdgeAttributeId(attr_->id))
         _newEdgeAttributes.push_back(attr_);
     }
   }
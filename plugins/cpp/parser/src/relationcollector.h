@@ -1,7 +1,9 @@
 #ifndef CC_PARSER_RELATIONCOLLECTOR_H
 #define CC_PARSER_RELATIONCOLLECTOR_H
 
+#include <memory>
 #include <mutex>
+#include <vector>
 
 #include <clang/AST/RecursiveASTVisitor.h>
 
@@ -12,7 +14,9 @@
 
 #include <parser/parsercontext.h>
 
+#include <util/arena.h>
 #include <util/logutil.h>
+#include <util/sharedhashmap.h>
 
 #include <cppparser/filelocutil.h>
 
@@ -38,7 +42,45 @@ public:
 
   static void cleanUp();
 
+  /**
+   * Moves the edge caches into shared memory, so that the processes forked
+   * afterwards don't persist the same edges. The caches are filled from the
+   * database first if they are empty. This function must be called before
+   * forking. When a shared cache is full, the further IDs go into the private
+   * cache of the process.
+   * @param capacity_ Maximal number of the elements of each cache. It is
+   * raised to twice the current size if that is more.
+   */
+  static void share(ParserContext& ctx_, std::size_t capacity_);
+
+  /**
+   * Removes the IDs of the deleted edges and edge attributes from the private
+   * caches, so that they are persisted again when they are found again.
+   */
+  static void erase(
+    const std::vector<model::CppEdgeId>& edges_,
+    const std::vector<model::CppEdgeAttributeId>& attributes_);
+
 private:
+  /**
+   * Fills the edge caches from the database. _edgeCacheMutex must be locked.
+   */
+  static void loadCache(ParserContext& ctx_);
+
+  /**
+   * Inserts the ID into the private or the shared cache.
+   * @return True if the ID was not in the cache.
+   */
+  static bool insertEdgeId(model::CppEdgeId id_);
+  static bool insertEdgeAttributeId(model::CppEdgeAttributeId id_);
+
+  /**
+   * Persists the new edges and edge attributes. Their IDs are published in
+   * the shared caches after the commit, or released if they couldn't be
+   * persisted, see util::SharedHashMap.
+   */
+  void persist();
+
   void addEdge(
     const model::FileId& from_,
     const model::FileId& to_,
@@ -50,7 +92,10 @@ private:
   static std::unordered_set<model::CppEdgeId> _edgeCache;
   static std::unordered_set<model::CppEdgeAttributeId> _edgeAttrCache;
   static std::mutex _edgeCacheMutex;
+  static std::unique_ptr<util::SharedHashMap> _sharedEdgeCache;
+  static std::unique_ptr<util::SharedHashMap> _sharedEdgeAttrCache;
 
+  util::Arena _arena;
   std::vector<model::CppEdgePtr> _newEdges;
   std::vector<model::CppEdgeAttributePtr> _newEdgeAttributes;
 
@@ -8,6 +8,7 @@
 
 #include <model/fileloc.h>
 #include <model/fileloc-odb.hxx>
+#include <util/hash.h>
 #include <util/logutil.h>
 
 #include "symbolhelper.h"
@@ -106,6 +107,31 @@ std::string getUSR(const clang::QualType& qt_, clang::ASTContext& ctx_)
   return std::string(data, data + usr.size());
 }
 
+std::uint64_t getUSRHash(const clang::NamedDecl* nd_)
+{
+  // See getUSR() for ignoring the return value.
+  llvm::SmallVector<char, 64> usr;
+  clang::index::generateUSRForDecl(nd_, usr);
+  return util::fnvHash(usr.data(), usr.size());
+}
+
+std::uint64_t getUSRHash(const clang::QualType& qt_, clang::ASTContext& ctx_)
+{
+  const clang::Type* type = qt_.getTypePtr();
+
+  if (const clang::TypedefType* td = type->getAs<clang::TypedefType>())
+  {
+    if (const clang::TypedefNameDecl* tDecl = td->getDecl())
+      return getUSRHash(tDecl);
+  }
+  else if (const clang::TagDecl* tDecl = type->getAsTagDecl())
+    return getUSRHash(tDecl);
+
+  llvm::SmallVector<char, 64> usr;
+  clang::index::generateUSRForType(qt_, ctx_, usr);
+  return util::fnvHash(usr.data(), usr.size());
+}
+
 bool isFunction(const clang::Type* type_)
 {
   while (type_)
@@ -1,6 +1,7 @@
 #ifndef CC_PARSER_SYMBOLHELPER_H
 #define CC_PARSER_SYMBOLHELPER_H
 
+#include <cstdint>
 #include <string>
 
 #include <clang/AST/Decl.h>
@@ -19,6 +20,13 @@ const clang::Type* getStrippedType(const clang::QualType& qt_);
 std::string getUSR(const clang::NamedDecl* nd_);
 std::string getUSR(const clang::QualType& qt_, clang::ASTContext& ctx_);
 
+/**
+ * These functions return util::fnvHash() of the USR without copying it to a
+ * string.
+ */
+std::uint64_t getUSRHash(const clang::NamedDecl* nd_);
+std::uint64_t getUSRHash(const clang::QualType& qt_, clang::ASTContext& ctx_);
+
 bool isFunction(const clang::Type* type_);
 
 std::string getSignature(const clang::FunctionDecl* fn_);
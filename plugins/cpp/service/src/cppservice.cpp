@@ -23,9 +23,14 @@
 #include <model/cppmacroexpansion-odb.hxx>
 #include <model/cppdoccomment.h>
 #include <model/cppdoccomment-odb.hxx>
+#include <model/filecontent.h>
+#include <model/filecontent-odb.hxx>
+#include <model/filecontentstore.h>
 
 #include <service/cppservice.h>
 
+#include <webserver/filecache.h>
+
 #include "diagram.h"
 #include "filediagram.h"
 
@@ -143,19 +148,58 @@ void CppServiceHandler::getSourceText(
   std::string& return_,
   const core::AstNodeId& astNodeId_)
 {
-  return_ = _transaction([this, &astNodeId_](){
+  model::Range range;
+  std::string hash;
+
+  _transaction([&, this](){
     model::CppAstNode astNode = queryCppAstNode(astNodeId_);
+    range = astNode.location.range;
 
     if (astNode.location.file)
-      return cc::util::textRange(
-        astNode.location.file.load()->content.load()->content,
-        astNode.location.range.start.line,
-        astNode.location.range.start.column,
-        astNode.location.range.end.line,
-        astNode.location.range.end.column);
-
-    return std::string();
+    {
+      model::FilePtr file = astNode.location.file.load();
+      if (file->content)
+        hash = file->content.object_id();
+    }
   });
+
+  if (hash.empty() ||
+      range.start.line == model::Position::npos ||
+      range.end.line == model::Position::npos ||
+      range.end.line < range.start.line)
+    return;
+
+  // The file content is cached as a whole, because the source text of the
+  // other nodes of the file is likely to be queried too. Without the cache
+  // only the lines of the node are loaded.
+  std::string lines;
+
+  if (_context.fileCache)
+    lines = _context.fileCache->content(_db, hash, [&, this](){
+      return _transaction([&, this](){
+        model::FileContentPtr content = _db->find<model::FileContent>(hash);
+
+        return std::make_shared<const webserver::FileCacheContent>(content
+          ? model::loadFileContent(*_db, *content)
+          : std::string());
+      });
+    })->lines(range.start.line, range.end.line);
+  else
+    lines = _transaction([&, this](){
+      model::FileContentPtr content = _db->find<model::FileContent>(hash);
+
+      return content
+        ? model::loadFileLines(*_db, *content, range.start.line, range.end.line)
+        : std::string();
+    });
+
+  // The range is shifted to start at the first loaded line.
+  return_ = cc::util::textRange(
+    lines,
+    1,
+    range.start.column,
+    range.end.line - range.start.line + 1,
+    range.end.column);
 }
 
 void CppServiceHandler::getDocumentation(
@@ -1115,7 +1159,9 @@ void CppServiceHandler::getSyntaxHighlight(
   std::vector<SyntaxHighlight>& return_,
   const core::FileRange& range_)
 {
+  // Only the lines of the range are loaded, content[0] is firstLine.
   std::vector<std::string> content;
+  std::size_t firstLine = std::max<std::size_t>(range_.range.startpos.line, 1);
 
   _transaction([&, this]() {
 
@@ -1127,7 +1173,8 @@ void CppServiceHandler::getSyntaxHighlight(
     if (!file->content.load())
       return;
 
-    std::istringstream s(file->content->content);
+    std::istringstream s(model::loadFileLines(
+      *_db, *file->content, firstLine, range_.range.endpos.line));
     std::string line;
     while (std::getline(s, line))
       content.push_back(line);
@@ -1148,12 +1195,15 @@ void CppServiceHandler::getSyntaxHighlight(
       std::string reg = "\\b" + node.astValue + "\\b";
 
       for (std::size_t i = node.location.range.start.line - 1;
-           i < node.location.range.end.line && i < content.size();
+           i < node.location.range.end.line &&
+           i - (firstLine - 1) < content.size();
            ++i)
       {
+        const std::string& text = content[i - (firstLine - 1)];
+
         std::regex words_regex(reg);
         auto words_begin = std::sregex_iterator(
-          content[i].begin(), content[i].end(),
+          text.begin(), text.end(),
           words_regex);
         auto words_end = std::sregex_iterator();
 
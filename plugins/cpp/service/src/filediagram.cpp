@@ -1,3 +1,7 @@
+#include <ctime>
+#include <map>
+#include <mutex>
+
 #include <boost/filesystem.hpp>
 
 #include <model/cppheaderinclusion.h>
@@ -8,6 +12,7 @@
 
 #include <model/cppedge.h>
 #include <model/cppedge-odb.hxx>
+#include <model/cppfilegraph.h>
 
 #include <util/logutil.h>
 #include <util/dbutil.h>
@@ -39,11 +44,41 @@ FileDiagram::FileDiagram(
   const cc::webserver::ServerContext& context_)
     : _db(db_),
       _transaction(db_),
+      _fileGraph(getFileGraph(*datadir_)),
       _cppHandler(db_, datadir_, context_),
       _projectHandler(db_, datadir_, context_)
 {
 }
 
+util::CsrGraphPtr FileDiagram::getFileGraph(const std::string& datadir_)
+{
+  static std::mutex graphsMutex;
+  static std::map<std::string, std::pair<std::time_t, util::CsrGraphPtr>>
+    graphs;
+
+  const std::string path = model::cppFileGraphPath(datadir_);
+
+  boost::system::error_code ec;
+  std::time_t mtime = boost::filesystem::last_write_time(path, ec);
+  if (ec)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(graphsMutex);
+
+  auto it = graphs.find(path);
+  if (it != graphs.end() && it->second.first == mtime)
+    return it->second.second;
+
+  util::CsrGraphPtr graph = util::CsrGraph::load(path);
+  if (graph)
+    LOG(debug)
+      << "File graph loaded: " << path << " (" << graph->nodeCount()
+      << " files, " << graph->edgeCount() << " edges)";
+
+  graphs[path] = std::make_pair(mtime, graph);
+  return graph;
+}
+
 void FileDiagram::getComponentUsersDiagram(
   util::Graph& graph_,
   const core::FileId& fileId_)
@@ -344,6 +379,23 @@ std::vector<util::Graph::Node> FileDiagram::getIncludedFiles(
 {
   std::vector<util::Graph::Node> include;
 
+  if (_fileGraph)
+  {
+    util::CsrGraph::EdgeMask mask
+      = util::CsrGraph::mask(model::FG_INCLUDE);
+
+    for (util::CsrGraph::NodeId fileId : reverse_
+      ? _fileGraph->predecessors(std::stoull(node_), mask)
+      : _fileGraph->successors(std::stoull(node_), mask))
+    {
+      core::FileInfo fileInfo;
+      _projectHandler.getFileInfo(fileInfo, std::to_string(fileId));
+      include.push_back(addNode(graph_, fileInfo));
+    }
+
+    return include;
+  }
+
   _transaction([&, this]{
     IncludeResult res = _db->query<model::CppHeaderInclusion>(
       (reverse_
@@ -568,6 +620,19 @@ std::vector<core::FileId> FileDiagram::getProvidedFileIds(
 {
   std::vector<core::FileId> depends;
 
+  if (_fileGraph)
+  {
+    util::CsrGraph::EdgeMask mask
+      = util::CsrGraph::mask(model::FG_PROVIDE);
+
+    for (util::CsrGraph::NodeId fileId : reverse_
+      ? _fileGraph->predecessors(std::stoull(node_), mask)
+      : _fileGraph->successors(std::stoull(node_), mask))
+      depends.push_back(std::to_string(fileId));
+
+    return depends;
+  }
+
   _transaction([&, this]{
     EdgeResult res = _db->query<model::CppEdge>(
       (reverse_
@@ -676,6 +741,18 @@ std::vector<core::FileId> FileDiagram::getUsedFileIds(
 {
   std::vector<core::FileId> usages;
 
+  if (_fileGraph)
+  {
+    util::CsrGraph::EdgeMask mask = util::CsrGraph::mask(model::FG_USE);
+
+    for (util::CsrGraph::NodeId fileId : reverse_
+      ? _fileGraph->predecessors(std::stoull(node_), mask)
+      : _fileGraph->successors(std::stoull(node_), mask))
+      usages.push_back(std::to_string(fileId));
+
+    return usages;
+  }
+
   _transaction([&, this]{
     EdgeResult res = _db->query<model::CppEdge>(
       (reverse_
@@ -3,6 +3,7 @@
 
 #include <service/cppservice.h>
 #include <projectservice/projectservice.h>
+#include <util/csrgraph.h>
 #include <util/graph.h>
 
 namespace cc
@@ -367,6 +368,15 @@ private:
     const util::Graph::Node& node_,
     bool reverse_);
 
+  /**
+   * Returns the file graph which was saved by the C++ parser into the given
+   * project directory. The mapped graphs are shared between the FileDiagram
+   * instances and they are reloaded when the parser rewrites the graph file.
+   * @return nullptr if the workspace has no file graph. In this case the
+   * relations have to be queried from the database.
+   */
+  static util::CsrGraphPtr getFileGraph(const std::string& datadir_);
+
   static const Decoration centerNodeDecoration;
   static const Decoration sourceFileNodeDecoration;
   static const Decoration headerFileNodeDecoration;
@@ -388,6 +398,7 @@ private:
 
   std::shared_ptr<odb::database> _db;
   util::OdbTransaction _transaction;
+  util::CsrGraphPtr _fileGraph;
   CppServiceHandler _cppHandler;
   core::ProjectServiceHandler _projectHandler;
 };
@@ -0,0 +1,16 @@
+#ifndef CLEANUP_BASE_H
+#define CLEANUP_BASE_H
+
+struct Base
+{
+  int base;
+};
+
+struct Helper
+{
+  int helper;
+};
+
+int helperFunction();
+
+#endif
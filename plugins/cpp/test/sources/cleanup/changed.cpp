@@ -0,0 +1,17 @@
+#include "base.h"
+
+class ChangedFriend;
+
+struct ChangedDerived : Base
+{
+  friend class ChangedFriend;
+
+  int changedMember;
+};
+
+Helper changedHelper;
+
+int helperFunction()
+{
+  return 1;
+}
@@ -0,0 +1,4 @@
+int changedFunction()
+{
+  return 2;
+}
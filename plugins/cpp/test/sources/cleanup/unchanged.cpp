@@ -0,0 +1,15 @@
+#include "base.h"
+
+class UnchangedFriend;
+
+struct UnchangedDerived : Base
+{
+  friend class UnchangedFriend;
+};
+
+Helper unchangedHelper;
+
+int unchangedFunction()
+{
+  return helperFunction();
+}
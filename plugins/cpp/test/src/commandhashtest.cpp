@@ -0,0 +1,110 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "commandhash.h"
+
+using namespace cc::parser;
+
+using Args = std::vector<std::string>;
+
+namespace
+{
+
+/**
+ * Hashes a command compiling main.cpp in the given directory. The arguments
+ * are placed between the compiler and the source file.
+ */
+std::uint64_t hash(const Args& args_, const std::string& directory_ = "/build")
+{
+  Args commandLine{"/usr/bin/g++"};
+  commandLine.insert(commandLine.end(), args_.begin(), args_.end());
+  commandLine.push_back("-c");
+  commandLine.push_back("../src/main.cpp");
+
+  return semanticCommandHash(clang::tooling::CompileCommand(
+    directory_, "../src/main.cpp", commandLine, "main.o"));
+}
+
+} // namespace
+
+TEST(CommandHashTest, DebugFlags)
+{
+  const Args base{"-std=c++14", "-O2", "-DNDEBUG", "-Iinclude"};
+  std::uint64_t expected = hash(base);
+
+  for (const Args& debug : std::vector<Args>{
+         {"-g"}, {"-g3"}, {"-ggdb"}, {"-ggdb3"}, {"-gdwarf-4"},
+         {"-g", "-gsplit-dwarf"}, {"-gz=zlib"}, {"-gline-tables-only"},
+         {"-g", "-gno-column-info", "-fdebug-prefix-map=/build=."}})
+  {
+    Args args = base;
+    args.insert(args.end(), debug.begin(), debug.end());
+    EXPECT_EQ(expected, hash(args)) << debug.front();
+  }
+}
+
+TEST(CommandHashTest, IgnoredFlags)
+{
+  std::uint64_t expected = hash({"-O2", "-DA=1", "-DB", "-Iinclude"});
+
+  // Outputs, dependency files and warnings.
+  EXPECT_EQ(expected, hash({
+    "-O2", "-DA=1", "-DB", "-Iinclude", "-o", "main.o", "-MD", "-MF",
+    "main.d", "-MT", "main.o", "-Wall", "-Wextra", "-Werror",
+    "-fdiagnostics-color=always"}));
+
+  // The order of the macros of different names, and the macros redefined
+  // later.
+  EXPECT_EQ(expected, hash({"-O2", "-DB", "-D", "A=1", "-Iinclude"}));
+  EXPECT_EQ(expected, hash({"-O2", "-DA=0", "-DB", "-UA", "-DA=1",
+    "-Iinclude"}));
+
+  // Include paths given as absolute paths.
+  EXPECT_EQ(expected, hash({"-O2", "-DA=1", "-DB", "-I/build/include"}));
+}
+
+TEST(CommandHashTest, Configurations)
+{
+  const Args base{"-std=c++14", "-O2", "-DNDEBUG", "-Iinclude"};
+  std::uint64_t baseHash = hash(base);
+
+  // Each of these changes the AST or the code model.
+  for (const Args& other : std::vector<Args>{
+         {"-std=c++17", "-O2", "-DNDEBUG", "-Iinclude"},
+         {"-std=c++14", "-O0", "-DNDEBUG", "-Iinclude"},
+         {"-std=c++14", "-O2", "-Iinclude"},
+         {"-std=c++14", "-O2", "-DNDEBUG=0", "-Iinclude"},
+         {"-std=c++14", "-O2", "-UNDEBUG", "-Iinclude"},
+         {"-std=c++14", "-O2", "-DNDEBUG", "-Iinclude2"},
+         {"-std=c++14", "-O2", "-DNDEBUG", "-Iinclude", "-m32"},
+         {"-std=c++14", "-O2", "-DNDEBUG", "-Iinclude", "-fno-exceptions"},
+         {"-std=c++14", "-O2", "-DNDEBUG", "-Iinclude", "-include",
+          "config.h"}})
+    EXPECT_NE(baseHash, hash(other)) << other.front() << ' ' << other[1];
+
+  // The relative paths are resolved in the build directory.
+  EXPECT_NE(baseHash, hash(base, "/build2"));
+
+  // Flags starting with -g which are not debug info flags.
+  EXPECT_NE(
+    hash({"-O2", "-gcc-toolchain", "/opt/gcc-9"}),
+    hash({"-O2", "-gcc-toolchain", "/opt/gcc-11"}));
+  EXPECT_NE(
+    hash({"-O2", "--gcc-toolchain=/opt/gcc-9"}),
+    hash({"-O2", "--gcc-toolchain=/opt/gcc-11"}));
+}
+
+TEST(CommandHashTest, SourceExtension)
+{
+  EXPECT_TRUE(hasSourceExtension("main.cpp"));
+  EXPECT_TRUE(hasSourceExtension("/src/MAIN.CC"));
+  EXPECT_TRUE(hasSourceExtension("lib.a"));
+  EXPECT_FALSE(hasSourceExtension("main.h"));
+  EXPECT_FALSE(hasSourceExtension("-O2"));
+}
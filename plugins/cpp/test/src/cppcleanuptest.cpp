@@ -0,0 +1,210 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <cstdlib>
+#include <set>
+#include <unordered_set>
+
+#include <gtest/gtest.h>
+
+#include <model/buildaction.h>
+#include <model/buildaction-odb.hxx>
+#include <model/buildsourcetarget.h>
+#include <model/buildsourcetarget-odb.hxx>
+#include <model/cppastnode.h>
+#include <model/cppastnode-odb.hxx>
+#include <model/cppedge.h>
+#include <model/cppedge-odb.hxx>
+#include <model/cppentity.h>
+#include <model/cppentity-odb.hxx>
+#include <model/cppfriendship.h>
+#include <model/cppfriendship-odb.hxx>
+#include <model/cppfunction.h>
+#include <model/cppfunction-odb.hxx>
+#include <model/cppinheritance.h>
+#include <model/cppinheritance-odb.hxx>
+#include <model/file.h>
+#include <model/file-odb.hxx>
+
+#include <util/dbutil.h>
+#include <util/odbtransaction.h>
+
+extern const char* dbConnectionString;
+extern const char* reparseCommand;
+
+using namespace cc;
+
+using QBuildSource = odb::query<model::BuildSource>;
+using QCppAstNode = odb::query<model::CppAstNode>;
+using QCppEdge = odb::query<model::CppEdge>;
+using QCppFunction = odb::query<model::CppFunction>;
+using QFile = odb::query<model::File>;
+
+namespace
+{
+
+/**
+ * IDs of the rows which belong to a source file.
+ */
+struct FileRows
+{
+  std::set<model::CppEntityId> entities;
+  std::set<int> inheritances;
+  std::set<int> friendships;
+  std::set<model::CppEdgeId> edges;
+  std::set<std::uint64_t> actions;
+};
+
+FileRows fileRows(
+  std::shared_ptr<odb::database> db_,
+  const std::string& filename_)
+{
+  FileRows rows;
+
+  util::OdbTransaction {db_} ([&]() {
+    model::FileId file = db_->query_value<model::File>(
+      QFile::filename == filename_).id;
+
+    std::unordered_set<model::CppAstNodeId> astNodes;
+    std::unordered_set<std::uint64_t> definitions;
+
+    for (const model::CppAstNode& node : db_->query<model::CppAstNode>(
+      QCppAstNode::location.file == file))
+    {
+      astNodes.insert(node.id);
+      if (node.astType == model::CppAstNode::AstType::Definition)
+        definitions.insert(node.entityHash);
+    }
+
+    for (const model::CppEntity& entity : db_->query<model::CppEntity>())
+      if (astNodes.count(entity.astNodeId))
+        rows.entities.insert(entity.id);
+
+    for (const model::CppInheritance& inh
+      : db_->query<model::CppInheritance>())
+      if (definitions.count(inh.derived))
+        rows.inheritances.insert(inh.id);
+
+    for (const model::CppFriendship& friendship
+      : db_->query<model::CppFriendship>())
+      if (definitions.count(friendship.target))
+        rows.friendships.insert(friendship.id);
+
+    for (const model::CppEdge& edge : db_->query<model::CppEdge>(
+      QCppEdge::from == file))
+      rows.edges.insert(edge.id);
+
+    for (const model::BuildSource& source : db_->query<model::BuildSource>(
+      QBuildSource::file == file))
+      rows.actions.insert(source.action.object_id());
+  });
+
+  return rows;
+}
+
+} // namespace
+
+/**
+ * The project is parsed first, then changed.cpp is replaced by a version
+ * without the inheritance, the friendship, the entities and the file
+ * relations of the original one, and the project is parsed incrementally.
+ */
+class CppCleanupTest : public ::testing::Test
+{
+protected:
+  static void SetUpTestCase()
+  {
+    _db = util::connectDatabase(dbConnectionString);
+
+    _changedBefore = fileRows(_db, "changed.cpp");
+    _unchangedBefore = fileRows(_db, "unchanged.cpp");
+
+    ASSERT_NE(nullptr, reparseCommand);
+    GTEST_LOG_(INFO) << "Executing incremental parser command: "
+      << reparseCommand;
+    ASSERT_EQ(0, std::system(reparseCommand));
+
+    _changedAfter = fileRows(_db, "changed.cpp");
+    _unchangedAfter = fileRows(_db, "unchanged.cpp");
+  }
+
+  static void TearDownTestCase()
+  {
+    _db.reset();
+  }
+
+  /**
+   * Returns true if none of the IDs of the type is in the database.
+   */
+  template <typename T, typename Id>
+  static bool allDeleted(const std::set<Id>& ids_)
+  {
+    return util::OdbTransaction {_db} ([&]() {
+      for (Id id : ids_)
+        if (_db->find<T>(id))
+          return false;
+      return true;
+    });
+  }
+
+  static std::shared_ptr<odb::database> _db;
+  static FileRows _changedBefore;
+  static FileRows _changedAfter;
+  static FileRows _unchangedBefore;
+  static FileRows _unchangedAfter;
+};
+
+std::shared_ptr<odb::database> CppCleanupTest::_db;
+FileRows CppCleanupTest::_changedBefore;
+FileRows CppCleanupTest::_changedAfter;
+FileRows CppCleanupTest::_unchangedBefore;
+FileRows CppCleanupTest::_unchangedAfter;
+
+TEST_F(CppCleanupTest, FixtureIsParsed)
+{
+  EXPECT_FALSE(_changedBefore.entities.empty());
+  EXPECT_FALSE(_changedBefore.inheritances.empty());
+  EXPECT_FALSE(_changedBefore.friendships.empty());
+  EXPECT_FALSE(_changedBefore.edges.empty());
+  EXPECT_FALSE(_changedBefore.actions.empty());
+}
+
+TEST_F(CppCleanupTest, OldRowsAreDeleted)
+{
+  EXPECT_TRUE(allDeleted<model::CppEntity>(_changedBefore.entities));
+  EXPECT_TRUE(allDeleted<model::CppInheritance>(_changedBefore.inheritances));
+  EXPECT_TRUE(allDeleted<model::CppFriendship>(_changedBefore.friendships));
+  EXPECT_TRUE(allDeleted<model::CppEdge>(_changedBefore.edges));
+  EXPECT_TRUE(allDeleted<model::BuildAction>(_changedBefore.actions));
+
+  // The modified file has none of these relations.
+  EXPECT_TRUE(_changedAfter.inheritances.empty());
+  EXPECT_TRUE(_changedAfter.friendships.empty());
+  EXPECT_TRUE(_changedAfter.edges.empty());
+}
+
+TEST_F(CppCleanupTest, ModifiedFileIsParsed)
+{
+  EXPECT_FALSE(_changedAfter.entities.empty());
+  EXPECT_FALSE(_changedAfter.actions.empty());
+
+  util::OdbTransaction {_db} ([&]() {
+    EXPECT_TRUE(_db->query_one<model::CppFunction>(
+      QCppFunction::name == "changedFunction"));
+  });
+}
+
+TEST_F(CppCleanupTest, UnaffectedRowsAreKept)
+{
+  EXPECT_FALSE(_unchangedBefore.entities.empty());
+  EXPECT_FALSE(_unchangedBefore.inheritances.empty());
+  EXPECT_FALSE(_unchangedBefore.friendships.empty());
+  EXPECT_FALSE(_unchangedBefore.edges.empty());
+  EXPECT_FALSE(_unchangedBefore.actions.empty());
+
+  EXPECT_EQ(_unchangedBefore.entities, _unchangedAfter.entities);
+  EXPECT_EQ(_unchangedBefore.inheritances, _unchangedAfter.inheritances);
+  EXPECT_EQ(_unchangedBefore.friendships, _unchangedAfter.friendships);
+  EXPECT_EQ(_unchangedBefore.edges, _unchangedAfter.edges);
+  EXPECT_EQ(_unchangedBefore.actions, _unchangedAfter.actions);
+}
@@ -4,6 +4,7 @@
 #include <gtest/gtest.h>
 
 const char* dbConnectionString;
+const char* reparseCommand = nullptr;
 
 int main(int argc, char** argv)
 {
@@ -21,6 +22,11 @@ int main(int argc, char** argv)
   GTEST_LOG_(INFO) << "Executing parser command: " << argv[2];
   system(argv[2]);
 
+  // The optional fourth argument changes the project and parses it again.
+  // It is executed by the tests which compare the two states.
+  if (argc > 4)
+    reparseCommand = argv[4];
+
   GTEST_LOG_(INFO) << "Using database for tests: " << dbConnectionString;
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
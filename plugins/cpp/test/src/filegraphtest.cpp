@@ -0,0 +1,173 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include <model/cppedge.h>
+#include <model/cppedge-odb.hxx>
+#include <model/cppfilegraph.h>
+#include <model/cppheaderinclusion.h>
+#include <model/cppheaderinclusion-odb.hxx>
+#include <model/file.h>
+#include <model/file-odb.hxx>
+
+#include <util/dbutil.h>
+#include <util/odbtransaction.h>
+
+#include "filegraph.h"
+
+using namespace cc;
+
+namespace fs = boost::filesystem;
+
+using Ids = std::vector<util::CsrGraph::NodeId>;
+
+// The tests run on a temporary SQLite database.
+#ifdef DATABASE_SQLITE
+
+class FileGraphTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/filegraphtestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = dir;
+
+    _db = util::connectDatabase(
+      "sqlite:database=" + _root + "/filegraph.sqlite");
+    ASSERT_NE(nullptr, _db);
+
+    util::createTables(_db, MODEL_SQL_DIR);
+    util::createTables(_db, CPP_MODEL_SQL_DIR);
+
+    //   a.cpp (1) -> a.h (2) -> common.h (3) <- b.h (5) <- b.cpp (4)
+    //   a.cpp (1) -> common.h (3)
+    //   c.cpp (6) -> c.h (7)
+    //   c.cpp (6) uses common.h (3)
+    util::OdbTransaction {_db} ([this]{
+      const std::vector<std::string> paths{
+        "/src/a.cpp", "/src/a.h", "/src/common.h", "/src/b.cpp",
+        "/src/b.h", "/src/c.cpp", "/src/c.h"};
+
+      for (std::size_t i = 0; i < paths.size(); ++i)
+      {
+        model::File file;
+        file.id = i + 1;
+        file.path = paths[i];
+        file.filename = fs::path(paths[i]).filename().string();
+        file.type = "CPP";
+        file.timestamp = 0;
+        _db->persist(file);
+      }
+
+      persistInclusion(1, 2);
+      persistInclusion(2, 3);
+      persistInclusion(1, 3);
+      persistInclusion(4, 5);
+      persistInclusion(5, 3);
+      persistInclusion(6, 7);
+
+      // The same inclusion by an other translation unit.
+      persistInclusion(2, 3);
+
+      persistEdge(6, 3, model::CppEdge::USE);
+    });
+  }
+
+  void TearDown() override
+  {
+    _db.reset();
+
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  void persistInclusion(model::FileId includer_, model::FileId included_)
+  {
+    model::CppHeaderInclusion inc;
+    inc.includer = odb::lazy_shared_ptr<model::File>(*_db, includer_);
+    inc.included = odb::lazy_shared_ptr<model::File>(*_db, included_);
+    _db->persist(inc);
+  }
+
+  void persistEdge(
+    model::FileId from_,
+    model::FileId to_,
+    model::CppEdge::Type type_)
+  {
+    model::CppEdge edge;
+    edge.from = _db->load<model::File>(from_);
+    edge.to = _db->load<model::File>(to_);
+    edge.type = type_;
+    edge.id = model::createIdentifier(edge);
+    _db->persist(edge);
+  }
+
+  /**
+   * Returns the files including any of the given files directly or
+   * indirectly, the way the incremental parser collects them.
+   */
+  static Ids includers(const util::CsrGraph& graph_, const Ids& files_)
+  {
+    Ids result = graph_.closure(
+      files_, util::CsrGraph::mask(model::FG_INCLUDE), true);
+    std::sort(result.begin(), result.end());
+    return result;
+  }
+
+  std::string _root;
+  std::shared_ptr<odb::database> _db;
+};
+
+TEST_F(FileGraphTest, ReverseIncludeClosure)
+{
+  std::unique_ptr<util::CsrGraph> graph;
+  util::OdbTransaction {_db} ([&]{
+    graph = parser::createFileGraph(*_db);
+  });
+  ASSERT_NE(nullptr, graph);
+
+  // The duplicate inclusion is stored once.
+  EXPECT_EQ(7u, graph->nodeCount());
+  EXPECT_EQ(7u, graph->edgeCount());
+
+  // The other kinds of edges are not followed: c.cpp only uses common.h.
+  EXPECT_EQ(Ids({1, 2, 4, 5}), includers(*graph, {3}));
+  EXPECT_EQ(Ids({1, 4}), includers(*graph, {2, 5}));
+  EXPECT_EQ(Ids({6}), includers(*graph, {7}));
+  EXPECT_EQ(Ids(), includers(*graph, {1}));
+  EXPECT_EQ(Ids(), includers(*graph, {42}));
+
+  EXPECT_EQ(
+    Ids({3}),
+    graph->successors(6, util::CsrGraph::mask(model::FG_USE)));
+}
+
+TEST_F(FileGraphTest, SavedGraph)
+{
+  std::unique_ptr<util::CsrGraph> graph;
+  util::OdbTransaction {_db} ([&]{
+    graph = parser::createFileGraph(*_db);
+  });
+
+  // The incremental parser uses the saved graph of the previous parse.
+  std::string path = model::cppFileGraphPath(_root);
+  ASSERT_TRUE(graph->save(path));
+
+  std::unique_ptr<util::CsrGraph> loaded = util::CsrGraph::load(path);
+  ASSERT_NE(nullptr, loaded);
+  EXPECT_EQ(includers(*graph, {3}), includers(*loaded, {3}));
+  EXPECT_EQ(includers(*graph, {7}), includers(*loaded, {7}));
+}
+
+#endif
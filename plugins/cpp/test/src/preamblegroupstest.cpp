@@ -0,0 +1,212 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include "preamblegroups.h"
+
+using namespace cc::parser;
+
+namespace fs = boost::filesystem;
+
+using Lines = std::vector<std::string>;
+
+class PreambleGroupsTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/preamblegroupstestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = dir;
+    _srcDir = _root + "/src";
+    fs::create_directory(_srcDir);
+  }
+
+  void TearDown() override
+  {
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  /**
+   * Writes a file into the source directory and returns its path.
+   */
+  std::string write(const std::string& name_, const std::string& content_)
+  {
+    std::string path = _srcDir + '/' + name_;
+    std::ofstream ofs(path);
+    ofs << content_;
+    return path;
+  }
+
+  /**
+   * Writes a source file starting with the given includes and returns its
+   * compile command.
+   */
+  clang::tooling::CompileCommand source(
+    const std::string& name_,
+    const Lines& includes_,
+    const std::string& flag_ = "-O2")
+  {
+    std::string content;
+    for (const std::string& include : includes_)
+      content += include + '\n';
+    write(name_, content + "\nint " + name_.substr(0, 1) + ";\n");
+
+    return clang::tooling::CompileCommand(_srcDir, name_,
+      {"g++", flag_, "-c", name_, "-o", name_ + ".o"}, name_ + ".o");
+  }
+
+  std::string _root;
+  std::string _srcDir;
+};
+
+TEST_F(PreambleGroupsTest, IncludePrefix)
+{
+  write("local.h", "");
+
+  std::string path = write("main.cpp",
+    "// Comment\n"
+    "\n"
+    "/* Comment\n"
+    "   spanning lines */\n"
+    "#include <vector>\n"
+    "  #  include   \"local.h\"  // trailing comment\n"
+    "/* comment */\n"
+    "#include \"missing.h\"\n"
+    "#include <map>\n"
+    "#define MACRO\n"
+    "#include <set>\n");
+
+  EXPECT_EQ(
+    Lines({
+      "#include <vector>",
+      "#include \"" + _srcDir + "/local.h\"",
+      "#include \"missing.h\"",
+      "#include <map>"}),
+    PreambleGroups::readIncludePrefix(path));
+}
+
+TEST_F(PreambleGroupsTest, IncludePrefixEnd)
+{
+  // The scan stops at the first line which is not an include or a comment.
+  EXPECT_EQ(
+    Lines({"#include <vector>"}),
+    PreambleGroups::readIncludePrefix(write("a.cpp",
+      "#include <vector>\n"
+      "#include_next <map>\n"
+      "#include <set>\n")));
+
+  EXPECT_EQ(
+    Lines({"#include <vector>"}),
+    PreambleGroups::readIncludePrefix(write("b.cpp",
+      "#include <vector>\n"
+      "/* comment */ int x;\n"
+      "#include <set>\n")));
+
+  EXPECT_EQ(
+    Lines({"#include <vector>"}),
+    PreambleGroups::readIncludePrefix(write("c.cpp",
+      "#include <vector>\n"
+      "#include MACRO\n"
+      "#include <set>\n")));
+
+  EXPECT_EQ(
+    Lines(),
+    PreambleGroups::readIncludePrefix(write("d.cpp",
+      "int x;\n"
+      "#include <vector>\n")));
+
+  EXPECT_EQ(Lines(), PreambleGroups::readIncludePrefix(_srcDir + "/none.cpp"));
+}
+
+TEST_F(PreambleGroupsTest, Plan)
+{
+  const Lines includes{
+    "#include <a.h>", "#include <b.h>", "#include <c.h>", "#include <d.h>"};
+
+  std::vector<clang::tooling::CompileCommand> commands{
+    source("a.cpp", includes),
+    source("b.cpp", includes),
+    source("c.cpp", {
+      "#include <a.h>", "#include <b.h>", "#include <c.h>", "#include <d.h>",
+      "#include <e.h>"}),
+    // It differs from the others at the third include.
+    source("d.cpp", {"#include <a.h>", "#include <b.h>", "#include <x.h>"}),
+    // Too few includes.
+    source("e.cpp", {"#include <a.h>", "#include <b.h>"}),
+    // Other flags.
+    source("f.cpp", includes, "-O0"),
+    source("g.cpp", includes, "-O0")};
+
+  std::vector<const clang::tooling::CompileCommand*> commandPtrs;
+  for (const clang::tooling::CompileCommand& command : commands)
+    commandPtrs.push_back(&command);
+
+  PreambleGroups preambles(_root + "/preambles");
+  preambles.plan(commandPtrs);
+
+  // The longest prefix shared by at least three translation units of the
+  // same flags.
+  ASSERT_EQ(1u, preambles.groups().size());
+
+  PreambleGroup& group = *preambles.groups().front();
+  EXPECT_EQ(_srcDir, group.directory);
+  EXPECT_EQ(includes, group.includes);
+  EXPECT_EQ(
+    std::vector<const clang::tooling::CompileCommand*>(
+      {&commands[0], &commands[1], &commands[2]}),
+    group.commands);
+
+  for (std::size_t i = 0; i < commands.size(); ++i)
+    EXPECT_EQ(i < 3 ? &group : nullptr, preambles.find(commands[i])) << i;
+
+  // The generated header contains the includes, and the precompiled header
+  // is built by the command of the first translation unit.
+  std::ifstream header(group.headerPath);
+  Lines headerLines;
+  for (std::string line; std::getline(header, line); )
+    headerLines.push_back(line);
+  EXPECT_EQ(includes, headerLines);
+
+  EXPECT_EQ(_srcDir, group.pchCommand.Directory);
+  EXPECT_EQ(group.headerPath, group.pchCommand.Filename);
+  EXPECT_EQ(
+    Lines({"g++", "-O2", "-c", group.headerPath, "-o", "a.cpp.o"}),
+    group.pchCommand.CommandLine);
+
+  // The first translation unit is the baseline parsed without the preamble.
+  EXPECT_FALSE(PreambleGroups::usesPreamble(group, commands[1]));
+  group.built = true;
+  EXPECT_FALSE(PreambleGroups::usesPreamble(group, commands[0]));
+  EXPECT_TRUE(PreambleGroups::usesPreamble(group, commands[1]));
+}
+
+TEST_F(PreambleGroupsTest, NoGroup)
+{
+  const Lines includes{"#include <a.h>", "#include <b.h>", "#include <c.h>"};
+
+  std::vector<clang::tooling::CompileCommand> commands{
+    source("a.cpp", includes),
+    source("b.cpp", includes),
+    source("c.cpp", includes, "-O0")};
+
+  PreambleGroups preambles(_root + "/preambles");
+  preambles.plan({&commands[0], &commands[1], &commands[2]});
+
+  // Two translation units are too few to share a preamble, and no directory
+  // is created for it.
+  EXPECT_TRUE(preambles.groups().empty());
+  EXPECT_EQ(nullptr, preambles.find(commands[0]));
+  EXPECT_FALSE(fs::exists(_root + "/preambles"));
+}
@@ -33,6 +33,22 @@ struct ASTNodeDetail
   2: list<ASTNodeBasic> children /** Basic details about the children nodes. */
 }
 
+/**
+ * Statistics of the server-side cache of the reparsed syntax trees.
+ */
+struct ASTCacheStatistics
+{
+  1: i64 hits /** Requests served from memory. */
+  2: i64 misses /** Requests which had to build or load the AST. */
+  3: i64 sharedBuilds /** Requests which waited for a parse of an other request. */
+  4: i64 evictions /** ASTs removed from memory. */
+  5: i64 spills /** Evicted ASTs serialized to disk. */
+  6: i64 spillLoads /** ASTs deserialized from disk instead of reparsing. */
+  7: i64 entries /** The number of ASTs currently in memory. */
+  8: i64 memoryUsage /** The memory used by the cached ASTs in bytes. */
+  9: i64 memoryLimit /** The configured memory limit in bytes. */
+}
+
 service CppReparseService
 {
   /**
@@ -50,4 +66,9 @@ service CppReparseService
    * Returns the AST for the given AST Node('s subtree) as an HTML string.
    */
   string getAsHTMLForNode(1: common.AstNodeId nodeId);
+
+  /**
+   * Returns the hit, miss and eviction statistics of the AST cache.
+   */
+  ASTCacheStatistics getCacheStatistics();
 }
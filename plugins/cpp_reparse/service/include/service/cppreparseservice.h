@@ -35,7 +35,7 @@ class CppReparseServiceHandler: virtual public CppReparseServiceIf
 public:
   CppReparseServiceHandler(
     std::shared_ptr<odb::database> db_,
-    std::shared_ptr<std::string> /* datadir_ */,
+    std::shared_ptr<std::string> datadir_,
     const cc::webserver::ServerContext& context_);
 
   ~CppReparseServiceHandler();
@@ -50,6 +50,8 @@ public:
     std::string& return_,
     const core::AstNodeId& nodeId_) override;
 
+  virtual void getCacheStatistics(ASTCacheStatistics& return_) override;
+
 private:
   std::shared_ptr<odb::database> _db;
   util::OdbTransaction _transaction;
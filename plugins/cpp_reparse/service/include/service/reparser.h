@@ -2,6 +2,7 @@
 #define CC_SERVICE_CPPREPARSESERVICE_REPARSER_H
 
 #include <memory>
+#include <mutex>
 
 #include <boost/variant.hpp>
 
@@ -29,6 +30,7 @@ namespace reparse
 {
 
 class ASTCache;
+class DatabaseFileSnapshot;
 
 class CppReparser
 {
@@ -66,6 +68,16 @@ private:
   util::OdbTransaction _transaction;
   std::shared_ptr<ASTCache> _astCache;
 
+  /**
+   * The image of the File table used by the reparses. It is created by the
+   * first reparse and shared by the later ones until the project is parsed
+   * again.
+   */
+  std::shared_ptr<const DatabaseFileSnapshot> _fileSnapshot;
+  std::mutex _fileSnapshotMutex;
+
+  std::shared_ptr<const DatabaseFileSnapshot> getFileSnapshot();
+
   std::string getFilenameForId(const core::FileId& fileId_);
 };
 
@@ -1,11 +1,20 @@
 #include <algorithm>
 
+#include <boost/filesystem.hpp>
+
+#include <clang/Basic/DiagnosticOptions.h>
+#include <clang/Basic/FileSystemOptions.h>
 #include <clang/Frontend/ASTUnit.h>
+#include <clang/Frontend/CompilerInstance.h>
+#include <clang/Lex/Preprocessor.h>
+#include <clang/Serialization/PCHContainerOperations.h>
 
 #include <util/logutil.h>
 
 #include "astcache.h"
 
+namespace fs = boost::filesystem;
+
 namespace cc
 {
 
@@ -17,9 +26,40 @@ namespace reparse
 
 using namespace clang;
 
-ASTCache::ASTCache(size_t maxCacheSize_)
-  : _maxCacheSize(maxCacheSize_)
-{}
+ASTCache::ASTCache(
+  size_t maxCacheSize_,
+  size_t maxMemory_,
+  const std::string& spillDir_)
+  : _maxCacheSize(maxCacheSize_),
+    _maxMemory(maxMemory_),
+    _spillDir(spillDir_),
+    _pchOperations(std::make_shared<PCHContainerOperations>())
+{
+  if (_spillDir.empty())
+    return;
+
+  // ASTs spilled by a previous server run may belong to an older version of
+  // the project, so they are never reused.
+  boost::system::error_code ec;
+  fs::remove_all(_spillDir, ec);
+  fs::create_directories(_spillDir, ec);
+
+  if (ec)
+  {
+    LOG(warning) << "Failed to create AST spill directory " << _spillDir
+                 << ": " << ec.message() << ". Evicted ASTs will be dropped.";
+    _spillDir.clear();
+  }
+}
+
+ASTCache::~ASTCache()
+{
+  if (!_spillDir.empty())
+  {
+    boost::system::error_code ec;
+    fs::remove_all(_spillDir, ec);
+  }
+}
 
 std::shared_ptr<clang::ASTUnit> ASTCache::getAST(const core::FileId& id_)
 {
@@ -28,49 +68,241 @@ std::shared_ptr<clang::ASTUnit> ASTCache::getAST(const core::FileId& id_)
   if (it == _cache.end())
     return nullptr;
 
-  return it->second.getAST();
+  ++_stats.hits;
+  return hit(it->second);
 }
 
 std::shared_ptr<ASTUnit> ASTCache::storeAST(
   const core::FileId& id_,
   std::unique_ptr<ASTUnit> AST_)
 {
-  if (_cache.size() >= _maxCacheSize)
-    pruneEntries();
+  std::shared_ptr<ASTUnit> result;
+  std::vector<std::pair<core::FileId, std::shared_ptr<ASTUnit>>> evicted;
 
-  std::lock_guard<std::mutex> lock(_lock);
-  auto it = _cache.find(id_);
-  if (it != _cache.end())
-    // If the key already exists in the map, it has to be overwritten.
-    // This cannot be done pre-C++17 without clearing the element first.
-    _cache.erase(it);
+  {
+    std::lock_guard<std::mutex> lock(_lock);
+
+    auto it = _cache.find(id_);
+    if (it != _cache.end())
+    {
+      // If the key already exists, the entry is overwritten.
+      _stats.memoryUsage -= it->second->second.memoryUsage();
+      _entries.erase(it->second);
+      _cache.erase(it);
+    }
+
+    _entries.emplace_front(id_, std::move(AST_));
+    _cache.emplace(id_, _entries.begin());
+    _stats.memoryUsage += _entries.front().second.memoryUsage();
+
+    // The returned reference keeps the new entry from being pruned.
+    result = _entries.front().second.getAST();
+    evicted = pruneEntries();
+  }
+
+  spill(evicted);
+
+  return result;
+}
 
-  auto result = _cache.emplace(id_, std::move(AST_));
-  return result.first->second.getAST();
+ASTCache::ASTResult ASTCache::getOrBuildAST(
+  const core::FileId& id_,
+  ASTBuilder builder_)
+{
+  std::promise<ASTResult> promise;
+
+  {
+    std::unique_lock<std::mutex> lock(_lock);
+
+    auto it = _cache.find(id_);
+    if (it != _cache.end())
+    {
+      ++_stats.hits;
+      return hit(it->second);
+    }
+
+    auto flight = _inFlight.find(id_);
+    if (flight != _inFlight.end())
+    {
+      ++_stats.sharedBuilds;
+      std::shared_future<ASTResult> future = flight->second;
+      lock.unlock();
+
+      LOG(debug) << "Waiting for the AST of " << id_
+                 << " which is being built by an other request...";
+      return future.get();
+    }
+
+    ++_stats.misses;
+    _inFlight.emplace(id_, promise.get_future().share());
+  }
+
+  ASTResult result;
+
+  try
+  {
+    std::unique_ptr<ASTUnit> AST = loadSpilled(id_);
+    if (!AST)
+    {
+      auto built = builder_();
+      if (std::string* err = boost::get<std::string>(&built))
+        result = *err;
+      else
+        AST = std::move(boost::get<std::unique_ptr<ASTUnit>>(built));
+    }
+
+    if (AST)
+      result = storeAST(id_, std::move(AST));
+  }
+  catch (const std::exception& ex)
+  {
+    // The waiting requests must be released even if the build failed.
+    result = std::string("Building the AST failed: ") + ex.what();
+  }
+
+  // The entry is removed from the in-flight map before the waiting requests
+  // are notified, so a failed build can be retried by later requests.
+  {
+    std::lock_guard<std::mutex> lock(_lock);
+    _inFlight.erase(id_);
+  }
+  promise.set_value(result);
+
+  return result;
 }
 
-void ASTCache::pruneEntries()
+ASTCache::Statistics ASTCache::statistics()
 {
   std::lock_guard<std::mutex> lock(_lock);
+  Statistics stats = _stats;
+  stats.entries = _cache.size();
+  return stats;
+}
+
+std::size_t ASTCache::measureMemory(const ASTUnit& AST_)
+{
+  const ASTContext& context = AST_.getASTContext();
+  const SourceManager& srcMgr = AST_.getSourceManager();
+
+  std::size_t memory
+    = context.getASTAllocatedMemory()
+    + context.getSideTableAllocatedMemory()
+    + srcMgr.getContentCacheSize()
+    + srcMgr.getDataStructureSizes();
 
-  while (_cache.size() >= _maxCacheSize)
+  if (AST_.getPreprocessorPtr())
+    memory += AST_.getPreprocessor().getTotalMemory();
+
+  return memory;
+}
+
+std::shared_ptr<ASTUnit> ASTCache::hit(EntryList::iterator entry_)
+{
+  _entries.splice(_entries.begin(), _entries, entry_);
+  return entry_->second.getAST();
+}
+
+std::vector<std::pair<core::FileId, std::shared_ptr<ASTUnit>>>
+ASTCache::pruneEntries()
+{
+  std::vector<std::pair<core::FileId, std::shared_ptr<ASTUnit>>> evicted;
+
+  // The entries are visited from the least recently used one. ASTs which are
+  // currently in use can't be freed, so evicting them is pointless.
+  auto it = _entries.end();
+
+  while ((_cache.size() > _maxCacheSize || _stats.memoryUsage > _maxMemory)
+    && it != _entries.begin())
+  {
+    --it;
+
+    if (it->second.referenceCount() != 0)
+      continue;
+
+    LOG(debug) << "Evicting AST of " << it->first << " ("
+               << it->second.memoryUsage() / 1048576 << " MiB)";
+
+    ++_stats.evictions;
+    _stats.memoryUsage -= it->second.memoryUsage();
+    evicted.emplace_back(it->first, it->second.release());
+    _cache.erase(it->first);
+
+    // The iterator points to the next, more recently used entry, which has
+    // already been visited.
+    it = _entries.erase(it);
+  }
+
+  return evicted;
+}
+
+void ASTCache::spill(
+  const std::vector<std::pair<core::FileId, std::shared_ptr<ASTUnit>>>&
+    evicted_)
+{
+  if (_spillDir.empty())
+    return;
+
+  for (const auto& entry : evicted_)
   {
-    // For now, remove the element who wasn't touched for the longest time.
-    auto elemToRemove = std::min_element(
-        _cache.begin(), _cache.end(),
-        [](const auto& lhs, const auto& rhs)
-        {
-          return lhs.second.lastHit() < rhs.second.lastHit();
-        });
-
-    _cache.erase(elemToRemove);
+    // ASTUnit::Save() returns true on error.
+    if (entry.second->Save(spillPath(entry.first)))
+    {
+      LOG(warning) << "Failed to spill the AST of " << entry.first;
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lock(_lock);
+    ++_stats.spills;
   }
 }
 
+std::unique_ptr<ASTUnit> ASTCache::loadSpilled(const core::FileId& id_)
+{
+  if (_spillDir.empty())
+    return nullptr;
+
+  std::string path = spillPath(id_);
+
+  boost::system::error_code ec;
+  if (!fs::is_regular_file(path, ec))
+    return nullptr;
+
+  std::unique_ptr<ASTUnit> AST = ASTUnit::LoadFromASTFile(
+    path,
+    _pchOperations->getRawReader(),
+    ASTUnit::LoadEverything,
+    CompilerInstance::createDiagnostics(new DiagnosticOptions()),
+    FileSystemOptions());
+
+  // The AST file is consumed either way: a loaded AST lives in the cache and
+  // a broken file would fail again.
+  fs::remove(path, ec);
+
+  if (!AST)
+  {
+    LOG(warning) << "Failed to load spilled AST of " << id_
+                 << ", reparsing the file.";
+    return nullptr;
+  }
+
+  LOG(debug) << "Loaded spilled AST of " << id_;
+
+  std::lock_guard<std::mutex> lock(_lock);
+  ++_stats.spillLoads;
+
+  return AST;
+}
+
+std::string ASTCache::spillPath(const core::FileId& id_) const
+{
+  return _spillDir + '/' + id_ + ".ast";
+}
+
 ASTCache::ASTCacheEntry::ASTCacheEntry(std::unique_ptr<clang::ASTUnit> AST_)
   : _AST(std::move(AST_)),
     _hitCount(0),
-    _lastHit(std::chrono::steady_clock::now())
+    _lastHit(std::chrono::steady_clock::now()),
+    _memoryUsage(measureMemory(*_AST))
 {}
 
 std::shared_ptr<ASTUnit> ASTCache::ASTCacheEntry::getAST()
@@ -90,6 +322,11 @@ std::chrono::steady_clock::time_point ASTCache::ASTCacheEntry::lastHit() const
   return _lastHit;
 }
 
+size_t ASTCache::ASTCacheEntry::memoryUsage() const
+{
+  return _memoryUsage;
+}
+
 size_t ASTCache::ASTCacheEntry::referenceCount() const
 {
   auto useCount = static_cast<size_t>(_AST.use_count());
@@ -98,6 +335,11 @@ size_t ASTCache::ASTCacheEntry::referenceCount() const
   return useCount - 1;
 }
 
+std::shared_ptr<ASTUnit> ASTCache::ASTCacheEntry::release()
+{
+  return std::move(_AST);
+}
+
 } // namespace language
 } // namespace service
 } // namespace cc
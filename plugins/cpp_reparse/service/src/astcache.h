@@ -2,9 +2,17 @@
 #define CC_SERVICE_CPPREPARSESERVICE_ASTCACHE_H
 
 #include <chrono>
+#include <functional>
+#include <future>
+#include <list>
 #include <map>
 #include <memory>
 #include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/variant.hpp>
 
 // Required for the Thrift objects, such as core::FileId.
 #include "cppreparse_types.h"
@@ -12,6 +20,7 @@
 namespace clang
 {
 class ASTUnit;
+class PCHContainerOperations;
 } // namespace clang
 
 namespace cc
@@ -28,23 +37,67 @@ namespace reparse
  * of having to parse source files over and over again, as it is a *very*
  * costly operation.
  *
+ * The cache is limited both by the number of entries and by the memory used by
+ * the cached ASTs. Evicted ASTs can be serialized into AST files in a spill
+ * directory, so a later request for the same file deserializes the AST
+ * instead of reparsing the translation unit. The deserialized AST resolves
+ * its input files on the real file system, not on the database file system
+ * which built it, so spilling is only usable if the sources of the project
+ * are on the disk of the server, unchanged since parsing.
+ *
  * This class owns the ASTUnit instances cached. It is expected that this
  * class outlives the execution of FrontendActions over an AST.
  */
 class ASTCache
 {
 public:
+  /**
+   * The result of a cache lookup: either the AST or the reason why the AST
+   * could not be built.
+   */
+  typedef boost::variant<std::shared_ptr<clang::ASTUnit>, std::string>
+    ASTResult;
+
+  /**
+   * Function which builds the AST of a translation unit on a cache miss.
+   */
+  typedef std::function<
+    boost::variant<std::unique_ptr<clang::ASTUnit>, std::string>()>
+    ASTBuilder;
+
+  struct Statistics
+  {
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t sharedBuilds = 0; /*!< Requests which waited for a parse
+                                       started by an other request. */
+    std::size_t evictions = 0;
+    std::size_t spills = 0;
+    std::size_t spillLoads = 0;
+    std::size_t entries = 0;
+    std::size_t memoryUsage = 0;
+  };
 
   /**
-   * @param maxCacheSize_ The maximum size of the cache above which automatic
-   * pruning of old entries will take place. This is not an absolute limit, the
-   * cache is allowed to overfill in case no more entries could be pruned.
+   * @param maxCacheSize_ The maximum number of entries in the cache above
+   * which automatic pruning of old entries will take place.
+   * @param maxMemory_ The maximum memory (in bytes) used by the cached ASTs.
+   * @param spillDir_ Directory where the evicted ASTs are serialized. If empty
+   * then evicted ASTs are dropped. See the class comment for the requirements
+   * of spilling.
+   *
+   * The limits are not absolute: ASTs which are in use by a request are never
+   * evicted, so the cache is allowed to overfill in case no more entries could
+   * be pruned.
    */
-  ASTCache(size_t maxCacheSize_);
+  ASTCache(
+    std::size_t maxCacheSize_,
+    std::size_t maxMemory_,
+    const std::string& spillDir_ = "");
 
   ASTCache(const ASTCache&) = delete;
   ASTCache& operator=(const ASTCache&) = delete;
-  ~ASTCache() = default;
+  ~ASTCache();
 
   /**
    * Retrieves the AST stored for the given file ID, or a nullptr if none is
@@ -61,6 +114,16 @@ public:
     const core::FileId& id_,
     std::unique_ptr<clang::ASTUnit> AST_);
 
+  /**
+   * Returns the AST of the given file. On a cache miss the AST is loaded from
+   * the spill directory or built by builder_. Concurrent requests for the same
+   * file share a single build: only the first one calls builder_, the others
+   * wait for its result.
+   */
+  ASTResult getOrBuildAST(const core::FileId& id_, ASTBuilder builder_);
+
+  Statistics statistics();
+
 private:
 
   class ASTCacheEntry
@@ -78,6 +141,11 @@ private:
     size_t hitCount() const;
     std::chrono::steady_clock::time_point lastHit() const;
 
+    /**
+     * Returns the memory used by the AST, measured when the entry was created.
+     */
+    size_t memoryUsage() const;
+
     /**
      * Returns the number of EXTERNAL (not counting the reference made by the
      * smart pointer stored in the current instance) references that are
@@ -85,6 +153,11 @@ private:
      */
     size_t referenceCount() const;
 
+    /**
+     * Releases the AST from the entry.
+     */
+    std::shared_ptr<clang::ASTUnit> release();
+
   private:
     std::shared_ptr<clang::ASTUnit> _AST;
 
@@ -98,17 +171,57 @@ private:
      * retrieved, this timestamp stores the time when it was stored.
      */
     std::chrono::steady_clock::time_point _lastHit;
+
+    size_t _memoryUsage;
   };
 
   /**
-   * Handles the clearing of the cache if there are more elements than
-   * _maxCacheSize stored.
+   * Returns an approximation of the heap memory allocated for the AST.
+   */
+  static std::size_t measureMemory(const clang::ASTUnit& AST_);
+
+  /**
+   * The entries ordered by their last use, the most recently used first.
+   */
+  typedef std::list<std::pair<core::FileId, ASTCacheEntry>> EntryList;
+
+  /**
+   * Returns the AST of the entry and moves the entry to the front of the
+   * LRU list. The caller must hold _lock.
+   */
+  std::shared_ptr<clang::ASTUnit> hit(EntryList::iterator entry_);
+
+  /**
+   * Removes the least recently used, currently unreferenced entries while
+   * the cache is over one of its limits. The caller must hold _lock.
+   * @return The evicted ASTs, which should be spilled after releasing the lock.
+   */
+  std::vector<std::pair<core::FileId, std::shared_ptr<clang::ASTUnit>>>
+  pruneEntries();
+
+  /**
+   * Serializes the evicted ASTs into the spill directory.
    */
-  void pruneEntries();
+  void spill(
+    const std::vector<std::pair<
+      core::FileId, std::shared_ptr<clang::ASTUnit>>>& evicted_);
+
+  /**
+   * Loads a previously spilled AST, or returns nullptr if there is none.
+   */
+  std::unique_ptr<clang::ASTUnit> loadSpilled(const core::FileId& id_);
+
+  std::string spillPath(const core::FileId& id_) const;
 
   std::mutex _lock;
-  std::map<core::FileId, ASTCacheEntry> _cache;
+  EntryList _entries;
+  std::map<core::FileId, EntryList::iterator> _cache;
+  std::map<core::FileId, std::shared_future<ASTResult>> _inFlight;
   size_t _maxCacheSize;
+  size_t _maxMemory;
+  std::string _spillDir;
+  std::shared_ptr<clang::PCHContainerOperations> _pchOperations;
+  Statistics _stats;
 };
 
 } // namespace reparse
@@ -38,7 +38,7 @@ using namespace clang::tooling;
 
 CppReparseServiceHandler::CppReparseServiceHandler(
   std::shared_ptr<odb::database> db_,
-  std::shared_ptr<std::string> /* datadir_ */,
+  std::shared_ptr<std::string> datadir_,
   const cc::webserver::ServerContext& context_)
   : _db(db_),
     _transaction(db_),
@@ -56,7 +56,12 @@ CppReparseServiceHandler::CppReparseServiceHandler(
       maxCacheSize = jobs;
     }
 
-    _astCache = std::make_shared<ASTCache>(maxCacheSize);
+    size_t maxMemory = _config["ast-cache-memory-limit"].as<size_t>() << 20;
+    std::string spillDir = _config["ast-cache-spill"].as<bool>()
+      ? *datadir_ + "/reparse"
+      : std::string();
+
+    _astCache = std::make_shared<ASTCache>(maxCacheSize, maxMemory, spillDir);
     _reparser = std::make_unique<CppReparser>(_db, _astCache);
   }
 }
@@ -144,6 +149,25 @@ void CppReparseServiceHandler::getAsHTMLForNode(
   return_ = htmlFactory.str();
 }
 
+void CppReparseServiceHandler::getCacheStatistics(
+  ASTCacheStatistics& return_)
+{
+  if (!isEnabled())
+    return;
+
+  ASTCache::Statistics stats = _astCache->statistics();
+
+  return_.hits = stats.hits;
+  return_.misses = stats.misses;
+  return_.sharedBuilds = stats.sharedBuilds;
+  return_.evictions = stats.evictions;
+  return_.spills = stats.spills;
+  return_.spillLoads = stats.spillLoads;
+  return_.entries = stats.entries;
+  return_.memoryUsage = stats.memoryUsage;
+  return_.memoryLimit = _config["ast-cache-memory-limit"].as<size_t>() << 20;
+}
+
 } // namespace language
 } // namespace service
 } // namespace cc
@@ -6,10 +6,17 @@
 #include <llvm/ADT/SmallString.h>
 #include <llvm/Support/Path.h>
 
+#include <model/databasegeneration.h>
 #include <model/file.h>
 #include <model/file-odb.hxx>
 #include <model/filecontent.h>
 #include <model/filecontent-odb.hxx>
+#include <model/filecontentblock.h>
+#include <model/filecontentblock-odb.hxx>
+#include <model/filecontentstore.h>
+
+#include <util/dbutil.h>
+#include <util/logutil.h>
 
 #include "databasefilesystem.h"
 
@@ -21,42 +28,9 @@ namespace
 
 using namespace cc;
 
-typedef odb::query<model::File> FileQuery;
-typedef odb::result<model::File> FileResult;
-typedef odb::query<model::FileContentLength> FileContentLengthQuery;
-typedef odb::result<model::FileContentLength> FileContentLengthResult;
-
-/**
- * Retrieve a file by path from the database.
- */
-model::FilePtr getFile(
-  odb::database& db_,
-  const std::string& path_)
-{
-  model::FilePtr file;
-  util::OdbTransaction {db_} ([&]() {
-    file = db_.query_one<model::File>(FileQuery::path == path_);
-  });
-  return file;
-}
-
-/**
- * Retrieve the children of the given path from the database.
- */
-std::vector<model::FilePtr> getChildrenOfFile(
-  odb::database& db_,
-  const model::FileId& fileId_)
-{
-  std::vector<model::FilePtr> result;
-  util::OdbTransaction {db_} ([&]() {
-    FileResult res = db_.query<model::File>(FileQuery::parent == fileId_);
-    for (auto fp : res)
-      result.push_back(std::make_shared<model::File>(std::move(fp)));
-  });
-  return result;
-}
+using Entry = service::reparse::DatabaseFileSnapshot::Entry;
 
-directory_entry fileToEntry(const model::File& file_)
+directory_entry fileToEntry(const Entry& file_)
 {
   using namespace llvm::sys::fs;
 
@@ -71,28 +45,14 @@ directory_entry fileToEntry(const model::File& file_)
   return {file_.path, fileType};
 }
 
-Status fileToStatus(
-  odb::database& db_,
-  const model::File& file_)
+Status fileToStatus(const Entry& file_)
 {
   using namespace llvm::sys::fs;
   vfs::directory_entry entry = fileToEntry(file_);
 
-  size_t size = 0;
-  if (file_.content)
-    util::OdbTransaction {db_} ([&]() {
-      // For some weird thing, query_one produces an error here if one attempts
-      // to use a std::shared_ptr as the result of the query_one().
-      FileContentLengthResult res = db_.query<model::FileContentLength>(
-        FileContentLengthQuery::hash == file_.content.object_id());
-
-      if (!res.empty())
-        size = res.begin()->size;
-    });
-
   return Status(file_.path, UniqueID(0, file_.id),
                 sys::toTimePoint(file_.timestamp), 0, 0,
-                size, entry.type(), perms::all_read);
+                file_.size, entry.type(), perms::all_read);
 }
 
 /**
@@ -102,19 +62,19 @@ Status fileToStatus(
 class DatabaseDirectoryIterator : public vfs::detail::DirIterImpl
 {
 public:
-  DatabaseDirectoryIterator(odb::database& db_,
-                            const model::FilePtr& dir_,
-                            std::error_code& ec_)
-    : _db(db_)
+  DatabaseDirectoryIterator(
+    service::reparse::DatabaseFileSnapshotPtr snapshot_,
+    const Entry& dir_,
+    std::error_code& ec_)
+    : _snapshot(snapshot_)
   {
-    if (dir_->type != model::File::DIRECTORY_TYPE)
+    if (dir_.type != model::File::DIRECTORY_TYPE)
     {
       ec_ = std::error_code(EIO, std::generic_category());
       return;
     }
 
-    for (const auto& fp : getChildrenOfFile(db_, dir_->id))
-      _remainingEntries.push_back(fp);
+    _remainingEntries.assign(dir_.children.begin(), dir_.children.end());
 
     // This sets the iterator's current element to the first one, if exists.
     ec_ = increment();
@@ -130,14 +90,14 @@ public:
       return std::error_code(ENOENT, std::generic_category());
     }
 
-    CurrentEntry = fileToEntry(*_remainingEntries.front());
+    CurrentEntry = fileToEntry(_snapshot->entry(_remainingEntries.front()));
     _remainingEntries.pop_front();
     return std::error_code();
   }
 
 private:
-  odb::database& _db;
-  std::deque<model::FilePtr> _remainingEntries;
+  service::reparse::DatabaseFileSnapshotPtr _snapshot;
+  std::deque<std::uint32_t> _remainingEntries;
 };
 
 /**
@@ -146,12 +106,14 @@ private:
 class DatabaseFile : public File
 {
 public:
-  DatabaseFile(const Status& status_, std::string&& content_)
+  DatabaseFile(
+    const Status& status_,
+    std::shared_ptr<const std::string> content_)
     : _status(status_),
       _content(std::move(content_))
   {
-    assert(_content.size() == status_.getSize() && "The content's size should "
-           "be the same as known by the status.");
+    assert(_content->size() == status_.getSize() && "The content's size "
+           "should be the same as known by the status.");
   }
 
   virtual ~DatabaseFile()
@@ -173,14 +135,14 @@ public:
     // The buffer is copied into a MemoryBuffer that owns the copied contents,
     // because Clang seems to call close() on the File entry *before* giving it
     // to the parser, which means the instance's _content is destroyed early.
-    return MemoryBuffer::getMemBufferCopy(_content, _status.getName());
+    return MemoryBuffer::getMemBufferCopy(*_content, _status.getName());
   }
 
   std::error_code close() override { return {}; }
 
 private:
   const Status _status;
-  const std::string _content;
+  const std::shared_ptr<const std::string> _content;
 };
 
 } // namespace (anonymous)
@@ -193,48 +155,184 @@ namespace service
 namespace reparse
 {
 
-DatabaseFileSystem::DatabaseFileSystem(std::shared_ptr<odb::database> db_)
+DatabaseFileSnapshot::DatabaseFileSnapshot(
+  std::shared_ptr<odb::database> db_,
+  std::size_t maxContentCache_)
   : _db(db_),
-    _transaction(db_),
+    // The generation is read first, so that a parsing which runs during the
+    // creation is detected by the next refresh().
+    _generation(model::loadDatabaseGeneration(db_)),
+    _contentSize(0),
+    _maxContentSize(maxContentCache_)
+{
+  std::unordered_map<std::string, std::size_t> sizes;
+  std::vector<model::FileId> parents;
+
+  // Databases of projects parsed by an earlier version have no compressed
+  // contents.
+  bool compressed = util::tableExists(_db, "FileContentIndex");
+
+  util::OdbTransaction {_db} ([&]() {
+    for (const model::FileContentLength& length
+      : _db->query<model::FileContentLength>())
+      sizes.emplace(length.hash, length.size);
+
+    // The plain text of a compressed content is empty.
+    if (compressed)
+      for (const model::FileContentIndexSize& index
+        : _db->query<model::FileContentIndexSize>())
+        sizes[index.hash] = index.size;
+
+    for (const model::File& file : _db->query<model::File>())
+    {
+      Entry entry;
+      entry.id = file.id;
+      entry.path = file.path;
+      entry.type = file.type;
+      entry.timestamp = file.timestamp;
+      entry.size = 0;
+
+      if (file.content)
+      {
+        entry.contentHash = file.content.object_id();
+
+        auto it = sizes.find(entry.contentHash);
+        if (it != sizes.end())
+          entry.size = it->second;
+      }
+
+      parents.push_back(file.parent ? file.parent.object_id() : 0);
+      _entries.push_back(std::move(entry));
+    }
+  });
+
+  std::unordered_map<model::FileId, std::uint32_t> idIndex;
+  for (std::uint32_t i = 0; i < _entries.size(); ++i)
+  {
+    idIndex.emplace(_entries[i].id, i);
+    _pathIndex.emplace(_entries[i].path, i);
+  }
+
+  for (std::uint32_t i = 0; i < _entries.size(); ++i)
+  {
+    auto it = idIndex.find(parents[i]);
+    if (parents[i] && it != idIndex.end())
+      _entries[it->second].children.push_back(i);
+  }
+
+  LOG(debug) << "File snapshot created for reparse with " << _entries.size()
+             << " files";
+}
+
+std::shared_ptr<const DatabaseFileSnapshot> DatabaseFileSnapshot::refresh(
+  std::shared_ptr<odb::database> db_,
+  std::shared_ptr<const DatabaseFileSnapshot> snapshot_)
+{
+  if (snapshot_ &&
+      snapshot_->generation() == model::loadDatabaseGeneration(db_))
+    return snapshot_;
+
+  return std::make_shared<DatabaseFileSnapshot>(db_);
+}
+
+const DatabaseFileSnapshot::Entry* DatabaseFileSnapshot::find(
+  const std::string& path_) const
+{
+  auto it = _pathIndex.find(path_);
+  return it == _pathIndex.end() ? nullptr : &_entries[it->second];
+}
+
+std::shared_ptr<const std::string> DatabaseFileSnapshot::content(
+  const Entry& file_) const
+{
+  if (file_.contentHash.empty())
+    return nullptr;
+
+  {
+    std::lock_guard<std::mutex> lock(_contentLock);
+
+    auto it = _contents.find(file_.contentHash);
+    if (it != _contents.end())
+    {
+      _contentLru.splice(_contentLru.begin(), _contentLru, it->second);
+      return it->second->second;
+    }
+  }
+
+  std::shared_ptr<std::string> content;
+  util::OdbTransaction {_db} ([&]() {
+    std::shared_ptr<model::FileContent> fileContent
+      = _db->find<model::FileContent>(file_.contentHash);
+
+    if (fileContent)
+      content = std::make_shared<std::string>(
+        model::loadFileContent(*_db, *fileContent));
+  });
+
+  if (!content)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(_contentLock);
+
+  // An other thread may have loaded the same content in the meantime.
+  auto it = _contents.find(file_.contentHash);
+  if (it != _contents.end())
+    return it->second->second;
+
+  _contentLru.emplace_front(file_.contentHash, content);
+  _contents.emplace(file_.contentHash, _contentLru.begin());
+  _contentSize += content->size();
+
+  while (_contentSize > _maxContentSize && _contentLru.size() > 1)
+  {
+    _contentSize -= _contentLru.back().second->size();
+    _contents.erase(_contentLru.back().first);
+    _contentLru.pop_back();
+  }
+
+  return content;
+}
+
+DatabaseFileSystem::DatabaseFileSystem(DatabaseFileSnapshotPtr snapshot_)
+  : _snapshot(snapshot_),
     _currentWorkingDirectory("/")
 {}
 
 ErrorOr<Status> DatabaseFileSystem::status(const Twine& path_)
 {
-  model::FilePtr file = getFile(*_db, path_.str());
+  const Entry* file = _snapshot->find(path_.str());
   if (!file)
     return std::error_code(ENOENT, std::generic_category());
 
-  return fileToStatus(*_db, *file);
+  return fileToStatus(*file);
 }
 
 ErrorOr<std::unique_ptr<File>>
 DatabaseFileSystem::openFileForRead(const Twine& path_)
 {
-  model::FilePtr file = getFile(*_db, path_.str());
+  const Entry* file = _snapshot->find(path_.str());
   if (!file)
     return std::error_code(ENOENT, std::generic_category());
   if (file->type == model::File::DIRECTORY_TYPE)
     return std::error_code(EISDIR, std::generic_category());
-  if (file->type == model::File::UNKNOWN_TYPE || !file->content)
+  if (file->type == model::File::UNKNOWN_TYPE || file->contentHash.empty())
     return std::error_code(EIO, std::generic_category());
 
-  std::unique_ptr<File> dbFile;
-  _transaction([&](){
-    dbFile = std::make_unique<DatabaseFile>(
-      fileToStatus(*_db, *file),
-      std::move(file->content.load()->content));
-  });
-  return std::move(dbFile);
+  std::shared_ptr<const std::string> content = _snapshot->content(*file);
+  if (!content)
+    return std::error_code(EIO, std::generic_category());
+
+  return std::unique_ptr<File>(
+    std::make_unique<DatabaseFile>(fileToStatus(*file), content));
 }
 
 directory_iterator
 DatabaseFileSystem::dir_begin(const Twine& dir_, std::error_code& ec_)
 {
-  model::FilePtr dirFile = getFile(*_db, dir_.str());
-  if (dirFile &&  dirFile->type == model::File::DIRECTORY_TYPE)
+  const Entry* dirFile = _snapshot->find(dir_.str());
+  if (dirFile && dirFile->type == model::File::DIRECTORY_TYPE)
     return directory_iterator(std::make_shared<DatabaseDirectoryIterator>(
-      *_db, dirFile, ec_));
+      _snapshot, *dirFile, ec_));
 
   // If the folder does not exist, or isn't a folder, return an end-iterator.
   return directory_iterator();
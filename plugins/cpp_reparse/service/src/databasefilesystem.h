@@ -1,12 +1,20 @@
 #ifndef CC_SERVICE_CPPREPARSESERVICE_DATABASEFILESYSTEM_H
 #define CC_SERVICE_CPPREPARSESERVICE_DATABASEFILESYSTEM_H
 
+#include <cstdint>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <llvm/Support/VirtualFileSystem.h>
 
 #include <odb/database.hxx>
 
+#include <model/file.h>
+
 #include <util/odbtransaction.h>
 
 namespace cc
@@ -16,14 +24,98 @@ namespace service
 namespace reparse
 {
 
+/**
+ * An immutable in-memory image of the File table which serves the file system
+ * queries of the reparse. The file tree (paths, types, sizes and children) is
+ * read by two queries when the snapshot is created. File contents are fetched
+ * lazily and kept in a size limited LRU cache.
+ *
+ * A snapshot is thread-safe and is meant to be shared by every reparse of a
+ * project. It doesn't follow the changes of the database, a new snapshot is
+ * created when the database generation changes (see refresh()).
+ */
+class DatabaseFileSnapshot
+{
+public:
+  struct Entry
+  {
+    model::FileId id;
+    std::string path;
+    std::string type;
+    std::uint64_t timestamp;
+    std::string contentHash; /*!< Empty if the file has no content. */
+    std::size_t size;
+    std::vector<std::uint32_t> children; /*!< Indices of the child entries. */
+  };
+
+  /**
+   * @param maxContentCache_ The total size (in bytes) of the file contents
+   * kept in memory.
+   */
+  DatabaseFileSnapshot(
+    std::shared_ptr<odb::database> db_,
+    std::size_t maxContentCache_ = 256 << 20);
+
+  DatabaseFileSnapshot(const DatabaseFileSnapshot&) = delete;
+  DatabaseFileSnapshot& operator=(const DatabaseFileSnapshot&) = delete;
+
+  /**
+   * Returns the given snapshot if it was created in the current generation of
+   * the database (see model/databasegeneration.h), otherwise a new snapshot.
+   * The reparses which use the earlier snapshot keep it alive.
+   */
+  static std::shared_ptr<const DatabaseFileSnapshot> refresh(
+    std::shared_ptr<odb::database> db_,
+    std::shared_ptr<const DatabaseFileSnapshot> snapshot_);
+
+  /**
+   * Returns the database generation in which the snapshot was created.
+   */
+  std::uint64_t generation() const { return _generation; }
+
+  /**
+   * Returns the entry of the given path or nullptr if the database doesn't
+   * contain it.
+   */
+  const Entry* find(const std::string& path_) const;
+
+  const Entry& entry(std::uint32_t index_) const
+  {
+    return _entries[index_];
+  }
+
+  /**
+   * Returns the content of the file from the cache, or loads it from the
+   * database on a cache miss. Returns nullptr if the file has no content.
+   */
+  std::shared_ptr<const std::string> content(const Entry& file_) const;
+
+private:
+  typedef std::list<std::pair<std::string, std::shared_ptr<const std::string>>>
+    ContentList;
+
+  std::shared_ptr<odb::database> _db;
+  std::uint64_t _generation;
+  std::vector<Entry> _entries;
+  std::unordered_map<std::string, std::uint32_t> _pathIndex;
+
+  mutable std::mutex _contentLock;
+  mutable ContentList _contentLru;
+  mutable std::unordered_map<std::string, ContentList::iterator> _contents;
+  mutable std::size_t _contentSize;
+  std::size_t _maxContentSize;
+};
+
+typedef std::shared_ptr<const DatabaseFileSnapshot> DatabaseFileSnapshotPtr;
+
 /**
  * A Clang Virtual File System implementation that retrieves file information
- * and contents from CodeCompass' database.
+ * and contents from CodeCompass' database through a DatabaseFileSnapshot.
  */
 class DatabaseFileSystem : public llvm::vfs::FileSystem
 {
 public:
-  DatabaseFileSystem(std::shared_ptr<odb::database> db_);
+  DatabaseFileSystem(DatabaseFileSnapshotPtr snapshot_);
 
   virtual ~DatabaseFileSystem() = default;
 
@@ -40,8 +132,7 @@ public:
   std::error_code setCurrentWorkingDirectory(const llvm::Twine& path_) override;
 
 private:
-  std::shared_ptr<odb::database> _db;
-  util::OdbTransaction _transaction;
+  DatabaseFileSnapshotPtr _snapshot;
 
   std::string _currentWorkingDirectory;
 };
@@ -51,4 +142,3 @@ private:
 } //namespace cc
 
 #endif // CC_SERVICE_CPPREPARSESERVICE_DATABASEFILESYSTEM_H
-
@@ -23,6 +23,20 @@ extern "C"
        "The maximum number of reparsed syntax trees that should be cached in "
        "memory.");
 
+    description.add_options()
+      ("ast-cache-memory-limit", po::value<size_t>()->default_value(4096),
+       "The maximum memory (in MiB) used by the reparsed syntax trees cached "
+       "in memory. Syntax trees above this limit are evicted from the cache, "
+       "starting with the least recently used one.");
+
+    description.add_options()
+      ("ast-cache-spill", po::value<bool>()->default_value(false),
+       "Serialize the syntax trees evicted from the cache into the workspace, "
+       "so they can be reloaded without reparsing the translation unit. A "
+       "reloaded syntax tree reads its inputs from the disk instead of the "
+       "database, so this requires the source tree of the project on the "
+       "server, in the same state as when the project was parsed.");
+
     return description;
   }
 
@@ -44,6 +44,14 @@ CppReparser::CppReparser(
     _astCache(astCache_)
 {}
 
+std::shared_ptr<const DatabaseFileSnapshot> CppReparser::getFileSnapshot()
+{
+  std::lock_guard<std::mutex> lock(_fileSnapshotMutex);
+
+  _fileSnapshot = DatabaseFileSnapshot::refresh(_db, _fileSnapshot);
+  return _fileSnapshot;
+}
+
 std::string CppReparser::getFilenameForId(const core::FileId& fileId_)
 {
   std::string fileName;
@@ -148,8 +156,8 @@ boost::variant<std::shared_ptr<clang::ASTUnit>, std::string>
 CppReparser::getASTForTranslationUnitFile(
   const core::FileId& fileId_)
 {
-  std::shared_ptr<ASTUnit> AST = _astCache->getAST(fileId_);
-  if (!AST)
+  return _astCache->getOrBuildAST(fileId_, [&, this]()
+    -> boost::variant<std::unique_ptr<ASTUnit>, std::string>
   {
     LOG(debug) << "Fetching AST for " << fileId_ << " from database...";
 
@@ -162,7 +170,7 @@ CppReparser::getASTForTranslationUnitFile(
 
     // TODO: FIXME: Change this into the shortcutting overlay creation once the interface is upstreamed. (https://reviews.llvm.org/D45094)
     IntrusiveRefCntPtr<DatabaseFileSystem> dbfs(
-      new DatabaseFileSystem(_db));
+      new DatabaseFileSystem(getFileSnapshot()));
     IntrusiveRefCntPtr<llvm::vfs::OverlayFileSystem> overlayFs(
       new llvm::vfs::OverlayFileSystem(llvm::vfs::getRealFileSystem()));
     overlayFs->pushOverlay(dbfs);
@@ -183,10 +191,8 @@ CppReparser::getASTForTranslationUnitFile(
         std::to_string(error);
     }
 
-    AST = _astCache->storeAST(fileId_, std::move(vect.at(0)));
-  }
-
-  return AST;
+    return std::move(vect.at(0));
+  });
 }
 
 } // namespace reparse
@@ -0,0 +1,247 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <clang/Frontend/ASTUnit.h>
+#include <clang/Tooling/CompilationDatabase.h>
+#include <clang/Tooling/Tooling.h>
+
+#include <gtest/gtest.h>
+
+#include "astcache.h"
+
+using namespace cc::service::reparse;
+
+namespace fs = boost::filesystem;
+
+typedef std::shared_ptr<clang::ASTUnit> ASTPtr;
+typedef boost::variant<std::unique_ptr<clang::ASTUnit>, std::string>
+  BuildResult;
+
+class ASTCacheTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/astcachetestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = dir;
+  }
+
+  void TearDown() override
+  {
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  /**
+   * Writes a source file with the given name and parses it. The file is on
+   * the disk, so the AST can be reloaded from a spilled AST file.
+   */
+  std::unique_ptr<clang::ASTUnit> buildAST(const std::string& name_)
+  {
+    std::string path = _root + '/' + name_ + ".cpp";
+    {
+      std::ofstream ofs(path);
+      ofs << "int " << name_ << "() { return 42; }\n";
+    }
+
+    clang::tooling::FixedCompilationDatabase db(_root, {"-std=c++14"});
+    clang::tooling::ClangTool tool(db, {path});
+
+    std::vector<std::unique_ptr<clang::ASTUnit>> ASTs;
+    tool.buildASTs(ASTs);
+
+    return ASTs.empty() ? nullptr : std::move(ASTs.front());
+  }
+
+  static ASTPtr get(const ASTCache::ASTResult& result_)
+  {
+    const ASTPtr* AST = boost::get<ASTPtr>(&result_);
+    return AST ? *AST : nullptr;
+  }
+
+  std::string _root;
+};
+
+TEST_F(ASTCacheTest, StoreAndGet)
+{
+  ASTCache cache(10, 1ULL << 40);
+
+  EXPECT_EQ(nullptr, cache.getAST("a"));
+
+  ASTPtr stored = cache.storeAST("a", buildAST("a"));
+  ASSERT_NE(nullptr, stored);
+  EXPECT_EQ(stored, cache.getAST("a"));
+
+  ASTCache::Statistics stats = cache.statistics();
+  EXPECT_EQ(1u, stats.entries);
+  EXPECT_EQ(1u, stats.hits);
+  EXPECT_GT(stats.memoryUsage, 0u);
+}
+
+TEST_F(ASTCacheTest, LeastRecentlyUsedIsEvicted)
+{
+  ASTCache cache(2, 1ULL << 40);
+
+  cache.storeAST("a", buildAST("a"));
+  cache.storeAST("b", buildAST("b"));
+
+  // "a" is used, so "b" becomes the least recently used one.
+  EXPECT_NE(nullptr, cache.getAST("a"));
+  cache.storeAST("c", buildAST("c"));
+
+  EXPECT_NE(nullptr, cache.getAST("a"));
+  EXPECT_EQ(nullptr, cache.getAST("b"));
+  EXPECT_NE(nullptr, cache.getAST("c"));
+
+  ASTCache::Statistics stats = cache.statistics();
+  EXPECT_EQ(2u, stats.entries);
+  EXPECT_EQ(1u, stats.evictions);
+}
+
+TEST_F(ASTCacheTest, ReferencedEntryIsKept)
+{
+  ASTCache cache(2, 1ULL << 40);
+
+  // The least recently used "a" is in use, so "b" is evicted instead.
+  ASTPtr a = cache.storeAST("a", buildAST("a"));
+  cache.storeAST("b", buildAST("b"));
+  cache.storeAST("c", buildAST("c"));
+
+  EXPECT_EQ(a, cache.getAST("a"));
+  EXPECT_EQ(nullptr, cache.getAST("b"));
+  EXPECT_NE(nullptr, cache.getAST("c"));
+
+  // The cache overfills if every entry is in use.
+  ASTPtr c = cache.getAST("c");
+  ASTPtr d = cache.storeAST("d", buildAST("d"));
+
+  EXPECT_EQ(3u, cache.statistics().entries);
+}
+
+TEST_F(ASTCacheTest, MemoryBudget)
+{
+  // Every AST is above the budget, so only the ones in use are kept.
+  ASTCache cache(10, 1);
+
+  ASTPtr a = cache.storeAST("a", buildAST("a"));
+  ASSERT_NE(nullptr, a);
+  EXPECT_EQ(1u, cache.statistics().entries);
+
+  a.reset();
+  ASTPtr b = cache.storeAST("b", buildAST("b"));
+
+  EXPECT_EQ(nullptr, cache.getAST("a"));
+  EXPECT_EQ(b, cache.getAST("b"));
+
+  ASTCache::Statistics stats = cache.statistics();
+  EXPECT_EQ(1u, stats.entries);
+  EXPECT_EQ(1u, stats.evictions);
+  EXPECT_EQ(0u, stats.spills);
+}
+
+TEST_F(ASTCacheTest, SingleFlight)
+{
+  ASTCache cache(10, 1ULL << 40);
+
+  std::atomic<int> builds(0);
+  std::promise<void> gate;
+  std::shared_future<void> opened = gate.get_future().share();
+
+  ASTCache::ASTBuilder builder = [&]() -> BuildResult
+  {
+    ++builds;
+    opened.wait();
+    return buildAST("a");
+  };
+
+  auto first = std::async(std::launch::async,
+    [&]{ return cache.getOrBuildAST("a", builder); });
+
+  while (builds == 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  // The second request waits for the build of the first one.
+  auto second = std::async(std::launch::async,
+    [&]{ return cache.getOrBuildAST("a", builder); });
+
+  while (cache.statistics().sharedBuilds == 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+  gate.set_value();
+
+  ASTPtr firstAST = get(first.get());
+  ASTPtr secondAST = get(second.get());
+
+  ASSERT_NE(nullptr, firstAST);
+  EXPECT_EQ(firstAST, secondAST);
+  EXPECT_EQ(1, builds);
+
+  ASTCache::Statistics stats = cache.statistics();
+  EXPECT_EQ(1u, stats.misses);
+  EXPECT_EQ(1u, stats.sharedBuilds);
+}
+
+TEST_F(ASTCacheTest, FailedBuildIsRetried)
+{
+  ASTCache cache(10, 1ULL << 40);
+
+  int builds = 0;
+
+  ASTCache::ASTResult result = cache.getOrBuildAST("a", [&]() -> BuildResult
+  {
+    ++builds;
+    return std::string("error");
+  });
+
+  const std::string* error = boost::get<std::string>(&result);
+  ASSERT_NE(nullptr, error);
+  EXPECT_EQ("error", *error);
+
+  result = cache.getOrBuildAST("a", [&]() -> BuildResult
+  {
+    ++builds;
+    return buildAST("a");
+  });
+
+  EXPECT_NE(nullptr, get(result));
+  EXPECT_EQ(2, builds);
+}
+
+TEST_F(ASTCacheTest, SpilledASTIsReloaded)
+{
+  ASTCache cache(1, 1ULL << 40, _root + "/spill");
+
+  cache.storeAST("a", buildAST("a"));
+  cache.storeAST("b", buildAST("b"));
+
+  ASTCache::Statistics stats = cache.statistics();
+  EXPECT_EQ(1u, stats.evictions);
+  EXPECT_EQ(1u, stats.spills);
+
+  // The evicted AST is loaded from the spill directory instead of building
+  // it again.
+  int builds = 0;
+  ASTPtr a = get(cache.getOrBuildAST("a", [&]() -> BuildResult
+  {
+    ++builds;
+    return buildAST("a");
+  }));
+
+  ASSERT_NE(nullptr, a);
+  EXPECT_EQ(0, builds);
+  EXPECT_EQ(1u, cache.statistics().spillLoads);
+}
@@ -0,0 +1,189 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <gtest/gtest.h>
+
+#include <model/databasegeneration.h>
+#include <model/file.h>
+#include <model/file-odb.hxx>
+#include <model/filecontent.h>
+#include <model/filecontent-odb.hxx>
+
+#include <util/dbutil.h>
+#include <util/odbtransaction.h>
+
+#include "databasefilesystem.h"
+
+using namespace cc;
+using namespace cc::service::reparse;
+
+namespace fs = boost::filesystem;
+
+// The tests run on a temporary SQLite database.
+#ifdef DATABASE_SQLITE
+
+class DatabaseFileSystemTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/databasefilesystemtestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = dir;
+
+    _db = util::connectDatabase(
+      "sqlite:database=" + _root + "/files.sqlite");
+    ASSERT_NE(nullptr, _db);
+
+    util::createTables(_db, MODEL_SQL_DIR);
+
+    persistFile(1, "/", model::File::DIRECTORY_TYPE, 0);
+    persistFile(2, "/src", model::File::DIRECTORY_TYPE, 1);
+    persistFile(3, "/src/a.h", "CPP", 2, "int a;\n");
+  }
+
+  void TearDown() override
+  {
+    _db.reset();
+
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  /**
+   * Stores a file, replacing the earlier one of the same ID. The content is
+   * stored only if it is given.
+   */
+  void persistFile(
+    model::FileId id_,
+    const std::string& path_,
+    const std::string& type_,
+    model::FileId parent_,
+    const std::string& content_ = std::string())
+  {
+    util::OdbTransaction {_db} ([&]{
+      model::File file;
+      file.id = id_;
+      file.path = path_;
+      file.filename = fs::path(path_).filename().string();
+      file.type = type_;
+      file.timestamp = 0;
+
+      if (parent_)
+        file.parent = odb::lazy_shared_ptr<model::File>(*_db, parent_);
+
+      if (!content_.empty())
+      {
+        model::FileContent content;
+        content.hash = path_ + ':' + content_;
+        content.content = content_;
+        _db->persist(content);
+
+        file.content = odb::lazy_shared_ptr<model::FileContent>(
+          *_db, content.hash);
+      }
+
+      _db->erase_query<model::File>(odb::query<model::File>::id == id_);
+      _db->persist(file);
+    });
+  }
+
+  static std::string read(DatabaseFileSystem& fs_, const std::string& path_)
+  {
+    auto file = fs_.openFileForRead(path_);
+    if (!file)
+      return "<error: " + file.getError().message() + '>';
+
+    auto buffer = (*file)->getBuffer(path_);
+    if (!buffer)
+      return "<error: " + buffer.getError().message() + '>';
+
+    return (*buffer)->getBuffer().str();
+  }
+
+  static std::vector<std::string> list(
+    DatabaseFileSystem& fs_,
+    const std::string& dir_)
+  {
+    std::vector<std::string> paths;
+    std::error_code ec;
+
+    for (llvm::vfs::directory_iterator it = fs_.dir_begin(dir_, ec), end;
+         it != end && !ec;
+         it.increment(ec))
+      paths.push_back(it->path().str());
+
+    std::sort(paths.begin(), paths.end());
+    return paths;
+  }
+
+  std::string _root;
+  std::shared_ptr<odb::database> _db;
+};
+
+TEST_F(DatabaseFileSystemTest, Snapshot)
+{
+  DatabaseFileSnapshotPtr snapshot = DatabaseFileSnapshot::refresh(_db, {});
+  ASSERT_NE(nullptr, snapshot);
+
+  DatabaseFileSystem files(snapshot);
+
+  EXPECT_EQ("int a;\n", read(files, "/src/a.h"));
+  EXPECT_EQ(7u, files.status("/src/a.h")->getSize());
+  EXPECT_TRUE(files.status("/src")->isDirectory());
+  EXPECT_FALSE(files.status("/src/b.h"));
+  EXPECT_FALSE(files.openFileForRead("/src"));
+  EXPECT_EQ(std::vector<std::string>({"/src/a.h"}), list(files, "/src"));
+
+  // The snapshot is reused while the database doesn't change.
+  EXPECT_EQ(snapshot, DatabaseFileSnapshot::refresh(_db, snapshot));
+}
+
+TEST_F(DatabaseFileSystemTest, NewGeneration)
+{
+  DatabaseFileSnapshotPtr snapshot = DatabaseFileSnapshot::refresh(_db, {});
+  DatabaseFileSystem oldFiles(snapshot);
+  EXPECT_EQ("int a;\n", read(oldFiles, "/src/a.h"));
+
+  // The project is parsed again: a file is changed and an other one is
+  // added.
+  persistFile(3, "/src/a.h", "CPP", 2, "int a = 42;\n");
+  persistFile(4, "/src/b.h", "CPP", 2, "int b;\n");
+
+  // The parser increments the generation at the end of the parsing.
+  EXPECT_EQ(snapshot, DatabaseFileSnapshot::refresh(_db, snapshot));
+  model::incrementDatabaseGeneration(_db);
+
+  DatabaseFileSnapshotPtr newSnapshot
+    = DatabaseFileSnapshot::refresh(_db, snapshot);
+  ASSERT_NE(snapshot, newSnapshot);
+  EXPECT_EQ(1u, newSnapshot->generation());
+
+  DatabaseFileSystem files(newSnapshot);
+
+  EXPECT_EQ("int a = 42;\n", read(files, "/src/a.h"));
+  EXPECT_EQ(12u, files.status("/src/a.h")->getSize());
+  EXPECT_EQ("int b;\n", read(files, "/src/b.h"));
+  EXPECT_EQ(
+    std::vector<std::string>({"/src/a.h", "/src/b.h"}),
+    list(files, "/src"));
+
+  // The reparses started earlier still see the earlier snapshot.
+  EXPECT_EQ("int a;\n", read(oldFiles, "/src/a.h"));
+  EXPECT_FALSE(oldFiles.status("/src/b.h"));
+
+  EXPECT_EQ(newSnapshot, DatabaseFileSnapshot::refresh(_db, newSnapshot));
+}
+
+#endif
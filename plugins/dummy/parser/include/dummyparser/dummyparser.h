@@ -15,6 +15,7 @@ public:
   DummyParser(ParserContext& ctx_);
   virtual ~DummyParser();
   virtual bool parse() override;
+  virtual bool multiThreaded() const override;
 private:
   bool accept(const std::string& path_);
 };
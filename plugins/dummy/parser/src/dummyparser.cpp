@@ -21,6 +21,11 @@ bool DummyParser::accept(const std::string& path_)
   return ext == ".dummy";
 }
 
+bool DummyParser::multiThreaded() const
+{
+  return false;
+}
+
 bool DummyParser::parse()
 {        
   for(std::string path : _ctx.options["input"].as<std::vector<std::string>>())
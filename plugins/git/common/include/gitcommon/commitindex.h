@@ -0,0 +1,128 @@
+#ifndef CC_GIT_COMMITINDEX_H
+#define CC_GIT_COMMITINDEX_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <git2.h>
+
+namespace cc
+{
+namespace git
+{
+
+/**
+ * Read-only index of every commit of a repository, built by the git parser
+ * after cloning the repository and used by the git service to answer
+ * filtered, paged history queries without walking the revision graph.
+ *
+ * The index is columnar: the object ids, commit times, parent lists and the
+ * searchable texts (message, author name, committer name) are stored in
+ * separate arrays, in commit time order. A trigram index over the lower-case
+ * searchable texts narrows down the commits to check for a filter. The index
+ * file is memory mapped when it is loaded.
+ */
+class CommitIndex
+{
+public:
+  static const std::size_t npos = static_cast<std::size_t>(-1);
+
+  /**
+   * A page of query results.
+   */
+  struct Page
+  {
+    std::vector<std::size_t> commits; /*!< Positions of the matching commits. */
+    std::size_t nextPosition = 0; /*!< Where the next page starts. */
+    bool hasRemaining = false;
+  };
+
+  /**
+   * Returns the path of the index file of the given repository.
+   * @param versionDir_ The version data directory of the project.
+   */
+  static std::string indexPath(
+    const std::string& versionDir_,
+    const std::string& repoId_);
+
+  /**
+   * Walks every commit reachable from the references of the repository and
+   * writes the index into path_.
+   * @return True on success.
+   */
+  static bool build(git_repository* repo_, const std::string& path_);
+
+  /**
+   * Maps an index file into memory.
+   * @return nullptr if the file doesn't exist or it is invalid.
+   */
+  static std::unique_ptr<CommitIndex> load(const std::string& path_);
+
+  CommitIndex(const CommitIndex&) = delete;
+  CommitIndex& operator=(const CommitIndex&) = delete;
+  ~CommitIndex();
+
+  std::size_t size() const { return _commitCount; }
+
+  /**
+   * Returns the position of the commit in the index or npos.
+   */
+  std::size_t find(const git_oid& oid_) const;
+
+  /**
+   * Returns the object id of the commit at the given position.
+   */
+  git_oid oid(std::size_t position_) const;
+
+  /**
+   * Collects the commits which are reachable from start_ (including itself)
+   * and match the filter, in commit time order.
+   *
+   * @param filter_ Commits are returned if their message, author name or
+   * committer name contains the filter case-insensitively.
+   * @param position_ The position where the previous page finished.
+   * @param skip_ The number of matching commits to skip before the page.
+   * @param count_ The maximal size of the page. Negative means unlimited.
+   */
+  Page query(
+    std::size_t start_,
+    const std::string& filter_,
+    std::size_t position_,
+    std::size_t skip_,
+    std::int64_t count_) const;
+
+private:
+  CommitIndex() = default;
+
+  /**
+   * Returns the commits which may contain the filter according to the trigram
+   * index, or every commit if the filter is shorter than a trigram.
+   */
+  std::vector<std::uint32_t> candidates(const std::string& filter_) const;
+
+  bool matches(std::size_t position_, const std::string& filter_) const;
+
+  void* _mapping = nullptr;
+  std::size_t _mappingSize = 0;
+
+  std::size_t _commitCount = 0;
+  std::size_t _trigramCount = 0;
+
+  const unsigned char* _oids = nullptr;
+  const std::uint32_t* _oidOrder = nullptr;
+  const std::int64_t* _times = nullptr;
+  const std::uint64_t* _parentOffsets = nullptr;
+  const std::uint32_t* _parents = nullptr;
+  const std::uint64_t* _textOffsets = nullptr;
+  const char* _texts = nullptr;
+  const std::uint32_t* _trigrams = nullptr;
+  const std::uint64_t* _postingOffsets = nullptr;
+  const std::uint32_t* _postings = nullptr;
+};
+
+} // git
+} // cc
+
+#endif // CC_GIT_COMMITINDEX_H
@@ -0,0 +1,535 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/range/iterator_range.hpp>
+
+#include <util/logutil.h>
+
+#include <gitcommon/commitindex.h>
+
+namespace
+{
+
+const char INDEX_MAGIC[8] = {'C', 'C', 'G', 'I', 'T', 'I', 'D', 'X'};
+const std::uint32_t INDEX_VERSION = 1;
+const std::size_t OID_SIZE = GIT_OID_RAWSZ;
+
+struct IndexHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::uint64_t commitCount;
+  std::uint64_t parentCount;
+  std::uint64_t textSize;
+  std::uint64_t trigramCount;
+  std::uint64_t postingCount;
+};
+
+std::size_t align(std::size_t size_)
+{
+  return (size_ + 7) & ~static_cast<std::size_t>(7);
+}
+
+/**
+ * Returns the size of the sections of the index file in the order they are
+ * written.
+ */
+std::vector<std::size_t> sectionSizes(const IndexHeader& header_)
+{
+  std::size_t n = header_.commitCount;
+
+  return {
+    align(n * OID_SIZE),
+    align(n * sizeof(std::uint32_t)),
+    align(n * sizeof(std::int64_t)),
+    align((n + 1) * sizeof(std::uint64_t)),
+    align(header_.parentCount * sizeof(std::uint32_t)),
+    align((n + 1) * sizeof(std::uint64_t)),
+    align(header_.textSize),
+    align(header_.trigramCount * sizeof(std::uint32_t)),
+    align((header_.trigramCount + 1) * sizeof(std::uint64_t)),
+    align(header_.postingCount * sizeof(std::uint32_t))};
+}
+
+template <typename T>
+void writeSection(std::ofstream& out_, const T* data_, std::size_t count_)
+{
+  static const char padding[8] = {0};
+
+  std::size_t size = count_ * sizeof(T);
+  out_.write(reinterpret_cast<const char*>(data_), size);
+  out_.write(padding, align(size) - size);
+}
+
+/**
+ * Calls func_ with every trigram of the lower-case version of text_.
+ */
+template <typename Func>
+void forEachTrigram(const char* begin_, const char* end_, Func func_)
+{
+  for (const char* it = begin_; it + 2 < end_; ++it)
+  {
+    std::uint32_t trigram = 0;
+    for (int i = 0; i < 3; ++i)
+      trigram = (trigram << 8)
+        | static_cast<unsigned char>(std::tolower(
+            static_cast<unsigned char>(it[i])));
+
+    func_(trigram);
+  }
+}
+
+} // namespace
+
+namespace cc
+{
+namespace git
+{
+
+const std::size_t CommitIndex::npos;
+
+std::string CommitIndex::indexPath(
+  const std::string& versionDir_,
+  const std::string& repoId_)
+{
+  return versionDir_ + '/' + repoId_ + ".commits";
+}
+
+bool CommitIndex::build(git_repository* repo_, const std::string& path_)
+{
+  git_revwalk* walker = nullptr;
+  if (git_revwalk_new(&walker, repo_))
+  {
+    LOG(warning) << "Creating revision walker failed for commit index.";
+    return false;
+  }
+
+  std::unique_ptr<git_revwalk, decltype(&git_revwalk_free)> walkerPtr(
+    walker, &git_revwalk_free);
+
+  git_revwalk_sorting(walker, GIT_SORT_TIME);
+  git_revwalk_push_glob(walker, "refs/*");
+  git_revwalk_push_head(walker);
+
+  //--- Collect the commits in commit time order ---//
+
+  std::vector<git_oid> oids;
+  std::vector<std::int64_t> times;
+  std::vector<std::uint64_t> parentOffsets{0};
+  std::vector<git_oid> parentOids;
+  std::vector<std::uint64_t> textOffsets{0};
+  std::string texts;
+
+  git_oid oid;
+  while (!git_revwalk_next(&oid, walker))
+  {
+    git_commit* commit = nullptr;
+    if (git_commit_lookup(&commit, repo_, &oid))
+      continue;
+
+    oids.push_back(oid);
+    times.push_back(git_commit_time(commit));
+
+    unsigned int parentCount = git_commit_parentcount(commit);
+    for (unsigned int i = 0; i < parentCount; ++i)
+      parentOids.push_back(*git_commit_parent_id(commit, i));
+    parentOffsets.push_back(parentOids.size());
+
+    const char* message = git_commit_message(commit);
+    texts.append(message ? message : "").push_back('\0');
+    texts.append(git_commit_author(commit)->name).push_back('\0');
+    texts.append(git_commit_committer(commit)->name).push_back('\0');
+    textOffsets.push_back(texts.size());
+
+    git_commit_free(commit);
+  }
+
+  std::size_t n = oids.size();
+
+  //--- Sort the object ids for lookup ---//
+
+  std::vector<std::uint32_t> oidOrder(n);
+  for (std::uint32_t i = 0; i < n; ++i)
+    oidOrder[i] = i;
+
+  std::sort(oidOrder.begin(), oidOrder.end(),
+    [&oids](std::uint32_t lhs_, std::uint32_t rhs_) {
+      return git_oid_cmp(&oids[lhs_], &oids[rhs_]) < 0;
+    });
+
+  auto position = [&](const git_oid& oid_) {
+    auto it = std::lower_bound(oidOrder.begin(), oidOrder.end(), oid_,
+      [&oids](std::uint32_t lhs_, const git_oid& rhs_) {
+        return git_oid_cmp(&oids[lhs_], &rhs_) < 0;
+      });
+    return it != oidOrder.end() && git_oid_equal(&oids[*it], &oid_)
+      ? static_cast<std::int64_t>(*it)
+      : -1;
+  };
+
+  //--- Resolve the parents to positions ---//
+
+  // Parents which are not in the index (e.g. in a shallow clone) are dropped.
+  std::vector<std::uint32_t> parents;
+  std::vector<std::uint64_t> resolvedOffsets{0};
+
+  for (std::size_t i = 0; i < n; ++i)
+  {
+    for (std::uint64_t p = parentOffsets[i]; p < parentOffsets[i + 1]; ++p)
+    {
+      std::int64_t pos = position(parentOids[p]);
+      if (pos >= 0)
+        parents.push_back(static_cast<std::uint32_t>(pos));
+    }
+    resolvedOffsets.push_back(parents.size());
+  }
+
+  //--- Build the trigram index ---//
+
+  std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> postingMap;
+
+  for (std::uint32_t i = 0; i < n; ++i)
+  {
+    const char* begin = texts.data() + textOffsets[i];
+    const char* end = texts.data() + textOffsets[i + 1];
+
+    // The fields are indexed one by one, so no trigram spans two fields.
+    while (begin < end)
+    {
+      const char* fieldEnd = std::find(begin, end, '\0');
+
+      forEachTrigram(begin, fieldEnd, [&](std::uint32_t trigram_) {
+        std::vector<std::uint32_t>& posting = postingMap[trigram_];
+        if (posting.empty() || posting.back() != i)
+          posting.push_back(i);
+      });
+
+      begin = fieldEnd + 1;
+    }
+  }
+
+  std::vector<std::uint32_t> trigrams;
+  trigrams.reserve(postingMap.size());
+  for (const auto& posting : postingMap)
+    trigrams.push_back(posting.first);
+  std::sort(trigrams.begin(), trigrams.end());
+
+  std::vector<std::uint64_t> postingOffsets{0};
+  std::vector<std::uint32_t> postings;
+
+  for (std::uint32_t trigram : trigrams)
+  {
+    const std::vector<std::uint32_t>& posting = postingMap[trigram];
+    postings.insert(postings.end(), posting.begin(), posting.end());
+    postingOffsets.push_back(postings.size());
+  }
+
+  //--- Write the index file ---//
+
+  std::vector<unsigned char> rawOids(n * OID_SIZE);
+  for (std::size_t i = 0; i < n; ++i)
+    std::memcpy(&rawOids[i * OID_SIZE], oids[i].id, OID_SIZE);
+
+  IndexHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  header.version = INDEX_VERSION;
+  header.commitCount = n;
+  header.parentCount = parents.size();
+  header.textSize = texts.size();
+  header.trigramCount = trigrams.size();
+  header.postingCount = postings.size();
+
+  std::string tmpPath = path_ + ".tmp";
+
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(out, rawOids.data(), rawOids.size());
+    writeSection(out, oidOrder.data(), oidOrder.size());
+    writeSection(out, times.data(), times.size());
+    writeSection(out, resolvedOffsets.data(), resolvedOffsets.size());
+    writeSection(out, parents.data(), parents.size());
+    writeSection(out, textOffsets.data(), textOffsets.size());
+    writeSection(out, texts.data(), texts.size());
+    writeSection(out, trigrams.data(), trigrams.size());
+    writeSection(out, postingOffsets.data(), postingOffsets.size());
+    writeSection(out, postings.data(), postings.size());
+
+    if (!out)
+    {
+      LOG(warning) << "Failed to write commit index: " << tmpPath;
+      return false;
+    }
+  }
+
+  if (std::rename(tmpPath.c_str(), path_.c_str()) != 0)
+  {
+    LOG(warning) << "Failed to rename commit index to: " << path_;
+    return false;
+  }
+
+  LOG(info) << "Commit index written with " << n << " commits: " << path_;
+
+  return true;
+}
+
+std::unique_ptr<CommitIndex> CommitIndex::load(const std::string& path_)
+{
+  int fd = ::open(path_.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<std::size_t>(st.st_size) < sizeof(IndexHeader))
+  {
+    ::close(fd);
+    return nullptr;
+  }
+
+  std::size_t size = st.st_size;
+  void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+    return nullptr;
+
+  const IndexHeader& header = *static_cast<const IndexHeader*>(mapping);
+
+  std::vector<std::size_t> sections;
+  std::size_t expected = sizeof(IndexHeader);
+
+  if (std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+      header.version == INDEX_VERSION)
+  {
+    sections = sectionSizes(header);
+    for (std::size_t section : sections)
+      expected += section;
+  }
+
+  if (sections.empty() || expected != size)
+  {
+    LOG(warning) << "Invalid or outdated commit index: " << path_;
+    ::munmap(mapping, size);
+    return nullptr;
+  }
+
+  std::unique_ptr<CommitIndex> index(new CommitIndex());
+  index->_mapping = mapping;
+  index->_mappingSize = size;
+  index->_commitCount = header.commitCount;
+  index->_trigramCount = header.trigramCount;
+
+  const char* ptr = static_cast<const char*>(mapping) + sizeof(IndexHeader);
+  auto next = [&ptr, &sections](std::size_t i_) {
+    const char* section = ptr;
+    ptr += sections[i_];
+    return section;
+  };
+
+  index->_oids = reinterpret_cast<const unsigned char*>(next(0));
+  index->_oidOrder = reinterpret_cast<const std::uint32_t*>(next(1));
+  index->_times = reinterpret_cast<const std::int64_t*>(next(2));
+  index->_parentOffsets = reinterpret_cast<const std::uint64_t*>(next(3));
+  index->_parents = reinterpret_cast<const std::uint32_t*>(next(4));
+  index->_textOffsets = reinterpret_cast<const std::uint64_t*>(next(5));
+  index->_texts = next(6);
+  index->_trigrams = reinterpret_cast<const std::uint32_t*>(next(7));
+  index->_postingOffsets = reinterpret_cast<const std::uint64_t*>(next(8));
+  index->_postings = reinterpret_cast<const std::uint32_t*>(next(9));
+
+  return index;
+}
+
+CommitIndex::~CommitIndex()
+{
+  if (_mapping)
+    ::munmap(_mapping, _mappingSize);
+}
+
+std::size_t CommitIndex::find(const git_oid& oid_) const
+{
+  const std::uint32_t* end = _oidOrder + _commitCount;
+  const std::uint32_t* it = std::lower_bound(_oidOrder, end, oid_,
+    [this](std::uint32_t lhs_, const git_oid& rhs_) {
+      return std::memcmp(_oids + lhs_ * OID_SIZE, rhs_.id, OID_SIZE) < 0;
+    });
+
+  if (it == end || std::memcmp(_oids + *it * OID_SIZE, oid_.id, OID_SIZE))
+    return npos;
+
+  return *it;
+}
+
+git_oid CommitIndex::oid(std::size_t position_) const
+{
+  git_oid result;
+  git_oid_fromraw(&result, _oids + position_ * OID_SIZE);
+  return result;
+}
+
+std::vector<std::uint32_t> CommitIndex::candidates(
+  const std::string& filter_) const
+{
+  std::vector<std::uint32_t> filterTrigrams;
+  forEachTrigram(filter_.data(), filter_.data() + filter_.size(),
+    [&filterTrigrams](std::uint32_t trigram_) {
+      filterTrigrams.push_back(trigram_);
+    });
+
+  std::sort(filterTrigrams.begin(), filterTrigrams.end());
+  filterTrigrams.erase(
+    std::unique(filterTrigrams.begin(), filterTrigrams.end()),
+    filterTrigrams.end());
+
+  //--- Collect the posting lists, the shortest first ---//
+
+  std::vector<std::pair<const std::uint32_t*, const std::uint32_t*>> lists;
+
+  for (std::uint32_t trigram : filterTrigrams)
+  {
+    const std::uint32_t* end = _trigrams + _trigramCount;
+    const std::uint32_t* it = std::lower_bound(_trigrams, end, trigram);
+
+    // A missing trigram means that no commit can match.
+    if (it == end || *it != trigram)
+      return {};
+
+    std::size_t idx = it - _trigrams;
+    lists.emplace_back(
+      _postings + _postingOffsets[idx],
+      _postings + _postingOffsets[idx + 1]);
+  }
+
+  std::sort(lists.begin(), lists.end(),
+    [](const auto& lhs_, const auto& rhs_) {
+      return lhs_.second - lhs_.first < rhs_.second - rhs_.first;
+    });
+
+  //--- Intersect them ---//
+
+  std::vector<std::uint32_t> result(lists[0].first, lists[0].second);
+
+  for (std::size_t i = 1; i < lists.size() && !result.empty(); ++i)
+  {
+    std::vector<std::uint32_t> intersection;
+    std::set_intersection(
+      result.begin(), result.end(),
+      lists[i].first, lists[i].second,
+      std::back_inserter(intersection));
+    result.swap(intersection);
+  }
+
+  return result;
+}
+
+bool CommitIndex::matches(
+  std::size_t position_,
+  const std::string& filter_) const
+{
+  const char* begin = _texts + _textOffsets[position_];
+  const char* end = _texts + _textOffsets[position_ + 1];
+
+  while (begin < end)
+  {
+    const char* fieldEnd = std::find(begin, end, '\0');
+
+    if (boost::icontains(boost::make_iterator_range(begin, fieldEnd), filter_))
+      return true;
+
+    begin = fieldEnd + 1;
+  }
+
+  return false;
+}
+
+CommitIndex::Page CommitIndex::query(
+  std::size_t start_,
+  const std::string& filter_,
+  std::size_t position_,
+  std::size_t skip_,
+  std::int64_t count_) const
+{
+  Page page;
+  page.nextPosition = _commitCount;
+
+  //--- Mark the ancestors of the start commit ---//
+
+  std::vector<bool> reachable(_commitCount, false);
+  std::vector<std::uint32_t> stack{static_cast<std::uint32_t>(start_)};
+  reachable[start_] = true;
+
+  while (!stack.empty())
+  {
+    std::uint32_t commit = stack.back();
+    stack.pop_back();
+
+    for (std::uint64_t p = _parentOffsets[commit];
+         p < _parentOffsets[commit + 1];
+         ++p)
+      if (!reachable[_parents[p]])
+      {
+        reachable[_parents[p]] = true;
+        stack.push_back(_parents[p]);
+      }
+  }
+
+  //--- Collect the matching commits from the given position ---//
+
+  auto visit = [&](std::size_t pos_) {
+    if (!reachable[pos_] || (!filter_.empty() && !matches(pos_, filter_)))
+      return true;
+
+    if (skip_)
+    {
+      --skip_;
+      return true;
+    }
+
+    if (count_ >= 0 && page.commits.size() >= static_cast<std::size_t>(count_))
+    {
+      page.hasRemaining = true;
+      page.nextPosition = pos_;
+      return false;
+    }
+
+    page.commits.push_back(pos_);
+    return true;
+  };
+
+  if (filter_.size() < 3)
+  {
+    for (std::size_t pos = position_; pos < _commitCount; ++pos)
+      if (!visit(pos))
+        break;
+  }
+  else
+  {
+    std::vector<std::uint32_t> positions = candidates(filter_);
+    for (auto it = std::lower_bound(
+           positions.begin(), positions.end(), position_);
+         it != positions.end();
+         ++it)
+      if (!visit(*it))
+        break;
+  }
+
+  return page;
+}
+
+} // git
+} // cc
@@ -17,6 +17,7 @@ public:
   GitParser(ParserContext& ctx_);
   virtual ~GitParser();
   virtual bool parse() override;
+  virtual bool multiThreaded() const override;
 private:
   util::DirIterCallback getParserCallback();
 };
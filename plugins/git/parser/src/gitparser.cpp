@@ -8,6 +8,8 @@
 #include <util/hash.h>
 #include <util/logutil.h>
 
+#include <gitcommon/commitindex.h>
+
 #include <gitparser/gitparser.h>
 
 namespace cc
@@ -69,6 +71,16 @@ util::DirIterCallback GitParser::getParserCallback()
       return false;
     }
 
+    //--- Index the commits for the history queries of the service ---//
+
+    if (!git::CommitIndex::build(
+          out, git::CommitIndex::indexPath(versionDataDir, repoId)))
+      LOG(warning)
+        << "Failed to build the commit index of " << path
+        << ", the history will be queried from the repository.";
+
+    git_repository_free(out);
+
     //--- Write repository options to an .INI file in the data directory. ---//
 
     boost::property_tree::ptree pt;
@@ -85,20 +97,24 @@ util::DirIterCallback GitParser::getParserCallback()
   };
 }
 
+bool GitParser::multiThreaded() const
+{
+  return false;
+}
+
 bool GitParser::parse()
 {
-  for (const std::string& path :
-    _ctx.options["input"].as<std::vector<std::string>>())
-  {
-    LOG(info) << "Git parse path: " << path;
+  auto cb = getParserCallback();
 
-    auto cb = getParserCallback();
+  for (const FileManifest::Entry& entry : _ctx.manifest.entries())
+  {
+    if (!entry.directory)
+      continue;
 
-    /*--- Call non-empty iter-callback for all files
-       in the current root directory. ---*/
+    /*--- Call the callback for the directories of the inputs. ---*/
     try
     {
-      util::iterateDirectoryRecursive(path, cb);
+      cb(entry.path);
     }
     catch (const std::exception& ex_)
     {
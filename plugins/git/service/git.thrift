@@ -72,6 +72,7 @@ struct CommitListFilteredResult
   1:i32 newOffset;
   2:bool hasRemaining;
   3:list<GitCommit> result;
+  4:string nextCursor; /**< Opaque position of the next page. */
 }
 
 struct RepositoryByProjectPathResult
@@ -145,13 +146,16 @@ service GitService
   /**
    * Retrieves a commit list from the repository starting from a given commit
    * returns at most count elements. Use count=-1 to return all elements.
+   * The next page can be requested by passing back the nextCursor of the
+   * result. An empty cursor starts the list after offset matching commits.
    */
   CommitListFilteredResult getCommitListFiltered(
     1:string repoId_,
     2:string hexOid_,
     3:i32 count_,
     4:i32 offset_,
-    10:string filter_)
+    10:string filter_,
+    11:string cursor_)
 
   /**
    * Returns a list with all the references that can be found in the repository.
@@ -1,20 +1,28 @@
 #ifndef CC_SERVICE_GITSERVICE_H
 #define CC_SERVICE_GITSERVICE_H
 
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
-#include <memory>
 
 #include <git2.h>
 
 #include <boost/program_options/variables_map.hpp>
 
 #include <odb/database.hxx>
+#include <util/lrucache.h>
 #include <util/odbtransaction.h>
 #include <webserver/servercontext.h>
 
 #include <projectservice/projectservice.h>
 
+#include <gitcommon/commitindex.h>
+
 #include <GitService.h>
 
 namespace cc
@@ -26,7 +34,7 @@ namespace service
 namespace git
 {
 
-typedef std::unique_ptr<git_repository, decltype(&git_repository_free)> RepositoryPtr;
+typedef std::unique_ptr<git_repository, std::function<void(git_repository*)>> RepositoryPtr;
 typedef std::unique_ptr<git_revwalk, decltype(&git_revwalk_free)> RevWalkPtr;
 typedef std::unique_ptr<git_commit, decltype(&git_commit_free)> CommitPtr;
 typedef std::unique_ptr<git_tree, decltype(&git_tree_free)> TreePtr;
@@ -90,7 +98,8 @@ public:
     const std::string& hexOid_,
     const int32_t count_,
     const int32_t offset_,
-    const std::string& filter_) override;
+    const std::string& filter_,
+    const std::string& cursor_) override;
 
   virtual void getReferenceList(
     std::vector<std::string>& return_,
@@ -139,10 +148,46 @@ private:
 
   /**
    * Open a git repository. The 'repoId_' argument must be a valid
-   * repository id.
+   * repository id. The repository handle is taken from the pool of opened
+   * repositories if possible, and it is returned to the pool when the
+   * returned pointer is destroyed, unless the caches have been cleared
+   * meanwhile.
    */
   RepositoryPtr createRepository(const std::string& repoId_);
 
+  /**
+   * Reads the repositories of the project from repositories.txt.
+   */
+  std::vector<GitRepository> loadRepositoryList();
+
+  /**
+   * Frees the pooled repository handles and drops the cached data. This is
+   * called when the parser has rewritten the repositories of the project.
+   */
+  void clearCaches();
+
+  /**
+   * Fills return_ with the metadata of the given commit. The metadata is
+   * served from the commit cache if possible.
+   * @return False if the commit can't be found.
+   */
+  bool getCommitData(
+    GitCommit& return_,
+    const std::string& repoId_,
+    git_repository* repo_,
+    const git_oid& oid_);
+
+  /**
+   * Returns the commit index built by the parser for the repository, or
+   * nullptr if there is none. The index is mapped again if the parser has
+   * rewritten the index file.
+   * @param generation_ Set to the modification time of the index file. Paging
+   * cursors are only valid in the same generation.
+   */
+  std::shared_ptr<const ::cc::git::CommitIndex> getCommitIndex(
+    const std::string& repoId_,
+    std::time_t& generation_);
+
   /**
    * Retrieve and resolve the reference pointed at by HEAD.
    */
@@ -239,6 +284,48 @@ private:
   std::shared_ptr<std::string> _datadir;
 
   core::ProjectServiceHandler _projectHandler;
+
+  /**
+   * Opened repository handles which are not in use at the moment, by
+   * repository id. A git_repository must not be used by multiple threads at
+   * the same time, so every request takes its own handle from the pool.
+   */
+  std::map<std::string, std::vector<git_repository*>> _repositoryPool;
+  std::mutex _repositoryPoolMutex;
+
+  /**
+   * Incremented by clearCaches(). The handles opened in an older generation
+   * are freed when they are released instead of being pooled again.
+   */
+  std::uint64_t _repositoryPoolGeneration;
+
+  /**
+   * The repository list is read again only if the modification time of
+   * repositories.txt changes.
+   */
+  std::vector<GitRepository> _repositoryList;
+  std::time_t _repositoryListTime;
+  std::mutex _repositoryListMutex;
+
+  /**
+   * Blame results of unmodified files by repository id, commit and path.
+   */
+  util::LruCache<std::string, std::vector<GitBlameHunk>> _blameCache;
+
+  /**
+   * Commit metadata by repository id and commit id.
+   */
+  util::LruCache<std::string, GitCommit> _commitCache;
+
+  /**
+   * Loaded commit indexes with the modification time of their files by
+   * repository id.
+   */
+  std::map<
+    std::string,
+    std::pair<std::time_t, std::shared_ptr<const ::cc::git::CommitIndex>>>
+    _commitIndexes;
+  std::mutex _commitIndexMutex;
 };
 
 } //namespace git
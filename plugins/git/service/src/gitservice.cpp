@@ -122,7 +122,11 @@ GitServiceHandler::GitServiceHandler(
     : _db(db_),
       _transaction(db_),
       _datadir(datadir_),
-      _projectHandler(db_, datadir_, context_)
+      _projectHandler(db_, datadir_, context_),
+      _repositoryPoolGeneration(0),
+      _repositoryListTime(0),
+      _blameCache(256),
+      _commitCache(4096)
 {
   git_libgit2_init();
 }
@@ -136,10 +140,37 @@ void GitServiceHandler::getRepositoryList(std::vector<GitRepository>& return_)
 {
   namespace fs = ::boost::filesystem;
 
+  std::string repoFile(*_datadir + "/version/repositories.txt");
+
+  boost::system::error_code ec;
+  std::time_t mtime = fs::last_write_time(repoFile, ec);
+
+  std::lock_guard<std::mutex> lock(_repositoryListMutex);
+
+  if (ec || mtime != _repositoryListTime)
+  {
+    // The parser has cloned the repositories again, so the opened handles and
+    // the cached results may belong to the old clones.
+    if (_repositoryListTime)
+      clearCaches();
+
+    _repositoryList = loadRepositoryList();
+    _repositoryListTime = ec ? 0 : mtime;
+  }
+
+  return_ = _repositoryList;
+}
+
+std::vector<GitRepository> GitServiceHandler::loadRepositoryList()
+{
+  namespace fs = ::boost::filesystem;
+
+  std::vector<GitRepository> repositories;
+
   fs::path versionDataDir(*_datadir + "/version");
 
   if (!fs::is_directory(versionDataDir))
-    return;
+    return repositories;
 
   std::string repoFile(versionDataDir.string() + "/repositories.txt");
   boost::property_tree::ptree pt;
@@ -147,7 +178,7 @@ void GitServiceHandler::getRepositoryList(std::vector<GitRepository>& return_)
   if (!fs::is_regular(repoFile))
   {
     LOG(warning) << "Repository file not found in data directory: " << repoFile;
-    return;
+    return repositories;
   }
 
   boost::property_tree::read_ini(repoFile, pt);
@@ -189,8 +220,60 @@ void GitServiceHandler::getRepositoryList(std::vector<GitRepository>& return_)
         break;
     }
 
-    return_.push_back(std::move(gitRepo));
+    repositories.push_back(std::move(gitRepo));
+  }
+
+  return repositories;
+}
+
+void GitServiceHandler::clearCaches()
+{
+  {
+    std::lock_guard<std::mutex> lock(_repositoryPoolMutex);
+
+    for (auto& repos : _repositoryPool)
+      for (git_repository* repo : repos.second)
+        git_repository_free(repo);
+
+    _repositoryPool.clear();
+
+    // The handles in use are freed when they are released.
+    ++_repositoryPoolGeneration;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_commitIndexMutex);
+    _commitIndexes.clear();
   }
+
+  _blameCache.clear();
+  _commitCache.clear();
+}
+
+std::shared_ptr<const ::cc::git::CommitIndex>
+GitServiceHandler::getCommitIndex(
+  const std::string& repoId_,
+  std::time_t& generation_)
+{
+  std::string path = ::cc::git::CommitIndex::indexPath(
+    *_datadir + "/version", repoId_);
+
+  boost::system::error_code ec;
+  generation_ = boost::filesystem::last_write_time(path, ec);
+  if (ec)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(_commitIndexMutex);
+
+  auto it = _commitIndexes.find(repoId_);
+  if (it != _commitIndexes.end() && it->second.first == generation_)
+    return it->second.second;
+
+  std::shared_ptr<const ::cc::git::CommitIndex> index
+    = ::cc::git::CommitIndex::load(path);
+  _commitIndexes[repoId_] = std::make_pair(generation_, index);
+
+  return index;
 }
 
 void GitServiceHandler::getRepositoryByProjectPath(
@@ -294,6 +377,13 @@ void GitServiceHandler::getBlameInfo(
   const std::string& path_,
   const std::string& localModificationsFileId_)
 {
+  // The blame of a committed file never changes, so it can be cached. Locally
+  // modified files are blamed against their current content every time.
+  const std::string cacheKey = repoId_ + ':' + hexOid_ + ':' + path_;
+
+  if (localModificationsFileId_.empty() && _blameCache.get(cacheKey, return_))
+    return;
+
   RepositoryPtr repo = createRepository(repoId_);
 
   if (!repo)
@@ -302,6 +392,9 @@ void GitServiceHandler::getBlameInfo(
   BlameOptsPtr opt = createBlameOpts(gitOidFromStr(hexOid_));
   BlamePtr blame = createBlame(repo.get(), path_.c_str(), opt.get());
 
+  if (!blame)
+    return;
+
   if (!localModificationsFileId_.empty())
   {
     std::string fileContent;
@@ -319,6 +412,12 @@ void GitServiceHandler::getBlameInfo(
     blameHunk.finalCommitId = gitOidToString(&hunk->final_commit_id);
     blameHunk.finalStartLineNumber = hunk->final_start_line_number;
 
+    // Many hunks belong to the same commit, so the commit data is taken from
+    // the commit cache instead of looking up the commit for every hunk.
+    GitCommit finalCommit;
+    bool hasFinalCommit = !git_oid_iszero(&hunk->final_commit_id) &&
+      getCommitData(finalCommit, repoId_, repo.get(), hunk->final_commit_id);
+
     // If files are locally changed, final_signature will be null pointer.
     // I think it will be a `libgit2` bug.
     if (hunk->final_signature)
@@ -327,22 +426,13 @@ void GitServiceHandler::getBlameInfo(
       blameHunk.finalSignature.email = hunk->final_signature->email;
       blameHunk.finalSignature.time = hunk->final_signature->when.time;
     }
-    else if (!git_oid_iszero(&hunk->final_commit_id))
-    {
-      CommitPtr commit = createCommit(repo.get(), hunk->final_commit_id);
-      const git_signature* author = git_commit_author(commit.get());
-      blameHunk.finalSignature.name = author->name;
-      blameHunk.finalSignature.email = author->email;
-      blameHunk.finalSignature.time = author->when.time;
-    }
+    else if (hasFinalCommit)
+      blameHunk.finalSignature = finalCommit.author;
 
     //--- If the changes are not committed yet ---//
 
-    if (blameHunk.finalSignature.time)
-    {
-      CommitPtr commit = createCommit(repo.get(), hunk->final_commit_id);
-      blameHunk.finalCommitMessage = git_commit_message(commit.get());
-    }
+    if (blameHunk.finalSignature.time && hasFinalCommit)
+      blameHunk.finalCommitMessage = finalCommit.message;
 
     blameHunk.origCommitId = gitOidToString(&hunk->orig_commit_id);
     blameHunk.origPath = hunk->orig_path;
@@ -357,6 +447,8 @@ void GitServiceHandler::getBlameInfo(
     return_.push_back(std::move(blameHunk));
   }
 
+  if (localModificationsFileId_.empty())
+    _blameCache.put(cacheKey, return_);
 }
 
 void GitServiceHandler::getCommit(
@@ -364,15 +456,15 @@ void GitServiceHandler::getCommit(
   const std::string& repoId_,
   const std::string& hexOid_)
 {
+  if (_commitCache.get(repoId_ + ':' + hexOid_, return_))
+    return;
+
   RepositoryPtr repo = createRepository(repoId_);
 
   if (!repo)
     return;
 
-  CommitPtr commit = createCommit(repo.get(), gitOidFromStr(hexOid_));
-
-  if (commit)
-    setCommitData(return_, repoId_, commit.get());
+  getCommitData(return_, repoId_, repo.get(), gitOidFromStr(hexOid_));
 }
 
 void GitServiceHandler::getTag(
@@ -405,18 +497,69 @@ void GitServiceHandler::getCommitListFiltered(
   const std::string& hexOid_,
   const int32_t count_,
   const int32_t offset_,
-  const std::string& filter_)
+  const std::string& filter_,
+  const std::string& cursor_)
 {
   RepositoryPtr repo = createRepository(repoId_);
 
   if (!repo)
     return;
 
+  git_oid hexoId = gitOidFromStr(hexOid_);
+
+  //--- Answer the query from the commit index if possible ---//
+
+  std::time_t generation;
+  std::shared_ptr<const ::cc::git::CommitIndex> index
+    = getCommitIndex(repoId_, generation);
+  std::size_t start = index
+    ? index->find(hexoId)
+    : static_cast<std::size_t>(::cc::git::CommitIndex::npos);
+
+  if (start != ::cc::git::CommitIndex::npos)
+  {
+    // The cursor is "<generation>:<position>". Without a valid cursor the
+    // offset is the number of matching commits to skip.
+    std::size_t position = 0;
+    std::size_t skip = offset_ > 0 ? offset_ : 0;
+
+    std::vector<std::string> parts;
+    boost::split(parts, cursor_, boost::is_any_of(":"));
+
+    if (parts.size() == 2 && parts[0] == std::to_string(generation))
+      try
+      {
+        position = std::stoull(parts[1]);
+        skip = 0;
+      }
+      catch (const std::exception&)
+      {
+        position = 0;
+      }
+
+    ::cc::git::CommitIndex::Page page
+      = index->query(start, filter_, position, skip, count_);
+
+    for (std::size_t pos : page.commits)
+    {
+      GitCommit gcommit;
+      if (getCommitData(gcommit, repoId_, repo.get(), index->oid(pos)))
+        return_.result.push_back(std::move(gcommit));
+    }
+
+    return_.newOffset = offset_ + page.commits.size();
+    return_.hasRemaining = page.hasRemaining;
+    return_.nextCursor
+      = std::to_string(generation) + ':' + std::to_string(page.nextPosition);
+
+    return;
+  }
+
+  //--- Walk the history if the repository has no index ---//
+
   RevWalkPtr revWalk = createRevWalk(repo.get());
 
   git_revwalk_sorting(revWalk.get(), GIT_SORT_TIME);
-
-  git_oid hexoId = gitOidFromStr(hexOid_);
   git_revwalk_push(revWalk.get(), &hexoId);
 
   git_oid oid;
@@ -429,10 +572,9 @@ void GitServiceHandler::getCommitListFiltered(
     if (i < offset_)
       continue;
 
-    CommitPtr commit = createCommit(repo.get(), oid);
-
     GitCommit gcommit;
-    setCommitData(gcommit, repoId_, commit.get());
+    if (!getCommitData(gcommit, repoId_, repo.get(), oid))
+      continue;
 
     if (boost::icontains(gcommit.message, filter_) ||
         boost::icontains(gcommit.author.name, filter_) ||
@@ -610,6 +752,28 @@ std::string GitServiceHandler::gitOidToString(const git_oid* oid_)
   return std::string(oidstr);
 }
 
+bool GitServiceHandler::getCommitData(
+  GitCommit& return_,
+  const std::string& repoId_,
+  git_repository* repo_,
+  const git_oid& oid_)
+{
+  const std::string cacheKey = repoId_ + ':' + gitOidToString(&oid_);
+
+  if (_commitCache.get(cacheKey, return_))
+    return true;
+
+  CommitPtr commit = createCommit(repo_, oid_);
+
+  if (!commit)
+    return false;
+
+  setCommitData(return_, repoId_, commit.get());
+  _commitCache.put(cacheKey, return_);
+
+  return true;
+}
+
 std::string GitServiceHandler::gitSignatureToString(const git_signature* sig_)
 {
   return std::string(sig_->name) + " (" + sig_->email + ")";
@@ -629,10 +793,12 @@ void GitServiceHandler::setCommitData(
   const git_signature* author = git_commit_author(commit_);
   return_.author.name = author->name;
   return_.author.email = author->email;
+  return_.author.time = author->when.time;
 
   const git_signature* cmtter = git_commit_committer(commit_);
   return_.committer.name = cmtter->name;
   return_.committer.email = cmtter->email;
+  return_.committer.time = cmtter->when.time;
 
   const git_oid* treeId = git_commit_tree_id(commit_);
   return_.treeOid = gitOidToString(treeId);
@@ -672,14 +838,46 @@ std::string GitServiceHandler::gitDiffToString(git_diff* diff_, bool isCompact_)
 
 RepositoryPtr GitServiceHandler::createRepository(const std::string& repoId_)
 {
-  std::string repoPath = getRepoPath(repoId_);
   git_repository* repository = nullptr;
-  int error = git_repository_open(&repository, repoPath.c_str());
+  std::uint64_t generation;
 
-  if (error)
-    LOG(error) << "Opening repository " << repoPath << " failed: " << error;
+  {
+    std::lock_guard<std::mutex> lock(_repositoryPoolMutex);
+
+    generation = _repositoryPoolGeneration;
 
-  return RepositoryPtr { repository, &git_repository_free };
+    std::vector<git_repository*>& pooled = _repositoryPool[repoId_];
+    if (!pooled.empty())
+    {
+      repository = pooled.back();
+      pooled.pop_back();
+    }
+  }
+
+  if (!repository)
+  {
+    std::string repoPath = getRepoPath(repoId_);
+    int error = git_repository_open(&repository, repoPath.c_str());
+
+    if (error)
+    {
+      LOG(error) << "Opening repository " << repoPath << " failed: " << error;
+      return RepositoryPtr { nullptr, &git_repository_free };
+    }
+  }
+
+  return RepositoryPtr { repository,
+    [this, repoId_, generation](git_repository* repo_)
+    {
+      std::lock_guard<std::mutex> lock(_repositoryPoolMutex);
+
+      // The handle may refer to the state of the repository before it was
+      // rewritten by the parser.
+      if (generation != _repositoryPoolGeneration)
+        git_repository_free(repo_);
+      else
+        _repositoryPool[repoId_].push_back(repo_);
+    }};
 }
 
 ReferencePtr GitServiceHandler::createRepositoryHead(git_repository* repo_)
@@ -845,6 +1043,7 @@ BlameOptsPtr GitServiceHandler::createBlameOpts(const git_oid& newCommitOid_)
 
 GitServiceHandler::~GitServiceHandler()
 {
+  clearCaches();
   git_libgit2_shutdown();
 }
 
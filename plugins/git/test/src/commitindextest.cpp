@@ -0,0 +1,234 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <cstdlib>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <boost/filesystem.hpp>
+
+#include <gitcommon/commitindex.h>
+
+using namespace cc::git;
+
+namespace
+{
+
+std::string toString(const git_oid& oid_)
+{
+  char buffer[GIT_OID_HEXSZ + 1];
+  git_oid_tostr(buffer, sizeof(buffer), &oid_);
+  return buffer;
+}
+
+} // namespace
+
+/**
+ * Creates a repository with a linear history of ten commits. The even ones
+ * are authored by Alice, the odd ones by Bob.
+ */
+class CommitIndexTest : public ::testing::Test
+{
+protected:
+  static const int COMMIT_NUM = 10;
+
+  virtual void SetUp() override
+  {
+    git_libgit2_init();
+
+    char dirTemplate[] = "/tmp/commitindextest.XXXXXX";
+    ASSERT_TRUE(::mkdtemp(dirTemplate));
+    _dir = dirTemplate;
+
+    ASSERT_EQ(git_repository_init(&_repo, (_dir + "/repo").c_str(), 1), 0);
+
+    git_treebuilder* builder = nullptr;
+    git_oid treeId;
+    ASSERT_EQ(git_treebuilder_new(&builder, _repo, nullptr), 0);
+    ASSERT_EQ(git_treebuilder_write(&treeId, builder), 0);
+    git_treebuilder_free(builder);
+
+    git_tree* tree = nullptr;
+    ASSERT_EQ(git_tree_lookup(&tree, _repo, &treeId), 0);
+
+    git_commit* parent = nullptr;
+
+    for (int i = 0; i < COMMIT_NUM; ++i)
+    {
+      git_signature* signature = nullptr;
+      ASSERT_EQ(git_signature_new(&signature,
+        i % 2 ? "Bob" : "Alice", "dev@example.com", 1500000000 + i * 60, 0),
+        0);
+
+      const git_commit* parents[] = {parent};
+      git_oid oid;
+      std::string message = "Change number " + std::to_string(i);
+
+      ASSERT_EQ(git_commit_create(&oid, _repo, "HEAD", signature, signature,
+        nullptr, message.c_str(), tree, parent ? 1 : 0, parents), 0);
+
+      git_signature_free(signature);
+      git_commit_free(parent);
+      ASSERT_EQ(git_commit_lookup(&parent, _repo, &oid), 0);
+
+      _commits.push_back(oid);
+    }
+
+    git_commit_free(parent);
+    git_tree_free(tree);
+
+    std::string path = CommitIndex::indexPath(_dir, "repo");
+    ASSERT_TRUE(CommitIndex::build(_repo, path));
+
+    _index = CommitIndex::load(path);
+    ASSERT_TRUE(_index);
+  }
+
+  virtual void TearDown() override
+  {
+    _index.reset();
+    git_repository_free(_repo);
+    boost::filesystem::remove_all(_dir);
+    git_libgit2_shutdown();
+  }
+
+  /**
+   * Returns the commits of the page as hexadecimal object ids.
+   */
+  std::vector<std::string> oids(const CommitIndex::Page& page_) const
+  {
+    std::vector<std::string> result;
+    for (std::size_t pos : page_.commits)
+      result.push_back(toString(_index->oid(pos)));
+    return result;
+  }
+
+  /**
+   * Queries every page of the given size from the head commit.
+   */
+  std::vector<std::string> queryPages(
+    const std::string& filter_,
+    std::int64_t count_)
+  {
+    std::size_t head = _index->find(_commits.back());
+    std::vector<std::string> result;
+    std::size_t position = 0;
+
+    while (true)
+    {
+      CommitIndex::Page page
+        = _index->query(head, filter_, position, 0, count_);
+
+      EXPECT_LE(page.commits.size(), static_cast<std::size_t>(count_));
+
+      std::vector<std::string> pageOids = oids(page);
+      result.insert(result.end(), pageOids.begin(), pageOids.end());
+
+      if (!page.hasRemaining)
+        break;
+
+      EXPECT_GT(page.nextPosition, position);
+      position = page.nextPosition;
+    }
+
+    return result;
+  }
+
+  std::string _dir;
+  git_repository* _repo = nullptr;
+  std::vector<git_oid> _commits;
+  std::unique_ptr<CommitIndex> _index;
+};
+
+TEST_F(CommitIndexTest, EveryCommitIsIndexed)
+{
+  ASSERT_EQ(_index->size(), static_cast<std::size_t>(COMMIT_NUM));
+
+  for (const git_oid& commit : _commits)
+  {
+    std::size_t pos = _index->find(commit);
+    ASSERT_NE(pos, CommitIndex::npos);
+    EXPECT_EQ(toString(_index->oid(pos)), toString(commit));
+  }
+
+  git_oid unknown;
+  git_oid_fromstr(&unknown, "0123456789012345678901234567890123456789");
+  EXPECT_EQ(_index->find(unknown), CommitIndex::npos);
+}
+
+TEST_F(CommitIndexTest, PagesCoverTheHistoryOnce)
+{
+  std::vector<std::string> all = queryPages("", COMMIT_NUM);
+  ASSERT_EQ(all.size(), static_cast<std::size_t>(COMMIT_NUM));
+  EXPECT_EQ(std::set<std::string>(all.begin(), all.end()).size(), all.size());
+
+  // The newest commit comes first.
+  EXPECT_EQ(all.front(), toString(_commits.back()));
+
+  EXPECT_EQ(queryPages("", 3), all);
+  EXPECT_EQ(queryPages("", 1), all);
+}
+
+TEST_F(CommitIndexTest, SkipAndCount)
+{
+  std::vector<std::string> all = queryPages("", COMMIT_NUM);
+  std::size_t head = _index->find(_commits.back());
+
+  CommitIndex::Page page = _index->query(head, "", 0, 4, 3);
+  EXPECT_EQ(oids(page), std::vector<std::string>(
+    all.begin() + 4, all.begin() + 7));
+  EXPECT_TRUE(page.hasRemaining);
+
+  page = _index->query(head, "", 0, 8, 5);
+  EXPECT_EQ(oids(page), std::vector<std::string>(all.begin() + 8, all.end()));
+  EXPECT_FALSE(page.hasRemaining);
+
+  // A negative count means no limit.
+  EXPECT_EQ(_index->query(head, "", 0, 0, -1).commits.size(), all.size());
+}
+
+TEST_F(CommitIndexTest, FilterMatchesTextsCaseInsensitively)
+{
+  std::set<std::string> alice, bob;
+  for (int i = 0; i < COMMIT_NUM; ++i)
+    (i % 2 ? bob : alice).insert(toString(_commits[i]));
+
+  // The trigram index is used for filters of at least three characters.
+  std::vector<std::string> result = queryPages("aLiCe", 2);
+  EXPECT_EQ(std::set<std::string>(result.begin(), result.end()), alice);
+
+  result = queryPages("ob", 2);
+  EXPECT_EQ(std::set<std::string>(result.begin(), result.end()), bob);
+
+  result = queryPages("number 7", 2);
+  ASSERT_EQ(result.size(), 1u);
+  EXPECT_EQ(result[0], toString(_commits[7]));
+
+  EXPECT_TRUE(queryPages("nonexistent", 2).empty());
+}
+
+TEST_F(CommitIndexTest, OnlyAncestorsOfTheStartAreReturned)
+{
+  std::size_t start = _index->find(_commits[3]);
+
+  CommitIndex::Page page = _index->query(start, "", 0, 0, -1);
+
+  std::vector<std::string> result = oids(page);
+  EXPECT_EQ(std::set<std::string>(result.begin(), result.end()),
+    std::set<std::string>({
+      toString(_commits[0]), toString(_commits[1]),
+      toString(_commits[2]), toString(_commits[3])}));
+}
+
+TEST_F(CommitIndexTest, InvalidIndexIsNotLoaded)
+{
+  EXPECT_FALSE(CommitIndex::load(_dir + "/missing.commits"));
+
+  std::string path = _dir + "/invalid.commits";
+  boost::filesystem::copy_file(CommitIndex::indexPath(_dir, "repo"), path);
+  boost::filesystem::resize_file(path, 64);
+  EXPECT_FALSE(CommitIndex::load(path));
+}
@@ -297,11 +297,13 @@ function (Tooltip, ObjectStoreModel, declare, Memory, Observable, topic,
      * Loads commits dynamically either under the reference or in place of the
      * load more commits list item.
      */
-    loadCommits : function (repoId, branchName, topCommit, offset, parentid) {
+    loadCommits : function (repoId, branchName, topCommit, offset, parentid,
+      cursor) {
       var that = this;
 
       var filteredCommits = model.gitservice.getCommitListFiltered(repoId,
-        topCommit, this._numOfCommitsToLoad, offset, this._filterText);
+        topCommit, this._numOfCommitsToLoad, offset, this._filterText,
+        cursor || '');
 
       //--- Add commits to the store ---//
 
@@ -342,7 +344,8 @@ function (Tooltip, ObjectStoreModel, declare, Memory, Observable, topic,
           hasChildren : true,
           onClick     : function () {
             that.loadCommits(repoId, branchName, topCommit,
-              filteredCommits.newOffset, parentid);
+              filteredCommits.newOffset, parentid,
+              filteredCommits.nextCursor);
           }
         });
       } else {
@@ -17,10 +17,10 @@ public:
   MetricsParser(ParserContext& ctx_);
   virtual bool cleanupDatabase() override;
   virtual bool parse() override;
+  virtual std::vector<std::string> dependencies() const override;
+  virtual bool incremental() const override;
 
 private:
-  util::DirIterCallback getParserCallback();
-
   struct Loc
   {
     Loc() : originalLines(0), nonblankLines(0), codeLines(0) {}
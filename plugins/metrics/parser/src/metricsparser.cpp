@@ -11,6 +11,7 @@
 
 #include <parser/sourcemanager.h>
 
+#include <model/filecontentstore.h>
 #include <model/metrics.h>
 #include <model/metrics-odb.hxx>
 
@@ -30,20 +31,19 @@ MetricsParser::MetricsParser(ParserContext& ctx_): AbstractParser(ctx_)
       _fileIdCache.insert(mf.file);
     }
   });
+}
 
-  int threadNum = _ctx.options["jobs"].as<int>();
-  _pool = util::make_thread_pool<std::string>(
-    threadNum, [this](const std::string& path_)
-    {
-      model::FilePtr file = _ctx.srcMgr.getFile(path_);
-      if (file)
-      {
-        if (_fileIdCache.find(file->id) == _fileIdCache.end())
-          this->persistLoc(getLocFromFile(file), file->id);
-        else
-          LOG(info) << "Metrics already counted for file: " << file->path;
-      }
-    });
+std::vector<std::string> MetricsParser::dependencies() const
+{
+  // The comment syntax depends on the file types which are set by the
+  // language parsers.
+  return {"cppparser", "pythonparser"};
+}
+
+bool MetricsParser::incremental() const
+{
+  // The metrics of the unchanged files are kept in the cache.
+  return true;
 }
 
 bool MetricsParser::cleanupDatabase()
@@ -82,52 +82,30 @@ bool MetricsParser::cleanupDatabase()
 
 bool MetricsParser::parse()
 {
-  for(std::string path : _ctx.options["input"].as<std::vector<std::string>>())
-  {
-    LOG(info) << "Metrics parse path: " << path;
-
-    util::OdbTransaction trans(_ctx.db);
-    trans([&, this]() {
-      auto cb = getParserCallback();
-
-      /*--- Call non-empty iter-callback for all files
-         in the current root directory. ---*/
-      try
-      {
-        util::iterateDirectoryRecursive(path, cb);
-      }
-      catch (std::exception& ex_)
-      {
-        LOG(warning)
-          << "Metrics parser threw an exception: " << ex_.what();
-      }
-      catch (...)
+  // The thread pool is created here, because the number of threads is granted
+  // by the parser driver right before parsing.
+  _pool = util::make_thread_pool<std::string>(
+    threadNum(), [this](const std::string& path_)
+    {
+      model::FilePtr file = _ctx.srcMgr.getFile(path_);
+      if (file)
       {
-        LOG(warning)
-          << "Metrics parser failed with unknown exception!";
+        if (_fileIdCache.find(file->id) == _fileIdCache.end())
+          this->persistLoc(getLocFromFile(file), file->id);
+        else
+          LOG(info) << "Metrics already counted for file: " << file->path;
       }
-
     });
-  }
+
+  for (const FileManifest::Entry& entry : _ctx.manifest.entries())
+    if (!entry.directory)
+      _pool->enqueue(entry.path);
 
   _pool->wait();
 
   return true;
 }
 
-util::DirIterCallback MetricsParser::getParserCallback()
-{
-  return [this](const std::string& currPath_)
-  {
-    boost::filesystem::path path(currPath_);
-
-    if (boost::filesystem::is_regular_file(path))
-      _pool->enqueue(currPath_);
-
-    return true;
-  };
-}
-
 MetricsParser::Loc MetricsParser::getLocFromFile(model::FilePtr file_) const
 {
   Loc result;
@@ -136,8 +114,14 @@ MetricsParser::Loc MetricsParser::getLocFromFile(model::FilePtr file_) const
 
   //--- Get source code ---//
 
-  std::string content
-    = file_->content ? file_->content.load()->content : std::string();
+  model::FileContentPtr fileContent = file_->content.load();
+  std::string content = fileContent ? fileContent->content : std::string();
+
+  // The contents of the files parsed earlier are stored compressed.
+  if (fileContent && content.empty())
+    util::OdbTransaction {_ctx.db} ([&, this]{
+      content = model::loadFileContent(*_ctx.db, *fileContent);
+    });
 
   if (content.empty())
     return result;
@@ -21,6 +21,7 @@ public:
     virtual bool cleanupDatabase() override;
 
     virtual bool parse() override;
+    virtual bool multiThreaded() const override;
 };
 
 } // parser
@@ -137,21 +137,25 @@ void Persistence::persistFile(boost::python::object pyFile)
             std::cout << "path is None..." << std::endl;
         } else {
             file = ctx.srcMgr.getFile(boost::python::extract<std::string>(path));
-            file->type = "PY";
             buildSource.file = file;
-            switch(boost::python::extract<int>(status)){
-                case 0:
-                    buildSource.file->parseStatus = model::File::PSNone;
-                    break;
-                case 1:
-                    buildSource.file->parseStatus = model::File::PSPartiallyParsed;
-                    break;
-                case 2:
-                    buildSource.file->parseStatus = model::File::PSFullyParsed;
-                    break;
-                default:
-                    std::cout << "Unknown status: " << boost::python::extract<int>(status) << std::endl;
-            }
+            int parseStatus = boost::python::extract<int>(status);
+            ctx.srcMgr.updateFile(file, [parseStatus](model::File& file_){
+                file_.type = "PY";
+                switch(parseStatus){
+                    case 0:
+                        file_.parseStatus = model::File::PSNone;
+                        break;
+                    case 1:
+                        file_.parseStatus = model::File::PSPartiallyParsed;
+                        break;
+                    case 2:
+                        file_.parseStatus = model::File::PSFullyParsed;
+                        break;
+                    default:
+                        std::cout << "Unknown status: " << parseStatus << std::endl;
+                }
+                return true;
+            });
 
             model::BuildActionPtr buildAction(new model::BuildAction);
             buildAction->command = "";
@@ -165,8 +169,6 @@ void Persistence::persistFile(boost::python::object pyFile)
 
                 buildSource.action = buildAction;
 
-                ctx.srcMgr.updateFile(*buildSource.file);
-
                 transaction([&, this] {
                     ctx.db->persist(buildSource);
                 });
@@ -843,6 +845,8 @@ void PythonParser::markModifiedFiles() {}
 
 bool PythonParser::cleanupDatabase() { return true; }
 
+bool PythonParser::multiThreaded() const { return false; }
+
 bool PythonParser::parse()
 {
     const std::string PARSER_SCRIPTS_DIR = _ctx.compassRoot + "/lib/parserplugin/scripts/python";
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <regex>
 #include <iostream>
 
@@ -20,6 +21,7 @@
 #include <model/pythonvariable.h>
 #include <model/pythonvariable-odb.hxx>
 #include <model/pythonentity-odb.hxx>
+#include <model/filecontentstore.h>
 
 namespace
 {
@@ -165,17 +167,31 @@ void PythonServiceHandler::getSourceText(
 {
     return_ = _transaction([this, &astNodeId_](){
         model::PythonAstNode astNode = queryPythonAstNode(astNodeId_);
+        const model::Range& range = astNode.location.range;
 
-        if (astNode.location.file){
-            return cc::util::textRange(
-                astNode.location.file.load()->content.load()->content,
-                astNode.location.range.start.line,
-                astNode.location.range.start.column,
-                astNode.location.range.end.line,
-                astNode.location.range.end.column);
+        if (!astNode.location.file ||
+            range.start.line == model::Position::npos ||
+            range.end.line == model::Position::npos ||
+            range.end.line < range.start.line){
+            return std::string();
         }
 
-        return std::string();
+        model::FileContentPtr content =
+                astNode.location.file.load()->content.load();
+
+        if (!content){
+            return std::string();
+        }
+
+        // Only the lines of the node are loaded, so the range is shifted to
+        // start at the first line.
+        return cc::util::textRange(
+            model::loadFileLines(
+                *_db, *content, range.start.line, range.end.line),
+            1,
+            range.start.column,
+            range.end.line - range.start.line + 1,
+            range.end.column);
     });
 }
 
@@ -845,7 +861,10 @@ void PythonServiceHandler::getSyntaxHighlight(
     std::vector<SyntaxHighlight>& return_,
     const core::FileRange& range_)
 {
+    // Only the lines of the range are loaded, content[0] is firstLine.
     std::vector<std::string> content;
+    std::size_t firstLine =
+            std::max<std::size_t>(range_.range.startpos.line, 1);
 
     _transaction([&, this]() {
 
@@ -858,7 +877,8 @@ void PythonServiceHandler::getSyntaxHighlight(
             return;
         }
 
-        std::istringstream s(file->content->content);
+        std::istringstream s(model::loadFileLines(
+                *_db, *file->content, firstLine, range_.range.endpos.line));
         std::string line;
         while (std::getline(s, line)){
             content.push_back(line);
@@ -880,12 +900,15 @@ void PythonServiceHandler::getSyntaxHighlight(
             std::string reg = "\\b" + node.astValue + "\\b";
 
             for (std::size_t i = node.location.range.start.line - 1;
-                 i < node.location.range.end.line && i < content.size();
+                 i < node.location.range.end.line &&
+                 i - (firstLine - 1) < content.size();
                  ++i)
             {
+                const std::string& text = content[i - (firstLine - 1)];
+
                 std::regex words_regex(reg);
                 auto words_begin = std::sregex_iterator(
-                        content[i].begin(), content[i].end(),
+                        text.begin(), text.end(),
                         words_regex);
                 auto words_end = std::sregex_iterator();
 
@@ -1,10 +1,6 @@
 #ifndef CC_PARSER_SEARCHPARSER_H
 #define CC_PARSER_SEARCHPARSER_H
 
-#include <magic.h>
-
-#include <util/parserutil.h>
-
 #include <parser/abstractparser.h>
 #include <parser/parsercontext.h>
 
@@ -22,11 +18,13 @@ public:
   virtual ~SearchParser();
 
   virtual bool parse() override;
+  virtual bool multiThreaded() const override;
 
 private:
   void postParse();
-  util::DirIterCallback getParserCallback(const std::string& path_);
-  bool shouldHandle(const std::string& path_);
+  bool isSkippedDirectory(const std::string& path_) const;
+  void indexFile(const FileManifest::Entry& entry_);
+  bool shouldHandle(const FileManifest::Entry& entry_);
 
 private:
   /**
@@ -34,11 +32,6 @@ private:
    */
   std::unique_ptr<IndexerProcess> _indexProcess;
 
-  /**
-   * libmagic handler for mime types.
-   */
-  ::magic_t _fileMagic;
-
   /**
    * Directory of search database.
    */
@@ -1,5 +1,6 @@
 #include <string>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #include <array>
 #include <sys/types.h>
@@ -31,23 +32,8 @@ std::array<const char*, 15> excludedSuffixes{{
   ".Metrics.dat", ".pp"
 }};
 
-SearchParser::SearchParser(ParserContext& ctx_) : AbstractParser(ctx_),
-  _fileMagic(::magic_open(MAGIC_MIME_TYPE | MAGIC_SYMLINK))
+SearchParser::SearchParser(ParserContext& ctx_) : AbstractParser(ctx_)
 {
-  if (!_fileMagic)
-  {
-    LOG(warning) << "Failed to create a libmagic cookie!";
-  }
-  else if (::magic_load(_fileMagic, nullptr) != 0)
-  {
-    LOG(warning)
-      << "magic_load failed! libmagic error: "
-      << ::magic_error(_fileMagic);
-
-    ::magic_close(_fileMagic);
-    _fileMagic = nullptr;
-  }
-
   std::string wsDir = ctx_.options["workspace"].as<std::string>();
   std::string projDir = wsDir + '/' + ctx_.options["name"].as<std::string>();
   _searchDatabase = projDir + "/search";
@@ -78,8 +64,20 @@ SearchParser::SearchParser(ParserContext& ctx_) : AbstractParser(ctx_),
   }
 }
 
+bool SearchParser::multiThreaded() const
+{
+  return false;
+}
+
 bool SearchParser::parse()
 {
+  // The existing search database is kept if it can't be rebuilt.
+  if (!_indexProcess)
+  {
+    LOG(warning) << "Indexer process is not available, skip parsing.";
+    return false;
+  }
+
   if (fs::is_directory(_searchDatabase))
   {
     fs::remove_all(_searchDatabase);
@@ -87,14 +85,31 @@ bool SearchParser::parse()
     LOG(info) << "Search database already exists, dropping.";
   }
 
-  for (const std::string& path :
-    _ctx.options["input"].as<std::vector<std::string>>())
+  // Entry paths of the skipped directories, each followed by a separator.
+  std::vector<std::string> skippedPaths;
+
+  for (const FileManifest::Entry& entry : _ctx.manifest.entries())
   {
-    LOG(info) << "Search parse path: " << path;
+    if (std::any_of(skippedPaths.begin(), skippedPaths.end(),
+      [&entry](const std::string& prefix_)
+      {
+        return entry.path.compare(0, prefix_.size(), prefix_) == 0;
+      }))
+      continue;
 
     try
     {
-      util::iterateDirectoryRecursive(path, getParserCallback(path));
+      if (entry.directory)
+      {
+        if (isSkippedDirectory(entry.path))
+        {
+          LOG(info) << "Skipping " << entry.path << " because it was listed "
+            "in the skipping directory flag of the search parser.";
+          skippedPaths.push_back(entry.path + '/');
+        }
+      }
+      else if (shouldHandle(entry))
+        indexFile(entry);
     }
     catch (const std::exception& ex_)
     {
@@ -111,70 +126,43 @@ bool SearchParser::parse()
   return true;
 }
 
-util::DirIterCallback SearchParser::getParserCallback(const std::string& path_)
+bool SearchParser::isSkippedDirectory(const std::string& path_) const
 {
-  if (!_indexProcess)
-  {
-    LOG(warning) << "Indexer process is not available, skip path: " << path_;
-    return [](const std::string&){ return false; };
-  }
+  if (_skipDirectories.empty())
+    return false;
 
-  return [this](const std::string& currPath_)
-  {
-    if (fs::is_directory(currPath_))
-    {
-      fs::path canonicalPath = fs::canonical(currPath_);
+  fs::path canonicalPath = fs::canonical(path_);
 
-      if (std::find(_skipDirectories.begin(), _skipDirectories.end(),
-            canonicalPath) != _skipDirectories.end())
-      {
-        LOG(info) << "Skipping " << currPath_ << " because it was listed in "
-          "the skipping directory flag of the search parser.";
-        return false;
-      }
-    }
+  return std::find(_skipDirectories.begin(), _skipDirectories.end(),
+    canonicalPath) != _skipDirectories.end();
+}
 
-    if (!shouldHandle(currPath_))
-      return true;
+void SearchParser::indexFile(const FileManifest::Entry& entry_)
+{
+  model::FilePtr file = _ctx.srcMgr.getFile(entry_.path);
 
-    model::FilePtr file = _ctx.srcMgr.getFile(currPath_);
+  if (file)
+  {
+    std::string mimeType = _ctx.manifest.fileType(entry_.path).mimeType;
+    if (mimeType.empty())
+      mimeType = "text/plain";
 
-    if (file)
+    _ctx.srcMgr.updateFile(file, [](model::File& file_)
     {
-      std::string mimeType("text/plain");
-      if (_fileMagic)
-      {
-        const char* mimeStr = ::magic_file(_fileMagic, currPath_.c_str());
-
-        if (mimeStr)
-          mimeType = mimeStr;
-        else
-          LOG(warning)
-            << "Failed to get mime type for file '"
-            << currPath_ << "'. libmagic error: "
-            << ::magic_error(_fileMagic);
-      }
-
-      file->inSearchIndex = true;
-      _ctx.srcMgr.persistFiles();
-      _indexProcess->indexFile(
-        std::to_string(file->id), file->path, mimeType);
-    }
-
-    return true;
-  };
+      file_.inSearchIndex = true;
+      return true;
+    });
+    _ctx.srcMgr.persistFiles();
+    _indexProcess->indexFile(
+      std::to_string(file->id), file->path, mimeType);
+  }
 }
 
-bool SearchParser::shouldHandle(const std::string& path_)
+bool SearchParser::shouldHandle(const FileManifest::Entry& entry_)
 {
-  //--- The file is not regular. ---//
-
-  if (!fs::is_regular(path_))
-    return false;
-
   //--- The file is excluded by suffix. ---//
 
-  std::string normPath(path_);
+  std::string normPath(entry_.path);
   std::transform(normPath.begin(), normPath.end(), normPath.begin(), ::tolower);
 
   for (const char* suff : excludedSuffixes)
@@ -184,25 +172,22 @@ bool SearchParser::shouldHandle(const std::string& path_)
     if (normPath.length() >= sufflen &&
         normPath.compare(normPath.length() - sufflen, sufflen, suff) == 0)
     {
-      LOG(info) << "Skipping " << path_;
+      LOG(info) << "Skipping " << entry_.path;
       return false;
     }
   }
 
   //--- The file is larger than one megabyte. ---//
 
-  struct stat statbuf;
-  if (::stat(path_.c_str(), &statbuf) == -1)
-    return false;
-
-  if (statbuf.st_size > (1024 * 1024))
+  if (entry_.size > (1024 * 1024))
     return false;
 
   //--- The file is not plain text. ---//
 
-  if (!_ctx.srcMgr.isPlainText(path_))
+  if (!_ctx.manifest.fileType(entry_.path).plainText)
   {
-    LOG(info) << "Skipping " << path_ << " because it is not plain text.";
+    LOG(info) << "Skipping " << entry_.path
+      << " because it is not plain text.";
     return false;
   }
 
@@ -225,8 +210,6 @@ void SearchParser::postParse()
 
 SearchParser::~SearchParser()
 {
-  if (_fileMagic)
-    ::magic_close(_fileMagic);
 }
 
 #pragma clang diagnostic push
@@ -1,7 +1,11 @@
 #ifndef CC_SERVICE_CORE_PROJECTSERVICE_H
 #define CC_SERVICE_CORE_PROJECTSERVICE_H
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 #include <boost/program_options/variables_map.hpp>
 
@@ -9,6 +13,7 @@
 
 #include <model/file.h>
 #include <util/odbtransaction.h>
+#include <webserver/filecache.h>
 #include <webserver/servercontext.h>
 
 #include <ProjectService.h>
@@ -20,6 +25,8 @@ namespace service
 namespace core
 {
 
+class FileNameIndex;
+
 class ProjectServiceHandler : virtual public ProjectServiceIf {
 public:
   ProjectServiceHandler(
@@ -27,6 +34,8 @@ public:
     std::shared_ptr<std::string> datadir_,
     const cc::webserver::ServerContext& context_);
 
+  ~ProjectServiceHandler();
+
   void getFileInfo(FileInfo& return_, const FileId& fileId_) override;
   void getFileInfoByPath(FileInfo& return_, const std::string& path) override;
   void getFileContent(std::string& return_, const FileId& fileId_) override;
@@ -49,11 +58,42 @@ private:
    */
   static bool fileInfoOrder(const FileInfo& left, const FileInfo& right);
 
-  FileInfo makeFileInfo(model::File &f_);
+  FileInfo makeFileInfo(const model::File& f_);
+
+  /**
+   * Returns the File row of the given ID through the file cache.
+   * @throw InvalidId if there is no such file.
+   */
+  webserver::FileCache::FilePtr loadFile(const FileId& fileId_);
+
+  /**
+   * Returns the file name index if it belongs to the current generation of
+   * the database. Otherwise it starts building a new index in the background
+   * unless it is already being built, and returns nullptr.
+   */
+  std::shared_ptr<const FileNameIndex> fileNameIndex();
+
+  /**
+   * Returns the generation of the database. Like in webserver::FileCache, it
+   * is queried at most once in _generationCheckInterval, so the searches
+   * triggered by keystrokes don't query it every time.
+   */
+  std::uint64_t generation();
 
   std::shared_ptr<odb::database> _db;
   util::OdbTransaction _transaction;
   std::string _datadir;
+  webserver::FileCache* _fileCache;
+
+  std::shared_ptr<const FileNameIndex> _fileNameIndex;
+  std::thread _fileNameIndexBuilder;
+  bool _fileNameIndexBuilding;
+  std::mutex _fileNameIndexMutex;
+
+  const std::chrono::seconds _generationCheckInterval;
+  std::uint64_t _generation;
+  std::chrono::steady_clock::time_point _generationCheckTime;
+  std::mutex _generationMutex;
 };
 
 } // project
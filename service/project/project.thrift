@@ -63,7 +63,15 @@ service ProjectService
   list<FileInfo> getOpenTreeTillFile(1:common.FileId fileId)
   list<FileInfo> getPathTillFile(1:common.FileId fileId)
   list<BuildLog> getBuildLog(1:common.FileId fileId)
+
+  /**
+   * This function returns the files whose path (or name if onlyFile is true)
+   * contains the characters of the text in order, case-insensitively. The
+   * best 500 matches are returned, the best one first. Until the file name
+   * index of the server is built, every file containing the text is returned.
+   */
   list<FileInfo> searchFile(1:string text, 2:bool onlyFile)
+
   list<StatisticsInfo> getStatistics()
   list<string> getFileTypes()
 
@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <future>
+#include <queue>
+#include <thread>
+
+#include <odb/query.hxx>
+
+#include <model/file-odb.hxx>
+
+#include "filenameindex.h"
+
+namespace
+{
+
+/**
+ * Score of a matching character and the bonuses and penalties on top of it,
+ * following the weights of fzf.
+ */
+constexpr int SCORE_MATCH = 16;
+constexpr int SCORE_GAP_START = -3;
+constexpr int SCORE_GAP_EXTENSION = -1;
+constexpr int BONUS_BOUNDARY = 8;
+constexpr int BONUS_CAMEL = 7;
+constexpr int BONUS_CONSECUTIVE = 4;
+constexpr int BONUS_FIRST_CHAR_MULTIPLIER = 2;
+
+/**
+ * Bonus of a path search whose characters are all in the file name, so that
+ * these files precede the ones matching only in the directories.
+ */
+constexpr int BONUS_FILE_NAME = 2 * SCORE_MATCH;
+
+/**
+ * Indexes with more entries than this are searched by several threads.
+ */
+constexpr std::size_t PARALLEL_SEARCH_THRESHOLD = 256 * 1024;
+
+inline char toLower(char c_)
+{
+  return c_ >= 'A' && c_ <= 'Z' ? c_ - 'A' + 'a' : c_;
+}
+
+inline bool isLower(char c_)
+{
+  return c_ >= 'a' && c_ <= 'z';
+}
+
+inline bool isUpper(char c_)
+{
+  return c_ >= 'A' && c_ <= 'Z';
+}
+
+inline bool isDigit(char c_)
+{
+  return c_ >= '0' && c_ <= '9';
+}
+
+/**
+ * Returns the bonus of a matching character at pos_ based on the character
+ * before it.
+ */
+int boundaryBonus(const char* textBegin_, const char* pos_)
+{
+  if (pos_ == textBegin_)
+    return BONUS_BOUNDARY;
+
+  char prev = pos_[-1];
+  char curr = *pos_;
+
+  switch (prev)
+  {
+    case '/': case '\\': case '_': case '-': case '.': case ' ':
+      return BONUS_BOUNDARY;
+  }
+
+  if (isLower(prev) && isUpper(curr))
+    return BONUS_CAMEL;
+
+  if (!isDigit(prev) && isDigit(curr))
+    return BONUS_CAMEL;
+
+  return 0;
+}
+
+/**
+ * Orders the better matches first: a higher score, then a shorter path.
+ */
+template <typename Match>
+struct BetterMatch
+{
+  bool operator()(const Match& left_, const Match& right_) const
+  {
+    if (left_.score != right_.score)
+      return left_.score > right_.score;
+    if (left_.pathSize != right_.pathSize)
+      return left_.pathSize < right_.pathSize;
+    return left_.id < right_.id;
+  }
+};
+
+} // namespace
+
+namespace cc
+{
+namespace service
+{
+namespace core
+{
+
+FileNameIndex::FileNameIndex(odb::database& db_, std::uint64_t generation_)
+  : _generation(generation_)
+{
+  for (const model::File& file : db_.query<model::File>())
+    add(file);
+
+  shrink();
+}
+
+FileNameIndex::FileNameIndex(
+  const std::vector<model::File>& files_,
+  std::uint64_t generation_)
+  : _generation(generation_)
+{
+  for (const model::File& file : files_)
+    add(file);
+
+  shrink();
+}
+
+void FileNameIndex::add(const model::File& file_)
+{
+  const std::string& path = file_.path;
+
+  std::size_t nameOffset;
+  if (!file_.filename.empty() &&
+      file_.filename.size() <= path.size() &&
+      path.compare(
+        path.size() - file_.filename.size(),
+        file_.filename.size(),
+        file_.filename) == 0)
+    nameOffset = path.size() - file_.filename.size();
+  else
+    nameOffset = path.rfind('/') + 1; // npos + 1 is 0.
+
+  Entry entry;
+  entry.id = file_.id;
+  entry.pathBegin = _paths.size();
+  entry.pathSize = path.size();
+  entry.nameOffset = nameOffset;
+  entry.isDirectory = file_.type == model::File::DIRECTORY_TYPE;
+
+  _paths += path;
+  _entries.push_back(entry);
+  _pathMasks.push_back(charMask(path.data(), path.data() + path.size()));
+  _nameMasks.push_back(charMask(
+    path.data() + nameOffset, path.data() + path.size()));
+}
+
+void FileNameIndex::shrink()
+{
+  _paths.shrink_to_fit();
+  _entries.shrink_to_fit();
+  _pathMasks.shrink_to_fit();
+  _nameMasks.shrink_to_fit();
+}
+
+std::vector<model::FileId> FileNameIndex::search(
+  const std::string& pattern_,
+  bool onlyFile_,
+  std::size_t limit_) const
+{
+  std::string pattern(pattern_.size(), '\0');
+  std::transform(pattern_.begin(), pattern_.end(), pattern.begin(), toLower);
+
+  std::vector<Match> matches;
+
+  std::size_t threadNum = std::thread::hardware_concurrency();
+
+  if (_entries.size() < PARALLEL_SEARCH_THRESHOLD || threadNum < 2)
+    matches = searchRange(pattern, onlyFile_, limit_, 0, _entries.size());
+  else
+  {
+    std::size_t chunkSize = (_entries.size() + threadNum - 1) / threadNum;
+    std::vector<std::future<std::vector<Match>>> chunks;
+
+    for (std::size_t begin = 0; begin < _entries.size(); begin += chunkSize)
+      chunks.push_back(std::async(
+        std::launch::async,
+        &FileNameIndex::searchRange,
+        this,
+        std::cref(pattern),
+        onlyFile_,
+        limit_,
+        begin,
+        std::min(begin + chunkSize, _entries.size())));
+
+    for (std::future<std::vector<Match>>& chunk : chunks)
+    {
+      std::vector<Match> chunkMatches = chunk.get();
+      matches.insert(matches.end(), chunkMatches.begin(), chunkMatches.end());
+    }
+  }
+
+  BetterMatch<Match> better;
+
+  if (matches.size() > limit_)
+  {
+    std::nth_element(
+      matches.begin(), matches.begin() + limit_, matches.end(), better);
+    matches.resize(limit_);
+  }
+
+  std::sort(matches.begin(), matches.end(), better);
+
+  std::vector<model::FileId> result;
+  result.reserve(matches.size());
+  for (const Match& match : matches)
+    result.push_back(match.id);
+
+  return result;
+}
+
+std::vector<FileNameIndex::Match> FileNameIndex::searchRange(
+  const std::string& pattern_,
+  bool onlyFile_,
+  std::size_t limit_,
+  std::size_t begin_,
+  std::size_t end_) const
+{
+  std::uint64_t patternMask
+    = charMask(pattern_.data(), pattern_.data() + pattern_.size());
+
+  const std::vector<std::uint64_t>& masks
+    = onlyFile_ ? _nameMasks : _pathMasks;
+
+  // The worst of the best matches is on the top, so that it can be replaced
+  // by a better one.
+  std::priority_queue<Match, std::vector<Match>, BetterMatch<Match>> best;
+
+  for (std::size_t i = begin_; i < end_; ++i)
+  {
+    if ((masks[i] & patternMask) != patternMask)
+      continue;
+
+    const Entry& entry = _entries[i];
+
+    if (onlyFile_ && entry.isDirectory)
+      continue;
+
+    const char* path = _paths.data() + entry.pathBegin;
+    const char* name = path + entry.nameOffset;
+    const char* end = path + entry.pathSize;
+
+    int matchScore = -1;
+
+    if (onlyFile_ || (_nameMasks[i] & patternMask) == patternMask)
+    {
+      matchScore = score(pattern_, name, name, end);
+      if (!onlyFile_ && matchScore >= 0)
+        matchScore += BONUS_FILE_NAME;
+    }
+
+    if (!onlyFile_ && matchScore < 0)
+      matchScore = score(pattern_, path, path, end);
+
+    if (matchScore < 0)
+      continue;
+
+    Match match{matchScore, entry.pathSize, entry.id};
+
+    if (best.size() < limit_)
+      best.push(match);
+    else if (limit_ && BetterMatch<Match>()(match, best.top()))
+    {
+      best.pop();
+      best.push(match);
+    }
+  }
+
+  std::vector<Match> result;
+  result.reserve(best.size());
+  for (; !best.empty(); best.pop())
+    result.push_back(best.top());
+
+  return result;
+}
+
+std::uint64_t FileNameIndex::charMask(const char* begin_, const char* end_)
+{
+  std::uint64_t mask = 0;
+
+  for (const char* it = begin_; it != end_; ++it)
+  {
+    unsigned char c = toLower(*it);
+
+    if (c >= 'a' && c <= 'z')
+      mask |= std::uint64_t(1) << (c - 'a');
+    else if (c >= '0' && c <= '9')
+      mask |= std::uint64_t(1) << (26 + c - '0');
+    else
+      mask |= std::uint64_t(1) << (36 + c % 28);
+  }
+
+  return mask;
+}
+
+int FileNameIndex::score(
+  const std::string& pattern_,
+  const char* textBegin_,
+  const char* matchBegin_,
+  const char* textEnd_)
+{
+  if (pattern_.empty())
+    return 0;
+
+  // Find the first occurrence of the pattern as a subsequence, then scan
+  // backwards from its end to find the shortest one ending there.
+
+  std::size_t p = 0;
+  const char* end = matchBegin_;
+  for (; end != textEnd_ && p < pattern_.size(); ++end)
+    if (toLower(*end) == pattern_[p])
+      ++p;
+
+  if (p < pattern_.size())
+    return -1;
+
+  const char* begin = end;
+  for (p = pattern_.size(); p > 0; )
+    if (toLower(*--begin) == pattern_[p - 1])
+      --p;
+
+  // Score the occurrence.
+
+  int result = 0;
+  int consecutive = 0;
+  bool inGap = false;
+  p = 0;
+
+  for (const char* it = begin; it != end; ++it)
+  {
+    if (toLower(*it) == pattern_[p])
+    {
+      int bonus = boundaryBonus(textBegin_, it);
+
+      if (consecutive)
+        bonus = std::max(bonus, BONUS_CONSECUTIVE);
+      if (p == 0)
+        bonus *= BONUS_FIRST_CHAR_MULTIPLIER;
+
+      result += SCORE_MATCH + bonus;
+      ++consecutive;
+      inGap = false;
+      ++p;
+    }
+    else
+    {
+      result += inGap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+      consecutive = 0;
+      inGap = true;
+    }
+  }
+
+  return std::max(result, 0);
+}
+
+} // core
+} // service
+} // cc
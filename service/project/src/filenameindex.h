@@ -0,0 +1,143 @@
+#ifndef CC_SERVICE_CORE_FILENAMEINDEX_H
+#define CC_SERVICE_CORE_FILENAMEINDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <odb/database.hxx>
+
+#include <model/file.h>
+
+namespace cc
+{
+namespace service
+{
+namespace core
+{
+
+/**
+ * In-memory index of the paths of the files for the file finder. A search
+ * matches the characters of the pattern in order, but not necessarily
+ * consecutively, case-insensitively. The matches are scored the way fzf does:
+ * consecutive characters and characters at the beginning of a path component
+ * or a word score higher, gaps between the characters score lower.
+ *
+ * The paths are stored in one string. Each entry has a bit mask of the
+ * characters in its path and file name, so most of the entries are rejected
+ * by one bitwise operation without looking at the path. The masks are stored
+ * in separate arrays to scan as little memory as possible. Large indexes are
+ * searched by several threads.
+ *
+ * The index is immutable after it has been built, so it can be searched by
+ * several threads at the same time.
+ */
+class FileNameIndex
+{
+public:
+  /**
+   * Builds the index from the File table. This function must be called in a
+   * transaction.
+   * @param generation_ Generation of the database (see
+   * model/databasegeneration.h) which the index belongs to.
+   */
+  FileNameIndex(odb::database& db_, std::uint64_t generation_);
+
+  /**
+   * Builds the index from the given files.
+   */
+  FileNameIndex(
+    const std::vector<model::File>& files_,
+    std::uint64_t generation_);
+
+  /**
+   * Returns the IDs of the best matching files, the best one first.
+   * @param onlyFile_ If true then the pattern is matched against the file
+   * names of the non-directory files, otherwise against the whole paths.
+   * @param limit_ Maximal number of the results.
+   */
+  std::vector<model::FileId> search(
+    const std::string& pattern_,
+    bool onlyFile_,
+    std::size_t limit_) const;
+
+  std::size_t size() const
+  {
+    return _entries.size();
+  }
+
+  std::uint64_t generation() const
+  {
+    return _generation;
+  }
+
+private:
+  struct Entry
+  {
+    model::FileId id;
+    std::size_t pathBegin; /*!< Offset of the path in _paths. */
+    std::uint32_t pathSize;
+    std::uint32_t nameOffset; /*!< Offset of the file name in the path. */
+    bool isDirectory;
+  };
+
+  struct Match
+  {
+    int score;
+    std::uint32_t pathSize;
+    model::FileId id;
+  };
+
+  /**
+   * Appends a file to the index.
+   */
+  void add(const model::File& file_);
+
+  /**
+   * Releases the unused capacity after the files have been added.
+   */
+  void shrink();
+
+  /**
+   * Returns the best matches among the entries [begin_, end_) in an
+   * arbitrary order.
+   */
+  std::vector<Match> searchRange(
+    const std::string& pattern_,
+    bool onlyFile_,
+    std::size_t limit_,
+    std::size_t begin_,
+    std::size_t end_) const;
+
+  /**
+   * Returns a bit mask of the characters in the text. Letters and digits
+   * have their own bits, the other characters share the remaining ones.
+   */
+  static std::uint64_t charMask(const char* begin_, const char* end_);
+
+  /**
+   * Returns the fuzzy match score of the pattern in the text or a negative
+   * value if the text doesn't contain the characters of the pattern in
+   * order. The pattern must be lower case.
+   * @param textBegin_ Beginning of the text which is scanned for boundaries.
+   * @param matchBegin_ The pattern is matched in [matchBegin_, textEnd_).
+   */
+  static int score(
+    const std::string& pattern_,
+    const char* textBegin_,
+    const char* matchBegin_,
+    const char* textEnd_);
+
+  std::uint64_t _generation;
+  std::string _paths;
+  std::vector<Entry> _entries;
+  std::vector<std::uint64_t> _pathMasks; /*!< See charMask(). */
+  std::vector<std::uint64_t> _nameMasks;
+};
+
+} // core
+} // service
+} // cc
+
+#endif // CC_SERVICE_CORE_FILENAMEINDEX_H
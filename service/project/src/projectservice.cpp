@@ -1,4 +1,7 @@
 #include <algorithm>
+#include <chrono>
+#include <iterator>
+#include <unordered_map>
 
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/json_parser.hpp>
@@ -9,14 +12,21 @@
 #include <model/file-odb.hxx>
 #include <model/buildlog.h>
 #include <model/buildlog-odb.hxx>
+#include <model/databasegeneration.h>
+#include <model/filecontent.h>
+#include <model/filecontent-odb.hxx>
+#include <model/filecontentstore.h>
 #include <model/statistics.h>
 #include <model/statistics-odb.hxx>
 
 #include <util/dbutil.h>
+#include <util/logutil.h>
 #include <util/odbtransaction.h>
 
 #include <projectservice/projectservice.h>
 
+#include "filenameindex.h"
+
 namespace cc
 {
 namespace service
@@ -24,31 +34,219 @@ namespace service
 namespace core
 {
 
+namespace
+{
+
+typedef odb::query<model::File> FileQuery;
+typedef odb::result<model::File> FileResult;
+
+/**
+ * Maximal number of the results of searchFile() when it is answered from the
+ * file name index.
+ */
+constexpr std::size_t SEARCH_FILE_LIMIT = 500;
+
+/**
+ * Children of the directories, sorted by ProjectServiceHandler::fileInfoOrder,
+ * keyed by the ID of the directory.
+ */
+typedef std::unordered_map<FileId, std::vector<FileInfo>> ChildMap;
+
+/**
+ * Returns a subquery selecting the IDs of the descendants of a directory. The
+ * tree is walked by a recursive common table expression, which PostgreSQL and
+ * SQLite (since 3.8.3) both support, so a whole subtree is fetched in one
+ * query.
+ */
+FileQuery descendantIds(model::FileId fileId_)
+{
+  return FileQuery(
+    "(WITH RECURSIVE \"Descendant\"(\"id\") AS ("
+    "SELECT \"id\" FROM \"File\" WHERE \"parent\" = "
+    + FileQuery::_val(fileId_) +
+    " UNION ALL "
+    "SELECT \"f\".\"id\" FROM \"File\" AS \"f\" "
+    "JOIN \"Descendant\" AS \"d\" ON \"f\".\"parent\" = \"d\".\"id\") "
+    "SELECT \"id\" FROM \"Descendant\")");
+}
+
+/**
+ * Returns a subquery selecting the ID of a file and of its ancestors, see
+ * descendantIds().
+ */
+FileQuery ancestorIds(model::FileId fileId_)
+{
+  return FileQuery(
+    "(WITH RECURSIVE \"Ancestor\"(\"id\", \"parent\") AS ("
+    "SELECT \"id\", \"parent\" FROM \"File\" WHERE \"id\" = "
+    + FileQuery::_val(fileId_) +
+    " UNION ALL "
+    "SELECT \"f\".\"id\", \"f\".\"parent\" FROM \"File\" AS \"f\" "
+    "JOIN \"Ancestor\" AS \"a\" ON \"f\".\"id\" = \"a\".\"parent\") "
+    "SELECT \"id\" FROM \"Ancestor\")");
+}
+
+/**
+ * Returns the IDs of the files from the root to the given file by following
+ * the parents. The path ends where a parent is not in the map.
+ */
+std::vector<FileId> pathOf(
+  const FileId& fileId_,
+  const std::unordered_map<FileId, FileId>& parents_)
+{
+  std::vector<FileId> path;
+
+  for (auto it = parents_.find(fileId_);
+       it != parents_.end();
+       it = parents_.find(it->second))
+  {
+    path.push_back(it->first);
+
+    // Guard against a cycle in a corrupt database.
+    if (path.size() > parents_.size())
+      break;
+  }
+
+  std::reverse(path.begin(), path.end());
+  return path;
+}
+
+/**
+ * Appends the subtree of a directory in depth-first order.
+ */
+void appendSubtree(
+  std::vector<FileInfo>& return_,
+  const ChildMap& children_,
+  const FileId& fileId_)
+{
+  auto it = children_.find(fileId_);
+  if (it == children_.end())
+    return;
+
+  for (const FileInfo& f : it->second)
+  {
+    return_.push_back(f);
+    if (f.isDirectory)
+      appendSubtree(return_, children_, f.id);
+  }
+}
+
+} // namespace
+
 ProjectServiceHandler::ProjectServiceHandler(
   std::shared_ptr<odb::database> db_,
   std::shared_ptr<std::string> datadir_,
-  const cc::webserver::ServerContext& /*context_*/)
-    : _db(db_), _transaction(db_), _datadir(*datadir_)
+  const cc::webserver::ServerContext& context_)
+    : _db(db_), _transaction(db_), _datadir(*datadir_),
+      _fileCache(context_.fileCache), _fileNameIndexBuilding(false),
+      _generationCheckInterval(2), _generation(0)
 {
+  // Start building the file name index so that it is ready by the first
+  // search.
+  fileNameIndex();
 }
 
-void ProjectServiceHandler::getFileInfo(
-  FileInfo& return_,
-  const FileId& fileId_)
+ProjectServiceHandler::~ProjectServiceHandler()
 {
-  _transaction([&, this](){
-    model::File f;
+  if (_fileNameIndexBuilder.joinable())
+    _fileNameIndexBuilder.join();
+}
+
+std::uint64_t ProjectServiceHandler::generation()
+{
+  auto now = std::chrono::steady_clock::now();
 
-    if (!_db->find(std::stoull(fileId_), f))
+  {
+    std::lock_guard<std::mutex> lock(_generationMutex);
+
+    if (_generationCheckTime != std::chrono::steady_clock::time_point() &&
+        now - _generationCheckTime < _generationCheckInterval)
+      return _generation;
+  }
+
+  // The query runs without holding the lock. If several threads query the
+  // generation at the same time, then each of them stores the same value.
+  std::uint64_t value = model::loadDatabaseGeneration(_db);
+
+  std::lock_guard<std::mutex> lock(_generationMutex);
+  _generation = value;
+  _generationCheckTime = now;
+  return value;
+}
+
+std::shared_ptr<const FileNameIndex> ProjectServiceHandler::fileNameIndex()
+{
+  std::uint64_t generation = this->generation();
+
+  std::lock_guard<std::mutex> lock(_fileNameIndexMutex);
+
+  if (_fileNameIndex && _fileNameIndex->generation() == generation)
+    return _fileNameIndex;
+
+  if (_fileNameIndexBuilding)
+    return nullptr;
+
+  if (_fileNameIndexBuilder.joinable())
+    _fileNameIndexBuilder.join();
+
+  _fileNameIndexBuilding = true;
+  _fileNameIndexBuilder = std::thread([this, generation](){
+    std::shared_ptr<const FileNameIndex> index;
+
+    try
     {
-      InvalidId ex;
-      ex.__set_fid(fileId_);
-      ex.__set_msg("Invalid file ID");
-      throw ex;
+      auto start = std::chrono::steady_clock::now();
+
+      index = util::OdbTransaction {_db} ([&](){
+        return std::make_shared<const FileNameIndex>(*_db, generation);
+      });
+
+      LOG(info)
+        << "File name index of " << index->size() << " files built in "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now() - start).count() << " ms.";
+    }
+    catch (const std::exception& ex)
+    {
+      LOG(warning) << "Failed to build the file name index: " << ex.what();
     }
 
-    return_ = makeFileInfo(f);
+    std::lock_guard<std::mutex> indexLock(_fileNameIndexMutex);
+    if (index)
+      _fileNameIndex = std::move(index);
+    _fileNameIndexBuilding = false;
   });
+
+  return nullptr;
+}
+
+webserver::FileCache::FilePtr ProjectServiceHandler::loadFile(
+  const FileId& fileId_)
+{
+  auto load = [&, this](){
+    return _transaction([&, this](){
+      std::shared_ptr<model::File> f = std::make_shared<model::File>();
+
+      if (!_db->find(std::stoull(fileId_), *f))
+      {
+        InvalidId ex;
+        ex.__set_fid(fileId_);
+        ex.__set_msg("Invalid file ID");
+        throw ex;
+      }
+
+      return webserver::FileCache::FilePtr(f);
+    });
+  };
+
+  return _fileCache ? _fileCache->file(_db, fileId_, load) : load();
+}
+
+void ProjectServiceHandler::getFileInfo(
+  FileInfo& return_,
+  const FileId& fileId_)
+{
+  return_ = makeFileInfo(*loadFile(fileId_));
 }
 
 void ProjectServiceHandler::getFileInfoByPath(
@@ -76,20 +274,28 @@ void ProjectServiceHandler::getFileContent(
   std::string& return_,
   const FileId& fileId_)
 {
-  _transaction([&, this](){
-    model::File f;
+  webserver::FileCache::FilePtr f = loadFile(fileId_);
 
-    if (!_db->find(std::stoull(fileId_), f))
-    {
-      InvalidId ex;
-      ex.__set_msg("Invalid file ID: ");
-      ex.__set_fid(fileId_);
-      throw ex;
-    }
+  if (!f->content)
+    return;
 
-    if(std::shared_ptr<model::FileContent> fileContent = f.content.load())
-      return_ = fileContent->content;
-  });
+  std::string hash = f->content.object_id();
+
+  auto load = [&, this](){
+    return _transaction([&, this](){
+      std::shared_ptr<model::FileContent> fileContent
+        = _db->find<model::FileContent>(hash);
+
+      return std::make_shared<const webserver::FileCacheContent>(fileContent
+        ? model::loadFileContent(*_db, *fileContent)
+        : std::string());
+    });
+  };
+
+  if (_fileCache)
+    return_ = _fileCache->content(_db, hash, load)->text();
+  else
+    return_ = load()->text();
 }
 
 void ProjectServiceHandler::getParent(
@@ -153,69 +359,110 @@ void ProjectServiceHandler::getSubtree(
   std::vector<FileInfo>& return_,
   const FileId& fileId_)
 {
-  std::vector<FileInfo> childFiles;
-  getChildFiles(childFiles, fileId_);
+  ChildMap children;
 
-  for (const FileInfo& f : childFiles)
-  {
-    return_.push_back(f);
-    if (f.isDirectory)
-      getSubtree(return_, f.id);
-  }
+  _transaction([&, this](){
+    FileResult r = _db->query<model::File>(
+      FileQuery::id + " IN " + descendantIds(std::stoull(fileId_)));
+
+    model::File f;
+    for (FileResult::iterator i = r.begin(); i != r.end(); ++i)
+    {
+      i.load(f);
+      FileInfo fileInfo = makeFileInfo(f);
+      children[fileInfo.parent].push_back(std::move(fileInfo));
+    }
+  });
+
+  for (auto& siblings : children)
+    std::sort(siblings.second.begin(), siblings.second.end(), fileInfoOrder);
+
+  appendSubtree(return_, children, fileId_);
 }
 
 void ProjectServiceHandler::getOpenTreeTillFile(
   std::vector<FileInfo>& return_,
   const FileId& fileId_)
 {
-  FileInfo fInfo;
-  getFileInfo(fInfo, fileId_);
+  // The root files and the children of the directories on the path of the
+  // file are fetched by a single query. Every directory on the path is a
+  // child of the previous one, so the path can be rebuilt from the result.
+  std::vector<FileInfo> rootFiles;
+  std::unordered_map<FileId, FileId> parents;
+  ChildMap children;
 
-  std::vector<std::string> pathParts;
+  _transaction([&, this](){
+    FileResult r = _db->query<model::File>(
+      FileQuery::parent.is_null() ||
+      (FileQuery::parent + " IN " + ancestorIds(std::stoull(fileId_))));
 
-  char* path = const_cast<char*>(fInfo.path.c_str());
-  for (char* filename = std::strtok(path, "/");
-       filename;
-       filename = std::strtok(0, "/"))
-    pathParts.push_back(filename);
+    model::File f;
+    for (FileResult::iterator i = r.begin(); i != r.end(); ++i)
+    {
+      i.load(f);
+      FileInfo fileInfo = makeFileInfo(f);
+      parents[fileInfo.id] = fileInfo.parent;
 
-  std::vector<FileInfo> sub;
-  getRootFiles(sub);
-  std::copy(sub.begin(), sub.end(), std::back_inserter(return_));
+      if (f.parent)
+        children[fileInfo.parent].push_back(std::move(fileInfo));
+      else
+        rootFiles.push_back(std::move(fileInfo));
+    }
+  });
 
-  for (const std::string& filename : pathParts)
-    for (const FileInfo& child : sub)
-      if (child.name == filename)
-      {
-        sub.clear();
-        getChildFiles(sub, child.id);
-        std::copy(sub.begin(), sub.end(), std::back_inserter(return_));
-        break;
-      }
+  if (!parents.count(fileId_))
+  {
+    InvalidId ex;
+    ex.__set_fid(fileId_);
+    ex.__set_msg("Invalid file ID");
+    throw ex;
+  }
+
+  std::move(rootFiles.begin(), rootFiles.end(), std::back_inserter(return_));
+
+  for (const FileId& dirId : pathOf(fileId_, parents))
+  {
+    auto it = children.find(dirId);
+    if (it == children.end())
+      continue;
+
+    std::sort(it->second.begin(), it->second.end(), fileInfoOrder);
+    std::move(
+      it->second.begin(), it->second.end(), std::back_inserter(return_));
+  }
 }
 
 void ProjectServiceHandler::getPathTillFile(
   std::vector<FileInfo>& return_,
   const FileId& fileId_)
 {
-  FileInfo fileInfo;
-  getFileInfo(fileInfo, fileId_);
+  std::unordered_map<FileId, FileInfo> ancestors;
+  std::unordered_map<FileId, FileId> parents;
 
-  const std::string& path = fileInfo.path;
+  _transaction([&, this](){
+    FileResult r = _db->query<model::File>(
+      FileQuery::id + " IN " + ancestorIds(std::stoull(fileId_)));
 
-  std::size_t pos = -1;
-  while ((pos = path.find('/', pos + 1)) != std::string::npos)
-  {
-    std::string p = path.substr(0, pos);
-    if (p.empty())
-      p = "/";
+    model::File f;
+    for (FileResult::iterator i = r.begin(); i != r.end(); ++i)
+    {
+      i.load(f);
+      FileInfo fileInfo = makeFileInfo(f);
+      parents[fileInfo.id] = fileInfo.parent;
+      ancestors[fileInfo.id] = std::move(fileInfo);
+    }
+  });
 
-    FileInfo fileInfo;
-    getFileInfoByPath(fileInfo, p);
-    return_.push_back(fileInfo);
+  if (!ancestors.count(fileId_))
+  {
+    InvalidId ex;
+    ex.__set_fid(fileId_);
+    ex.__set_msg("Invalid file ID");
+    throw ex;
   }
 
-  return_.push_back(fileInfo);
+  for (const FileId& id : pathOf(fileId_, parents))
+    return_.push_back(std::move(ancestors[id]));
 }
 
 void ProjectServiceHandler::getBuildLog(
@@ -274,15 +521,43 @@ void ProjectServiceHandler::searchFile(
   const std::string& text_,
   const bool onlyFile_)
 {
-  typedef odb::result<model::File> FileResult;
-  typedef odb::query<model::File> FileQuery;
-
   std::string text = text_;
 
-  _transaction([&, this](){
-    if (text_.back() == '/')
-      text.pop_back();
+  if (!text.empty() && text.back() == '/')
+    text.pop_back();
+
+  std::shared_ptr<const FileNameIndex> index = fileNameIndex();
+
+  if (index)
+  {
+    std::vector<model::FileId> ids
+      = index->search(text, onlyFile_, SEARCH_FILE_LIMIT);
 
+    if (ids.empty())
+      return;
+
+    _transaction([&, this](){
+      std::unordered_map<model::FileId, FileInfo> fileInfos;
+
+      for (const model::File& f : _db->query<model::File>(
+             FileQuery::id.in_range(ids.begin(), ids.end())))
+        fileInfos[f.id] = makeFileInfo(f);
+
+      // The files are returned in the order of their ranks. A file may be
+      // missing if it has been removed since the index was built.
+      for (model::FileId id : ids)
+      {
+        auto it = fileInfos.find(id);
+        if (it != fileInfos.end())
+          return_.push_back(std::move(it->second));
+      }
+    });
+
+    return;
+  }
+
+  // The index is not built yet.
+  _transaction([&, this](){
     FileResult r
       = onlyFile_
       ? _db->query<model::File>(
@@ -365,7 +640,7 @@ void ProjectServiceHandler::getLabels(
       return_[label.first] = label.second.data();
 }
 
-FileInfo ProjectServiceHandler::makeFileInfo(model::File& f)
+FileInfo ProjectServiceHandler::makeFileInfo(const model::File& f)
 {
   FileInfo fileInfo;
 
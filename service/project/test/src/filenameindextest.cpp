@@ -0,0 +1,143 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <model/file.h>
+
+#include "filenameindex.h"
+
+using namespace cc;
+using namespace cc::service::core;
+
+namespace
+{
+
+model::File makeFile(
+  model::FileId id_,
+  const std::string& path_,
+  bool directory_ = false)
+{
+  model::File file;
+  file.id = id_;
+  file.path = path_;
+  file.filename = path_.substr(path_.rfind('/') + 1);
+  file.type = directory_ ? model::File::DIRECTORY_TYPE : "CPP";
+  return file;
+}
+
+} // namespace
+
+class FileNameIndexTest : public ::testing::Test
+{
+protected:
+  FileNameIndexTest()
+    : _index({
+        makeFile(1, "/src/util", true),
+        makeFile(2, "/src/util/strings.cpp"),
+        makeFile(3, "/src/util/strings.h"),
+        makeFile(4, "/docs/strings/readme.md"),
+        makeFile(5, "/src/parser/fabric.cpp"),
+        makeFile(6, "/src/parser/foo_bar.cpp"),
+        makeFile(7, "/src/parser/FooBar.h"),
+        makeFile(8, "/src/parser/fobber.h")}, 42)
+  {
+  }
+
+  FileNameIndex _index;
+};
+
+TEST_F(FileNameIndexTest, Build)
+{
+  EXPECT_EQ(8u, _index.size());
+  EXPECT_EQ(42u, _index.generation());
+}
+
+TEST_F(FileNameIndexTest, FileNameSearch)
+{
+  // Directories and the files matching only in their directories are left
+  // out. Equal scores are ordered by the path length.
+  EXPECT_EQ(
+    std::vector<model::FileId>({3, 2}),
+    _index.search("str", true, 10));
+}
+
+TEST_F(FileNameIndexTest, PathSearch)
+{
+  // The files matching in their names precede the ones matching only in
+  // their directories.
+  std::vector<model::FileId> result = _index.search("str", false, 10);
+  ASSERT_EQ(3u, result.size());
+  EXPECT_EQ(3u, result[0]);
+  EXPECT_EQ(2u, result[1]);
+  EXPECT_EQ(4u, result[2]);
+
+  EXPECT_EQ(
+    std::vector<model::FileId>({4}),
+    _index.search("docreadme", false, 10));
+  EXPECT_TRUE(_index.search("docreadme", true, 10).empty());
+}
+
+TEST_F(FileNameIndexTest, CaseInsensitive)
+{
+  EXPECT_EQ(
+    std::vector<model::FileId>({3}),
+    _index.search("STRINGS.H", true, 10));
+}
+
+TEST_F(FileNameIndexTest, BoundaryBonus)
+{
+  // "fb" matches at a word boundary and at a camel case boundary in foo_bar
+  // and FooBar, so these precede the matches in the middle of words.
+  std::vector<model::FileId> result = _index.search("fb", true, 10);
+  ASSERT_EQ(4u, result.size());
+  EXPECT_EQ(
+    std::vector<model::FileId>({6, 7}),
+    std::vector<model::FileId>({
+      std::min(result[0], result[1]), std::max(result[0], result[1])}));
+}
+
+TEST_F(FileNameIndexTest, NoMatch)
+{
+  EXPECT_TRUE(_index.search("xyz", false, 10).empty());
+  EXPECT_TRUE(_index.search("sgnirts", true, 10).empty());
+}
+
+TEST_F(FileNameIndexTest, Limit)
+{
+  EXPECT_EQ(
+    std::vector<model::FileId>({3}),
+    _index.search("str", true, 1));
+  EXPECT_TRUE(_index.search("str", true, 0).empty());
+
+  // An empty pattern matches every file, the shortest paths first.
+  std::vector<model::FileId> result = _index.search("", true, 3);
+  ASSERT_EQ(3u, result.size());
+  EXPECT_EQ(3u, result[0]);
+}
+
+TEST(FileNameIndexLargeTest, ParallelSearch)
+{
+  // Large indexes are searched in chunks by several threads.
+  std::vector<model::File> files;
+  for (model::FileId id = 1; id <= 300000; ++id)
+    files.push_back(makeFile(id, "/gen/file" + std::to_string(id) + ".cpp"));
+  files.push_back(makeFile(300001, "/src/needle.cpp"));
+  files.push_back(makeFile(300002, "/src/haystack/needles.h"));
+
+  FileNameIndex index(files, 1);
+  ASSERT_EQ(300002u, index.size());
+
+  EXPECT_EQ(
+    std::vector<model::FileId>({300001, 300002}),
+    index.search("needle", true, 5));
+
+  // The consecutive match precedes the ones with gaps, e.g. file123456.cpp.
+  std::vector<model::FileId> result = index.search("file12345.", true, 3);
+  ASSERT_EQ(3u, result.size());
+  EXPECT_EQ(12345u, result[0]);
+}
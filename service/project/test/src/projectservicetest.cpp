@@ -0,0 +1,171 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+#include <boost/program_options/variables_map.hpp>
+
+#include <gtest/gtest.h>
+
+#include <model/file.h>
+#include <model/file-odb.hxx>
+
+#include <util/dbutil.h>
+#include <util/odbtransaction.h>
+
+#include <webserver/servercontext.h>
+
+#include <projectservice/projectservice.h>
+
+using namespace cc;
+using namespace cc::service::core;
+
+namespace fs = boost::filesystem;
+
+using Ids = std::vector<std::string>;
+
+// The tests run on a temporary SQLite database.
+#ifdef DATABASE_SQLITE
+
+namespace
+{
+
+Ids ids(const std::vector<FileInfo>& files_)
+{
+  Ids result;
+  for (const FileInfo& file : files_)
+    result.push_back(file.id);
+  return result;
+}
+
+} // namespace
+
+class ProjectServiceTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/projectservicetestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = dir;
+
+    _db = util::connectDatabase(
+      "sqlite:database=" + _root + "/project.sqlite");
+    ASSERT_NE(nullptr, _db);
+
+    util::createTables(_db, MODEL_SQL_DIR);
+
+    // The children of a directory are ordered directories first, then by
+    // their names.
+    util::OdbTransaction {_db} ([this]{
+      persistFile(1, "/", 0, true);
+      persistFile(2, "/src", 1, true);
+      persistFile(3, "/src/main.cpp", 2);
+      persistFile(4, "/src/util", 2, true);
+      persistFile(5, "/src/util/a.h", 4);
+      persistFile(6, "/src/util/b.h", 4);
+      persistFile(7, "/docs", 1, true);
+      persistFile(8, "/docs/readme.md", 7);
+      persistFile(9, "/src/util/deep", 4, true);
+      persistFile(10, "/src/util/deep/x.h", 9);
+    });
+
+    _context.reset(new webserver::ServerContext(_root, _options));
+    _handler.reset(new ProjectServiceHandler(
+      _db, std::make_shared<std::string>(_root), *_context));
+  }
+
+  void TearDown() override
+  {
+    _handler.reset();
+    _db.reset();
+
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  void persistFile(
+    model::FileId id_,
+    const std::string& path_,
+    model::FileId parent_,
+    bool directory_ = false)
+  {
+    model::File file;
+    file.id = id_;
+    file.path = path_;
+    file.filename = fs::path(path_).filename().string();
+    file.type = directory_ ? model::File::DIRECTORY_TYPE : "CPP";
+    file.timestamp = 0;
+
+    if (parent_)
+      file.parent = odb::lazy_shared_ptr<model::File>(*_db, parent_);
+
+    _db->persist(file);
+  }
+
+  std::string _root;
+  std::shared_ptr<odb::database> _db;
+  boost::program_options::variables_map _options;
+  std::unique_ptr<webserver::ServerContext> _context;
+  std::unique_ptr<ProjectServiceHandler> _handler;
+};
+
+TEST_F(ProjectServiceTest, Subtree)
+{
+  std::vector<FileInfo> files;
+
+  // The descendants in depth-first order.
+  _handler->getSubtree(files, "2");
+  EXPECT_EQ(Ids({"4", "9", "10", "5", "6", "3"}), ids(files));
+  EXPECT_EQ("/src/util/deep/x.h", files[2].path);
+  EXPECT_EQ("9", files[2].parent);
+
+  files.clear();
+  _handler->getSubtree(files, "1");
+  EXPECT_EQ(
+    Ids({"7", "8", "2", "4", "9", "10", "5", "6", "3"}), ids(files));
+
+  files.clear();
+  _handler->getSubtree(files, "3");
+  EXPECT_TRUE(files.empty());
+}
+
+TEST_F(ProjectServiceTest, PathTillFile)
+{
+  std::vector<FileInfo> files;
+
+  // The ancestors from the root.
+  _handler->getPathTillFile(files, "10");
+  EXPECT_EQ(Ids({"1", "2", "4", "9", "10"}), ids(files));
+  EXPECT_EQ("/src/util", files[2].path);
+
+  files.clear();
+  _handler->getPathTillFile(files, "1");
+  EXPECT_EQ(Ids({"1"}), ids(files));
+
+  files.clear();
+  EXPECT_THROW(_handler->getPathTillFile(files, "99"), InvalidId);
+}
+
+TEST_F(ProjectServiceTest, OpenTreeTillFile)
+{
+  std::vector<FileInfo> files;
+
+  // The root files, then the children of every directory on the path.
+  _handler->getOpenTreeTillFile(files, "5");
+  EXPECT_EQ(Ids({"1", "7", "2", "4", "3", "9", "5", "6"}), ids(files));
+
+  files.clear();
+  _handler->getOpenTreeTillFile(files, "1");
+  EXPECT_EQ(Ids({"1", "7", "2"}), ids(files));
+
+  files.clear();
+  EXPECT_THROW(_handler->getOpenTreeTillFile(files, "99"), InvalidId);
+}
+
+#endif
@@ -0,0 +1,210 @@
+#ifndef CC_UTIL_ARENA_H
+#define CC_UTIL_ARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace cc
+{
+namespace util
+{
+
+/**
+ * Monotonic memory arena. Memory is carved from large blocks by bumping a
+ * pointer, deallocation is a no-op, and the blocks are released at once when
+ * the arena is destroyed. It suits objects of a common lifetime, e.g. the
+ * model objects built while parsing a translation unit, which are persisted
+ * and dropped together.
+ *
+ * An arena is used by one thread. The objects allocated by makeShared() must
+ * not outlive the arena.
+ */
+class Arena
+{
+public:
+  struct Statistics
+  {
+    std::uint64_t allocations = 0;
+    std::uint64_t bytes = 0; /*!< Sum of the requested sizes. */
+    std::uint64_t blocks = 0;
+  };
+
+  /**
+   * @param blockSize_ Size of the blocks. Larger allocations get a block of
+   * their own.
+   */
+  explicit Arena(std::size_t blockSize_ = 64 * 1024)
+    : _blockSize(blockSize_), _current(nullptr), _end(nullptr)
+  {
+  }
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  ~Arena()
+  {
+    release();
+  }
+
+  void* allocate(std::size_t size_, std::size_t alignment_)
+  {
+    std::uintptr_t current = reinterpret_cast<std::uintptr_t>(_current);
+    std::uintptr_t aligned = (current + alignment_ - 1) & ~(alignment_ - 1);
+
+    if (!_current || aligned + size_ > reinterpret_cast<std::uintptr_t>(_end))
+    {
+      std::size_t blockSize = std::max(_blockSize, size_ + alignment_);
+      _blocks.emplace_back(new char[blockSize]);
+      ++_stats.blocks;
+
+      _current = _blocks.back().get();
+      _end = _current + blockSize;
+
+      current = reinterpret_cast<std::uintptr_t>(_current);
+      aligned = (current + alignment_ - 1) & ~(alignment_ - 1);
+    }
+
+    _current = reinterpret_cast<char*>(aligned + size_);
+
+    ++_stats.allocations;
+    _stats.bytes += size_;
+
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  /**
+   * Frees every block of the arena and adds its statistics to the totals of
+   * the process.
+   */
+  void release()
+  {
+    _blocks.clear();
+    _current = _end = nullptr;
+
+    Totals& totals = processTotals();
+    totals.allocations.fetch_add(_stats.allocations, std::memory_order_relaxed);
+    totals.bytes.fetch_add(_stats.bytes, std::memory_order_relaxed);
+    totals.blocks.fetch_add(_stats.blocks, std::memory_order_relaxed);
+
+    std::uint64_t peak = totals.peakBytes.load(std::memory_order_relaxed);
+    while (peak < _stats.bytes && !totals.peakBytes.compare_exchange_weak(
+      peak, _stats.bytes, std::memory_order_relaxed))
+      ;
+
+    _stats = Statistics();
+  }
+
+  /**
+   * Allocates a shared object in the arena. The object and the control block
+   * of the pointer are allocated at once, like by std::make_shared().
+   */
+  template <typename T, typename... Args>
+  std::shared_ptr<T> makeShared(Args&&... args_);
+
+  const Statistics& statistics() const
+  {
+    return _stats;
+  }
+
+  /**
+   * Returns the sum of the statistics of the released arenas of the process.
+   * @param peakBytes_ Set to the largest number of bytes allocated by one
+   * arena.
+   */
+  static Statistics totals(std::uint64_t& peakBytes_)
+  {
+    Totals& totals = processTotals();
+
+    Statistics stats;
+    stats.allocations = totals.allocations.load(std::memory_order_relaxed);
+    stats.bytes = totals.bytes.load(std::memory_order_relaxed);
+    stats.blocks = totals.blocks.load(std::memory_order_relaxed);
+    peakBytes_ = totals.peakBytes.load(std::memory_order_relaxed);
+
+    return stats;
+  }
+
+private:
+  struct Totals
+  {
+    std::atomic<std::uint64_t> allocations{0};
+    std::atomic<std::uint64_t> bytes{0};
+    std::atomic<std::uint64_t> blocks{0};
+    std::atomic<std::uint64_t> peakBytes{0};
+  };
+
+  static Totals& processTotals()
+  {
+    static Totals totals;
+    return totals;
+  }
+
+  std::size_t _blockSize;
+  char* _current;
+  char* _end;
+  std::vector<std::unique_ptr<char[]>> _blocks;
+  Statistics _stats;
+};
+
+/**
+ * Standard allocator allocating from an arena.
+ */
+template <typename T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(Arena& arena_) : _arena(&arena_)
+  {
+  }
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other_) : _arena(other_._arena)
+  {
+  }
+
+  T* allocate(std::size_t n_)
+  {
+    return static_cast<T*>(_arena->allocate(n_ * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T*, std::size_t)
+  {
+  }
+
+  template <typename U>
+  bool operator==(const ArenaAllocator<U>& other_) const
+  {
+    return _arena == other_._arena;
+  }
+
+  template <typename U>
+  bool operator!=(const ArenaAllocator<U>& other_) const
+  {
+    return _arena != other_._arena;
+  }
+
+private:
+  template <typename U>
+  friend class ArenaAllocator;
+
+  Arena* _arena;
+};
+
+template <typename T, typename... Args>
+std::shared_ptr<T> Arena::makeShared(Args&&... args_)
+{
+  return std::allocate_shared<T>(
+    ArenaAllocator<T>(*this), std::forward<Args>(args_)...);
+}
+
+} // util
+} // cc
+
+#endif // CC_UTIL_ARENA_H
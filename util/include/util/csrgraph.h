@@ -0,0 +1,156 @@
+#ifndef CC_UTIL_CSRGRAPH_H
+#define CC_UTIL_CSRGRAPH_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace cc
+{
+namespace util
+{
+
+/**
+ * Compact, read-only directed graph in compressed sparse row (CSR) format.
+ *
+ * The nodes are identified by 64 bit ids (e.g. model::FileId) and every edge
+ * has a kind between 0 and 7, so queries can be restricted to a subset of edge
+ * kinds by a bit mask. Both the forward and the reverse adjacency lists are
+ * stored, so predecessor queries are as cheap as successor queries.
+ *
+ * The graph can be saved into a binary file and loaded back by memory mapping
+ * it, so loading does not depend on the size of the graph.
+ */
+class CsrGraph
+{
+public:
+  typedef std::uint64_t NodeId;
+  typedef std::uint8_t EdgeMask;
+
+  struct Edge
+  {
+    NodeId from;
+    NodeId to;
+    std::uint8_t kind;
+  };
+
+  static constexpr EdgeMask ALL_EDGES = 0xFF;
+
+  /**
+   * Returns the mask which selects only the given edge kind.
+   */
+  static constexpr EdgeMask mask(std::uint8_t kind_)
+  {
+    return static_cast<EdgeMask>(1u << kind_);
+  }
+
+  /**
+   * Builds the graph in memory from the given edge list. Duplicate edges are
+   * stored only once.
+   */
+  CsrGraph(std::vector<Edge> edges_ = {});
+  CsrGraph(const CsrGraph&) = delete;
+  CsrGraph& operator=(const CsrGraph&) = delete;
+  ~CsrGraph();
+
+  /**
+   * Memory maps a graph which was written by save().
+   * @return nullptr if the file doesn't exist or it is not a valid graph file.
+   */
+  static std::unique_ptr<CsrGraph> load(const std::string& path_);
+
+  /**
+   * Writes the graph to the given file. The file is written under a temporary
+   * name and renamed at the end so that readers never see a partial file.
+   * @return True on success.
+   */
+  bool save(const std::string& path_) const;
+
+  std::size_t nodeCount() const { return _nodeCount; }
+  std::size_t edgeCount() const { return _edgeCount; }
+
+  /**
+   * Returns true if the node has at least one incoming or outgoing edge.
+   */
+  bool contains(NodeId node_) const;
+
+  /**
+   * Returns the target nodes of the outgoing edges of node_.
+   */
+  std::vector<NodeId> successors(
+    NodeId node_,
+    EdgeMask mask_ = ALL_EDGES) const;
+
+  /**
+   * Returns the source nodes of the incoming edges of node_.
+   */
+  std::vector<NodeId> predecessors(
+    NodeId node_,
+    EdgeMask mask_ = ALL_EDGES) const;
+
+  /**
+   * Returns every node which is reachable from any of the roots_ along the
+   * edges selected by mask_. The roots themselves are not part of the result
+   * unless they are reachable from another root.
+   * @param reverse_ If true then the edges are followed backwards.
+   */
+  std::vector<NodeId> closure(
+    const std::vector<NodeId>& roots_,
+    EdgeMask mask_ = ALL_EDGES,
+    bool reverse_ = false) const;
+
+  /**
+   * Sorts the given nodes topologically along the edges selected by mask_
+   * considering only the edges between the given nodes. The first level
+   * contains the nodes without incoming edges, every further level contains
+   * the nodes whose predecessors are all in previous levels. If there is a
+   * cycle then the remaining nodes are put into an additional last level.
+   */
+  std::vector<std::vector<NodeId>> topologicalLevels(
+    const std::vector<NodeId>& nodes_,
+    EdgeMask mask_ = ALL_EDGES) const;
+
+private:
+  /**
+   * Returns the index of the node or npos if the graph doesn't contain it.
+   */
+  std::size_t indexOf(NodeId node_) const;
+
+  std::vector<NodeId> neighbours(
+    NodeId node_,
+    EdgeMask mask_,
+    bool reverse_) const;
+
+  static const std::size_t npos = static_cast<std::size_t>(-1);
+
+  std::size_t _nodeCount;
+  std::size_t _edgeCount;
+
+  // These point either into the owned vectors or into the mapped file.
+  const NodeId* _nodes;
+  const std::uint64_t* _fwdOffsets;
+  const std::uint64_t* _revOffsets;
+  const std::uint32_t* _fwdTargets;
+  const std::uint32_t* _revTargets;
+  const std::uint8_t* _fwdKinds;
+  const std::uint8_t* _revKinds;
+
+  std::vector<NodeId> _ownNodes;
+  std::vector<std::uint64_t> _ownFwdOffsets;
+  std::vector<std::uint64_t> _ownRevOffsets;
+  std::vector<std::uint32_t> _ownFwdTargets;
+  std::vector<std::uint32_t> _ownRevTargets;
+  std::vector<std::uint8_t> _ownFwdKinds;
+  std::vector<std::uint8_t> _ownRevKinds;
+
+  void* _mapping;
+  std::size_t _mappingSize;
+};
+
+typedef std::shared_ptr<const CsrGraph> CsrGraphPtr;
+
+} // util
+} // cc
+
+#endif // CC_UTIL_CSRGRAPH_H
@@ -62,6 +62,23 @@ void removeTables(
   std::shared_ptr<odb::database> db_,
   const std::string& sqlDir_);
 
+/**
+ * This function creates the tables and the indexes of a single .sql file. It
+ * can be used for adding the tables of a new model to an existing database.
+ * @param db_ Pointer to the ODB database.
+ * @param sqlFile_ Path of the SQL file.
+ */
+void createTablesFromFile(
+  std::shared_ptr<odb::database> db_,
+  const std::string& sqlFile_);
+
+/**
+ * This function returns true if the given table exists in the database.
+ */
+bool tableExists(
+  std::shared_ptr<odb::database> db_,
+  const std::string& table_);
+
 /**
  * This function updates a value for a given key in the connection string. The
  * connection string has the following format: dbsystem:key1=value1;key2=value2.
@@ -17,12 +17,11 @@ namespace cc
 namespace util
 {
 
-inline std::uint64_t fnvHash(const std::string& data_)
+inline std::uint64_t fnvHash(const char* data_, std::size_t size_)
 {
   std::uint64_t hash = 14695981039346656037ULL;
 
-  std::size_t len = data_.length();
-  for (std::size_t i = 0; i < len; ++i)
+  for (std::size_t i = 0; i < size_; ++i)
   {
     hash ^= static_cast<std::uint64_t>(data_[i]);
     hash *= static_cast<std::uint64_t>(1099511628211ULL);
@@ -31,6 +30,11 @@ inline std::uint64_t fnvHash(const std::string& data_)
   return hash;
 }
 
+inline std::uint64_t fnvHash(const std::string& data_)
+{
+  return fnvHash(data_.data(), data_.length());
+}
+
 inline std::string sha1Hash(const std::string& data_)
 {
   using namespace boost::uuids::detail;
@@ -0,0 +1,165 @@
+#ifndef CC_UTIL_LRUCACHE_H
+#define CC_UTIL_LRUCACHE_H
+
+#include <cstddef>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace cc
+{
+namespace util
+{
+
+/**
+ * Default weight function of LruCache: every element weighs one, so the
+ * capacity of the cache is the number of its elements.
+ */
+template <typename Value>
+struct LruUnitWeight
+{
+  std::size_t operator()(const Value&) const
+  {
+    return 1;
+  }
+};
+
+/**
+ * Thread-safe key-value cache with a fixed capacity. When the cache is full,
+ * inserting a new element removes the least recently used ones. The capacity
+ * is the maximal total weight of the elements, which are weighed by the
+ * Weigher function object when they are inserted.
+ */
+template <
+  typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename Weigher = LruUnitWeight<Value>>
+class LruCache
+{
+public:
+  LruCache(std::size_t capacity_) : _capacity(capacity_), _weight(0)
+  {
+  }
+
+  LruCache(const LruCache&) = delete;
+  LruCache& operator=(const LruCache&) = delete;
+
+  /**
+   * Looks up the value of the key and marks it as recently used.
+   * @return True if the key was found, in this case value_ is set.
+   */
+  bool get(const Key& key_, Value& value_)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _index.find(key_);
+    if (it == _index.end())
+      return false;
+
+    _items.splice(_items.begin(), _items, it->second);
+    value_ = it->second->value;
+    return true;
+  }
+
+  /**
+   * Inserts or replaces the value of the key.
+   * @return The number of the elements removed to make room for the value.
+   */
+  std::size_t put(const Key& key_, Value value_)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    std::size_t weight = Weigher()(value_);
+
+    auto it = _index.find(key_);
+    if (it != _index.end())
+    {
+      _weight -= it->second->weight;
+      it->second->value = std::move(value_);
+      it->second->weight = weight;
+      _items.splice(_items.begin(), _items, it->second);
+    }
+    else
+    {
+      _items.push_front(Item{key_, std::move(value_), weight});
+      _index.emplace(key_, _items.begin());
+    }
+
+    _weight += weight;
+
+    std::size_t evicted = 0;
+    while (_weight > _capacity && !_items.empty())
+    {
+      _weight -= _items.back().weight;
+      _index.erase(_items.back().key);
+      _items.pop_back();
+      ++evicted;
+    }
+
+    return evicted;
+  }
+
+  void erase(const Key& key_)
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto it = _index.find(key_);
+    if (it != _index.end())
+    {
+      _weight -= it->second->weight;
+      _items.erase(it->second);
+      _index.erase(it);
+    }
+  }
+
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _index.clear();
+    _items.clear();
+    _weight = 0;
+  }
+
+  std::size_t size() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _items.size();
+  }
+
+  /**
+   * Returns the total weight of the elements.
+   */
+  std::size_t weight() const
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _weight;
+  }
+
+  std::size_t capacity() const
+  {
+    return _capacity;
+  }
+
+private:
+  struct Item
+  {
+    Key key;
+    Value value;
+    std::size_t weight;
+  };
+
+  typedef std::list<Item> ItemList;
+
+  ItemList _items;
+  std::unordered_map<Key, typename ItemList::iterator, Hash> _index;
+  const std::size_t _capacity;
+  std::size_t _weight;
+  mutable std::mutex _mutex;
+};
+
+} // util
+} // cc
+
+#endif // CC_UTIL_LRUCACHE_H
@@ -0,0 +1,116 @@
+#ifndef CC_UTIL_SHARDEDLRUCACHE_H
+#define CC_UTIL_SHARDEDLRUCACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <util/lrucache.h>
+
+namespace cc
+{
+namespace util
+{
+
+/**
+ * LruCache split into shards by the hash of the keys. Every shard has its own
+ * lock and an equal part of the capacity, so threads accessing different
+ * keys rarely wait for each other. The cache counts its hits and misses.
+ */
+template <
+  typename Key,
+  typename Value,
+  typename Hash = std::hash<Key>,
+  typename Weigher = LruUnitWeight<Value>>
+class ShardedLruCache
+{
+public:
+  struct Statistics
+  {
+    std::size_t hits = 0;
+    std::size_t misses = 0;
+    std::size_t evictions = 0;
+    std::size_t size = 0; /*!< Number of the elements. */
+    std::size_t weight = 0; /*!< Total weight of the elements. */
+    std::size_t capacity = 0;
+  };
+
+  ShardedLruCache(std::size_t capacity_, std::size_t shardNum_ = 16)
+    : _hits(0), _misses(0), _evictions(0)
+  {
+    shardNum_ = std::max<std::size_t>(shardNum_, 1);
+
+    for (std::size_t i = 0; i < shardNum_; ++i)
+      _shards.emplace_back(new Shard(capacity_ / shardNum_));
+  }
+
+  ShardedLruCache(const ShardedLruCache&) = delete;
+  ShardedLruCache& operator=(const ShardedLruCache&) = delete;
+
+  /**
+   * Looks up the value of the key and marks it as recently used.
+   * @return True if the key was found, in this case value_ is set.
+   */
+  bool get(const Key& key_, Value& value_)
+  {
+    bool found = shard(key_).get(key_, value_);
+    ++(found ? _hits : _misses);
+    return found;
+  }
+
+  /**
+   * Inserts or replaces the value of the key.
+   */
+  void put(const Key& key_, Value value_)
+  {
+    _evictions += shard(key_).put(key_, std::move(value_));
+  }
+
+  void erase(const Key& key_)
+  {
+    shard(key_).erase(key_);
+  }
+
+  void clear()
+  {
+    for (const std::unique_ptr<Shard>& shard : _shards)
+      shard->clear();
+  }
+
+  Statistics statistics() const
+  {
+    Statistics stats;
+    stats.hits = _hits;
+    stats.misses = _misses;
+    stats.evictions = _evictions;
+
+    for (const std::unique_ptr<Shard>& shard : _shards)
+    {
+      stats.size += shard->size();
+      stats.weight += shard->weight();
+      stats.capacity += shard->capacity();
+    }
+
+    return stats;
+  }
+
+private:
+  typedef LruCache<Key, Value, Hash, Weigher> Shard;
+
+  Shard& shard(const Key& key_)
+  {
+    return *_shards[Hash()(key_) % _shards.size()];
+  }
+
+  std::vector<std::unique_ptr<Shard>> _shards;
+  std::atomic<std::size_t> _hits;
+  std::atomic<std::size_t> _misses;
+  std::atomic<std::size_t> _evictions;
+};
+
+} // util
+} // cc
+
+#endif // CC_UTIL_SHARDEDLRUCACHE_H
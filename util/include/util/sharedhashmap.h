@@ -0,0 +1,340 @@
+#ifndef CC_UTIL_SHAREDHASHMAP_H
+#define CC_UTIL_SHAREDHASHMAP_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace cc
+{
+namespace util
+{
+
+/**
+ * Fixed capacity hash map of 64 bit keys and values in shared memory. The map
+ * is created before forking, and the parent and the child processes see the
+ * insertions of each other. Insertion and lookup don't take locks, a slot is
+ * claimed by a compare-and-swap on its state.
+ *
+ * The map is used to tell the processes which objects have been persisted
+ * already. An inserted key is first claimed by the inserting process, which
+ * publishes it after the object has been committed, or releases it if the
+ * object couldn't be persisted. The claims of a process which has died, and
+ * the released ones, are taken over by the next insertion of the key. The
+ * state of a slot records the process ID of its owner for this purpose.
+ *
+ * Elements can't be removed. The slots are probed linearly, and the table is
+ * allocated with twice as many slots as the capacity. The pages of the table
+ * are allocated by the kernel only when they are first written.
+ */
+class SharedHashMap
+{
+public:
+  enum class Insertion
+  {
+    INSERTED, /*!< The key has been claimed by this process. */
+    FOUND, /*!< The key is claimed or published by another insertion. */
+    FULL /*!< The map is full, the key has not been inserted. */
+  };
+
+  /**
+   * @param capacity_ Maximal number of the elements.
+   * @throw std::bad_alloc if the shared memory can't be mapped.
+   */
+  explicit SharedHashMap(std::size_t capacity_)
+  {
+    _slotNum = 1;
+    while (_slotNum < 2 * capacity_)
+      _slotNum <<= 1;
+
+    _mapSize = sizeof(Header) + _slotNum * sizeof(Slot);
+
+    void* memory = ::mmap(
+      nullptr, _mapSize, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (memory == MAP_FAILED)
+      throw std::bad_alloc();
+
+    // Anonymous mappings are zero filled, which is the empty state of the
+    // header and the slots.
+    _header = static_cast<Header*>(memory);
+    _slots = reinterpret_cast<Slot*>(_header + 1);
+  }
+
+  SharedHashMap(const SharedHashMap&) = delete;
+  SharedHashMap& operator=(const SharedHashMap&) = delete;
+
+  ~SharedHashMap()
+  {
+    ::munmap(_header, _mapSize);
+  }
+
+  /**
+   * Claims the key for this process unless it is claimed by a living process
+   * or published already. A claim of a dead process or a released claim is
+   * taken over, its value is kept.
+   *
+   * A full map doesn't stop the callers: they can handle the key as a new
+   * one, e.g. persist the object again.
+   */
+  Insertion insert(std::uint64_t key_, std::uint64_t value_)
+  {
+    std::uint64_t claimed = claimedState();
+    std::size_t mask = _slotNum - 1;
+    std::size_t pos = mix(key_) & mask;
+
+    for (std::size_t probes = 0; probes < _slotNum; ++probes)
+    {
+      Slot& slot = _slots[pos];
+      std::uint64_t state = slot.state.load(std::memory_order_acquire);
+
+      if (state == EMPTY &&
+          slot.state.compare_exchange_strong(
+            state, writingState(), std::memory_order_acq_rel))
+      {
+        slot.key = key_;
+        slot.value = value_;
+        slot.state.store(claimed, std::memory_order_release);
+        _header->size.fetch_add(1, std::memory_order_relaxed);
+        return Insertion::INSERTED;
+      }
+
+      // The slot is taken, possibly by an insertion which is in progress.
+      std::uint64_t key;
+      if (waitReady(slot, key) && key == key_)
+      {
+        state = slot.state.load(std::memory_order_acquire);
+
+        // A failed compare-and-swap reloads the state.
+        while (tag(state) == CLAIMED && !isAlive(owner(state)))
+          if (slot.state.compare_exchange_strong(
+                state, claimed, std::memory_order_acq_rel))
+            return Insertion::INSERTED;
+
+        return Insertion::FOUND;
+      }
+
+      pos = (pos + 1) & mask;
+    }
+
+    return Insertion::FULL;
+  }
+
+  /**
+   * Marks the key claimed by this process as done, so that it is not taken
+   * over even if this process exits.
+   */
+  void publish(std::uint64_t key_)
+  {
+    setClaim(key_, claimedState(), PUBLISHED);
+  }
+
+  /**
+   * Gives up the claim of this process on the key, so that the next
+   * insertion of the key takes it over.
+   */
+  void release(std::uint64_t key_)
+  {
+    setClaim(key_, claimedState(), CLAIMED);
+  }
+
+  /**
+   * Looks up the value of the key. Claimed keys are found too.
+   * @return True if the key was found, in this case value_ is set.
+   */
+  bool find(std::uint64_t key_, std::uint64_t& value_) const
+  {
+    const Slot* slot = findSlot(key_);
+    if (slot)
+      value_ = slot->value;
+    return slot != nullptr;
+  }
+
+  bool contains(std::uint64_t key_) const
+  {
+    return findSlot(key_) != nullptr;
+  }
+
+  /**
+   * Returns the number of the elements inserted by all processes.
+   */
+  std::size_t size() const
+  {
+    return _header->size.load(std::memory_order_relaxed);
+  }
+
+private:
+  /**
+   * The low bits of a slot state are a tag, the high bits are the process ID
+   * of the owner while the slot is written or claimed. A released claim has
+   * no owner.
+   */
+  enum : std::uint64_t
+  {
+    EMPTY = 0,
+    WRITING = 1,
+    CLAIMED = 2,
+    PUBLISHED = 3,
+    ABANDONED = 4, /*!< The writer died, the key is unknown. */
+    TAG_BITS = 3,
+    TAG_MASK = (1 << TAG_BITS) - 1
+  };
+
+  struct Header
+  {
+    std::atomic<std::size_t> size;
+    char padding[64 - sizeof(std::atomic<std::size_t>)];
+  };
+
+  struct Slot
+  {
+    std::atomic<std::uint64_t> state;
+    std::uint64_t key;
+    std::uint64_t value;
+  };
+
+  static_assert(
+    ATOMIC_LLONG_LOCK_FREE == 2,
+    "Atomics in shared memory must be lock-free.");
+
+  static std::uint64_t tag(std::uint64_t state_)
+  {
+    return state_ & TAG_MASK;
+  }
+
+  static ::pid_t owner(std::uint64_t state_)
+  {
+    return static_cast<::pid_t>(state_ >> TAG_BITS);
+  }
+
+  static std::uint64_t writingState()
+  {
+    return static_cast<std::uint64_t>(::getpid()) << TAG_BITS | WRITING;
+  }
+
+  static std::uint64_t claimedState()
+  {
+    return static_cast<std::uint64_t>(::getpid()) << TAG_BITS | CLAIMED;
+  }
+
+  /**
+   * Returns false if the process doesn't exist, or if it's a released claim.
+   */
+  static bool isAlive(::pid_t pid_)
+  {
+    return pid_ && (::kill(pid_, 0) == 0 || errno != ESRCH);
+  }
+
+  /**
+   * Waits until the insertion into a taken slot has finished. An insertion
+   * writes two words only, so it is waited by spinning first. If the writer
+   * has died, the slot is abandoned. If the writer is alive but doesn't
+   * finish within a second (e.g. it has been stopped), the slot is skipped,
+   * so in the worst case a key is inserted twice.
+   * @return True if the key of the slot is known, then key_ is set.
+   */
+  static bool waitReady(Slot& slot_, std::uint64_t& key_)
+  {
+    std::chrono::steady_clock::time_point deadline;
+
+    for (unsigned spins = 0; ; ++spins)
+    {
+      std::uint64_t state = slot_.state.load(std::memory_order_acquire);
+
+      if (tag(state) == CLAIMED || tag(state) == PUBLISHED)
+      {
+        key_ = slot_.key;
+        return true;
+      }
+
+      if (tag(state) == ABANDONED)
+        return false;
+
+      if (spins < 1024)
+        continue;
+
+      if (!isAlive(owner(state)))
+      {
+        slot_.state.compare_exchange_strong(
+          state, ABANDONED, std::memory_order_acq_rel);
+        continue;
+      }
+
+      if (spins == 1024)
+        deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+      else if (std::chrono::steady_clock::now() > deadline)
+        return false;
+
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+
+  /**
+   * Returns the slot of the key or nullptr if it's not in the map.
+   */
+  Slot* findSlot(std::uint64_t key_) const
+  {
+    std::size_t mask = _slotNum - 1;
+    std::size_t pos = mix(key_) & mask;
+
+    for (std::size_t probes = 0; probes < _slotNum; ++probes)
+    {
+      Slot& slot = _slots[pos];
+
+      if (slot.state.load(std::memory_order_acquire) == EMPTY)
+        return nullptr;
+
+      std::uint64_t key;
+      if (waitReady(slot, key) && key == key_)
+        return &slot;
+
+      pos = (pos + 1) & mask;
+    }
+
+    return nullptr;
+  }
+
+  /**
+   * Replaces the state of the slot of the key if it is claimed by this
+   * process.
+   */
+  void setClaim(std::uint64_t key_, std::uint64_t from_, std::uint64_t to_)
+  {
+    if (Slot* slot = findSlot(key_))
+      slot->state.compare_exchange_strong(
+        from_, to_, std::memory_order_acq_rel);
+  }
+
+  /**
+   * Finalizer of MurmurHash3. The keys are often hashes already, but the low
+   * bits of some identifiers are not uniform.
+   */
+  static std::size_t mix(std::uint64_t key_)
+  {
+    key_ ^= key_ >> 33;
+    key_ *= 0xff51afd7ed558ccdULL;
+    key_ ^= key_ >> 33;
+    key_ *= 0xc4ceb3f99e3b8ee5ULL;
+    key_ ^= key_ >> 33;
+    return key_;
+  }
+
+  std::size_t _slotNum;
+  std::size_t _mapSize;
+  Header* _header;
+  Slot* _slots;
+};
+
+} // util
+} // cc
+
+#endif // CC_UTIL_SHAREDHASHMAP_H
@@ -0,0 +1,484 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <tuple>
+
+#include <util/csrgraph.h>
+#include <util/logutil.h>
+
+namespace
+{
+
+const char GRAPH_MAGIC[8] = {'C', 'C', 'C', 'S', 'R', 'G', 'R', 'F'};
+const std::uint32_t GRAPH_VERSION = 1;
+
+struct GraphHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t reserved;
+  std::uint64_t nodeCount;
+  std::uint64_t edgeCount;
+};
+
+/**
+ * Every array in the graph file starts on an 8 byte boundary so that they can
+ * be used directly from the mapped memory.
+ */
+std::size_t align(std::size_t size_)
+{
+  return (size_ + 7) & ~static_cast<std::size_t>(7);
+}
+
+/**
+ * Returns the size of the arrays in the graph file in the order they are
+ * written.
+ */
+std::vector<std::size_t> sectionSizes(
+  std::uint64_t nodeCount_,
+  std::uint64_t edgeCount_)
+{
+  return {
+    align(nodeCount_ * sizeof(std::uint64_t)),
+    align((nodeCount_ + 1) * sizeof(std::uint64_t)),
+    align((nodeCount_ + 1) * sizeof(std::uint64_t)),
+    align(edgeCount_ * sizeof(std::uint32_t)),
+    align(edgeCount_ * sizeof(std::uint32_t)),
+    align(edgeCount_),
+    align(edgeCount_)};
+}
+
+template <typename T>
+void writeSection(std::ofstream& out_, const T* data_, std::size_t count_)
+{
+  static const char padding[8] = {0};
+
+  std::size_t size = count_ * sizeof(T);
+  out_.write(reinterpret_cast<const char*>(data_), size);
+  out_.write(padding, align(size) - size);
+}
+
+} // namespace
+
+namespace cc
+{
+namespace util
+{
+
+constexpr CsrGraph::EdgeMask CsrGraph::ALL_EDGES;
+
+CsrGraph::CsrGraph(std::vector<Edge> edges_)
+  : _mapping(nullptr), _mappingSize(0)
+{
+  auto edgeLess = [](const Edge& lhs_, const Edge& rhs_) {
+    return std::tie(lhs_.from, lhs_.to, lhs_.kind)
+         < std::tie(rhs_.from, rhs_.to, rhs_.kind);
+  };
+  auto edgeEq = [](const Edge& lhs_, const Edge& rhs_) {
+    return lhs_.from == rhs_.from
+        && lhs_.to   == rhs_.to
+        && lhs_.kind == rhs_.kind;
+  };
+
+  std::sort(edges_.begin(), edges_.end(), edgeLess);
+  edges_.erase(
+    std::unique(edges_.begin(), edges_.end(), edgeEq),
+    edges_.end());
+
+  //--- Collect nodes ---//
+
+  _ownNodes.reserve(edges_.size() * 2);
+  for (const Edge& edge : edges_)
+  {
+    _ownNodes.push_back(edge.from);
+    _ownNodes.push_back(edge.to);
+  }
+
+  std::sort(_ownNodes.begin(), _ownNodes.end());
+  _ownNodes.erase(
+    std::unique(_ownNodes.begin(), _ownNodes.end()),
+    _ownNodes.end());
+  _ownNodes.shrink_to_fit();
+
+  _nodeCount = _ownNodes.size();
+  _edgeCount = edges_.size();
+
+  auto index = [this](NodeId node_) {
+    return static_cast<std::uint32_t>(
+      std::lower_bound(_ownNodes.begin(), _ownNodes.end(), node_)
+        - _ownNodes.begin());
+  };
+
+  //--- Forward adjacency lists ---//
+
+  _ownFwdOffsets.assign(_nodeCount + 1, 0);
+  _ownFwdTargets.reserve(_edgeCount);
+  _ownFwdKinds.reserve(_edgeCount);
+
+  // The edges are sorted by their source, so the targets can be appended in
+  // order.
+  for (const Edge& edge : edges_)
+  {
+    ++_ownFwdOffsets[index(edge.from) + 1];
+    _ownFwdTargets.push_back(index(edge.to));
+    _ownFwdKinds.push_back(edge.kind);
+  }
+
+  for (std::size_t i = 0; i < _nodeCount; ++i)
+    _ownFwdOffsets[i + 1] += _ownFwdOffsets[i];
+
+  //--- Reverse adjacency lists ---//
+
+  _ownRevOffsets.assign(_nodeCount + 1, 0);
+  _ownRevTargets.resize(_edgeCount);
+  _ownRevKinds.resize(_edgeCount);
+
+  for (std::uint32_t target : _ownFwdTargets)
+    ++_ownRevOffsets[target + 1];
+
+  for (std::size_t i = 0; i < _nodeCount; ++i)
+    _ownRevOffsets[i + 1] += _ownRevOffsets[i];
+
+  std::vector<std::uint64_t> fill(
+    _ownRevOffsets.begin(), _ownRevOffsets.end() - 1);
+
+  for (std::size_t from = 0; from < _nodeCount; ++from)
+    for (std::uint64_t e = _ownFwdOffsets[from];
+         e < _ownFwdOffsets[from + 1];
+         ++e)
+    {
+      std::uint64_t pos = fill[_ownFwdTargets[e]]++;
+      _ownRevTargets[pos] = static_cast<std::uint32_t>(from);
+      _ownRevKinds[pos] = _ownFwdKinds[e];
+    }
+
+  _nodes = _ownNodes.data();
+  _fwdOffsets = _ownFwdOffsets.data();
+  _revOffsets = _ownRevOffsets.data();
+  _fwdTargets = _ownFwdTargets.data();
+  _revTargets = _ownRevTargets.data();
+  _fwdKinds = _ownFwdKinds.data();
+  _revKinds = _ownRevKinds.data();
+}
+
+CsrGraph::~CsrGraph()
+{
+  if (_mapping)
+    ::munmap(_mapping, _mappingSize);
+}
+
+std::unique_ptr<CsrGraph> CsrGraph::load(const std::string& path_)
+{
+  int fd = ::open(path_.c_str(), O_RDONLY);
+  if (fd < 0)
+    return nullptr;
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<std::size_t>(st.st_size) < sizeof(GraphHeader))
+  {
+    ::close(fd);
+    return nullptr;
+  }
+
+  std::size_t size = st.st_size;
+  void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+
+  if (mapping == MAP_FAILED)
+  {
+    LOG(warning) << "Failed to map graph file: " << path_;
+    return nullptr;
+  }
+
+  const GraphHeader* header = static_cast<const GraphHeader*>(mapping);
+
+  std::size_t expected = sizeof(GraphHeader);
+  if (std::memcmp(header->magic, GRAPH_MAGIC, sizeof(GRAPH_MAGIC)) == 0 &&
+      header->version == GRAPH_VERSION)
+    for (std::size_t section
+      : sectionSizes(header->nodeCount, header->edgeCount))
+      expected += section;
+
+  if (expected != size)
+  {
+    LOG(warning) << "Invalid or outdated graph file: " << path_;
+    ::munmap(mapping, size);
+    return nullptr;
+  }
+
+  std::unique_ptr<CsrGraph> graph(new CsrGraph());
+  graph->_mapping = mapping;
+  graph->_mappingSize = size;
+  graph->_nodeCount = header->nodeCount;
+  graph->_edgeCount = header->edgeCount;
+
+  std::vector<std::size_t> sections
+    = sectionSizes(header->nodeCount, header->edgeCount);
+  const char* ptr = static_cast<const char*>(mapping) + sizeof(GraphHeader);
+
+  graph->_nodes = reinterpret_cast<const NodeId*>(ptr);
+  ptr += sections[0];
+  graph->_fwdOffsets = reinterpret_cast<const std::uint64_t*>(ptr);
+  ptr += sections[1];
+  graph->_revOffsets = reinterpret_cast<const std::uint64_t*>(ptr);
+  ptr += sections[2];
+  graph->_fwdTargets = reinterpret_cast<const std::uint32_t*>(ptr);
+  ptr += sections[3];
+  graph->_revTargets = reinterpret_cast<const std::uint32_t*>(ptr);
+  ptr += sections[4];
+  graph->_fwdKinds = reinterpret_cast<const std::uint8_t*>(ptr);
+  ptr += sections[5];
+  graph->_revKinds = reinterpret_cast<const std::uint8_t*>(ptr);
+
+  return graph;
+}
+
+bool CsrGraph::save(const std::string& path_) const
+{
+  std::string tmpPath = path_ + ".tmp";
+
+  {
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out)
+    {
+      LOG(warning) << "Failed to create graph file: " << tmpPath;
+      return false;
+    }
+
+    GraphHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, GRAPH_MAGIC, sizeof(GRAPH_MAGIC));
+    header.version = GRAPH_VERSION;
+    header.nodeCount = _nodeCount;
+    header.edgeCount = _edgeCount;
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(out, _nodes, _nodeCount);
+    writeSection(out, _fwdOffsets, _nodeCount + 1);
+    writeSection(out, _revOffsets, _nodeCount + 1);
+    writeSection(out, _fwdTargets, _edgeCount);
+    writeSection(out, _revTargets, _edgeCount);
+    writeSection(out, _fwdKinds, _edgeCount);
+    writeSection(out, _revKinds, _edgeCount);
+
+    if (!out)
+    {
+      LOG(warning) << "Failed to write graph file: " << tmpPath;
+      return false;
+    }
+  }
+
+  if (std::rename(tmpPath.c_str(), path_.c_str()) != 0)
+  {
+    LOG(warning) << "Failed to rename graph file to: " << path_;
+    return false;
+  }
+
+  return true;
+}
+
+std::size_t CsrGraph::indexOf(NodeId node_) const
+{
+  const NodeId* end = _nodes + _nodeCount;
+  const NodeId* it = std::lower_bound(_nodes, end, node_);
+
+  return it != end && *it == node_ ? it - _nodes : npos;
+}
+
+bool CsrGraph::contains(NodeId node_) const
+{
+  return indexOf(node_) != npos;
+}
+
+std::vector<CsrGraph::NodeId> CsrGraph::neighbours(
+  NodeId node_,
+  EdgeMask mask_,
+  bool reverse_) const
+{
+  std::vector<NodeId> result;
+
+  std::size_t idx = indexOf(node_);
+  if (idx == npos)
+    return result;
+
+  const std::uint64_t* offsets = reverse_ ? _revOffsets : _fwdOffsets;
+  const std::uint32_t* targets = reverse_ ? _revTargets : _fwdTargets;
+  const std::uint8_t* kinds = reverse_ ? _revKinds : _fwdKinds;
+
+  for (std::uint64_t e = offsets[idx]; e < offsets[idx + 1]; ++e)
+    if (mask_ & mask(kinds[e]))
+      result.push_back(_nodes[targets[e]]);
+
+  // The same node may be reached through edges of different kinds.
+  result.erase(std::unique(result.begin(), result.end()), result.end());
+
+  return result;
+}
+
+std::vector<CsrGraph::NodeId> CsrGraph::successors(
+  NodeId node_,
+  EdgeMask mask_) const
+{
+  return neighbours(node_, mask_, false);
+}
+
+std::vector<CsrGraph::NodeId> CsrGraph::predecessors(
+  NodeId node_,
+  EdgeMask mask_) const
+{
+  return neighbours(node_, mask_, true);
+}
+
+std::vector<CsrGraph::NodeId> CsrGraph::closure(
+  const std::vector<NodeId>& roots_,
+  EdgeMask mask_,
+  bool reverse_) const
+{
+  const std::uint64_t* offsets = reverse_ ? _revOffsets : _fwdOffsets;
+  const std::uint32_t* targets = reverse_ ? _revTargets : _fwdTargets;
+  const std::uint8_t* kinds = reverse_ ? _revKinds : _fwdKinds;
+
+  std::vector<bool> visited(_nodeCount, false);
+  std::vector<std::uint32_t> stack;
+  std::vector<NodeId> result;
+
+  for (NodeId root : roots_)
+  {
+    std::size_t idx = indexOf(root);
+    if (idx != npos)
+      stack.push_back(static_cast<std::uint32_t>(idx));
+  }
+
+  while (!stack.empty())
+  {
+    std::uint32_t idx = stack.back();
+    stack.pop_back();
+
+    for (std::uint64_t e = offsets[idx]; e < offsets[idx + 1]; ++e)
+    {
+      std::uint32_t target = targets[e];
+
+      if (!(mask_ & mask(kinds[e])) || visited[target])
+        continue;
+
+      visited[target] = true;
+      result.push_back(_nodes[target]);
+      stack.push_back(target);
+    }
+  }
+
+  return result;
+}
+
+std::vector<std::vector<CsrGraph::NodeId>> CsrGraph::topologicalLevels(
+  const std::vector<NodeId>& nodes_,
+  EdgeMask mask_) const
+{
+  std::vector<std::vector<NodeId>> levels;
+
+  // Nodes without edges can't depend on anything.
+  std::vector<NodeId> isolated;
+  std::vector<std::uint32_t> subset;
+
+  for (NodeId node : nodes_)
+  {
+    std::size_t idx = indexOf(node);
+    if (idx == npos)
+      isolated.push_back(node);
+    else
+      subset.push_back(static_cast<std::uint32_t>(idx));
+  }
+
+  std::sort(subset.begin(), subset.end());
+  subset.erase(std::unique(subset.begin(), subset.end()), subset.end());
+
+  auto position = [&subset](std::uint32_t idx_) {
+    auto it = std::lower_bound(subset.begin(), subset.end(), idx_);
+    return it != subset.end() && *it == idx_ ? it - subset.begin() : -1;
+  };
+
+  //--- Count incoming edges inside the subset ---//
+
+  std::vector<std::size_t> inDegree(subset.size(), 0);
+
+  for (std::size_t i = 0; i < subset.size(); ++i)
+  {
+    std::uint32_t idx = subset[i];
+    for (std::uint64_t e = _fwdOffsets[idx]; e < _fwdOffsets[idx + 1]; ++e)
+    {
+      if (!(mask_ & mask(_fwdKinds[e])) || _fwdTargets[e] == idx)
+        continue;
+
+      auto pos = position(_fwdTargets[e]);
+      if (pos >= 0)
+        ++inDegree[pos];
+    }
+  }
+
+  //--- Kahn's algorithm by levels ---//
+
+  std::vector<std::size_t> current;
+  for (std::size_t i = 0; i < subset.size(); ++i)
+    if (inDegree[i] == 0)
+      current.push_back(i);
+
+  std::vector<bool> done(subset.size(), false);
+  std::size_t doneCount = 0;
+
+  while (!current.empty())
+  {
+    std::vector<NodeId> level;
+    std::vector<std::size_t> next;
+
+    for (std::size_t i : current)
+    {
+      done[i] = true;
+      ++doneCount;
+      level.push_back(_nodes[subset[i]]);
+
+      std::uint32_t idx = subset[i];
+      for (std::uint64_t e = _fwdOffsets[idx]; e < _fwdOffsets[idx + 1]; ++e)
+      {
+        if (!(mask_ & mask(_fwdKinds[e])) || _fwdTargets[e] == idx)
+          continue;
+
+        auto pos = position(_fwdTargets[e]);
+        if (pos >= 0 && --inDegree[pos] == 0)
+          next.push_back(pos);
+      }
+    }
+
+    levels.push_back(std::move(level));
+    current = std::move(next);
+  }
+
+  if (!isolated.empty())
+  {
+    if (levels.empty())
+      levels.emplace_back();
+    levels.front().insert(
+      levels.front().end(), isolated.begin(), isolated.end());
+  }
+
+  //--- Nodes in cycles ---//
+
+  if (doneCount != subset.size())
+  {
+    std::vector<NodeId> rest;
+    for (std::size_t i = 0; i < subset.size(); ++i)
+      if (!done[i])
+        rest.push_back(_nodes[subset[i]]);
+    levels.push_back(std::move(rest));
+  }
+
+  return levels;
+}
+
+} // util
+} // cc
@@ -17,6 +17,7 @@
 #endif
 
 #include <odb/connection.hxx>
+#include <odb/transaction.hxx>
 
 #include <util/logutil.h>
 #include <util/dbutil.h>
@@ -51,6 +52,15 @@ boost::optional<std::vector<std::string>> createOdbOptions(
       setenv("PGPASSFILE", val.c_str(), 1);
       continue;
     }
+
+    // The tables are created in the given schema instead of the default one,
+    // e.g. the shards of a project can be stored in one database.
+    if (opt == "schema")
+    {
+      opts.emplace_back("--options");
+      opts.emplace_back("-c search_path=" + val);
+      continue;
+    }
 #endif
 
 #ifdef DATABASE_SQLITE
@@ -211,6 +221,61 @@ std::string removeByRegex(
   return boost::regex_replace(s_, expr, "");
 }
 
+/**
+ * This function runs an .sql file which is produced by ODB.
+ * @param connection_ A database connection.
+ * @param fileName_ Path of the .sql file.
+ * @param replacer_ A function can be given which will be applied to the .sql
+ * file content before execution.
+ * @param logMessage_ This log message is printed before the .sql file
+ * execution followed by the file name.
+ */
+void runSqlFile(
+  odb::connection_ptr connection_,
+  const std::string& fileName_,
+  std::function<std::string(const std::string&)> replacer_,
+  const std::string& logMessage_)
+{
+  LOG(info) << logMessage_ << ' ' << fileName_;
+
+  std::ifstream file(fileName_);
+
+  std::string fileContent(
+    (std::istreambuf_iterator<char>(file)),
+    (std::istreambuf_iterator<char>()));
+
+  file.close();
+
+  try
+  {
+    // In SQLite if several SQL commands are provided separated by semicolon
+    // then only the first executes. So we have to split and execute them one
+    // by one.
+    std::string sql = replacer_(fileContent);
+    std::vector<std::string> v;
+    boost::algorithm::split_regex(v, sql, boost::regex("\n\n"));
+
+    for (std::size_t i = 0; i < v.size(); ++i)
+    {
+#ifdef DATABASE_SQLITE
+      // DROP TABLE SQL commands generated by ODB may contain "CASCADE"
+      // keyword which is not known by SQLITE.
+      if (v[i].find("DROP TABLE") == 0)
+      {
+        std::size_t pos = v[i].find("CASCADE");
+        if (pos != std::string::npos)
+          v[i].erase(pos, 7); // 7 == length of "CASCADE"
+      }
+#endif
+      connection_->execute(v[i]);
+    }
+  }
+  catch (const odb::exception& ex)
+  {
+    LOG(warning) << "Exception when running SQL command: " << ex.what();
+  }
+}
+
 /**
  * This function runs all .sql files which are produced by ODB.
  * @param db_ A database object.
@@ -236,45 +301,11 @@ void runSqlFiles(
     if (!boost::filesystem::is_regular_file(it->path()))
       continue;
 
-    std::string fileName = boost::filesystem::canonical(it->path()).native();
-    LOG(info) << logMessage_ << ' ' << fileName;
-
-    std::ifstream file(fileName);
-
-    std::string fileContent(
-      (std::istreambuf_iterator<char>(file)),
-      (std::istreambuf_iterator<char>()));
-
-    file.close();
-
-    try
-    {
-      // In SQLite if several SQL commands are provided separated by semicolon
-      // then only the first executes. So we have to split and execute them one
-      // by one.
-      std::string sql = replacer_(fileContent);
-      std::vector<std::string> v;
-      boost::algorithm::split_regex(v, sql, boost::regex("\n\n"));
-
-      for (std::size_t i = 0; i < v.size(); ++i)
-      {
-#ifdef DATABASE_SQLITE
-        // DROP TABLE SQL commands generated by ODB may contain "CASCADE"
-        // keyword which is not known by SQLITE.
-        if (v[i].find("DROP TABLE") == 0)
-        {
-          std::size_t pos = v[i].find("CASCADE");
-          if (pos != std::string::npos)
-            v[i].erase(pos, 7); // 7 == length of "CASCADE"
-        }
-#endif
-        connection->execute(v[i]);
-      }
-    }
-    catch (const odb::exception& ex)
-    {
-      LOG(warning) << "Exception when running SQL command: " << ex.what();
-    }
+    runSqlFile(
+      connection,
+      boost::filesystem::canonical(it->path()).native(),
+      replacer_,
+      logMessage_);
   }
 }
 
@@ -398,6 +429,28 @@ std::shared_ptr<odb::database> connectDatabase(
     db->connection()->execute("PRAGMA case_sensitive_like = ON");
 #endif
 
+#ifdef DATABASE_PGSQL
+  // A database without the schema of the connection string is a new one.
+  std::string schema = connStrComponent(connStr_, "schema");
+  if (database == "pgsql" && !schema.empty())
+  {
+    odb::connection_ptr connection = db->connection();
+
+    bool exists = connection->execute(
+      "SELECT 1 FROM information_schema.schemata "
+      "WHERE schema_name = '" + schema + "'") > 0;
+
+    if (!exists && !create_)
+      return nullptr;
+
+    if (!exists)
+    {
+      connection->execute("CREATE SCHEMA \"" + schema + "\"");
+      LOG(info) << "Creating schema: " << schema;
+    }
+  }
+#endif
+
   databasePool[connStr_] = db;
 
   return db;
@@ -450,6 +503,34 @@ void createIndexes(
     "Creating indexes from file");
 }
 
+void createTablesFromFile(
+  std::shared_ptr<odb::database> db_,
+  const std::string& sqlFile_)
+{
+  runSqlFile(db_->connection(), sqlFile_,
+    [](const std::string& s_){
+      return removeByRegex(s_, "DROP", ";");
+    },
+    "Creating tables from file");
+}
+
+bool tableExists(
+  std::shared_ptr<odb::database> db_,
+  const std::string& table_)
+{
+  try
+  {
+    odb::transaction t(db_->begin());
+    db_->execute("SELECT 1 FROM \"" + table_ + "\" WHERE 1 = 0");
+    t.commit();
+    return true;
+  }
+  catch (const odb::exception&)
+  {
+    return false;
+  }
+}
+
 std::string updateConnectionString(
   std::string connStr_,
   const std::string& key_,
@@ -0,0 +1,139 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <util/arena.h>
+
+using namespace cc::util;
+
+namespace
+{
+
+struct Counted
+{
+  Counted(int& alive_, std::string name_) : alive(alive_), name(name_)
+  {
+    ++alive;
+  }
+
+  ~Counted()
+  {
+    --alive;
+  }
+
+  int& alive;
+  std::string name;
+};
+
+bool isAligned(const void* ptr_, std::size_t alignment_)
+{
+  return reinterpret_cast<std::uintptr_t>(ptr_) % alignment_ == 0;
+}
+
+} // namespace
+
+TEST(ArenaTest, Alignment)
+{
+  Arena arena(256);
+
+  for (std::size_t alignment : {1, 2, 4, 8, 16, 64})
+  {
+    arena.allocate(1, 1);
+    EXPECT_TRUE(isAligned(arena.allocate(3, alignment), alignment));
+  }
+}
+
+TEST(ArenaTest, AllocationsShareBlocks)
+{
+  Arena arena(256);
+
+  char* first = static_cast<char*>(arena.allocate(8, 8));
+  char* second = static_cast<char*>(arena.allocate(8, 8));
+
+  // Consecutive allocations are carved from the same block.
+  EXPECT_EQ(first + 8, second);
+  EXPECT_EQ(1u, arena.statistics().blocks);
+
+  // An allocation which doesn't fit into the rest of the block starts a new
+  // one, a larger allocation than the block size gets a block of its own.
+  arena.allocate(250, 8);
+  EXPECT_EQ(2u, arena.statistics().blocks);
+
+  arena.allocate(1000, 8);
+  EXPECT_EQ(3u, arena.statistics().blocks);
+
+  EXPECT_EQ(4u, arena.statistics().allocations);
+  EXPECT_EQ(1266u, arena.statistics().bytes);
+}
+
+TEST(ArenaTest, MakeShared)
+{
+  int alive = 0;
+
+  {
+    Arena arena;
+    std::shared_ptr<Counted> first = arena.makeShared<Counted>(alive, "a");
+    std::shared_ptr<Counted> second = arena.makeShared<Counted>(alive, "b");
+
+    EXPECT_EQ(2, alive);
+    EXPECT_EQ("a", first->name);
+    EXPECT_EQ("b", second->name);
+
+    // The objects are destroyed when their last pointer is released, even
+    // though their memory is freed only with the arena.
+    first.reset();
+    EXPECT_EQ(1, alive);
+    EXPECT_EQ(2u, arena.statistics().allocations);
+  }
+
+  EXPECT_EQ(0, alive);
+}
+
+TEST(ArenaTest, Allocator)
+{
+  Arena arena;
+  std::vector<int, ArenaAllocator<int>> numbers{ArenaAllocator<int>(arena)};
+
+  for (int i = 0; i < 1000; ++i)
+    numbers.push_back(i);
+
+  EXPECT_EQ(499500, std::accumulate(numbers.begin(), numbers.end(), 0));
+  EXPECT_LT(0u, arena.statistics().allocations);
+
+  Arena other;
+  EXPECT_TRUE(ArenaAllocator<int>(arena) == ArenaAllocator<char>(arena));
+  EXPECT_TRUE(ArenaAllocator<int>(arena) != ArenaAllocator<int>(other));
+}
+
+TEST(ArenaTest, ReleaseAddsToTotals)
+{
+  std::uint64_t peakBefore;
+  Arena::Statistics before = Arena::totals(peakBefore);
+
+  {
+    Arena arena(1024);
+    arena.allocate(100, 8);
+    arena.allocate(200, 8);
+
+    // Releasing resets the statistics of the arena, which can be reused.
+    arena.release();
+    EXPECT_EQ(0u, arena.statistics().allocations);
+    EXPECT_EQ(0u, arena.statistics().blocks);
+
+    arena.allocate(50, 8);
+  }
+
+  std::uint64_t peak;
+  Arena::Statistics after = Arena::totals(peak);
+
+  EXPECT_EQ(before.allocations + 3, after.allocations);
+  EXPECT_EQ(before.bytes + 350, after.bytes);
+  EXPECT_EQ(before.blocks + 2, after.blocks);
+  EXPECT_EQ(std::max<std::uint64_t>(peakBefore, 300), peak);
+}
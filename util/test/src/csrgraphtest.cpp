@@ -0,0 +1,162 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include <gtest/gtest.h>
+
+#include <unistd.h>
+
+#include <util/csrgraph.h>
+
+using namespace cc::util;
+
+namespace
+{
+
+const std::uint8_t INCLUDE = 0;
+const std::uint8_t USE = 1;
+
+std::vector<CsrGraph::NodeId> sorted(std::vector<CsrGraph::NodeId> nodes_)
+{
+  std::sort(nodes_.begin(), nodes_.end());
+  return nodes_;
+}
+
+} // namespace
+
+class CsrGraphTest : public ::testing::Test
+{
+protected:
+  /**
+   * 1 -> 2 -> 3 -> 4 along inclusions, 5 -> 3 along an inclusion and
+   * 1 -> 6 along a use. The IDs are large like the file hashes.
+   */
+  CsrGraphTest() : _graph({
+    {id(1), id(2), INCLUDE},
+    {id(2), id(3), INCLUDE},
+    {id(3), id(4), INCLUDE},
+    {id(5), id(3), INCLUDE},
+    {id(1), id(6), USE},
+    {id(1), id(2), INCLUDE}})
+  {
+  }
+
+  static CsrGraph::NodeId id(std::uint64_t n_)
+  {
+    return 0xF000000000000000ULL + n_;
+  }
+
+  std::string tempPath() const
+  {
+    return "/tmp/csrgraphtest." + std::to_string(::getpid()) + ".bin";
+  }
+
+  CsrGraph _graph;
+};
+
+TEST_F(CsrGraphTest, DuplicateEdgesAreStoredOnce)
+{
+  EXPECT_EQ(_graph.nodeCount(), 6u);
+  EXPECT_EQ(_graph.edgeCount(), 5u);
+  EXPECT_TRUE(_graph.contains(id(6)));
+  EXPECT_FALSE(_graph.contains(id(7)));
+}
+
+TEST_F(CsrGraphTest, NeighboursAreFilteredByKind)
+{
+  EXPECT_EQ(sorted(_graph.successors(id(1))),
+    std::vector<CsrGraph::NodeId>({id(2), id(6)}));
+  EXPECT_EQ(_graph.successors(id(1), CsrGraph::mask(INCLUDE)),
+    std::vector<CsrGraph::NodeId>({id(2)}));
+  EXPECT_EQ(sorted(_graph.predecessors(id(3))),
+    std::vector<CsrGraph::NodeId>({id(2), id(5)}));
+  EXPECT_TRUE(_graph.predecessors(id(7)).empty());
+}
+
+TEST_F(CsrGraphTest, ClosureFollowsTheSelectedEdges)
+{
+  EXPECT_EQ(sorted(_graph.closure({id(1)})),
+    std::vector<CsrGraph::NodeId>({id(2), id(3), id(4), id(6)}));
+  EXPECT_EQ(sorted(_graph.closure({id(1)}, CsrGraph::mask(INCLUDE))),
+    std::vector<CsrGraph::NodeId>({id(2), id(3), id(4)}));
+
+  // The includers of a header, e.g. the files affected by its change.
+  EXPECT_EQ(sorted(_graph.closure({id(4)}, CsrGraph::mask(INCLUDE), true)),
+    std::vector<CsrGraph::NodeId>({id(1), id(2), id(3), id(5)}));
+
+  EXPECT_TRUE(_graph.closure({id(7)}).empty());
+}
+
+TEST_F(CsrGraphTest, TopologicalLevels)
+{
+  std::vector<std::vector<CsrGraph::NodeId>> levels
+    = _graph.topologicalLevels({id(1), id(2), id(3), id(5), id(7)});
+
+  ASSERT_EQ(levels.size(), 3u);
+  EXPECT_EQ(sorted(levels[0]),
+    std::vector<CsrGraph::NodeId>({id(1), id(5), id(7)}));
+  EXPECT_EQ(levels[1], std::vector<CsrGraph::NodeId>({id(2)}));
+  EXPECT_EQ(levels[2], std::vector<CsrGraph::NodeId>({id(3)}));
+}
+
+TEST_F(CsrGraphTest, CyclesFormTheLastLevel)
+{
+  CsrGraph graph({
+    {id(1), id(2), INCLUDE},
+    {id(2), id(3), INCLUDE},
+    {id(3), id(2), INCLUDE}});
+
+  std::vector<std::vector<CsrGraph::NodeId>> levels
+    = graph.topologicalLevels({id(1), id(2), id(3)});
+
+  ASSERT_EQ(levels.size(), 2u);
+  EXPECT_EQ(levels[0], std::vector<CsrGraph::NodeId>({id(1)}));
+  EXPECT_EQ(sorted(levels[1]), std::vector<CsrGraph::NodeId>({id(2), id(3)}));
+}
+
+TEST_F(CsrGraphTest, SaveAndLoad)
+{
+  std::string path = tempPath();
+  ASSERT_TRUE(_graph.save(path));
+
+  std::unique_ptr<CsrGraph> loaded = CsrGraph::load(path);
+  std::remove(path.c_str());
+
+  ASSERT_TRUE(loaded);
+  EXPECT_EQ(loaded->nodeCount(), _graph.nodeCount());
+  EXPECT_EQ(loaded->edgeCount(), _graph.edgeCount());
+  EXPECT_EQ(sorted(loaded->closure({id(4)}, CsrGraph::ALL_EDGES, true)),
+    sorted(_graph.closure({id(4)}, CsrGraph::ALL_EDGES, true)));
+  EXPECT_EQ(loaded->successors(id(1), CsrGraph::mask(USE)),
+    std::vector<CsrGraph::NodeId>({id(6)}));
+}
+
+TEST_F(CsrGraphTest, InvalidFilesAreNotLoaded)
+{
+  std::string path = tempPath();
+
+  EXPECT_FALSE(CsrGraph::load(path));
+
+  std::ofstream(path) << "not a graph";
+  EXPECT_FALSE(CsrGraph::load(path));
+
+  // A truncated graph file.
+  ASSERT_TRUE(_graph.save(path));
+  ::truncate(path.c_str(), 100);
+  EXPECT_FALSE(CsrGraph::load(path));
+
+  std::remove(path.c_str());
+}
+
+TEST_F(CsrGraphTest, EmptyGraph)
+{
+  CsrGraph graph;
+
+  EXPECT_EQ(graph.nodeCount(), 0u);
+  EXPECT_TRUE(graph.closure({id(1)}).empty());
+  EXPECT_EQ(graph.topologicalLevels({id(1)}),
+    std::vector<std::vector<CsrGraph::NodeId>>({{id(1)}}));
+}
@@ -0,0 +1,107 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <util/lrucache.h>
+
+using namespace cc::util;
+
+namespace
+{
+
+struct LengthWeight
+{
+  std::size_t operator()(const std::string& value_) const
+  {
+    return value_.size();
+  }
+};
+
+} // namespace
+
+TEST(LruCacheTest, LeastRecentlyUsedIsEvicted)
+{
+  LruCache<int, std::string> cache(3);
+  std::string value;
+
+  EXPECT_EQ(cache.put(1, "a"), 0u);
+  EXPECT_EQ(cache.put(2, "b"), 0u);
+  EXPECT_EQ(cache.put(3, "c"), 0u);
+
+  // 1 becomes the most recently used, so 2 is evicted next.
+  ASSERT_TRUE(cache.get(1, value));
+  EXPECT_EQ(value, "a");
+
+  EXPECT_EQ(cache.put(4, "d"), 1u);
+  EXPECT_FALSE(cache.get(2, value));
+  EXPECT_TRUE(cache.get(1, value));
+  EXPECT_TRUE(cache.get(3, value));
+  EXPECT_TRUE(cache.get(4, value));
+  EXPECT_EQ(cache.size(), 3u);
+
+  // The order is now 4, 3, 1 from the most recently used.
+  cache.put(5, "e");
+  EXPECT_FALSE(cache.get(1, value));
+}
+
+TEST(LruCacheTest, PutReplacesAndRefreshes)
+{
+  LruCache<int, std::string> cache(2);
+  std::string value;
+
+  cache.put(1, "a");
+  cache.put(2, "b");
+  EXPECT_EQ(cache.put(1, "x"), 0u);
+  EXPECT_EQ(cache.size(), 2u);
+
+  cache.put(3, "c");
+  EXPECT_FALSE(cache.get(2, value));
+  ASSERT_TRUE(cache.get(1, value));
+  EXPECT_EQ(value, "x");
+}
+
+TEST(LruCacheTest, CapacityIsTheTotalWeight)
+{
+  LruCache<int, std::string, std::hash<int>, LengthWeight> cache(10);
+  std::string value;
+
+  cache.put(1, "aaaa");
+  cache.put(2, "bbbb");
+  EXPECT_EQ(cache.weight(), 8u);
+
+  // The oldest element is evicted to make room for six characters.
+  EXPECT_EQ(cache.put(3, "cccccc"), 1u);
+  EXPECT_EQ(cache.weight(), 10u);
+  EXPECT_FALSE(cache.get(1, value));
+
+  // Replacing a value updates the weight.
+  cache.put(3, "c");
+  EXPECT_EQ(cache.weight(), 5u);
+
+  // A value heavier than the capacity doesn't stay.
+  cache.put(4, std::string(11, 'd'));
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.weight(), 0u);
+}
+
+TEST(LruCacheTest, EraseAndClear)
+{
+  LruCache<int, std::string> cache(3);
+  std::string value;
+
+  cache.put(1, "a");
+  cache.put(2, "b");
+
+  cache.erase(1);
+  cache.erase(3);
+  EXPECT_FALSE(cache.get(1, value));
+  EXPECT_EQ(cache.size(), 1u);
+
+  cache.clear();
+  EXPECT_FALSE(cache.get(2, value));
+  EXPECT_EQ(cache.size(), 0u);
+  EXPECT_EQ(cache.weight(), 0u);
+}
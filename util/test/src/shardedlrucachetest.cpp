@@ -0,0 +1,104 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include <util/shardedlrucache.h>
+
+using namespace cc::util;
+
+namespace
+{
+
+/**
+ * Puts every key into the same shard, so the eviction order is the one of a
+ * single LruCache.
+ */
+struct SameShard
+{
+  std::size_t operator()(int) const
+  {
+    return 0;
+  }
+};
+
+} // namespace
+
+TEST(ShardedLruCacheTest, CapacityIsSplitBetweenShards)
+{
+  ShardedLruCache<int, int> cache(40, 4);
+
+  for (int i = 0; i < 1000; ++i)
+    cache.put(i, i);
+
+  ShardedLruCache<int, int>::Statistics stats = cache.statistics();
+  EXPECT_EQ(stats.capacity, 40u);
+  EXPECT_LE(stats.size, 40u);
+  EXPECT_EQ(stats.weight, stats.size);
+  EXPECT_EQ(stats.evictions, 1000u - stats.size);
+}
+
+TEST(ShardedLruCacheTest, EvictionInShard)
+{
+  ShardedLruCache<int, int, SameShard> cache(8, 4);
+  int value;
+
+  cache.put(1, 1);
+  cache.put(2, 2);
+  EXPECT_TRUE(cache.get(1, value));
+
+  // Each shard holds two elements, 2 is the least recently used one.
+  cache.put(3, 3);
+  EXPECT_FALSE(cache.get(2, value));
+  EXPECT_TRUE(cache.get(1, value));
+  EXPECT_TRUE(cache.get(3, value));
+}
+
+TEST(ShardedLruCacheTest, HitsAndMisses)
+{
+  ShardedLruCache<int, int> cache(16);
+  int value = 0;
+
+  cache.put(1, 10);
+  EXPECT_TRUE(cache.get(1, value));
+  EXPECT_EQ(value, 10);
+  EXPECT_FALSE(cache.get(2, value));
+
+  cache.erase(1);
+  EXPECT_FALSE(cache.get(1, value));
+
+  ShardedLruCache<int, int>::Statistics stats = cache.statistics();
+  EXPECT_EQ(stats.hits, 1u);
+  EXPECT_EQ(stats.misses, 2u);
+  EXPECT_EQ(stats.size, 0u);
+}
+
+TEST(ShardedLruCacheTest, ConcurrentAccess)
+{
+  ShardedLruCache<int, int> cache(1000, 8);
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < 4; ++t)
+    threads.emplace_back([&cache, t]
+    {
+      int value;
+      for (int i = 0; i < 10000; ++i)
+      {
+        cache.put(t * 10000 + i, i);
+        cache.get(t * 10000 + i / 2, value);
+      }
+    });
+
+  for (std::thread& thread : threads)
+    thread.join();
+
+  ShardedLruCache<int, int>::Statistics stats = cache.statistics();
+  EXPECT_EQ(stats.hits + stats.misses, 40000u);
+  EXPECT_LE(stats.size, 1000u);
+
+  cache.clear();
+  EXPECT_EQ(cache.statistics().size, 0u);
+}
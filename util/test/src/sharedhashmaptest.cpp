@@ -0,0 +1,154 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <cstdint>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include <util/sharedhashmap.h>
+
+using namespace cc::util;
+
+namespace
+{
+
+/**
+ * Runs the function in a forked process and waits for it.
+ * @return True if the function returned true in the child.
+ */
+template <typename Function>
+bool runInChild(Function function_)
+{
+  ::pid_t pid = ::fork();
+  if (pid == 0)
+    ::_exit(function_() ? 0 : 1);
+
+  int status;
+  return pid > 0
+    && ::waitpid(pid, &status, 0) == pid
+    && WIFEXITED(status)
+    && WEXITSTATUS(status) == 0;
+}
+
+} // namespace
+
+TEST(SharedHashMapTest, InsertAndFind)
+{
+  SharedHashMap map(16);
+  std::uint64_t value = 0;
+
+  EXPECT_EQ(SharedHashMap::Insertion::INSERTED, map.insert(42, 7));
+  EXPECT_EQ(SharedHashMap::Insertion::FOUND, map.insert(42, 8));
+
+  // Claimed keys are found too.
+  EXPECT_TRUE(map.find(42, value));
+  EXPECT_EQ(7u, value);
+  EXPECT_TRUE(map.contains(42));
+  EXPECT_FALSE(map.contains(43));
+  EXPECT_EQ(1u, map.size());
+}
+
+TEST(SharedHashMapTest, FullMap)
+{
+  // The table has twice as many slots as the capacity.
+  SharedHashMap map(2);
+
+  for (std::uint64_t key = 0; key < 4; ++key)
+    EXPECT_EQ(SharedHashMap::Insertion::INSERTED, map.insert(key, key));
+
+  EXPECT_EQ(SharedHashMap::Insertion::FULL, map.insert(4, 4));
+  EXPECT_EQ(SharedHashMap::Insertion::FOUND, map.insert(3, 3));
+  EXPECT_FALSE(map.contains(4));
+}
+
+TEST(SharedHashMapTest, ReleasedClaimIsTakenOver)
+{
+  SharedHashMap map(16);
+
+  ASSERT_EQ(SharedHashMap::Insertion::INSERTED, map.insert(1, 0));
+  map.release(1);
+  EXPECT_TRUE(map.contains(1));
+  EXPECT_EQ(SharedHashMap::Insertion::INSERTED, map.insert(1, 0));
+
+  // A published key can't be released.
+  map.publish(1);
+  map.release(1);
+  EXPECT_EQ(SharedHashMap::Insertion::FOUND, map.insert(1, 0));
+  EXPECT_EQ(1u, map.size());
+}
+
+TEST(SharedHashMapTest, ClaimOfDeadProcessIsTakenOver)
+{
+  SharedHashMap map(16);
+
+  // The child claims a key and publishes another one, then exits.
+  ASSERT_TRUE(runInChild([&map]()
+  {
+    bool inserted = map.insert(1, 10) == SharedHashMap::Insertion::INSERTED
+      && map.insert(2, 20) == SharedHashMap::Insertion::INSERTED;
+    map.publish(2);
+    return inserted;
+  }));
+
+  std::uint64_t value = 0;
+  EXPECT_TRUE(map.find(1, value));
+  EXPECT_EQ(10u, value);
+
+  // The claim of the dead child is taken over, its value is kept.
+  EXPECT_EQ(SharedHashMap::Insertion::INSERTED, map.insert(1, 11));
+  EXPECT_TRUE(map.find(1, value));
+  EXPECT_EQ(10u, value);
+
+  EXPECT_EQ(SharedHashMap::Insertion::FOUND, map.insert(2, 21));
+}
+
+TEST(SharedHashMapTest, ClaimOfLivingProcessIsKept)
+{
+  SharedHashMap map(16);
+
+  // The claim of this process is found by the child.
+  ASSERT_EQ(SharedHashMap::Insertion::INSERTED, map.insert(1, 0));
+  EXPECT_TRUE(runInChild([&map]()
+  {
+    return map.insert(1, 0) == SharedHashMap::Insertion::FOUND;
+  }));
+}
+
+TEST(SharedHashMapTest, ConcurrentInsertions)
+{
+  const std::uint64_t keyNum = 10000;
+  SharedHashMap map(keyNum);
+  SharedHashMap counts(1);
+
+  // Both processes insert every key, each key is claimed by one of them.
+  auto insertAll = [&map, keyNum]()
+  {
+    std::uint64_t inserted = 0;
+    for (std::uint64_t key = 0; key < keyNum; ++key)
+      if (map.insert(key, 0) == SharedHashMap::Insertion::INSERTED)
+      {
+        map.publish(key);
+        ++inserted;
+      }
+    return inserted;
+  };
+
+  ::pid_t pid = ::fork();
+  if (pid == 0)
+  {
+    counts.insert(0, insertAll());
+    ::_exit(0);
+  }
+  ASSERT_GT(pid, 0);
+
+  std::uint64_t parentCount = insertAll();
+  ::waitpid(pid, nullptr, 0);
+
+  std::uint64_t childCount = 0;
+  ASSERT_TRUE(counts.find(0, childCount));
+  EXPECT_EQ(keyNum, parentCount + childCount);
+  EXPECT_EQ(keyNum, map.size());
+}
@@ -13,6 +13,8 @@ function (urlHandler, exports) {
    */
   exports.addService = function (name, url, Client) {
     if (!this[name]) {
+      var serviceName = url;
+
       // These two services are independent from the workspaces, so these are
       // on an URL which don't contain the workspace name.
       if (url !== 'AuthenticationService' &&
@@ -31,12 +33,63 @@ function (urlHandler, exports) {
         });
       }
 
+      service._serviceName = serviceName;
       this[name] = service;
     }
 
     return this[name];
   }
 
+  /**
+   * Calls several functions of the workspace's services in a single HTTP
+   * request. The server runs the calls in parallel.
+   * @param {Array} calls The calls as objects with the following attributes:
+   * service (a service object created by addService()), method (the name of
+   * the function) and args (the array of arguments).
+   * @return {Array} The results of the calls in the same order. If a call
+   * failed then its result is the thrown exception or an Error object.
+   */
+  exports.batch = function (calls) {
+    var messages = calls.map(function (call) {
+      // A transport without URL returns the message instead of sending it.
+      var transport = new Thrift.Transport('');
+      var client = new call.service.constructor(
+        new Thrift.Protocol(transport));
+
+      client['send_' + call.method].apply(client, call.args || []);
+
+      return '[' + JSON.stringify(call.service._serviceName) + ','
+        + transport.send_buf + ']';
+    });
+
+    var xhr = new XMLHttpRequest();
+    xhr.open('POST', workspace + '/batch', false);
+    xhr.setRequestHeader('Content-Type', 'application/json');
+    xhr.send('[' + messages.join(',') + ']');
+
+    if (xhr.status !== 200)
+      throw new Error('Batch request failed: ' + xhr.statusText);
+
+    var responses = JSON.parse(xhr.responseText);
+
+    return calls.map(function (call, i) {
+      if (responses[i] === null)
+        return new Error('Batch call failed: ' + call.method);
+
+      var transport = new Thrift.Transport('');
+      transport.setRecvBuffer(JSON.stringify(responses[i]));
+
+      var client = new call.service.constructor(
+        new Thrift.Protocol(transport));
+
+      try {
+        return client['recv_' + call.method]();
+      } catch (ex) {
+        return ex;
+      }
+    });
+  }
+
   /**
    * This function returns the appropriate language service API belonging to
    * the given file type.
@@ -297,22 +297,38 @@ function (declare, domClass, dom, style, query, topic, ContentPane, Dialog,
      */
     loadFile : function (file) {
       var urlFileInfo = urlHandler.getFileInfo();
+      var fileContent;
 
       if (!(file instanceof FileInfo)) {
         // The same file shouldn't be loaded twice after each other.
         if (this._fileInfo && file === this._fileInfo.id)
           return;
 
-        this._fileInfo = urlFileInfo && urlFileInfo.id === file
-          ? urlFileInfo
-          : model.project.getFileInfo(file);
+        if (urlFileInfo && urlFileInfo.id === file) {
+          this._fileInfo = urlFileInfo;
+        } else {
+          // The file info and the content are fetched in one round trip.
+          var results = model.batch([
+            { service : model.project, method : 'getFileInfo',
+              args : [file] },
+            { service : model.project, method : 'getFileContent',
+              args : [file] }]);
+
+          if (results[0] instanceof Error || results[1] instanceof Error) {
+            this._fileInfo = model.project.getFileInfo(file);
+          } else {
+            this._fileInfo = results[0];
+            fileContent = results[1];
+          }
+        }
       } else {
         this._fileInfo = file;
       }
 
-      var fileContent = urlFileInfo && urlFileInfo.id === this._fileInfo.id
-        ? urlHandler.getFileContent()
-        : model.project.getFileContent(this._fileInfo.id);
+      if (fileContent === undefined)
+        fileContent = urlFileInfo && urlFileInfo.id === this._fileInfo.id
+          ? urlHandler.getFileContent()
+          : model.project.getFileContent(this._fileInfo.id);
 
       this.set('content', fileContent);
       this.set('header', this._fileInfo);
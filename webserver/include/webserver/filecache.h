@@ -0,0 +1,274 @@
+#ifndef CC_WEBSERVER_FILECACHE_H
+#define CC_WEBSERVER_FILECACHE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <odb/database.hxx>
+
+#include <model/databasegeneration.h>
+#include <model/file.h>
+
+#include <util/shardedlrucache.h>
+
+namespace cc
+{
+namespace webserver
+{
+
+/**
+ * Text of a file content together with the offsets of its lines.
+ */
+class FileCacheContent
+{
+public:
+  explicit FileCacheContent(std::string text_) : _text(std::move(text_))
+  {
+    _lineStarts.push_back(0);
+
+    for (std::size_t pos = _text.find('\n');
+         pos != std::string::npos && pos + 1 < _text.size();
+         pos = _text.find('\n', pos + 1))
+      _lineStarts.push_back(pos + 1);
+  }
+
+  const std::string& text() const
+  {
+    return _text;
+  }
+
+  /**
+   * Returns the lines [firstLine_, lastLine_] (numbered from 1) including the
+   * line break at the end of the last line, like model::loadFileLines().
+   */
+  std::string lines(std::size_t firstLine_, std::size_t lastLine_) const
+  {
+    firstLine_ = std::max<std::size_t>(firstLine_, 1);
+    if (lastLine_ < firstLine_ || firstLine_ > _lineStarts.size())
+      return std::string();
+
+    std::size_t begin = _lineStarts[firstLine_ - 1];
+    std::size_t end = lastLine_ < _lineStarts.size()
+      ? _lineStarts[lastLine_]
+      : _text.size();
+
+    return _text.substr(begin, end - begin);
+  }
+
+  /**
+   * Approximate memory usage of the object in bytes.
+   */
+  std::size_t memoryUsage() const
+  {
+    return sizeof(*this) + _text.capacity()
+      + _lineStarts.capacity() * sizeof(std::size_t);
+  }
+
+private:
+  std::string _text;
+  std::vector<std::size_t> _lineStarts;
+};
+
+/**
+ * Process-wide cache of File rows and file contents, shared by the services
+ * of every project. The webserver owns the cache and hands it to the services
+ * in the ServerContext. Rows are read in one transaction and never modified
+ * afterwards, so the cached objects are shared between the threads.
+ *
+ * The entries are keyed by the database and its generation, which the parser
+ * increments after every parsing (see model/databasegeneration.h). The
+ * entries of a reparsed project are not found anymore and they are removed
+ * from the cache as they become the least recently used ones.
+ */
+class FileCache
+{
+public:
+  typedef std::shared_ptr<const model::File> FilePtr;
+  typedef std::shared_ptr<const FileCacheContent> ContentPtr;
+
+  /**
+   * @param capacity_ Approximate memory limit in bytes. An eighth of it is
+   * used for the File rows, the rest for the contents.
+   */
+  FileCache(std::size_t capacity_)
+    : _files(capacity_ / 8),
+      _contents(capacity_ - capacity_ / 8),
+      _generationCheckInterval(2)
+  {
+  }
+
+  /**
+   * Returns the File row of the given ID. If it is not cached, then it is
+   * loaded by load_ and cached unless load_ returns nullptr.
+   */
+  template <typename Load>
+  FilePtr file(
+    const std::shared_ptr<odb::database>& db_,
+    const std::string& fileId_,
+    Load load_)
+  {
+    Key key{db_.get(), generation(db_), fileId_};
+
+    FilePtr file;
+    if (_files.get(key, file))
+      return file;
+
+    file = load_();
+    if (file)
+      _files.put(key, file);
+
+    return file;
+  }
+
+  /**
+   * Returns the file content of the given hash. If it is not cached, then it
+   * is loaded by load_ and cached unless load_ returns nullptr.
+   */
+  template <typename Load>
+  ContentPtr content(
+    const std::shared_ptr<odb::database>& db_,
+    const std::string& hash_,
+    Load load_)
+  {
+    Key key{db_.get(), generation(db_), hash_};
+
+    ContentPtr content;
+    if (_contents.get(key, content))
+      return content;
+
+    content = load_();
+    if (content)
+      _contents.put(key, content);
+
+    return content;
+  }
+
+  /**
+   * Returns the hit rates and the memory usage of the cache as a JSON object.
+   */
+  std::string toJson() const
+  {
+    std::ostringstream json;
+    json
+      << "{\"files\":" << toJson(_files.statistics())
+      << ",\"contents\":" << toJson(_contents.statistics()) << '}';
+    return json.str();
+  }
+
+private:
+  struct Key
+  {
+    const odb::database* db;
+    std::uint64_t generation;
+    std::string id; /*!< File ID or content hash. */
+
+    bool operator==(const Key& other_) const
+    {
+      return db == other_.db && generation == other_.generation
+        && id == other_.id;
+    }
+  };
+
+  struct KeyHash
+  {
+    std::size_t operator()(const Key& key_) const
+    {
+      std::size_t hash = std::hash<std::string>()(key_.id);
+      hash ^= std::hash<const void*>()(key_.db) + 0x9e3779b9
+        + (hash << 6) + (hash >> 2);
+      hash ^= std::hash<std::uint64_t>()(key_.generation) + 0x9e3779b9
+        + (hash << 6) + (hash >> 2);
+      return hash;
+    }
+  };
+
+  struct FileWeight
+  {
+    std::size_t operator()(const FilePtr& file_) const
+    {
+      return sizeof(model::File) + file_->path.capacity()
+        + file_->filename.capacity();
+    }
+  };
+
+  struct ContentWeight
+  {
+    std::size_t operator()(const ContentPtr& content_) const
+    {
+      return content_->memoryUsage();
+    }
+  };
+
+  struct Generation
+  {
+    std::uint64_t value;
+    std::chrono::steady_clock::time_point checkTime;
+  };
+
+  /**
+   * Returns the generation of the database. It is queried again when the
+   * last query is older than _generationCheckInterval.
+   */
+  std::uint64_t generation(const std::shared_ptr<odb::database>& db_)
+  {
+    auto now = std::chrono::steady_clock::now();
+
+    {
+      std::lock_guard<std::mutex> lock(_generationMutex);
+
+      auto it = _generations.find(db_.get());
+      if (it != _generations.end()
+        && now - it->second.checkTime < _generationCheckInterval)
+        return it->second.value;
+    }
+
+    // The query runs without holding the lock. If several threads query the
+    // generation at the same time, then each of them stores the same value.
+    std::uint64_t value = model::loadDatabaseGeneration(db_);
+
+    std::lock_guard<std::mutex> lock(_generationMutex);
+    _generations[db_.get()] = Generation{value, now};
+    return value;
+  }
+
+  template <typename Statistics>
+  static std::string toJson(const Statistics& stats_)
+  {
+    std::size_t lookups = stats_.hits + stats_.misses;
+
+    std::ostringstream json;
+    json
+      << "{\"hits\":" << stats_.hits
+      << ",\"misses\":" << stats_.misses
+      << ",\"hitRate\":" << (lookups ? double(stats_.hits) / lookups : 0.0)
+      << ",\"evictions\":" << stats_.evictions
+      << ",\"entries\":" << stats_.size
+      << ",\"bytes\":" << stats_.weight
+      << ",\"capacity\":" << stats_.capacity << '}';
+    return json.str();
+  }
+
+  util::ShardedLruCache<Key, FilePtr, KeyHash, FileWeight> _files;
+  util::ShardedLruCache<Key, ContentPtr, KeyHash, ContentWeight> _contents;
+
+  /**
+   * The generation of a database is queried at most once in this interval.
+   */
+  const std::chrono::seconds _generationCheckInterval;
+  std::map<const odb::database*, Generation> _generations;
+  std::mutex _generationMutex;
+};
+
+} // webserver
+} // cc
+
+#endif // CC_WEBSERVER_FILECACHE_H
@@ -0,0 +1,48 @@
+#ifndef CC_WEBSERVER_HTTPCOMPRESSION_H
+#define CC_WEBSERVER_HTTPCOMPRESSION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cc
+{
+namespace webserver
+{
+
+enum class ContentEncoding
+{
+  Identity,
+  Deflate,
+  Gzip,
+  Brotli
+};
+
+/**
+ * Chooses the best supported content coding from the value of an
+ * Accept-Encoding request header. Codings with zero quality are ignored, and
+ * the wildcard "*" accepts the codings which are not listed. Returns
+ * ContentEncoding::Identity if the header is null or no coding is acceptable.
+ */
+ContentEncoding negotiateContentEncoding(const char* acceptEncoding_);
+
+/**
+ * Returns the name of the coding as used in the Content-Encoding header.
+ */
+const char* contentEncodingName(ContentEncoding encoding_);
+
+/**
+ * Compresses the given buffer with the given coding into out_.
+ * @return False if the compression failed. In this case the response should
+ * be sent uncompressed.
+ */
+bool compressContent(
+  ContentEncoding encoding_,
+  const std::uint8_t* data_,
+  std::size_t size_,
+  std::string& out_);
+
+} // webserver
+} // cc
+
+#endif // CC_WEBSERVER_HTTPCOMPRESSION_H
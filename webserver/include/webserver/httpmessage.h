@@ -0,0 +1,138 @@
+#ifndef CC_WEBSERVER_HTTPMESSAGE_H
+#define CC_WEBSERVER_HTTPMESSAGE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <strings.h>
+
+#include "mongoose.h"
+
+namespace cc
+{
+namespace webserver
+{
+
+/**
+ * An HTTP request as seen by a RequestHandler. Unlike mg_connection it can
+ * outlive the processing of the connection by mongoose, so the request can be
+ * handled on a thread other than the one polling the connection.
+ */
+struct HttpRequest
+{
+  /**
+   * Creates a request which refers to the content buffer of the connection.
+   * It is valid only while mongoose keeps the connection untouched.
+   */
+  static HttpRequest view(const mg_connection* conn_)
+  {
+    HttpRequest request;
+
+    request.uri = conn_->uri;
+    request.content = conn_->content;
+    request.contentLength = conn_->content_len;
+
+    request.headers.reserve(conn_->num_headers);
+    for (int i = 0; i < conn_->num_headers; ++i)
+      request.headers.emplace_back(
+        conn_->http_headers[i].name, conn_->http_headers[i].value);
+
+    return request;
+  }
+
+  /**
+   * Creates a request which owns a copy of the content of the connection.
+   */
+  static HttpRequest detach(const mg_connection* conn_)
+  {
+    HttpRequest request = view(conn_);
+
+    request._storage = std::make_shared<std::string>(
+      conn_->content, conn_->content_len);
+    request.content = request._storage->data();
+
+    return request;
+  }
+
+  /**
+   * Returns the value of the given header (case-insensitively) or nullptr if
+   * the request has no such header.
+   */
+  const char* header(const char* name_) const
+  {
+    for (const auto& header : headers)
+      if (::strcasecmp(header.first.c_str(), name_) == 0)
+        return header.second.c_str();
+
+    return nullptr;
+  }
+
+  std::string uri;
+  std::vector<std::pair<std::string, std::string>> headers;
+  const char* content = nullptr;
+  std::size_t contentLength = 0;
+
+private:
+  std::shared_ptr<std::string> _storage;
+};
+
+/**
+ * An HTTP response produced by a RequestHandler. The body is not copied into
+ * the response: it refers to a buffer which is kept alive by the response.
+ */
+struct HttpResponse
+{
+  /**
+   * Sets the body to the given buffer, which is kept alive by owner_.
+   */
+  void setBody(
+    std::shared_ptr<const void> owner_,
+    const char* data_,
+    std::size_t size_)
+  {
+    _bodyOwner = std::move(owner_);
+    body = data_;
+    bodySize = size_;
+  }
+
+  void setBody(std::string body_)
+  {
+    auto owner = std::make_shared<std::string>(std::move(body_));
+    setBody(owner, owner->data(), owner->size());
+  }
+
+  /**
+   * Writes the response to the connection.
+   */
+  void send(mg_connection* conn_) const
+  {
+    mg_send_status(conn_, status);
+
+    for (const auto& header : headers)
+      mg_send_header(conn_, header.first.c_str(), header.second.c_str());
+    mg_send_header(
+      conn_, "Content-Length", std::to_string(bodySize).c_str());
+
+    // Terminate headers
+    mg_write(conn_, "\r\n", 2);
+
+    if (bodySize)
+      mg_write(conn_, body, bodySize);
+  }
+
+  int status = 200;
+  std::vector<std::pair<std::string, std::string>> headers;
+  const char* body = nullptr;
+  std::size_t bodySize = 0;
+
+private:
+  std::shared_ptr<const void> _bodyOwner;
+};
+
+} // webserver
+} // cc
+
+#endif // CC_WEBSERVER_HTTPMESSAGE_H
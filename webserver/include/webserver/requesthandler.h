@@ -7,6 +7,7 @@
 
 #include <boost/program_options.hpp>
 
+#include "httpmessage.h"
 #include "pluginhandler.h"
 #include "mongoose.h"
 
@@ -20,6 +21,26 @@ class RequestHandler
 public:
   virtual std::string key() const = 0;
   virtual int beginRequest(struct mg_connection*) = 0;
+
+  /**
+   * Handles a request which has been detached from its connection. This is
+   * called on the worker threads of the server, the response is sent by the
+   * thread polling the connection.
+   */
+  virtual void handleRequest(
+    const HttpRequest& request_,
+    HttpResponse& response_) = 0;
+
+  /**
+   * Returns the name of the function called by the request, if the handler
+   * can tell it without processing the request. The server uses it to apply
+   * per-function concurrency limits.
+   */
+  virtual std::string functionName(const HttpRequest&) const
+  {
+    return std::string();
+  }
+
   virtual ~RequestHandler() = default;
 };
 
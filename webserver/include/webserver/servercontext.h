@@ -10,6 +10,7 @@ namespace cc
 namespace webserver
 {
 
+class FileCache;
 class SessionManager;
 
 /**
@@ -27,9 +28,10 @@ struct ServerContext
 
   ServerContext(const std::string& compassRoot_,
                 const boost::program_options::variables_map& options_,
-                SessionManager* sessionManager_)
+                SessionManager* sessionManager_,
+                FileCache* fileCache_ = nullptr)
     : compassRoot(compassRoot_), options(options_),
-      sessionManager(sessionManager_)
+      sessionManager(sessionManager_), fileCache(fileCache_)
   {
   }
 
@@ -50,6 +52,12 @@ struct ServerContext
    * webserver/session.h to interface with the SessionManager.
    */
   SessionManager* sessionManager;
+  /**
+   * Cache of File rows and file contents shared by the services of every
+   * project (see webserver/filecache.h). It may be null, e.g. in the tests
+   * of the services, then the services query the database directly.
+   */
+  FileCache* fileCache;
 };
 
 } // namespace webserver
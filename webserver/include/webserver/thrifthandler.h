@@ -2,16 +2,21 @@
 #define CC_WEBSERVER_THRIFTHANDLER_H
 
 #include <stdio.h>
+#include <cstring>
 #include <memory>
 
 #include <thrift/transport/TBufferTransports.h>
 #include <thrift/transport/THttpServer.h>
 #include <thrift/transport/TTransport.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TCompactProtocol.h>
 #include <thrift/protocol/TJSONProtocol.h>
 
 #include <util/logutil.h>
 
+#include "httpcompression.h"
 #include "mongoose.h"
+#include "thriftstatistics.h"
 
 namespace cc
 {
@@ -28,7 +33,8 @@ protected:
   struct CallContext
   {
     /**
-     * Mongoose connection.
+     * Mongoose connection. It is null: requests are processed detached from
+     * their connections.
      */
     struct mg_connection* connection;
 
@@ -36,8 +42,30 @@ protected:
      * A pointer for the real call context (for dispatch call).
      */
     void* nextCtx;
+
+    /**
+     * The name of the called function, set by the dispatch.
+     */
+    std::string function;
+  };
+
+  /**
+   * Wire formats of the Thrift messages, selected by the Content-Type of the
+   * request. The response is sent in the same format.
+   */
+  enum class Protocol
+  {
+    Json,
+    Binary,
+    Compact
   };
 
+  /**
+   * Responses smaller than this are sent uncompressed: compressing them would
+   * not pay off.
+   */
+  static constexpr std::size_t MIN_COMPRESSED_SIZE = 1024;
+
   class LoggingProcessor : public Processor
   {
   public:
@@ -56,6 +84,7 @@ protected:
       void* callContext_) override
     {
       CallContext& ctx = *reinterpret_cast<CallContext*>(callContext_);
+      ctx.function = fname_;
 
       return Processor::dispatchCall(in_, out_, fname_, seqid_, ctx.nextCtx);
     }
@@ -80,6 +109,19 @@ public:
   }
 
   int beginRequest(struct mg_connection *conn_) override
+  {
+    HttpResponse response;
+    handleRequest(HttpRequest::view(conn_), response);
+    response.send(conn_);
+
+    // Returning non-zero tells mongoose that our function has replied to
+    // the client, and mongoose should not send client any more data.
+    return MG_TRUE;
+  }
+
+  void handleRequest(
+    const HttpRequest& request_,
+    HttpResponse& response_) override
   {
     using namespace ::apache::thrift;
     using namespace ::apache::thrift::transport;
@@ -87,53 +129,162 @@ public:
 
     try
     {
-      std::string content{conn_->content, conn_->content + conn_->content_len};
+      Protocol protocol = negotiateProtocol(request_.header("Content-Type"));
 
-      LOG(debug) << "Request content:\n" << content;
+      if (protocol == Protocol::Json)
+        LOG(debug) << "Request content:\n"
+          << std::string(request_.content, request_.contentLength);
 
-      std::shared_ptr<TTransport> inputBuffer(
-        new TMemoryBuffer((std::uint8_t*)content.c_str(), content.length()));
+      // The request body is read in place, without copying it.
+      std::shared_ptr<TMemoryBuffer> inputBuffer(new TMemoryBuffer(
+        reinterpret_cast<std::uint8_t*>(const_cast<char*>(request_.content)),
+        request_.contentLength,
+        TMemoryBuffer::OBSERVE));
 
-      std::shared_ptr<TTransport> outputBuffer(new TMemoryBuffer(4096));
+      std::shared_ptr<TMemoryBuffer> outputBuffer(new TMemoryBuffer(4096));
 
-      std::shared_ptr<TProtocol> inputProtocol(
-        new TJSONProtocol(inputBuffer));
-      std::shared_ptr<TProtocol> outputProtocol(
-        new TJSONProtocol(outputBuffer));
+      CallContext ctx{nullptr, nullptr, std::string()};
+      _processor.process(
+        createProtocol(protocol, inputBuffer),
+        createProtocol(protocol, outputBuffer),
+        &ctx);
 
-      CallContext ctx{conn_, nullptr};
-      _processor.process(inputProtocol, outputProtocol, &ctx);
+      std::uint8_t* response;
+      std::uint32_t responseSize;
+      outputBuffer->getBuffer(&response, &responseSize);
 
-      TMemoryBuffer *mBuffer = dynamic_cast<TMemoryBuffer*>(outputBuffer.get());
+      if (protocol == Protocol::Json)
+        LOG(debug) << "Response:\n"
+          << std::string(response, response + responseSize);
 
-      std::string response = mBuffer->getBufferAsString();
+      ContentEncoding encoding = responseSize >= MIN_COMPRESSED_SIZE
+        ? negotiateContentEncoding(request_.header("Accept-Encoding"))
+        : ContentEncoding::Identity;
 
-      LOG(debug)
-        << "Response:\n" << response.c_str() << std::endl;
+      std::string compressed;
+      if (encoding != ContentEncoding::Identity &&
+          !compressContent(encoding, response, responseSize, compressed))
+      {
+        LOG(warning) << "Failed to compress the response of " << request_.uri
+          << " with " << contentEncodingName(encoding);
+        encoding = ContentEncoding::Identity;
+      }
 
-      // Send HTTP reply to the client create headers
-      mg_send_header(conn_, "Content-Type", "application/x-thrift");
-      mg_send_header(
-        conn_, "Content-Length", std::to_string(response.length()).c_str());
+      // The uncompressed response is sent from the output buffer without
+      // copying it.
+      if (encoding == ContentEncoding::Identity)
+        response_.setBody(
+          outputBuffer, reinterpret_cast<const char*>(response), responseSize);
+      else
+        response_.setBody(std::move(compressed));
 
-      // Terminate headers
-      mg_write(conn_, "\r\n", 2);
+      ThriftStatistics::instance().record(
+        endpoint(request_.uri, ctx.function),
+        request_.contentLength, responseSize, response_.bodySize);
 
-      // Send content
-      mg_write(conn_, response.c_str(), response.length());
+      response_.headers.emplace_back("Content-Type", contentType(protocol));
+      response_.headers.emplace_back("Vary", "Accept-Encoding");
+      if (encoding != ContentEncoding::Identity)
+        response_.headers.emplace_back(
+          "Content-Encoding", contentEncodingName(encoding));
     }
     catch (const std::exception& ex)
     {
       LOG(warning) << ex.what();
+      response_ = HttpResponse();
+      response_.status = 500;
     }
     catch (...)
     {
       LOG(warning) << "Unknown exception has been caught";
+      response_ = HttpResponse();
+      response_.status = 500;
     }
+  }
 
-    // Returning non-zero tells mongoose that our function has replied to
-    // the client, and mongoose should not send client any more data.
-    return MG_TRUE;
+  std::string functionName(const HttpRequest& request_) const override
+  {
+    using namespace ::apache::thrift::protocol;
+    using namespace ::apache::thrift::transport;
+
+    try
+    {
+      std::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(
+        reinterpret_cast<std::uint8_t*>(const_cast<char*>(request_.content)),
+        request_.contentLength,
+        TMemoryBuffer::OBSERVE));
+
+      std::string name;
+      TMessageType type;
+      std::int32_t seqid;
+      createProtocol(negotiateProtocol(request_.header("Content-Type")), buffer)
+        ->readMessageBegin(name, type, seqid);
+
+      return name;
+    }
+    catch (...)
+    {
+      // A malformed request fails later, when it is processed.
+      return std::string();
+    }
+  }
+
+private:
+  static Protocol negotiateProtocol(const char* contentType_)
+  {
+    if (!contentType_)
+      return Protocol::Json;
+
+    if (std::strstr(contentType_, "application/vnd.apache.thrift.compact"))
+      return Protocol::Compact;
+
+    if (std::strstr(contentType_, "application/vnd.apache.thrift.binary"))
+      return Protocol::Binary;
+
+    // The web GUI sends application/x-thrift or
+    // application/vnd.apache.thrift.json.
+    return Protocol::Json;
+  }
+
+  static const char* contentType(Protocol protocol_)
+  {
+    switch (protocol_)
+    {
+      case Protocol::Binary: return "application/vnd.apache.thrift.binary";
+      case Protocol::Compact: return "application/vnd.apache.thrift.compact";
+      default: return "application/x-thrift";
+    }
+  }
+
+  static std::shared_ptr<apache::thrift::protocol::TProtocol> createProtocol(
+    Protocol protocol_,
+    std::shared_ptr<apache::thrift::transport::TMemoryBuffer> transport_)
+  {
+    using namespace ::apache::thrift::protocol;
+    using namespace ::apache::thrift::transport;
+
+    switch (protocol_)
+    {
+      case Protocol::Binary:
+        return std::make_shared<TBinaryProtocolT<TMemoryBuffer>>(transport_);
+      case Protocol::Compact:
+        return std::make_shared<TCompactProtocolT<TMemoryBuffer>>(transport_);
+      default:
+        return std::make_shared<TJSONProtocol>(transport_);
+    }
+  }
+
+  /**
+   * Returns the name of the called endpoint for the traffic statistics. The
+   * URI of the service is "/<workspace>/<service>", only the service name is
+   * kept.
+   */
+  static std::string endpoint(
+    const std::string& uri_,
+    const std::string& function_)
+  {
+    return uri_.substr(uri_.rfind('/') + 1) + '/'
+      + (function_.empty() ? "<unknown>" : function_);
   }
 
 private:
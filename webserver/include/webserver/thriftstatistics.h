@@ -0,0 +1,61 @@
+#ifndef CC_WEBSERVER_THRIFTSTATISTICS_H
+#define CC_WEBSERVER_THRIFTSTATISTICS_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace cc
+{
+namespace webserver
+{
+
+/**
+ * Traffic counters of a Thrift endpoint (a function of a service).
+ */
+struct EndpointTraffic
+{
+  std::size_t calls = 0;
+  std::size_t requestBytes = 0;
+  std::size_t responseBytes = 0; /*!< Size of the serialized responses. */
+  std::size_t sentBytes = 0; /*!< Size of the response bodies after
+                                  compression. */
+};
+
+/**
+ * Process-wide collection of the traffic counters of the Thrift endpoints.
+ * The ThriftHandlers of the services record every call here.
+ */
+class ThriftStatistics
+{
+public:
+  static ThriftStatistics& instance();
+
+  /**
+   * @param endpoint_ The service and the function name separated by a '/'.
+   */
+  void record(
+    const std::string& endpoint_,
+    std::size_t requestBytes_,
+    std::size_t responseBytes_,
+    std::size_t sentBytes_);
+
+  std::map<std::string, EndpointTraffic> traffic() const;
+
+  /**
+   * Returns the counters as a JSON object keyed by the endpoints.
+   */
+  std::string toJson() const;
+
+private:
+  ThriftStatistics() = default;
+
+  std::map<std::string, EndpointTraffic> _traffic;
+  mutable std::mutex _mutex;
+};
+
+} // webserver
+} // cc
+
+#endif // CC_WEBSERVER_THRIFTSTATISTICS_H
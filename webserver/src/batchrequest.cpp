@@ -0,0 +1,168 @@
+#include <cctype>
+#include <stdexcept>
+
+#include "batchrequest.h"
+
+namespace
+{
+
+/**
+ * Minimal JSON scanner: the messages of the calls are not parsed, only their
+ * boundaries are looked for, so they can be passed to the Thrift processors
+ * as they are.
+ */
+class Scanner
+{
+public:
+  Scanner(const char* data_, std::size_t size_)
+    : _pos(data_), _end(data_ + size_)
+  {
+  }
+
+  void skipSpace()
+  {
+    while (_pos < _end && std::isspace(static_cast<unsigned char>(*_pos)))
+      ++_pos;
+  }
+
+  /**
+   * Consumes the given character after optional whitespace. Returns false if
+   * the next character is different.
+   */
+  bool accept(char ch_)
+  {
+    skipSpace();
+    if (_pos < _end && *_pos == ch_)
+    {
+      ++_pos;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char ch_)
+  {
+    if (!accept(ch_))
+      fail(std::string("'") + ch_ + "' expected");
+  }
+
+  std::string string()
+  {
+    expect('"');
+
+    std::string result;
+    while (_pos < _end && *_pos != '"')
+    {
+      // Service names contain no escapes, the escaped character is taken as
+      // it is.
+      if (*_pos == '\\' && _pos + 1 < _end)
+        ++_pos;
+      result.push_back(*_pos++);
+    }
+
+    expect('"');
+    return result;
+  }
+
+  /**
+   * Skips an array or an object and returns its beginning.
+   */
+  const char* compound()
+  {
+    skipSpace();
+
+    if (_pos == _end || (*_pos != '[' && *_pos != '{'))
+      fail("Thrift message expected");
+
+    const char* begin = _pos;
+    std::size_t depth = 0;
+    bool inString = false;
+
+    for (; _pos < _end; ++_pos)
+    {
+      if (inString)
+      {
+        if (*_pos == '\\' && _pos + 1 < _end)
+          ++_pos;
+        else if (*_pos == '"')
+          inString = false;
+        continue;
+      }
+
+      switch (*_pos)
+      {
+        case '"': inString = true; break;
+        case '[': case '{': ++depth; break;
+        case ']': case '}':
+          if (--depth == 0)
+          {
+            ++_pos;
+            return begin;
+          }
+          break;
+      }
+    }
+
+    fail("unterminated Thrift message");
+    return nullptr;
+  }
+
+  const char* position() const { return _pos; }
+
+  bool atEnd()
+  {
+    skipSpace();
+    return _pos == _end;
+  }
+
+  [[noreturn]] void fail(const std::string& message_) const
+  {
+    throw std::runtime_error("Malformed batch request: " + message_);
+  }
+
+private:
+  const char* _pos;
+  const char* _end;
+};
+
+} // namespace
+
+namespace cc
+{
+namespace webserver
+{
+
+std::vector<BatchCall> parseBatchRequest(const char* data_, std::size_t size_)
+{
+  std::vector<BatchCall> calls;
+  Scanner scanner(data_, size_);
+
+  scanner.expect('[');
+
+  if (!scanner.accept(']'))
+  {
+    do
+    {
+      BatchCall call;
+
+      scanner.expect('[');
+      call.service = scanner.string();
+      scanner.expect(',');
+      call.message = scanner.compound();
+      call.messageLength = scanner.position() - call.message;
+      scanner.expect(']');
+
+      calls.push_back(std::move(call));
+    } while (scanner.accept(','));
+
+    scanner.expect(']');
+  }
+
+  if (!scanner.atEnd())
+    scanner.fail("trailing characters");
+
+  return calls;
+}
+
+} // webserver
+} // cc
@@ -0,0 +1,48 @@
+#ifndef CC_WEBSERVER_BATCHREQUEST_H
+#define CC_WEBSERVER_BATCHREQUEST_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace cc
+{
+namespace webserver
+{
+
+/**
+ * A service call in a batch request.
+ */
+struct BatchCall
+{
+  std::string service;
+
+  /**
+   * The Thrift message of the call (JSON protocol). It points into the body
+   * of the batch request.
+   */
+  const char* message;
+  std::size_t messageLength;
+};
+
+/**
+ * Splits the body of a batch request into the calls. The body is a JSON array
+ * of [service, message] pairs, where service is the name of a service of the
+ * project (e.g. "CppService") and message is the Thrift JSON message of the
+ * call:
+ *
+ *   [["ProjectService",[1,"getFileInfo",1,0,{...}]],
+ *    ["CppService",[1,"getFileReferenceTypes",1,0,{...}]]]
+ *
+ * The response of the batch request is a JSON array of the Thrift response
+ * messages in the order of the calls. A call which failed to run (e.g. the
+ * service doesn't exist) has null in its place.
+ *
+ * @throw std::runtime_error if the body is malformed.
+ */
+std::vector<BatchCall> parseBatchRequest(const char* data_, std::size_t size_);
+
+} // webserver
+} // cc
+
+#endif // CC_WEBSERVER_BATCHREQUEST_H
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+
+#include <zlib.h>
+
+#ifdef CC_WEBSERVER_WITH_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#include <webserver/httpcompression.h>
+
+namespace
+{
+
+/**
+ * Compresses with zlib. The window bits select between the zlib (deflate)
+ * and the gzip wrapper.
+ */
+bool zlibCompress(
+  const std::uint8_t* data_,
+  std::size_t size_,
+  int windowBits_,
+  std::string& out_)
+{
+  z_stream stream{};
+
+  // Level 6 would double the compression time for a few percent gain, which
+  // is not worth it for responses produced on the fly.
+  if (deflateInit2(
+        &stream, 4, Z_DEFLATED, windowBits_, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return false;
+
+  out_.resize(deflateBound(&stream, size_));
+
+  stream.next_in = const_cast<Bytef*>(data_);
+  stream.avail_in = size_;
+  stream.next_out = reinterpret_cast<Bytef*>(&out_[0]);
+  stream.avail_out = out_.size();
+
+  int result = deflate(&stream, Z_FINISH);
+  out_.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  return result == Z_STREAM_END;
+}
+
+/**
+ * The supported codings in the order of the server's preference.
+ */
+const std::vector<cc::webserver::ContentEncoding> supportedEncodings{
+#ifdef CC_WEBSERVER_WITH_BROTLI
+  cc::webserver::ContentEncoding::Brotli,
+#endif
+  cc::webserver::ContentEncoding::Gzip,
+  cc::webserver::ContentEncoding::Deflate};
+
+} // namespace
+
+namespace cc
+{
+namespace webserver
+{
+
+ContentEncoding negotiateContentEncoding(const char* acceptEncoding_)
+{
+  if (!acceptEncoding_)
+    return ContentEncoding::Identity;
+
+  std::vector<std::string> codings;
+  boost::split(codings, acceptEncoding_, boost::is_any_of(","));
+
+  ContentEncoding best = ContentEncoding::Identity;
+  std::vector<ContentEncoding> listed;
+  bool wildcard = false;
+
+  for (std::string& coding : codings)
+  {
+    // Quality values are only checked for zero: the server's preference
+    // decides between the acceptable codings.
+    std::string::size_type paramPos = coding.find(';');
+    std::string params;
+    if (paramPos != std::string::npos)
+    {
+      params = coding.substr(paramPos + 1);
+      coding.erase(paramPos);
+    }
+
+    boost::trim(coding);
+    boost::erase_all(params, " ");
+    boost::to_lower(params);
+
+    bool rejected = boost::starts_with(params, "q=0") &&
+      params.find_first_of("123456789", 3) == std::string::npos;
+
+    // The wildcard stands for the codings which are not listed.
+    if (coding == "*")
+    {
+      wildcard = !rejected;
+      continue;
+    }
+
+    ContentEncoding encoding = ContentEncoding::Identity;
+    if (boost::iequals(coding, "gzip") || boost::iequals(coding, "x-gzip"))
+      encoding = ContentEncoding::Gzip;
+    else if (boost::iequals(coding, "deflate"))
+      encoding = ContentEncoding::Deflate;
+#ifdef CC_WEBSERVER_WITH_BROTLI
+    else if (boost::iequals(coding, "br"))
+      encoding = ContentEncoding::Brotli;
+#endif
+
+    listed.push_back(encoding);
+
+    if (!rejected && encoding > best)
+      best = encoding;
+  }
+
+  if (wildcard)
+    for (ContentEncoding encoding : supportedEncodings)
+      if (std::find(listed.begin(), listed.end(), encoding) == listed.end())
+      {
+        best = std::max(best, encoding);
+        break;
+      }
+
+  return best;
+}
+
+const char* contentEncodingName(ContentEncoding encoding_)
+{
+  switch (encoding_)
+  {
+    case ContentEncoding::Deflate: return "deflate";
+    case ContentEncoding::Gzip: return "gzip";
+    case ContentEncoding::Brotli: return "br";
+    default: return "identity";
+  }
+}
+
+bool compressContent(
+  ContentEncoding encoding_,
+  const std::uint8_t* data_,
+  std::size_t size_,
+  std::string& out_)
+{
+  switch (encoding_)
+  {
+    case ContentEncoding::Deflate:
+      return zlibCompress(data_, size_, MAX_WBITS, out_);
+
+    case ContentEncoding::Gzip:
+      return zlibCompress(data_, size_, MAX_WBITS + 16, out_);
+
+#ifdef CC_WEBSERVER_WITH_BROTLI
+    case ContentEncoding::Brotli:
+    {
+      std::size_t outSize = BrotliEncoderMaxCompressedSize(size_);
+      if (!outSize)
+        return false;
+
+      out_.resize(outSize);
+
+      // The higher qualities are meant for static content.
+      if (!BrotliEncoderCompress(
+            5, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+            size_, data_,
+            &outSize, reinterpret_cast<std::uint8_t*>(&out_[0])))
+        return false;
+
+      out_.resize(outSize);
+      return true;
+    }
+#endif
+
+    default:
+      return false;
+  }
+}
+
+} // webserver
+} // cc
@@ -1,9 +1,18 @@
+#include <atomic>
+
 #include <util/logutil.h>
 #include <util/util.h>
 
+#include <webserver/filecache.h>
+#include <webserver/httpcompression.h>
+#include <webserver/thriftstatistics.h>
+
+#include "batchrequest.h"
 #include "mainrequesthandler.h"
 
+#include "requestscheduler.h"
 #include "sessionmanager.h"
+#include "threadedmongoose.h"
 
 static bool isProtected(const char* uri_)
 {
@@ -40,6 +49,85 @@ namespace cc
 namespace webserver
 {
 
+/**
+ * A request which is being processed by a worker thread. The connection and
+ * the worker share it: the connection may be closed before the response is
+ * ready.
+ */
+struct PendingRequest
+{
+  HttpResponse response;
+  std::atomic<bool> done{false};
+};
+
+typedef std::shared_ptr<PendingRequest> PendingRequestPtr;
+
+/**
+ * The state of a batch request shared by the calls of the batch.
+ */
+struct BatchState
+{
+  std::shared_ptr<HttpRequest> request;
+  std::vector<BatchCall> calls;
+  std::vector<HttpResponse> responses;
+  std::atomic<std::size_t> remaining;
+  PendingRequestPtr pending;
+  mg_server* server;
+};
+
+/**
+ * Joins the responses of the calls into the response of the batch request.
+ * This is called by the call which finishes last.
+ */
+static void finishBatch(BatchState& batch_)
+{
+  std::string body = "[";
+
+  for (std::size_t i = 0; i < batch_.responses.size(); ++i)
+  {
+    const HttpResponse& response = batch_.responses[i];
+
+    if (i)
+      body += ',';
+
+    if (response.status == 200 && response.bodySize)
+      body.append(response.body, response.bodySize);
+    else
+      body += "null";
+  }
+
+  body += ']';
+
+  // The calls are not compressed one by one, the whole batch is.
+  HttpResponse& result = batch_.pending->response;
+  result.headers.emplace_back("Content-Type", "application/json");
+  result.headers.emplace_back("Vary", "Accept-Encoding");
+
+  ContentEncoding encoding = body.size() >= 1024
+    ? negotiateContentEncoding(batch_.request->header("Accept-Encoding"))
+    : ContentEncoding::Identity;
+
+  std::string compressed;
+  if (encoding != ContentEncoding::Identity &&
+      compressContent(
+        encoding,
+        reinterpret_cast<const std::uint8_t*>(body.data()),
+        body.size(),
+        compressed))
+  {
+    result.headers.emplace_back(
+      "Content-Encoding", contentEncodingName(encoding));
+    result.setBody(std::move(compressed));
+  }
+  else
+    result.setBody(std::move(body));
+
+  batch_.pending->done = true;
+
+  if (batch_.server)
+    mg_wakeup_server(batch_.server);
+}
+
 static void logRequest(const struct mg_connection* conn_, const Session* sess_)
 {
   std::string username = sess_ ? sess_->username : "Anonymous";
@@ -69,14 +157,29 @@ auto MainRequestHandler::executeWithSessionContext(Session* sess_, F func)
 }
 
 
-int MainRequestHandler::begin_request_handler(struct mg_connection* conn_)
+int MainRequestHandler::begin_request_handler(
+  struct mg_connection* conn_,
+  Session* sess_)
 {
   // We advance it by one because of the '/' character.
   const std::string& uri = conn_->uri + 1;
 
   auto handler = pluginHandler.getImplementation(uri);
   if (handler)
-    return handler->beginRequest(conn_);
+  {
+    if (scheduler && ThreadedMongoose::currentServer())
+      return dispatchRequest(conn_, handler, sess_);
+
+    return executeWithSessionContext(
+      sess_, [&handler, &conn_]() { return handler->beginRequest(conn_); });
+  }
+
+  const std::string batchSuffix = "/batch";
+  if (uri.size() > batchSuffix.size() &&
+      uri.compare(
+        uri.size() - batchSuffix.size(), std::string::npos, batchSuffix) == 0)
+    return dispatchBatch(
+      conn_, uri.substr(0, uri.size() - batchSuffix.size()), sess_);
 
   if (uri == "ga.txt")
   {
@@ -94,6 +197,20 @@ int MainRequestHandler::begin_request_handler(struct mg_connection* conn_)
     }
   }
 
+  if (uri == "statistics")
+  {
+    std::string traffic = ThriftStatistics::instance().toJson();
+    std::string requests = scheduler ? scheduler->toJson() : "null";
+    std::string files = fileCache ? fileCache->toJson() : "null";
+
+    mg_send_header(conn_, "Content-Type", "application/json");
+    mg_send_header(conn_, "Cache-Control", "no-cache");
+    mg_printf_data(conn_,
+      "{\"thrift\":%s,\"requests\":%s,\"fileCache\":%s}",
+      traffic.c_str(), requests.c_str(), files.c_str());
+    return MG_TRUE;
+  }
+
   if (uri.find("doxygen/") == 0)
   {
     mg_send_file(conn_, getDocDirByURI(uri).c_str());
@@ -105,6 +222,140 @@ int MainRequestHandler::begin_request_handler(struct mg_connection* conn_)
   return MG_FALSE;
 }
 
+int MainRequestHandler::dispatchRequest(
+  struct mg_connection* conn_,
+  std::shared_ptr<RequestHandler> handler_,
+  Session* sess_)
+{
+  // Mongoose calls the request handler again if more data arrives while the
+  // request is being processed.
+  if (conn_->connection_param)
+    return MG_MORE;
+
+  PendingRequestPtr pending = std::make_shared<PendingRequest>();
+  conn_->connection_param = new PendingRequestPtr(pending);
+
+  // The content buffer of the connection may be reallocated by mongoose in
+  // the meantime, so the worker gets its own copy of the request.
+  auto request = std::make_shared<HttpRequest>(HttpRequest::detach(conn_));
+  std::string function = handler_->functionName(*request);
+
+  const std::string& uri = request->uri;
+  std::string service = uri.substr(uri.rfind('/') + 1);
+
+  mg_server* server = ThreadedMongoose::currentServer();
+
+  scheduler->submit(service, function,
+    [this, handler_, request, pending, sess_, server]()
+    {
+      executeWithSessionContext(sess_, [&]() {
+        handler_->handleRequest(*request, pending->response);
+        return 0;
+      });
+
+      pending->done = true;
+      mg_wakeup_server(server);
+    });
+
+  return MG_MORE;
+}
+
+int MainRequestHandler::dispatchBatch(
+  struct mg_connection* conn_,
+  const std::string& project_,
+  Session* sess_)
+{
+  if (conn_->connection_param)
+    return MG_MORE;
+
+  auto batch = std::make_shared<BatchState>();
+  batch->request = std::make_shared<HttpRequest>(HttpRequest::detach(conn_));
+
+  try
+  {
+    batch->calls = parseBatchRequest(
+      batch->request->content, batch->request->contentLength);
+  }
+  catch (const std::exception& ex)
+  {
+    mg_send_status(conn_, 400); // 400 Bad Request.
+    mg_send_header(conn_, "Content-Type", "text/plain");
+    mg_printf_data(conn_, "%s", ex.what());
+    return MG_TRUE;
+  }
+
+  batch->responses.resize(batch->calls.size());
+  batch->remaining = batch->calls.size() + 1;
+  batch->pending = std::make_shared<PendingRequest>();
+  batch->server = scheduler ? ThreadedMongoose::currentServer() : nullptr;
+
+  conn_->connection_param = new PendingRequestPtr(batch->pending);
+
+  // The calls of a batch are independent, so they are run in parallel on the
+  // workers. All of them see the session of the batch request.
+  for (std::size_t i = 0; i < batch->calls.size(); ++i)
+  {
+    const BatchCall& call = batch->calls[i];
+
+    auto handler = pluginHandler.getImplementation(
+      project_ + '/' + call.service);
+
+    if (!handler)
+    {
+      LOG(warning) << "Batch call of unknown service: " << call.service;
+      batch->responses[i].status = 404;
+      --batch->remaining;
+      continue;
+    }
+
+    HttpRequest request;
+    request.uri = '/' + project_ + '/' + call.service;
+    request.headers.emplace_back("Content-Type", "application/x-thrift");
+    request.content = call.message;
+    request.contentLength = call.messageLength;
+
+    auto job = [this, batch, handler, request, i, sess_]()
+    {
+      executeWithSessionContext(sess_, [&]() {
+        handler->handleRequest(request, batch->responses[i]);
+        return 0;
+      });
+
+      if (--batch->remaining == 0)
+        finishBatch(*batch);
+    };
+
+    if (batch->server)
+      scheduler->submit(call.service, handler->functionName(request), job);
+    else
+      job();
+  }
+
+  // The extra count keeps the batch from finishing while the calls are being
+  // submitted.
+  if (--batch->remaining == 0)
+    finishBatch(*batch);
+
+  return batch->server ? MG_MORE : poll_request_handler(conn_);
+}
+
+int MainRequestHandler::poll_request_handler(struct mg_connection* conn_)
+{
+  PendingRequestPtr* pending
+    = static_cast<PendingRequestPtr*>(conn_->connection_param);
+
+  if (!pending || !(*pending)->done)
+    return MG_FALSE;
+
+  (*pending)->response.send(conn_);
+
+  delete pending;
+  conn_->connection_param = nullptr;
+
+  // Returning MG_TRUE tells mongoose that the request is finished.
+  return MG_TRUE;
+}
+
 int MainRequestHandler::operator()(struct mg_connection* conn_,
                                    enum mg_event ev_)
 {
@@ -113,10 +364,26 @@ int MainRequestHandler::operator()(struct mg_connection* conn_,
     // our own authentication system.
     return MG_TRUE;
 
+  if (ev_ == MG_POLL)
+    return poll_request_handler(conn_);
+
+  if (ev_ == MG_CLOSE)
+  {
+    // The worker may still be processing the request: it keeps its own
+    // reference to the pending request.
+    delete static_cast<PendingRequestPtr*>(conn_->connection_param);
+    conn_->connection_param = nullptr;
+    return MG_FALSE;
+  }
+
   if (ev_ != MG_REQUEST)
     // For everything else, bail out.
     return MG_FALSE;
 
+  if (conn_->connection_param)
+    // The request is being processed, more data has arrived.
+    return MG_MORE;
+
   const char* cookieHeader = mg_get_header(conn_, "Cookie");
 
   if (strcmp("/AuthenticationService", conn_->uri) == 0)
@@ -126,8 +393,7 @@ int MainRequestHandler::operator()(struct mg_connection* conn_,
 
     // Handle the authentication service specially - it needs access to the
     // session if it exists, but does NOT require a valid session to access.
-    return executeWithSessionContext(
-      sessCookie, [this, &conn_]() { return begin_request_handler(conn_); });
+    return begin_request_handler(conn_, sessCookie);
   }
 
   if (!isProtected(conn_->uri))
@@ -135,7 +401,7 @@ int MainRequestHandler::operator()(struct mg_connection* conn_,
     // For unprotected endpoints, just serve naturally, without querying the
     // session.
     logRequest(conn_, nullptr);
-    return begin_request_handler(conn_);
+    return begin_request_handler(conn_, nullptr);
   }
 
   Session* sessCookie = sessionManager->getSessionCookie(cookieHeader);
@@ -151,8 +417,7 @@ int MainRequestHandler::operator()(struct mg_connection* conn_,
     return MG_TRUE;
   }
 
-  return executeWithSessionContext(
-    sessCookie, [this, &conn_]() { return begin_request_handler(conn_); });
+  return begin_request_handler(conn_, sessCookie);
 }
 
 std::string MainRequestHandler::getDocDirByURI(std::string uri_)
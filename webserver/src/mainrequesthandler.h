@@ -9,6 +9,8 @@ namespace cc
 namespace webserver
 {
 
+class FileCache;
+class RequestScheduler;
 class Session;
 class SessionManager;
 
@@ -20,10 +22,46 @@ public:
   std::map<std::string, std::string> dataDir;
   std::string gaTrackingIdPath;
 
+  /**
+   * The service requests are handled on the workers of the scheduler. If it
+   * is null then they are handled on the polling threads.
+   */
+  RequestScheduler* scheduler = nullptr;
+
+  /**
+   * The file cache of the services. Its statistics are reported at
+   * /statistics.
+   */
+  FileCache* fileCache = nullptr;
+
   int operator()(struct mg_connection* conn_, enum mg_event ev_);
 
 private:
-  int begin_request_handler(struct mg_connection* conn_);
+  int begin_request_handler(struct mg_connection* conn_, Session* sess_);
+
+  /**
+   * Hands the request over to the scheduler. The response is sent by
+   * poll_request_handler() when it is ready.
+   */
+  int dispatchRequest(
+    struct mg_connection* conn_,
+    std::shared_ptr<RequestHandler> handler_,
+    Session* sess_);
+
+  /**
+   * Runs the calls of a batch request (see batchrequest.h) of the given
+   * project. The calls are handed over to the scheduler one by one, and the
+   * response is sent when the last one has finished.
+   */
+  int dispatchBatch(
+    struct mg_connection* conn_,
+    const std::string& project_,
+    Session* sess_);
+
+  /**
+   * Sends the response of a dispatched request if it is ready.
+   */
+  int poll_request_handler(struct mg_connection* conn_);
   std::string getDocDirByURI(std::string uri_);
 
   // Detail template - implementation in the .cpp only.
@@ -4986,7 +4986,10 @@ static void mg_ev_handler(struct ns_connection *nc, enum ns_event ev, void *p) {
           ping_idle_websocket_connection(conn, current_time);
         }
 
-        if (nc->last_io_time + MONGOOSE_IDLE_TIMEOUT_SECONDS < current_time) {
+        // Connections waiting for the response of a request handler are not
+        // idle: the handler may be processing the request on another thread.
+        if (nc->last_io_time + MONGOOSE_IDLE_TIMEOUT_SECONDS < current_time &&
+            (conn == NULL || conn->endpoint_type != EP_USER)) {
           mg_ev_handler(nc, NS_CLOSE, NULL);
           nc->flags |= NSF_CLOSE_IMMEDIATELY;
         }
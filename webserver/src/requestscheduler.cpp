@@ -0,0 +1,244 @@
+#include <algorithm>
+#include <sstream>
+
+#include <util/logutil.h>
+
+#include "requestscheduler.h"
+
+namespace
+{
+
+void histogramToJson(
+  std::ostream& out_,
+  const cc::webserver::RequestScheduler::Histogram& histogram_)
+{
+  typedef cc::webserver::RequestScheduler::Histogram Histogram;
+
+  out_ << "{\"count\":" << histogram_.count
+       << ",\"sumMs\":" << histogram_.sumMs
+       << ",\"buckets\":[";
+
+  for (std::size_t i = 0; i < histogram_.buckets.size(); ++i)
+  {
+    if (i)
+      out_ << ',';
+
+    out_ << "{\"le\":";
+    if (i < Histogram::BOUNDS.size())
+      out_ << Histogram::BOUNDS[i];
+    else
+      out_ << "\"inf\"";
+    out_ << ",\"count\":" << histogram_.buckets[i] << '}';
+  }
+
+  out_ << "]}";
+}
+
+} // namespace
+
+namespace cc
+{
+namespace webserver
+{
+
+const std::array<double, RequestScheduler::Histogram::BOUND_COUNT>
+RequestScheduler::Histogram::BOUNDS{{
+  1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000}};
+
+void RequestScheduler::Histogram::add(
+  std::chrono::steady_clock::duration duration_)
+{
+  double ms = std::chrono::duration<double, std::milli>(duration_).count();
+
+  std::size_t bucket = 0;
+  while (bucket < BOUNDS.size() && ms > BOUNDS[bucket])
+    ++bucket;
+
+  ++buckets[bucket];
+  ++count;
+  sumMs += ms;
+}
+
+RequestScheduler::RequestScheduler(
+  std::size_t workers_,
+  const std::map<std::string, std::size_t>& limits_)
+  : _workerCount(std::max<std::size_t>(workers_, 1)), _limits(limits_)
+{
+  _workers.reserve(_workerCount);
+  for (std::size_t i = 0; i < _workerCount; ++i)
+    _workers.emplace_back(&RequestScheduler::work, this);
+}
+
+RequestScheduler::~RequestScheduler()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+
+  _condition.notify_all();
+
+  for (std::thread& worker : _workers)
+    worker.join();
+}
+
+RequestScheduler::Group& RequestScheduler::group(
+  const std::string& service_,
+  const std::string& function_)
+{
+  std::string key = service_ + '/' + function_;
+  auto limit = _limits.find(key);
+
+  if (limit == _limits.end())
+  {
+    key = service_;
+    limit = _limits.find(key);
+  }
+
+  std::unique_ptr<Group>& group = _groups[key];
+  if (!group)
+  {
+    group.reset(new Group());
+    group->limit = limit == _limits.end()
+      ? _workerCount
+      : std::max<std::size_t>(limit->second, 1);
+    group->stats.limit = group->limit;
+  }
+
+  return *group;
+}
+
+void RequestScheduler::submit(
+  const std::string& service_,
+  const std::string& function_,
+  Job job_)
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    Group& target = group(service_, function_);
+    Task task{std::move(job_), &target, std::chrono::steady_clock::now()};
+
+    if (target.running < target.limit)
+    {
+      ++target.running;
+      _ready.push_back(std::move(task));
+    }
+    else
+    {
+      target.waiting.push_back(std::move(task));
+      ++_waiting;
+      return;
+    }
+  }
+
+  _condition.notify_one();
+}
+
+void RequestScheduler::work()
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  while (true)
+  {
+    _condition.wait(lock, [this]() { return _stop || !_ready.empty(); });
+
+    if (_ready.empty())
+      return;
+
+    Task task = std::move(_ready.front());
+    _ready.pop_front();
+
+    lock.unlock();
+
+    auto started = std::chrono::steady_clock::now();
+
+    try
+    {
+      task.job();
+    }
+    catch (const std::exception& ex)
+    {
+      LOG(warning) << "Request failed: " << ex.what();
+    }
+    catch (...)
+    {
+      LOG(warning) << "Request failed with unknown exception!";
+    }
+
+    auto finished = std::chrono::steady_clock::now();
+
+    lock.lock();
+
+    Group& group = *task.group;
+    group.stats.queueTime.add(started - task.queued);
+    group.stats.runTime.add(finished - started);
+    ++group.stats.completed;
+
+    // The freed slot of the group goes to its next waiting request.
+    if (!group.waiting.empty())
+    {
+      _ready.push_back(std::move(group.waiting.front()));
+      group.waiting.pop_front();
+      --_waiting;
+    }
+    else
+      --group.running;
+  }
+}
+
+std::size_t RequestScheduler::queueDepth() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _ready.size() + _waiting;
+}
+
+std::map<std::string, RequestScheduler::GroupStatistics>
+RequestScheduler::statistics() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  std::map<std::string, GroupStatistics> stats;
+  for (const auto& group : _groups)
+  {
+    GroupStatistics& groupStats = stats[group.first] = group.second->stats;
+    groupStats.running = group.second->running;
+    groupStats.waiting = group.second->waiting.size();
+  }
+
+  return stats;
+}
+
+std::string RequestScheduler::toJson() const
+{
+  std::ostringstream json;
+
+  json << "{\"workers\":" << _workerCount
+       << ",\"queueDepth\":" << queueDepth()
+       << ",\"groups\":{";
+
+  bool first = true;
+  for (const auto& group : statistics())
+  {
+    if (!first)
+      json << ',';
+    first = false;
+
+    json << '"' << group.first << "\":{"
+         << "\"limit\":" << group.second.limit
+         << ",\"running\":" << group.second.running
+         << ",\"waiting\":" << group.second.waiting
+         << ",\"completed\":" << group.second.completed
+         << ",\"queueTime\":";
+    histogramToJson(json, group.second.queueTime);
+    json << ",\"runTime\":";
+    histogramToJson(json, group.second.runTime);
+    json << '}';
+  }
+
+  json << "}}";
+  return json.str();
+}
+
+} // webserver
+} // cc
@@ -0,0 +1,147 @@
+#ifndef CC_WEBSERVER_REQUESTSCHEDULER_H
+#define CC_WEBSERVER_REQUESTSCHEDULER_H
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cc
+{
+namespace webserver
+{
+
+/**
+ * Runs the requests of the services on a bounded pool of worker threads.
+ *
+ * Requests are grouped by the called service, or by the called function if a
+ * limit is configured for it. A group never occupies more workers than its
+ * limit: the requests above the limit wait in the queue of their group, so
+ * slow endpoints (e.g. diagrams or reparsing) cannot starve the fast ones.
+ */
+class RequestScheduler
+{
+public:
+  typedef std::function<void()> Job;
+
+  /**
+   * Latency histogram with fixed buckets.
+   */
+  struct Histogram
+  {
+    static const std::size_t BOUND_COUNT = 13;
+
+    /**
+     * Upper bounds of the buckets in milliseconds. The last bucket collects
+     * everything above the last bound.
+     */
+    static const std::array<double, BOUND_COUNT> BOUNDS;
+
+    void add(std::chrono::steady_clock::duration duration_);
+
+    std::array<std::size_t, BOUND_COUNT + 1> buckets{};
+    std::size_t count = 0;
+    double sumMs = 0;
+  };
+
+  struct GroupStatistics
+  {
+    std::size_t limit = 0;
+    std::size_t running = 0;
+    std::size_t waiting = 0; /*!< Requests queued because of the limit. */
+    std::size_t completed = 0;
+    Histogram queueTime;
+    Histogram runTime;
+  };
+
+  /**
+   * @param workers_ The number of worker threads.
+   * @param limits_ Concurrency limits by service name ("CppService") or by
+   * function ("CppService/getDiagram"). Groups without a limit may use every
+   * worker.
+   */
+  RequestScheduler(
+    std::size_t workers_,
+    const std::map<std::string, std::size_t>& limits_);
+
+  /**
+   * Stops the workers after they finish the queued requests.
+   */
+  ~RequestScheduler();
+
+  RequestScheduler(const RequestScheduler&) = delete;
+  RequestScheduler& operator=(const RequestScheduler&) = delete;
+
+  /**
+   * Queues a request of the given service function.
+   */
+  void submit(
+    const std::string& service_,
+    const std::string& function_,
+    Job job_);
+
+  /**
+   * Returns the number of requests which wait for a worker.
+   */
+  std::size_t queueDepth() const;
+
+  std::map<std::string, GroupStatistics> statistics() const;
+
+  /**
+   * Returns the queue depth and the per group statistics as a JSON object.
+   */
+  std::string toJson() const;
+
+private:
+  struct Group;
+
+  struct Task
+  {
+    Job job;
+    Group* group;
+    std::chrono::steady_clock::time_point queued;
+  };
+
+  struct Group
+  {
+    std::size_t limit;
+    std::size_t running = 0;
+    std::deque<Task> waiting;
+    GroupStatistics stats;
+  };
+
+  /**
+   * Returns the group of the function. The caller must hold _mutex.
+   */
+  Group& group(const std::string& service_, const std::string& function_);
+
+  void work();
+
+  std::size_t _workerCount;
+  std::map<std::string, std::size_t> _limits;
+  std::map<std::string, std::unique_ptr<Group>> _groups;
+
+  /**
+   * Tasks which can be started without exceeding the limit of their group.
+   */
+  std::deque<Task> _ready;
+  std::size_t _waiting = 0;
+  bool _stop = false;
+
+  mutable std::mutex _mutex;
+  std::condition_variable _condition;
+  std::vector<std::thread> _workers;
+};
+
+} // webserver
+} // cc
+
+#endif // CC_WEBSERVER_REQUESTSCHEDULER_H
@@ -1,3 +1,6 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <random>
 #include <sstream>
 #include <vector>
@@ -12,24 +15,39 @@
 
 #define CODECOMPASS_SESSION_COOKIE "CodeCompass_SESH"
 
-/**
- * The number of sessions to exist in memory before automatic clearing of stale
- * sessions is performed.
- */
-static constexpr std::size_t SessionClearThreshold = 16;
-
 namespace cc
 {
 namespace webserver
 {
 
-SessionManager::SessionManager(const Authentication* authEngine_)
-  : _authEngine(authEngine_)
+SessionManager::SessionManager(
+  const Authentication* authEngine_,
+  std::chrono::milliseconds expiryPeriod_)
+  : _authEngine(authEngine_),
+    _sessions(std::make_shared<const SessionMap>()),
+    _expiryPeriod(expiryPeriod_),
+    _stopExpiry(false)
 {
   if (!isRequiringAuthentication())
     // Create a default session for services to be able to use, which is shared
     // between all users.
-    _sessions.emplace(CODECOMPASS_SESSION_COOKIE, Session{CODECOMPASS_SESSION_COOKIE, "Anonymous"});
+    _defaultSession = std::make_unique<Session>(
+      CODECOMPASS_SESSION_COOKIE, "Anonymous");
+  else
+    _expiryThread = std::thread(&SessionManager::runExpiry, this);
+}
+
+SessionManager::~SessionManager()
+{
+  {
+    const std::lock_guard<std::mutex> lock{_writeLock};
+    _stopExpiry = true;
+  }
+
+  _expiryCondition.notify_one();
+
+  if (_expiryThread.joinable())
+    _expiryThread.join();
 }
 
 bool SessionManager::isRequiringAuthentication() const
@@ -49,12 +67,8 @@ std::string SessionManager::getSessionCookieName() const
 
 Session* SessionManager::getSessionCookie(const char* cookieHeader_)
 {
-  if (!isRequiringAuthentication())
-  {
-    const std::lock_guard<std::mutex> lock{_sessionMapLock};
-    auto it = _sessions.find(CODECOMPASS_SESSION_COOKIE);
-    return &it->second;
-  }
+  if (_defaultSession)
+    return _defaultSession.get();
 
   if (!cookieHeader_)
     return nullptr;
@@ -81,11 +95,11 @@ Session* SessionManager::getSessionCookie(const char* cookieHeader_)
   if (identifier.empty())
     return nullptr;
 
-  const std::lock_guard<std::mutex> lock{_sessionMapLock};
-  auto it = _sessions.find(identifier);
-  if (it == _sessions.end())
+  std::shared_ptr<const SessionMap> sessions = std::atomic_load(&_sessions);
+  auto it = sessions->find(identifier);
+  if (it == sessions->end())
     return nullptr;
-  return &it->second;
+  return it->second.get();
 }
 
 void SessionManager::destroySessionCookie(Session* session_)
@@ -93,9 +107,16 @@ void SessionManager::destroySessionCookie(Session* session_)
   if (!session_ || session_->sessId == CODECOMPASS_SESSION_COOKIE)
     return;
 
-  const std::lock_guard<std::mutex> lock{_sessionMapLock};
-  _sessions.erase(session_->sessId);
-  cleanupOldSessions();
+  const std::lock_guard<std::mutex> lock{_writeLock};
+
+  auto sessions = std::make_shared<SessionMap>(*_sessions);
+  auto it = sessions->find(session_->sessId);
+  if (it == sessions->end())
+    return;
+
+  _retiredSessions.push_back(std::move(it->second));
+  sessions->erase(it);
+  publish(std::move(sessions));
 }
 
 bool SessionManager::isValid(const Session* session_) const
@@ -132,26 +153,51 @@ Session* SessionManager::authenticateUserWithNameAndPassword(
      << util::getCurrentDate() << distribution(random);
   std::string id = util::sha1Hash(os.str());
 
-  const std::lock_guard<std::mutex> lock{_sessionMapLock};
-  auto it = _sessions.emplace(id, Session{id, username_});
-  return &it.first->second;
+  const std::lock_guard<std::mutex> lock{_writeLock};
+
+  auto sessions = std::make_shared<SessionMap>(*_sessions);
+  auto it = sessions->emplace(id, std::make_shared<Session>(id, username_));
+  Session* session = it.first->second.get();
+  publish(std::move(sessions));
+  return session;
 }
 
-/**
- * Cleans up old sessions if the number of stored sessions is above a threshold.
- * This method expects to be called in a locked context.
- */
-void SessionManager::cleanupOldSessions()
+void SessionManager::publish(std::shared_ptr<const SessionMap> sessions_)
 {
-  if (_sessions.size() > SessionClearThreshold)
-  {
-    for (auto it = _sessions.begin(); it != _sessions.end();)
+  std::atomic_store(&_sessions, std::move(sessions_));
+}
+
+void SessionManager::expireSessions()
+{
+  _oldRetiredSessions = std::move(_retiredSessions);
+  _retiredSessions.clear();
+
+  std::shared_ptr<SessionMap> sessions;
+
+  for (const auto& session : *_sessions)
+    if (!isValid(session.second.get()))
     {
-      if (!isValid(&it->second))
-        it = _sessions.erase(it);
-      else
-        ++it;
+      if (!sessions)
+        sessions = std::make_shared<SessionMap>(*_sessions);
+
+      _retiredSessions.push_back(session.second);
+      sessions->erase(session.first);
     }
+
+  if (sessions)
+    publish(std::move(sessions));
+}
+
+void SessionManager::runExpiry()
+{
+  std::unique_lock<std::mutex> lock{_writeLock};
+
+  while (!_stopExpiry)
+  {
+    _expiryCondition.wait_for(lock, _expiryPeriod);
+
+    if (!_stopExpiry)
+      expireSessions();
   }
 }
 
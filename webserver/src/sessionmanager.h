@@ -1,9 +1,14 @@
 #ifndef CC_WEBSERVER_SESSIONMANAGER_H
 #define CC_WEBSERVER_SESSIONMANAGER_H
 
+#include <chrono>
+#include <condition_variable>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include <webserver/session.h>
 
@@ -17,11 +22,22 @@ class Authentication;
 /**
  * Keeps track of the active authenticated sessions to the server and handles
  * authenticating users.
+ *
+ * The sessions are looked up on every request, but they are rarely created or
+ * removed. The lookups read an immutable snapshot of the session map without
+ * taking the lock of the writers, which replace the snapshot with a modified
+ * copy. Expired sessions are removed by a background thread.
  */
 class SessionManager
 {
 public:
-  SessionManager(const Authentication* authEngine_);
+  /**
+   * The expired sessions are removed in every expiryPeriod_.
+   */
+  SessionManager(
+    const Authentication* authEngine_,
+    std::chrono::milliseconds expiryPeriod_ = std::chrono::seconds(60));
+  ~SessionManager();
 
   bool isRequiringAuthentication() const;
 
@@ -53,12 +69,52 @@ public:
                                                const std::string& password_);
 
 private:
+  typedef std::unordered_map<std::string, std::shared_ptr<Session>> SessionMap;
+
   const Authentication* _authEngine;
 
-  mutable std::mutex _sessionMapLock;
-  std::unordered_map<std::string, Session> _sessions;
+  /**
+   * The session shared between all users if authentication is disabled.
+   */
+  std::unique_ptr<Session> _defaultSession;
+
+  /**
+   * Snapshot of the sessions. It is read by std::atomic_load() and replaced by
+   * std::atomic_store() while holding _writeLock.
+   */
+  std::shared_ptr<const SessionMap> _sessions;
+
+  /**
+   * Sessions removed from the map. Request handlers may still use them, so
+   * they are destroyed one expiry period after their removal.
+   */
+  std::vector<std::shared_ptr<Session>> _retiredSessions;
+  std::vector<std::shared_ptr<Session>> _oldRetiredSessions;
 
-  void cleanupOldSessions();
+  const std::chrono::milliseconds _expiryPeriod;
+
+  std::mutex _writeLock;
+  std::condition_variable _expiryCondition;
+  bool _stopExpiry;
+  std::thread _expiryThread;
+
+  /**
+   * Replaces the snapshot of the sessions. The sessions removed from the map
+   * must be moved to _retiredSessions. This method expects to be called in a
+   * locked context.
+   */
+  void publish(std::shared_ptr<const SessionMap> sessions_);
+
+  /**
+   * Removes the expired sessions and destroys the ones retired before the
+   * previous call. This method expects to be called in a locked context.
+   */
+  void expireSessions();
+
+  /**
+   * Body of the background thread calling expireSessions() periodically.
+   */
+  void runExpiry();
 };
 
 } // namespace webserver
@@ -22,6 +22,8 @@ const unsigned ThreadedMongoose::DEFAULT_MAX_THREAD;
 
 ThreadedMongoose::Handler ThreadedMongoose::handler;
 
+thread_local mg_server* ThreadedMongoose::polledServer = nullptr;
+
 ThreadedMongoose::ThreadedMongoose(int numThreads_) : _numThreads(numThreads_)
 {
 }
@@ -38,6 +40,11 @@ std::string ThreadedMongoose::getOption(const std::string& optName_)
   return _options[optName_];
 }
 
+void ThreadedMongoose::setStopHandler(std::function<void()> stopHandler_)
+{
+  _stopHandler = std::move(stopHandler_);
+}
+
 void ThreadedMongoose::run(Handler handler_)
 {
   run((void*)0, handler_);
@@ -48,8 +55,15 @@ void ThreadedMongoose::signalHandler(int sigNum_)
   ThreadedMongoose::exitFlag = sigNum_;
 }
 
+mg_server* ThreadedMongoose::currentServer()
+{
+  return polledServer;
+}
+
 void* ThreadedMongoose::serve(void* server_)
 {
+  polledServer = static_cast<mg_server*>(server_);
+
   while (!exitFlag)
   {
     mg_poll_server((mg_server*)server_, 1000);
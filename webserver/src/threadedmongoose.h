@@ -1,9 +1,11 @@
 #ifndef CC_WEBSERVER_THREADEDMONGOOSE_H
 #define CC_WEBSERVER_THREADEDMONGOOSE_H
 
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <thread>
 #include <vector>
@@ -36,9 +38,10 @@ public:
 
   /**
    * Constructor for creating a multithreaded Mongoose server.
-   * @param numThreads_ Number of threads to run the server on. If its value is
-   * less than 1 then by default maximum the number of available cores and the
-   * value of DEFAULT_MAX_THREAD will be used.
+   * @param numThreads_ Number of threads polling the connections. The request
+   * handlers are expected to hand slow requests over to worker threads, so a
+   * few polling threads are enough. If its value is less than 1 then the
+   * number of available cores, at most DEFAULT_MAX_THREAD, will be used.
    */
   ThreadedMongoose(int numThreads_ = 0);
 
@@ -56,8 +59,22 @@ public:
    */
   std::string getOption(const std::string& optName_);
 
+  /**
+   * Sets a function which is called when the server stops, after the polling
+   * threads have finished but before the servers are destroyed. Work which
+   * may still wake up the servers has to be finished here.
+   */
+  void setStopHandler(std::function<void()> stopHandler_);
+
   void run(Handler handler_);
 
+  /**
+   * Returns the server polled by the current thread, or nullptr if the thread
+   * is not a polling thread. Worker threads can wake it up with
+   * mg_wakeup_server() when the response of a connection is ready.
+   */
+  static mg_server* currentServer();
+
   template <typename T>
   void run(T* serverData_, Handler handler_)
   {
@@ -72,8 +89,8 @@ public:
 
     if (_numThreads < 1)
     {
-      _numThreads
-        = std::max(std::thread::hardware_concurrency(), DEFAULT_MAX_THREAD);
+      _numThreads = std::max(
+        std::min(std::thread::hardware_concurrency(), DEFAULT_MAX_THREAD), 1u);
     }
 
     std::vector<ServerPtr> servers;
@@ -130,7 +147,12 @@ public:
       servers.push_back(std::move(server));
     }
 
-    // ~joiner waits for all threads to finish
+    for (std::thread& thread : threads)
+      thread.join();
+
+    if (_stopHandler)
+      _stopHandler();
+
     // ~servers releases the servers' resources
     // ~termSig and ~intSig restores signal handlers
   }
@@ -142,10 +164,12 @@ private:
 
   static volatile int exitFlag;
   static Handler handler;
-  static const unsigned DEFAULT_MAX_THREAD = 20u;
+  static thread_local mg_server* polledServer;
+  static const unsigned DEFAULT_MAX_THREAD = 4u;
 
   std::map<std::string, std::string> _options;
   int _numThreads;
+  std::function<void()> _stopHandler;
 };
 
 } // mongoose
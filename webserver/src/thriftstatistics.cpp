@@ -0,0 +1,64 @@
+#include <sstream>
+
+#include <webserver/thriftstatistics.h>
+
+namespace cc
+{
+namespace webserver
+{
+
+ThriftStatistics& ThriftStatistics::instance()
+{
+  static ThriftStatistics statistics;
+  return statistics;
+}
+
+void ThriftStatistics::record(
+  const std::string& endpoint_,
+  std::size_t requestBytes_,
+  std::size_t responseBytes_,
+  std::size_t sentBytes_)
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  EndpointTraffic& traffic = _traffic[endpoint_];
+  ++traffic.calls;
+  traffic.requestBytes += requestBytes_;
+  traffic.responseBytes += responseBytes_;
+  traffic.sentBytes += sentBytes_;
+}
+
+std::map<std::string, EndpointTraffic> ThriftStatistics::traffic() const
+{
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _traffic;
+}
+
+std::string ThriftStatistics::toJson() const
+{
+  std::ostringstream json;
+  json << '{';
+
+  bool first = true;
+  for (const auto& endpoint : traffic())
+  {
+    if (!first)
+      json << ',';
+    first = false;
+
+    // Endpoint names consist of service and function identifiers, they need
+    // no escaping.
+    json
+      << '"' << endpoint.first << "\":{"
+      << "\"calls\":" << endpoint.second.calls
+      << ",\"requestBytes\":" << endpoint.second.requestBytes
+      << ",\"responseBytes\":" << endpoint.second.responseBytes
+      << ",\"sentBytes\":" << endpoint.second.sentBytes << '}';
+  }
+
+  json << '}';
+  return json.str();
+}
+
+} // webserver
+} // cc
@@ -11,8 +11,11 @@
 #include <util/logutil.h>
 #include <util/webserverutil.h>
 
+#include <webserver/filecache.h>
+
 #include "authentication.h"
 #include "mainrequesthandler.h"
+#include "requestscheduler.h"
 #include "sessionmanager.h"
 #include "threadedmongoose.h"
 
@@ -38,7 +41,18 @@ po::options_description commandLineArguments()
          "Logging level of the parser. Possible values are: debug, info, warning, "
          "error, critical")
         ("jobs,j", po::value<int>()->default_value(4),
-         "Number of worker threads.");
+         "Number of worker threads.")
+        ("io-threads", po::value<int>()->default_value(2),
+         "Number of threads accepting the connections and doing the network "
+         "I/O. The requests are processed on the worker threads.")
+        ("endpoint-limit", po::value<std::vector<std::string>>()->multitoken(),
+         "Maximal number of worker threads used by a service or a service "
+         "function at the same time, e.g. CppReparseService=2 or "
+         "CppService/getDiagram=2. By default the reparse service and the "
+         "diagrams may use a quarter of the workers each.")
+        ("file-cache-size", po::value<int>()->default_value(256),
+         "Memory limit of the cache of file contents and file information "
+         "shared by the services, in MiB. 0 disables the cache.");
 
     return desc;
 }
@@ -133,12 +147,72 @@ int main(int argc, char* argv[])
 
     //--- Process workspaces ---//
 
-    cc::webserver::ServerContext ctx(compassRoot, vm, sessions.get());
+    //--- Set up the file cache ---//
+
+    std::unique_ptr<FileCache> fileCache;
+    if (vm["file-cache-size"].as<int>() > 0)
+    {
+        fileCache = std::make_unique<FileCache>(
+            std::size_t(vm["file-cache-size"].as<int>()) * 1024 * 1024);
+        requestHandler.fileCache = fileCache.get();
+    }
+
+    cc::webserver::ServerContext ctx(
+        compassRoot, vm, sessions.get(), fileCache.get());
     requestHandler.pluginHandler.configure(ctx);
 
+    //--- Set up the request workers ---//
+
+    std::size_t workers = std::max(vm["jobs"].as<int>(), 1);
+    std::map<std::string, std::size_t> limits;
+
+    if (vm.count("endpoint-limit"))
+    {
+        for (const std::string& limit :
+            vm["endpoint-limit"].as<std::vector<std::string>>())
+        {
+            std::size_t pos = limit.find('=');
+
+            try
+            {
+                if (pos == std::string::npos)
+                    throw std::invalid_argument(limit);
+
+                limits[limit.substr(0, pos)]
+                    = std::stoul(limit.substr(pos + 1));
+            }
+            catch (const std::exception&)
+            {
+                LOG(error) << "Invalid endpoint limit: " << limit;
+                return 1;
+            }
+        }
+    }
+    else
+    {
+        // Slow endpoints should not occupy the workers of the fast ones.
+        std::size_t slowLimit = std::max<std::size_t>(workers / 4, 1);
+        for (const char* endpoint : {
+            "CppReparseService",
+            "CppService/getDiagram",
+            "CppService/getFileDiagram"})
+            limits[endpoint] = slowLimit;
+    }
+
+    std::unique_ptr<RequestScheduler> scheduler{
+        std::make_unique<RequestScheduler>(workers, limits)};
+    requestHandler.scheduler = scheduler.get();
+
     //--- Start mongoose server ---//
 
-    cc::webserver::ThreadedMongoose server(vm["jobs"].as<int>());
+    cc::webserver::ThreadedMongoose server(vm["io-threads"].as<int>());
+
+    // The workers may wake up the servers until they finish.
+    server.setStopHandler([&]() {
+        requestHandler.scheduler = nullptr;
+        scheduler.reset();
+    });
+
     server.setOption("listening_port", std::to_string(vm["port"].as<int>()));
     server.setOption("document_root", vm["webguiDir"].as<std::string>());
 
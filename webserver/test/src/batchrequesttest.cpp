@@ -0,0 +1,85 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "batchrequest.h"
+
+using namespace cc::webserver;
+
+namespace
+{
+
+std::vector<BatchCall> parse(const std::string& body_)
+{
+  return parseBatchRequest(body_.data(), body_.size());
+}
+
+std::string message(const BatchCall& call_)
+{
+  return std::string(call_.message, call_.messageLength);
+}
+
+} // namespace
+
+TEST(BatchRequestTest, CallsAreSplit)
+{
+  std::string body =
+    " [ [\"ProjectService\", [1,\"getFileInfo\",1,0,{\"1\":{\"str\":\"42\"}}]],"
+    "\n  [\"CppService\",{\"a\":[1,2,{}]}] ] ";
+
+  std::vector<BatchCall> calls = parse(body);
+
+  ASSERT_EQ(calls.size(), 2u);
+  EXPECT_EQ(calls[0].service, "ProjectService");
+  EXPECT_EQ(message(calls[0]),
+    "[1,\"getFileInfo\",1,0,{\"1\":{\"str\":\"42\"}}]");
+  EXPECT_EQ(calls[1].service, "CppService");
+  EXPECT_EQ(message(calls[1]), "{\"a\":[1,2,{}]}");
+
+  // The messages point into the body.
+  EXPECT_GE(calls[0].message, body.data());
+  EXPECT_LE(calls[1].message + calls[1].messageLength,
+    body.data() + body.size());
+}
+
+TEST(BatchRequestTest, BracketsInStringsAreIgnored)
+{
+  std::string body = "[[\"S\",[1,\"]}\\\"[\",{\"x\":\"{\"}]]]";
+  std::vector<BatchCall> calls = parse(body);
+
+  ASSERT_EQ(calls.size(), 1u);
+  EXPECT_EQ(message(calls[0]), "[1,\"]}\\\"[\",{\"x\":\"{\"}]");
+}
+
+TEST(BatchRequestTest, EmptyBatch)
+{
+  EXPECT_TRUE(parse("[]").empty());
+  EXPECT_TRUE(parse("  [ ]\n").empty());
+}
+
+TEST(BatchRequestTest, MalformedInputIsRejected)
+{
+  const char* malformed[] = {
+    "",
+    "{}",
+    "[",
+    "[[\"S\"]]",
+    "[[\"S\",]]",
+    "[[\"S\",1]]",
+    "[[S,[1]]]",
+    "[[\"S\",[1]]",
+    "[[\"S\",[1,[2]]]",
+    "[[\"S\",[1,\"]]]",
+    "[[\"S\",[1]],]",
+    "[[\"S\",[1]] [\"T\",[2]]]",
+    "[[\"S\",[1],[2]]]",
+    "[[\"S\",[1]]] trailing",
+    "[[\"S\",[1,\"\\"};
+
+  for (const char* body : malformed)
+    EXPECT_THROW(parse(body), std::runtime_error) << "Body: " << body;
+}
@@ -0,0 +1,191 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include <zlib.h>
+
+#ifdef CC_WEBSERVER_WITH_BROTLI
+#include <brotli/decode.h>
+#endif
+
+#include <webserver/httpcompression.h>
+
+using namespace cc::webserver;
+
+namespace
+{
+
+/**
+ * Returns a JSON-like response body which compresses well.
+ */
+std::string responseBody()
+{
+  std::string body = "[";
+  for (int i = 0; i < 1000; ++i)
+    body += "{\"id\":\"" + std::to_string(i * 7919) + "\",\"name\":\"entity"
+      + std::to_string(i) + "\"},";
+  body.back() = ']';
+  return body;
+}
+
+std::string compress(ContentEncoding encoding_, const std::string& data_)
+{
+  std::string out;
+  EXPECT_TRUE(compressContent(encoding_,
+    reinterpret_cast<const std::uint8_t*>(data_.data()), data_.size(), out));
+  return out;
+}
+
+/**
+ * Decompresses a zlib or gzip stream. The window bits select the wrapper.
+ */
+std::string inflate(
+  const std::string& data_,
+  std::size_t size_,
+  int windowBits_)
+{
+  z_stream stream{};
+  if (inflateInit2(&stream, windowBits_) != Z_OK)
+    return std::string();
+
+  std::string out(size_, '\0');
+
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data_.data()));
+  stream.avail_in = data_.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  stream.avail_out = out.size();
+
+  int result = ::inflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  inflateEnd(&stream);
+
+  return result == Z_STREAM_END ? out : std::string();
+}
+
+} // namespace
+
+TEST(HttpCompressionTest, NoHeader)
+{
+  EXPECT_EQ(ContentEncoding::Identity, negotiateContentEncoding(nullptr));
+  EXPECT_EQ(ContentEncoding::Identity, negotiateContentEncoding(""));
+  EXPECT_EQ(ContentEncoding::Identity, negotiateContentEncoding("identity"));
+  EXPECT_EQ(ContentEncoding::Identity, negotiateContentEncoding("compress"));
+}
+
+TEST(HttpCompressionTest, ServerPreference)
+{
+  EXPECT_EQ(ContentEncoding::Gzip, negotiateContentEncoding("gzip"));
+  EXPECT_EQ(ContentEncoding::Gzip, negotiateContentEncoding("x-gzip"));
+  EXPECT_EQ(ContentEncoding::Deflate, negotiateContentEncoding("Deflate"));
+  EXPECT_EQ(ContentEncoding::Gzip,
+    negotiateContentEncoding("deflate, gzip, compress"));
+
+#ifdef CC_WEBSERVER_WITH_BROTLI
+  EXPECT_EQ(ContentEncoding::Brotli,
+    negotiateContentEncoding("gzip, deflate, br"));
+#else
+  EXPECT_EQ(ContentEncoding::Gzip,
+    negotiateContentEncoding("gzip, deflate, br"));
+#endif
+}
+
+TEST(HttpCompressionTest, QualityValues)
+{
+  // The nonzero quality values don't change the server's preference.
+  EXPECT_EQ(ContentEncoding::Gzip,
+    negotiateContentEncoding("deflate;q=1.0, gzip;q=0.5"));
+  EXPECT_EQ(ContentEncoding::Gzip, negotiateContentEncoding("gzip;q=0.001"));
+
+  // Zero quality rejects the coding.
+  EXPECT_EQ(ContentEncoding::Deflate,
+    negotiateContentEncoding("gzip;q=0, deflate"));
+  EXPECT_EQ(ContentEncoding::Deflate,
+    negotiateContentEncoding("gzip ; Q=0.000, deflate;q=0.5"));
+  EXPECT_EQ(ContentEncoding::Identity,
+    negotiateContentEncoding("gzip;q=0, deflate;q=0.0"));
+
+  // Identity is used anyway if nothing else is acceptable.
+  EXPECT_EQ(ContentEncoding::Gzip,
+    negotiateContentEncoding("identity;q=0, gzip"));
+  EXPECT_EQ(ContentEncoding::Identity,
+    negotiateContentEncoding("identity;q=0"));
+}
+
+TEST(HttpCompressionTest, Wildcard)
+{
+#ifdef CC_WEBSERVER_WITH_BROTLI
+  EXPECT_EQ(ContentEncoding::Brotli, negotiateContentEncoding("*"));
+  EXPECT_EQ(ContentEncoding::Gzip, negotiateContentEncoding("br;q=0, *"));
+#else
+  EXPECT_EQ(ContentEncoding::Gzip, negotiateContentEncoding("*"));
+#endif
+
+  // The listed codings are not matched by the wildcard.
+  EXPECT_EQ(ContentEncoding::Deflate,
+    negotiateContentEncoding("br;q=0, gzip;q=0, *;q=0.5"));
+  EXPECT_EQ(ContentEncoding::Identity,
+    negotiateContentEncoding("br;q=0, gzip;q=0, deflate;q=0, *"));
+  EXPECT_EQ(ContentEncoding::Identity, negotiateContentEncoding("*;q=0"));
+  EXPECT_EQ(ContentEncoding::Deflate,
+    negotiateContentEncoding("deflate, *;q=0"));
+}
+
+TEST(HttpCompressionTest, Names)
+{
+  EXPECT_STREQ("identity", contentEncodingName(ContentEncoding::Identity));
+  EXPECT_STREQ("deflate", contentEncodingName(ContentEncoding::Deflate));
+  EXPECT_STREQ("gzip", contentEncodingName(ContentEncoding::Gzip));
+  EXPECT_STREQ("br", contentEncodingName(ContentEncoding::Brotli));
+}
+
+TEST(HttpCompressionTest, DeflateRoundTrip)
+{
+  std::string body = responseBody();
+  std::string compressed = compress(ContentEncoding::Deflate, body);
+
+  EXPECT_LT(compressed.size(), body.size() / 2);
+  EXPECT_EQ(body, inflate(compressed, body.size(), MAX_WBITS));
+}
+
+TEST(HttpCompressionTest, GzipRoundTrip)
+{
+  std::string body = responseBody();
+  std::string compressed = compress(ContentEncoding::Gzip, body);
+
+  EXPECT_LT(compressed.size(), body.size() / 2);
+  EXPECT_EQ(body, inflate(compressed, body.size(), MAX_WBITS + 16));
+
+  // An empty body is compressed too.
+  EXPECT_EQ("", inflate(
+    compress(ContentEncoding::Gzip, ""), 0, MAX_WBITS + 16));
+}
+
+#ifdef CC_WEBSERVER_WITH_BROTLI
+TEST(HttpCompressionTest, BrotliRoundTrip)
+{
+  std::string body = responseBody();
+  std::string compressed = compress(ContentEncoding::Brotli, body);
+
+  EXPECT_LT(compressed.size(), body.size() / 2);
+
+  std::string out(body.size(), '\0');
+  std::size_t outSize = out.size();
+  ASSERT_EQ(BROTLI_DECODER_RESULT_SUCCESS, BrotliDecoderDecompress(
+    compressed.size(), reinterpret_cast<const std::uint8_t*>(compressed.data()),
+    &outSize, reinterpret_cast<std::uint8_t*>(&out[0])));
+  out.resize(outSize);
+
+  EXPECT_EQ(body, out);
+}
+#endif
+
+TEST(HttpCompressionTest, IdentityIsNotCompressed)
+{
+  std::string out;
+  EXPECT_FALSE(compressContent(ContentEncoding::Identity,
+    reinterpret_cast<const std::uint8_t*>("text"), 4, out));
+}
@@ -0,0 +1,211 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "requestscheduler.h"
+
+using namespace cc::webserver;
+
+namespace
+{
+
+/**
+ * Waits until the condition holds. Returns false on timeout.
+ */
+bool waitFor(const std::function<bool()>& condition_)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+  while (!condition_())
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  return true;
+}
+
+/**
+ * Jobs which block until the gate is opened, and count how many of them run
+ * at the same time.
+ */
+class GatedJobs
+{
+public:
+  GatedJobs() : _opened(_gate.get_future().share())
+  {
+  }
+
+  RequestScheduler::Job job()
+  {
+    return [this]()
+    {
+      std::size_t running = ++_running;
+
+      std::size_t max = _maxRunning;
+      while (running > max && !_maxRunning.compare_exchange_weak(max, running))
+        ;
+
+      _opened.wait();
+
+      --_running;
+      ++_completed;
+    };
+  }
+
+  void open() { _gate.set_value(); }
+
+  std::size_t running() const { return _running; }
+  std::size_t maxRunning() const { return _maxRunning; }
+  std::size_t completed() const { return _completed; }
+
+private:
+  std::promise<void> _gate;
+  std::shared_future<void> _opened;
+  std::atomic<std::size_t> _running{0};
+  std::atomic<std::size_t> _maxRunning{0};
+  std::atomic<std::size_t> _completed{0};
+};
+
+} // namespace
+
+TEST(RequestSchedulerTest, ServiceLimit)
+{
+  GatedJobs slow;
+  std::unique_ptr<RequestScheduler> scheduler(
+    new RequestScheduler(4, {{"SlowService", 1}}));
+
+  for (int i = 0; i < 5; ++i)
+    scheduler->submit("SlowService", "getDiagram", slow.job());
+
+  ASSERT_TRUE(waitFor([&]{ return slow.running() == 1; }));
+
+  RequestScheduler::GroupStatistics stats
+    = scheduler->statistics()["SlowService"];
+  EXPECT_EQ(1u, stats.limit);
+  EXPECT_EQ(1u, stats.running);
+  EXPECT_EQ(4u, stats.waiting);
+  EXPECT_EQ(4u, scheduler->queueDepth());
+
+  // The other services are not starved by the waiting requests.
+  std::promise<void> fastDone;
+  scheduler->submit("FastService", "getFileInfo",
+    [&]{ fastDone.set_value(); });
+  EXPECT_EQ(std::future_status::ready,
+    fastDone.get_future().wait_for(std::chrono::seconds(10)));
+
+  slow.open();
+  scheduler.reset();
+
+  EXPECT_EQ(5u, slow.completed());
+  EXPECT_EQ(1u, slow.maxRunning());
+}
+
+TEST(RequestSchedulerTest, FunctionLimit)
+{
+  GatedJobs diagrams;
+  GatedJobs others;
+  std::unique_ptr<RequestScheduler> scheduler(
+    new RequestScheduler(6, {{"CppService/getDiagram", 2}}));
+
+  for (int i = 0; i < 6; ++i)
+    scheduler->submit("CppService", "getDiagram", diagrams.job());
+
+  // The other functions of the service are not limited.
+  for (int i = 0; i < 3; ++i)
+    scheduler->submit("CppService", "getReferences", others.job());
+
+  ASSERT_TRUE(waitFor([&]{
+    return diagrams.running() == 2 && others.running() == 3;
+  }));
+
+  std::map<std::string, RequestScheduler::GroupStatistics> stats
+    = scheduler->statistics();
+  EXPECT_EQ(2u, stats["CppService/getDiagram"].running);
+  EXPECT_EQ(4u, stats["CppService/getDiagram"].waiting);
+  EXPECT_EQ(3u, stats["CppService"].running);
+  EXPECT_EQ(6u, stats["CppService"].limit);
+
+  diagrams.open();
+  others.open();
+  scheduler.reset();
+
+  EXPECT_EQ(6u, diagrams.completed());
+  EXPECT_EQ(2u, diagrams.maxRunning());
+  EXPECT_EQ(3u, others.completed());
+}
+
+TEST(RequestSchedulerTest, DrainOnStop)
+{
+  std::atomic<int> completed(0);
+
+  {
+    RequestScheduler scheduler(2, {{"LimitedService", 1}});
+
+    // The destructor waits for the queued requests, including the ones
+    // waiting for the limit of their group.
+    for (int i = 0; i < 20; ++i)
+    {
+      scheduler.submit("LimitedService", "f", [&]{
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ++completed;
+      });
+      scheduler.submit("OtherService", "f", [&]{ ++completed; });
+    }
+  }
+
+  EXPECT_EQ(40, completed);
+}
+
+TEST(RequestSchedulerTest, FailedRequest)
+{
+  std::atomic<int> completed(0);
+
+  {
+    RequestScheduler scheduler(1, {});
+
+    scheduler.submit("Service", "f", []{ throw std::runtime_error("error"); });
+    scheduler.submit("Service", "f", []{ throw 42; });
+    scheduler.submit("Service", "f", [&]{ ++completed; });
+  }
+
+  // The worker survives the exceptions.
+  EXPECT_EQ(1, completed);
+}
+
+TEST(RequestSchedulerTest, Statistics)
+{
+  RequestScheduler scheduler(2, {{"Service", 1}});
+
+  for (int i = 0; i < 3; ++i)
+    scheduler.submit("Service", "f", []{});
+
+  ASSERT_TRUE(waitFor([&]{
+    return scheduler.statistics()["Service"].completed == 3;
+  }));
+
+  RequestScheduler::GroupStatistics stats
+    = scheduler.statistics()["Service"];
+  EXPECT_EQ(0u, stats.running);
+  EXPECT_EQ(0u, stats.waiting);
+  EXPECT_EQ(3u, stats.queueTime.count);
+  EXPECT_EQ(3u, stats.runTime.count);
+  EXPECT_EQ(0u, scheduler.queueDepth());
+
+  std::string json = scheduler.toJson();
+  EXPECT_NE(std::string::npos, json.find("\"workers\":2"));
+  EXPECT_NE(std::string::npos, json.find(
+    "\"Service\":{\"limit\":1,\"running\":0,\"waiting\":0,\"completed\":3"));
+}
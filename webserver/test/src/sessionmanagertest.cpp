@@ -0,0 +1,202 @@
+#define GTEST_HAS_TR1_TUPLE 1
+#define GTEST_USE_OWN_TR1_TUPLE 0
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem.hpp>
+
+#include <gtest/gtest.h>
+
+#include "authentication.h"
+#include "sessionmanager.h"
+
+using namespace cc::webserver;
+
+namespace fs = boost::filesystem;
+
+namespace
+{
+
+/**
+ * Waits until the condition holds. Returns false on timeout.
+ */
+bool waitFor(const std::function<bool()>& condition_)
+{
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+
+  while (!condition_())
+  {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  return true;
+}
+
+/**
+ * Threads which look up a session until they are stopped, the way the request
+ * handlers do. It is an error if the session is found again after it was
+ * removed, or if it is not the session of the user.
+ */
+class SessionReaders
+{
+public:
+  SessionReaders(
+    SessionManager& manager_,
+    const std::string& cookie_,
+    const std::string& username_)
+  {
+    SessionManager* manager = &manager_;
+
+    for (int i = 0; i < 4; ++i)
+      _threads.emplace_back([this, manager, cookie_, username_]{
+        bool removed = false;
+
+        while (!_stop)
+        {
+          const Session* session = manager->getSessionCookie(cookie_.c_str());
+
+          if (!session)
+          {
+            removed = true;
+            ++_missed;
+          }
+          else if (session->username == username_ && !removed)
+            ++_found;
+          else
+            ++_errors;
+        }
+      });
+  }
+
+  ~SessionReaders()
+  {
+    _stop = true;
+    for (std::thread& thread : _threads)
+      thread.join();
+  }
+
+  std::size_t found() const { return _found; }
+  std::size_t missed() const { return _missed; }
+  std::size_t errors() const { return _errors; }
+
+private:
+  std::vector<std::thread> _threads;
+  std::atomic<bool> _stop{false};
+  std::atomic<std::size_t> _found{0};
+  std::atomic<std::size_t> _missed{0};
+  std::atomic<std::size_t> _errors{0};
+};
+
+} // namespace
+
+class SessionManagerTest : public ::testing::Test
+{
+protected:
+  void SetUp() override
+  {
+    char dir[] = "/tmp/sessionmanagertestXXXXXX";
+    ASSERT_NE(nullptr, ::mkdtemp(dir));
+    _root = dir;
+
+    // The sessions expire one second after the login.
+    std::string config = _root + "/authentication.json";
+    std::ofstream(config)
+      << "{\"enabled\": true, \"session-lifetime\": 1,"
+         " \"plain\": {\"enabled\": true, \"users\": [\"user:pass\"]}}";
+
+    _auth.reset(new Authentication(AUTH_PLUGIN_DIR, config));
+    ASSERT_TRUE(_auth->isEnabled());
+  }
+
+  void TearDown() override
+  {
+    _auth.reset();
+
+    boost::system::error_code ec;
+    fs::remove_all(_root, ec);
+  }
+
+  static std::string cookie(SessionManager& manager_, const Session* session_)
+  {
+    return "theme=dark; " + manager_.getSessionCookieName() + '='
+      + session_->sessId;
+  }
+
+  std::string _root;
+  std::unique_ptr<Authentication> _auth;
+};
+
+TEST_F(SessionManagerTest, Login)
+{
+  SessionManager manager(_auth.get());
+
+  EXPECT_EQ(nullptr,
+    manager.authenticateUserWithNameAndPassword("user", "wrong"));
+
+  Session* session = manager.authenticateUserWithNameAndPassword(
+    "user", "pass");
+  ASSERT_NE(nullptr, session);
+  EXPECT_EQ("user", session->username);
+  EXPECT_TRUE(manager.isValid(session));
+
+  EXPECT_EQ(
+    session, manager.getSessionCookie(cookie(manager, session).c_str()));
+  EXPECT_EQ(nullptr, manager.getSessionCookie(nullptr));
+  EXPECT_EQ(nullptr, manager.getSessionCookie("theme=dark"));
+}
+
+TEST_F(SessionManagerTest, ExpiryWithReaders)
+{
+  SessionManager manager(_auth.get(), std::chrono::milliseconds(20));
+
+  Session* session = manager.authenticateUserWithNameAndPassword(
+    "user", "pass");
+  ASSERT_NE(nullptr, session);
+
+  const std::string sessionCookie = cookie(manager, session);
+  SessionReaders readers(manager, sessionCookie, "user");
+  ASSERT_TRUE(waitFor([&]{ return readers.found() > 0; }));
+
+  // The expiry thread removes the session while it is being looked up, and
+  // the removed session remains readable for the lookups in progress.
+  ASSERT_TRUE(waitFor([&]{ return readers.missed() > 0; }));
+  EXPECT_EQ(nullptr, manager.getSessionCookie(sessionCookie.c_str()));
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  EXPECT_EQ(0u, readers.errors());
+}
+
+TEST_F(SessionManagerTest, LogoutWithReaders)
+{
+  SessionManager manager(_auth.get());
+
+  Session* session = manager.authenticateUserWithNameAndPassword(
+    "user", "pass");
+  Session* other = manager.authenticateUserWithNameAndPassword(
+    "user", "pass");
+  ASSERT_NE(nullptr, session);
+  ASSERT_NE(nullptr, other);
+
+  SessionReaders readers(manager, cookie(manager, session), "user");
+  SessionReaders otherReaders(manager, cookie(manager, other), "user");
+  ASSERT_TRUE(waitFor([&]{ return readers.found() > 0; }));
+
+  manager.destroySessionCookie(session);
+  ASSERT_TRUE(waitFor([&]{ return readers.missed() > 0; }));
+
+  // The other session of the user is not affected.
+  EXPECT_EQ(other, manager.getSessionCookie(cookie(manager, other).c_str()));
+  EXPECT_EQ(0u, otherReaders.missed());
+  EXPECT_EQ(0u, readers.errors() + otherReaders.errors());
+}